@@ -30,11 +30,6 @@
 #include <config.h>
 #endif
 
-/* required for asprintf(3) on macOS */
-#define _DARWIN_C_SOURCE
-/* required for asprintf(3) on Linux */
-#define _GNU_SOURCE
-
 #include "portgroup.h"
 #include "entry.h"
 #include "registry.h"
@@ -68,6 +63,32 @@
  *       deactivated/uninstalled.
  */
 
+/**
+ * Columns of registry.ports that can be accessed using `reg_entry_propget` and
+ * `reg_entry_propset`.
+ */
+static const char* entry_columns[] = {
+    "id",
+    "name",
+    "portfile",
+    "location",
+    "epoch",
+    "version",
+    "revision",
+    "variants",
+    "negated_variants",
+    "state",
+    "date",
+    "installtype",
+    "archs",
+    "requested",
+    "os_platform",
+    "os_major",
+    "cxx_stdlib",
+    "cxx_stdlib_overridden",
+    NULL
+};
+
 /**
  * Converts a `sqlite3_stmt` into a `reg_entry`. The first column of the stmt's
  * row must be the id of an entry; the second either `SQLITE_NULL` or the
@@ -123,7 +144,7 @@ reg_entry* reg_entry_create(reg_registry* reg, char* name, char* version,
     reg_entry* entry = NULL;
     char* query = "INSERT INTO registry.ports "
         "(name, version, revision, variants, epoch) VALUES (?, ?, ?, ?, ?)";
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC)
                 == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 2, version, -1, SQLITE_STATIC)
@@ -137,32 +158,28 @@ reg_entry* reg_entry_create(reg_registry* reg, char* name, char* version,
         int r;
         Tcl_HashEntry* hash;
         int is_new;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_DONE:
-                    entry = malloc(sizeof(reg_entry));
-                    if (entry) {
-                        entry->id = sqlite3_last_insert_rowid(reg->db);
-                        entry->reg = reg;
-                        entry->proc = NULL;
-                        hash = Tcl_CreateHashEntry(&reg->open_entries,
-                                (const char*)&entry->id, &is_new);
-                        Tcl_SetHashValue(hash, entry);
-                    }
-                    break;
-                case SQLITE_BUSY:
-                    break;
-                default:
-                    reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+        r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_DONE:
+                entry = malloc(sizeof(reg_entry));
+                if (entry) {
+                    entry->id = sqlite3_last_insert_rowid(reg->db);
+                    entry->reg = reg;
+                    entry->proc = NULL;
+                    hash = Tcl_CreateHashEntry(&reg->open_entries,
+                            (const char*)&entry->id, &is_new);
+                    Tcl_SetHashValue(hash, entry);
+                }
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     return entry;
 }
@@ -198,7 +215,7 @@ reg_entry* reg_entry_open(reg_registry* reg, char* name, char* version,
 #endif
                 "WHERE name=? AND version=? AND revision=? AND variants=? AND epoch!=?";
     }
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC)
                 == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 2, version, -1, SQLITE_STATIC)
@@ -209,32 +226,27 @@ reg_entry* reg_entry_open(reg_registry* reg, char* name, char* version,
                 == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 5, epoch, -1, SQLITE_STATIC)
                 == SQLITE_OK)) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_ROW:
-                    reg_stmt_to_entry(reg, (void**)&entry, stmt, &lower_bound, errPtr);
-                    break;
-                case SQLITE_DONE:
-                    errPtr->code = REG_NOT_FOUND;
-                    errPtr->description = sqlite3_mprintf("no matching port found for: " \
-                            "name=%s, version=%s, revision=%s, variants=%s, epoch=%s", \
-                            name, version, revision, variants, epoch);
-                    errPtr->free = (reg_error_destructor*) sqlite3_free;
-                    break;
-                case SQLITE_BUSY:
-                    continue;
-                default:
-                    reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_ROW:
+                reg_stmt_to_entry(reg, (void**)&entry, stmt, &lower_bound, errPtr);
+                break;
+            case SQLITE_DONE:
+                errPtr->code = REG_NOT_FOUND;
+                errPtr->description = sqlite3_mprintf("no matching port found for: " \
+                        "name=%s, version=%s, revision=%s, variants=%s, epoch=%s", \
+                        name, version, revision, variants, epoch);
+                errPtr->free = (reg_error_destructor*) sqlite3_free;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     return entry;
 }
@@ -259,90 +271,72 @@ int reg_entry_delete(reg_entry* entry, reg_error* errPtr) {
     char* files_query = "DELETE FROM registry.files WHERE id=?";
     char* dependencies_query = "DELETE FROM registry.dependencies WHERE id=?";
     char* portgroups_query = "DELETE FROM registry.portgroups WHERE id=?";
-    if ((sqlite3_prepare_v2(reg->db, ports_query, -1, &ports, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, ports_query, &ports) == SQLITE_OK)
             && (sqlite3_bind_int64(ports, 1, entry->id) == SQLITE_OK)
-            && (sqlite3_prepare_v2(reg->db, files_query, -1, &files, NULL)
-                == SQLITE_OK)
+            && (reg_stmt_prepare(reg, files_query, &files) == SQLITE_OK)
             && (sqlite3_bind_int64(files, 1, entry->id) == SQLITE_OK)
-            && (sqlite3_prepare_v2(reg->db, dependencies_query, -1, &dependencies,
-                    NULL) == SQLITE_OK)
+            && (reg_stmt_prepare(reg, dependencies_query, &dependencies)
+                == SQLITE_OK)
             && (sqlite3_bind_int64(dependencies, 1, entry->id) == SQLITE_OK)
-            && (sqlite3_prepare_v2(reg->db, portgroups_query, -1, &portgroups,
-                    NULL) == SQLITE_OK)
+            && (reg_stmt_prepare(reg, portgroups_query, &portgroups)
+                == SQLITE_OK)
             && (sqlite3_bind_int64(portgroups, 1, entry->id) == SQLITE_OK)) {
-        int r;
-        do {
-            r = sqlite3_step(ports);
-            switch (r) {
-                case SQLITE_DONE:
-                    if (sqlite3_changes(reg->db) > 0) {
-                        do {
-                            r = sqlite3_step(files);
+        int r = sqlite3_step(ports);
+        switch (r) {
+            case SQLITE_DONE:
+                if (sqlite3_changes(reg->db) > 0) {
+                    r = sqlite3_step(files);
+                    switch (r) {
+                        case SQLITE_DONE:
+                            r = sqlite3_step(dependencies);
                             switch (r) {
                                 case SQLITE_DONE:
-                                    do {
-                                        r = sqlite3_step(dependencies);
-                                        switch (r) {
-                                            case SQLITE_DONE:
-                                                do {
-                                                    r = sqlite3_step(portgroups);
-                                                    switch (r) {
-                                                        case SQLITE_DONE:
-                                                            result = 1;
-                                                            break;
-                                                        case SQLITE_BUSY:
-                                                            break;
-                                                        case SQLITE_ERROR:
-                                                            reg_sqlite_error(reg->db,
-                                                                    errPtr, NULL);
-                                                            break;
-                                                    }
-                                                } while (r == SQLITE_BUSY);
-                                                break;
-                                            case SQLITE_BUSY:
-                                                break;
-                                            case SQLITE_ERROR:
-                                                reg_sqlite_error(reg->db,
-                                                        errPtr, NULL);
-                                                break;
-                                        }
-                                    } while (r == SQLITE_BUSY);
-                                    break;
-                                case SQLITE_BUSY:
+                                    r = sqlite3_step(portgroups);
+                                    switch (r) {
+                                        case SQLITE_DONE:
+                                            result = 1;
+                                            break;
+                                        default:
+                                            reg_sqlite_error(reg->db,
+                                                    errPtr, NULL);
+                                            break;
+                                    }
                                     break;
-                                case SQLITE_ERROR:
-                                    reg_sqlite_error(reg->db, errPtr, NULL);
+                                default:
+                                    reg_sqlite_error(reg->db,
+                                            errPtr, NULL);
                                     break;
                             }
-                        } while (r == SQLITE_BUSY);
-                        break;
-                    } else {
-                        errPtr->code = REG_INVALID;
-                        errPtr->description = "an invalid entry was passed";
-                        errPtr->free = NULL;
+                            break;
+                        default:
+                            reg_sqlite_error(reg->db, errPtr, NULL);
+                            break;
                     }
                     break;
-                case SQLITE_BUSY:
-                    break;
-                case SQLITE_ERROR:
-                    reg_sqlite_error(reg->db, errPtr, NULL);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+                } else {
+                    errPtr->code = REG_INVALID;
+                    errPtr->description = "an invalid entry was passed";
+                    errPtr->free = NULL;
+                }
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, NULL);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, NULL);
     }
     if (ports) {
-        sqlite3_finalize(ports);
+        reg_stmt_release(ports);
     }
     if (files) {
-        sqlite3_finalize(files);
+        reg_stmt_release(files);
     }
     if (dependencies) {
-        sqlite3_finalize(dependencies);
+        reg_stmt_release(dependencies);
     }
     if (portgroups) {
-        sqlite3_finalize(portgroups);
+        reg_stmt_release(portgroups);
     }
     return result;
 }
@@ -381,6 +375,44 @@ static int reg_all_entries(reg_registry* reg, char* query, int query_len,
             reg_stmt_to_entry, &lower_bound, NULL, errPtr);
 }
 
+/**
+ * Appends the WHERE clause for an entry search to `query`. Keys and values are
+ * as for `reg_entry_search`.
+ *
+ * @param [in,out] query a reference to a query string allocated with `malloc`
+ * @param [in] keys       a list of keys to search by
+ * @param [in] vals       a list of values to search by, matching keys
+ * @param [in] key_count  the number of key/value pairs passed
+ * @param [in] strategies strategies to use (one of the `reg_strategy_*`
+ *                        constants)
+ * @param [out] errPtr    on error, a description of the error that occurred
+ * @return                true if success; false if failure
+ */
+static int reg_entry_search_where(char** query, const char** keys,
+        const char** vals, int key_count, int* strategies, reg_error* errPtr) {
+    int i;
+    char* kwd = " WHERE ";
+    size_t query_len, query_space;
+    char* op;
+    query_len = query_space = strlen(*query);
+    for (i=0; i<key_count; i++) {
+        /* get the strategy */
+        op = reg_strategy_op(strategies[i], errPtr);
+        if (op == NULL) {
+            return 0;
+        }
+        char* cond = sqlite3_mprintf(op, keys[i], vals[i]);
+        if (!cond || !reg_strcat(query, &query_len, &query_space, kwd)
+            || !reg_strcat(query, &query_len, &query_space, cond)) {
+            sqlite3_free(cond);
+            return 0;
+        }
+        sqlite3_free(cond);
+        kwd = " AND ";
+    }
+    return 1;
+}
+
 /**
  * Searches the registry for ports for which each key's value is equal to the
  * given value. To find all ports, pass a key_count of 0.
@@ -399,35 +431,200 @@ static int reg_all_entries(reg_registry* reg, char* query, int query_len,
  */
 int reg_entry_search(reg_registry* reg, const char** keys, const char** vals,
         int key_count, int *strategies, reg_entry*** entries, reg_error* errPtr) {
-    int i;
-    char* kwd = " WHERE ";
     char* query;
-    size_t query_len, query_space;
     int result;
-    char* op;
     /* build the query */
     query = strdup("SELECT id FROM registry.ports");
     if (!query) {
         return -1;
     }
+    if (!reg_entry_search_where(&query, keys, vals, key_count, strategies,
+                errPtr)) {
+        free(query);
+        return -1;
+    }
+    /* do the query */
+    result = reg_all_entries(reg, query, -1, entries, errPtr);
+    free(query);
+    return result;
+}
+
+/**
+ * Builds a query selecting the given columns of all ports matching the given
+ * search criteria. The column names are checked against the columns of
+ * registry.ports.
+ *
+ * @param [in] columns      the columns to select
+ * @param [in] column_count the number of columns
+ * @param [in] keys         a list of keys to search by
+ * @param [in] vals         a list of values to search by, matching keys
+ * @param [in] key_count    the number of key/value pairs passed
+ * @param [in] strategies   strategies to use (one of the `reg_strategy_*`
+ *                          constants)
+ * @param [in] with_rowid   whether to also select the rowid last, as
+ *                          `reg_rowid`
+ * @param [out] errPtr      on error, a description of the error that occurred
+ * @return                  the query, to be freed by the caller; NULL if
+ *                          failure
+ */
+static char* reg_entry_props_query(const char** columns, int column_count,
+        const char** keys, const char** vals, int key_count, int* strategies,
+        int with_rowid, reg_error* errPtr) {
+    char* query;
+    size_t query_len, query_space;
+    int i;
+    if (column_count < 1) {
+        reg_throw(errPtr, REG_MISUSE, "no properties requested");
+        return NULL;
+    }
+    /* build the query */
+    query = strdup("SELECT ");
+    if (!query) {
+        return NULL;
+    }
     query_len = query_space = strlen(query);
-    for (i=0; i<key_count; i++) {
-        /* get the strategy */
-        op = reg_strategy_op(strategies[i], errPtr);
-        if (op == NULL) {
-            return -1;
+    for (i=0; i<column_count; i++) {
+        if (!reg_check_column(entry_columns, columns[i], errPtr)) {
+            free(query);
+            return NULL;
         }
-        char* cond = sqlite3_mprintf(op, keys[i], vals[i]);
-        if (!cond || !reg_strcat(&query, &query_len, &query_space, kwd)
-            || !reg_strcat(&query, &query_len, &query_space, cond)) {
+        if ((i > 0 && !reg_strcat(&query, &query_len, &query_space, ", "))
+                || !reg_strcat(&query, &query_len, &query_space,
+                    (char*)columns[i])) {
             free(query);
-            return -1;
+            return NULL;
         }
-        sqlite3_free(cond);
-        kwd = " AND ";
     }
-    /* do the query */
-    result = reg_all_entries(reg, query, -1, entries, errPtr);
+    if ((with_rowid && !reg_strcat(&query, &query_len, &query_space,
+                    ", rowid AS reg_rowid"))
+            || !reg_strcat(&query, &query_len, &query_space,
+                " FROM registry.ports")
+            || !reg_entry_search_where(&query, keys, vals, key_count,
+                strategies, errPtr)) {
+        free(query);
+        return NULL;
+    }
+    return query;
+}
+
+/**
+ * Searches the registry like `reg_entry_search`, but returns the values of the
+ * given columns for each matching port instead of entries. This avoids having
+ * to open an entry and query each of its properties separately when only the
+ * values are needed.
+ *
+ * The values are returned in a single list holding `column_count` values per
+ * matching port. Values which are NULL in the database are returned as NULL.
+ * Both the list and all values in it need to be freed by the caller.
+ *
+ * @param [in] reg          registry to search in
+ * @param [in] columns      the columns to return for each port
+ * @param [in] column_count the number of columns
+ * @param [in] keys         a list of keys to search by
+ * @param [in] vals         a list of values to search by, matching keys
+ * @param [in] key_count    the number of key/value pairs passed
+ * @param [in] strategies   strategies to use (one of the `reg_strategy_*`
+ *                          constants)
+ * @param [out] rows        the values of the requested columns, row by row
+ * @param [out] errPtr      on error, a description of the error that occurred
+ * @return                  the number of matching ports if success; negative
+ *                          if failure
+ */
+int reg_entry_search_props(reg_registry* reg, const char** columns,
+        int column_count, const char** keys, const char** vals, int key_count,
+        int* strategies, char*** rows, reg_error* errPtr) {
+    sqlite3_stmt* stmt = NULL;
+    char* query;
+    char** result;
+    int result_count = 0;
+    int result_space = 10;
+    int i;
+    int r;
+
+    query = reg_entry_props_query(columns, column_count, keys, vals,
+            key_count, strategies, 0, errPtr);
+    if (!query) {
+        return -1;
+    }
+
+    result = malloc(result_space * sizeof(char*));
+    if (!result) {
+        free(query);
+        return -1;
+    }
+    if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK) {
+        do {
+            r = sqlite3_step(stmt);
+            switch (r) {
+                case SQLITE_ROW:
+                    for (i=0; i<column_count && r == SQLITE_ROW; i++) {
+                        const char* text =
+                            (const char*)sqlite3_column_text(stmt, i);
+                        char* element = NULL;
+                        if (text && !(element = strdup(text))) {
+                            r = SQLITE_ERROR;
+                        } else if (!reg_listcat((void***)&result,
+                                    &result_count, &result_space, element)) {
+                            free(element);
+                            r = SQLITE_ERROR;
+                        }
+                    }
+                    break;
+                case SQLITE_DONE:
+                    break;
+                default:
+                    reg_sqlite_error(reg->db, errPtr, query);
+                    break;
+            }
+        } while (r == SQLITE_ROW);
+    } else {
+        r = SQLITE_ERROR;
+        reg_sqlite_error(reg->db, errPtr, query);
+    }
+    if (stmt) {
+        sqlite3_finalize(stmt);
+    }
+    free(query);
+    if (r == SQLITE_DONE) {
+        *rows = result;
+        return result_count / column_count;
+    }
+    for (i=0; i<result_count; i++) {
+        free(result[i]);
+    }
+    free(result);
+    return -1;
+}
+
+/**
+ * Searches the registry like `reg_entry_search_props`, but instead of
+ * collecting the values of all matching ports, calls `fn` with the values of
+ * each matching row in turn, `values[i]` holding the value of `columns[i]`.
+ * `fn` can return false to stop the search early. See `reg_foreach_row`.
+ *
+ * @param [in] reg          registry to search in
+ * @param [in] columns      the columns to select for each port
+ * @param [in] column_count the number of columns
+ * @param [in] keys         a list of keys to search by
+ * @param [in] vals         a list of values to search by, matching keys
+ * @param [in] key_count    the number of key/value pairs passed
+ * @param [in] strategies   strategies to use (one of the `reg_strategy_*`
+ *                          constants)
+ * @param [in] fn           function to call for each matching port
+ * @param [in] calldata     data passed along to `fn`
+ * @param [out] errPtr      on error, a description of the error that occurred
+ * @return                  true if success; false if failure
+ */
+int reg_entry_foreach(reg_registry* reg, const char** columns,
+        int column_count, const char** keys, const char** vals, int key_count,
+        int* strategies, row_function* fn, void* calldata, reg_error* errPtr) {
+    int result;
+    char* query = reg_entry_props_query(columns, column_count, keys, vals,
+            key_count, strategies, 1, errPtr);
+    if (!query) {
+        return 0;
+    }
+    result = reg_foreach_row(reg, query, -1, fn, calldata, errPtr);
     free(query);
     return result;
 }
@@ -514,6 +711,33 @@ int reg_entry_installed(reg_registry* reg, char* name, reg_entry*** entries,
     return result;
 }
 
+/**
+ * Returns the query used to find the active owner of a file, picking the index
+ * matching the requested case sensitivity.
+ *
+ * @param [in] cs false if the lookup should be case-insensitive, true otherwise
+ * @return        the query, with the path as its only parameter
+ */
+static char* reg_owner_query(int cs) {
+    if (cs) {
+        return "SELECT id FROM registry.files "
+#if SQLITE_VERSION_NUMBER >= 3006004
+            "INDEXED BY file_actual "
+#endif
+            "WHERE (actual_path = ?) AND active";
+    } else {
+        return "SELECT id FROM registry.files "
+#if SQLITE_VERSION_NUMBER >= 3006004
+            "INDEXED BY file_actual_nocase "
+#endif
+#if SQLITE_VERSION_NUMBER >= 3003013
+            "WHERE (actual_path = ? COLLATE NOCASE) AND active";
+#else
+            "WHERE (actual_path = ?) AND active";
+#endif
+    }
+}
+
 /**
  * Finds the owner of a given file. Only ports active in the filesystem will be
  * returned.
@@ -531,53 +755,31 @@ int reg_entry_owner(reg_registry* reg, char* path, int cs, reg_entry** entry,
     int result = 0;
     sqlite3_stmt* stmt = NULL;
     int lower_bound = 0;
-    char *query = NULL;
+    char* query = reg_owner_query(cs);
 
-    asprintf(&query, "SELECT id FROM registry.files %s WHERE (actual_path = ? %s) AND active",
-#if SQLITE_VERSION_NUMBER >= 3003013
-#if SQLITE_VERSION_NUMBER >= 3006004
-             cs ? "INDEXED BY file_actual" : "INDEXED BY file_actual_nocase",
-#else
-             "",
-#endif
-             cs ? "" : "COLLATE NOCASE");
-#else
-             "", "");
-#endif
-
-    if (!query) {
-        return 0;
-    }
-
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC)
                 == SQLITE_OK)) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_ROW:
-                    result = reg_stmt_to_entry(reg, (void**)entry, stmt,
-                            &lower_bound, errPtr);
-                    break;
-                case SQLITE_DONE:
-                    *entry = NULL;
-                    result = 1;
-                    break;
-                case SQLITE_BUSY:
-                    break;
-                default:
-                    reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_ROW:
+                result = reg_stmt_to_entry(reg, (void**)entry, stmt,
+                        &lower_bound, errPtr);
+                break;
+            case SQLITE_DONE:
+                *entry = NULL;
+                result = 1;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
-    free(query);
     return result;
 }
 
@@ -598,40 +800,162 @@ int reg_entry_owner(reg_registry* reg, char* path, int cs, reg_entry** entry,
 sqlite_int64 reg_entry_owner_id(reg_registry* reg, char* path, int cs) {
     sqlite3_stmt* stmt = NULL;
     sqlite_int64 result = 0;
-    char *query = NULL;
+    char* query = reg_owner_query(cs);
 
-    asprintf(&query, "SELECT id FROM registry.files %s WHERE (actual_path = ? %s) AND active",
-#if SQLITE_VERSION_NUMBER >= 3003013
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
+            && (sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC)
+                == SQLITE_OK)) {
+        int r = sqlite3_step(stmt);
+        if (r == SQLITE_ROW) {
+            result = sqlite3_column_int64(stmt, 0);
+        }
+    }
+    if (stmt) {
+        reg_stmt_release(stmt);
+    }
+    return result;
+}
+
+/**
+ * Finds the active owners of many files at once. This is equivalent to calling
+ * `reg_entry_owner` on every path, but the paths are loaded into a temporary
+ * table and joined against registry.files in a single query, so activating a
+ * port with tens of thousands of files doesn't cost as many round trips. Only
+ * paths that are owned by an active port are returned, in the order they were
+ * given.
+ *
+ * @param [in] reg         registry to search in
+ * @param [in] paths       paths of the files to check ownership of
+ * @param [in] path_count  number of paths
+ * @param [in] cs          false if check should be performed case-insensitive,
+ *                         true otherwise
+ * @param [out] owned      the paths that have an active owner
+ * @param [out] owners     the owner of each path in `owned`
+ * @param [out] errPtr     on error, a description of the error that occurred
+ * @return                 the number of owned paths if success; negative if
+ *                         failure
+ */
+int reg_entry_owners(reg_registry* reg, char** paths, int path_count, int cs,
+        char*** owned, reg_entry*** owners, reg_error* errPtr) {
+    sqlite3_stmt* insert = NULL;
+    sqlite3_stmt* select = NULL;
+    char* insert_query = "INSERT INTO temp.owner_paths (path) VALUES (?)";
+    char* select_query;
+    char** result_paths = NULL;
+    reg_entry** result_owners = NULL;
+    int result_count = 0;
+    int owners_count = 0;
+    int paths_space = 10;
+    int owners_space = 10;
+    int own_transaction = !(reg->status & reg_transacting);
+    int lower_bound = 0;
+    int ok = 1;
+    int i;
+
+    if (cs) {
+        select_query = "SELECT f.id, t.path FROM temp.owner_paths AS t "
+            "INNER JOIN registry.files AS f "
 #if SQLITE_VERSION_NUMBER >= 3006004
-             cs ? "INDEXED BY file_actual" : "INDEXED BY file_actual_nocase",
-#else
-             "",
+            "INDEXED BY file_actual "
+#endif
+            "ON f.actual_path = t.path WHERE f.active ORDER BY t.rowid";
+    } else {
+        select_query = "SELECT f.id, t.path FROM temp.owner_paths AS t "
+            "INNER JOIN registry.files AS f "
+#if SQLITE_VERSION_NUMBER >= 3006004
+            "INDEXED BY file_actual_nocase "
 #endif
-             cs ? "" : "COLLATE NOCASE");
+#if SQLITE_VERSION_NUMBER >= 3003013
+            "ON f.actual_path = t.path COLLATE NOCASE "
 #else
-             "", "");
+            "ON f.actual_path = t.path "
 #endif
+            "WHERE f.active ORDER BY t.rowid";
+    }
 
-    if (!query) {
-        return 0;
+    /* without an open transaction every insert would be committed (and
+     * synced) on its own */
+    if (own_transaction
+            && sqlite3_exec(reg->db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) {
+        reg_sqlite_error(reg->db, errPtr, NULL);
+        return -1;
     }
 
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
-            && (sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC)
-                == SQLITE_OK)) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            if (r == SQLITE_ROW) {
-                result = sqlite3_column_int64(stmt, 0);
+    if (sqlite3_exec(reg->db, "DELETE FROM temp.owner_paths", NULL, NULL,
+                NULL) != SQLITE_OK
+            || reg_stmt_prepare(reg, insert_query, &insert) != SQLITE_OK) {
+        reg_sqlite_error(reg->db, errPtr, insert_query);
+        ok = 0;
+    }
+    for (i=0; ok && i<path_count; i++) {
+        if (sqlite3_bind_text(insert, 1, paths[i], -1, SQLITE_STATIC)
+                    != SQLITE_OK
+                || sqlite3_step(insert) != SQLITE_DONE) {
+            reg_sqlite_error(reg->db, errPtr, insert_query);
+            ok = 0;
+        }
+        sqlite3_reset(insert);
+    }
+    if (insert) {
+        reg_stmt_release(insert);
+    }
+
+    if (ok) {
+        result_paths = malloc(paths_space * sizeof(char*));
+        result_owners = malloc(owners_space * sizeof(reg_entry*));
+        if (!result_paths || !result_owners) {
+            ok = 0;
+        } else if (reg_stmt_prepare(reg, select_query, &select) != SQLITE_OK) {
+            reg_sqlite_error(reg->db, errPtr, select_query);
+            ok = 0;
+        }
+    }
+    while (ok) {
+        int r = sqlite3_step(select);
+        if (r == SQLITE_ROW) {
+            reg_entry* entry;
+            const char* text = (const char*)sqlite3_column_text(select, 1);
+            char* element = text ? strdup(text) : NULL;
+            if (!element) {
+                ok = 0;
+            } else if (!reg_stmt_to_entry(reg, (void**)&entry, select,
+                        &lower_bound, errPtr)
+                    || !reg_listcat((void***)&result_paths, &result_count,
+                        &paths_space, element)) {
+                free(element);
+                ok = 0;
+            } else if (!reg_listcat((void***)&result_owners, &owners_count,
+                        &owners_space, entry)) {
+                ok = 0;
             }
-        } while (r == SQLITE_BUSY);
+        } else if (r == SQLITE_DONE) {
+            break;
+        } else {
+            reg_sqlite_error(reg->db, errPtr, select_query);
+            ok = 0;
+        }
     }
-    if (stmt) {
-        sqlite3_finalize(stmt);
+    if (select) {
+        reg_stmt_release(select);
     }
-    free(query);
-    return result;
+
+    /* leave nothing behind for the next caller */
+    sqlite3_exec(reg->db, "DELETE FROM temp.owner_paths", NULL, NULL, NULL);
+    if (own_transaction) {
+        sqlite3_exec(reg->db, ok ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL);
+    }
+
+    if (!ok) {
+        for (i=0; i<result_count; i++) {
+            free(result_paths[i]);
+        }
+        free(result_paths);
+        free(result_owners);
+        return -1;
+    }
+    *owned = result_paths;
+    *owners = result_owners;
+    return result_count;
 }
 
 /**
@@ -652,44 +976,137 @@ int reg_entry_propget(reg_entry* entry, char* key, char** value,
     sqlite3_stmt* stmt = NULL;
     char* query;
     const char *text;
-    query = sqlite3_mprintf("SELECT %q FROM registry.ports WHERE id=%lld", key,
-            entry->id);
-    if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_ROW:
-                    text = (const char*)sqlite3_column_text(stmt, 0);
-                    if (text) {
-                        *value = strdup(text);
-                        result = 1;
-                    } else {
-                        reg_sqlite_error(reg->db, errPtr, query);
-                    }
-                    break;
-                case SQLITE_DONE:
-                    errPtr->code = REG_INVALID;
-                    errPtr->description = "an invalid entry was passed";
-                    errPtr->free = NULL;
-                    break;
-                case SQLITE_BUSY:
-                    continue;
-                default:
+    if (!reg_check_column(entry_columns, key, errPtr)) {
+        return 0;
+    }
+    query = sqlite3_mprintf("SELECT %s FROM registry.ports WHERE id=?", key);
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
+            && (sqlite3_bind_int64(stmt, 1, entry->id) == SQLITE_OK)) {
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_ROW:
+                text = (const char*)sqlite3_column_text(stmt, 0);
+                if (text) {
+                    *value = strdup(text);
+                    result = 1;
+                } else {
                     reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+                }
+                break;
+            case SQLITE_DONE:
+                errPtr->code = REG_INVALID;
+                errPtr->description = "an invalid entry was passed";
+                errPtr->free = NULL;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     sqlite3_free(query);
     return result;
 }
 
+/**
+ * Gets several properties of an entry using a single query. This is equivalent
+ * to calling `reg_entry_propget` for each of the keys, but only needs one trip
+ * to the database. Properties which are NULL in the database are returned as
+ * NULL; all other values and the list itself need to be freed by the caller.
+ *
+ * @param [in] entry     entry to get properties from
+ * @param [in] keys      properties to get
+ * @param [in] key_count the number of properties
+ * @param [out] values   the values of the properties, matching keys
+ * @param [out] errPtr   on error, a description of the error that occurred
+ * @return               true if success; false if failure
+ */
+int reg_entry_propget_many(reg_entry* entry, const char** keys, int key_count,
+        char*** values, reg_error* errPtr) {
+    reg_registry* reg = entry->reg;
+    int result = 0;
+    sqlite3_stmt* stmt = NULL;
+    char* query;
+    size_t query_len, query_space;
+    char** vals;
+    int i;
+
+    if (key_count < 1) {
+        reg_throw(errPtr, REG_MISUSE, "no properties requested");
+        return 0;
+    }
+    query = strdup("SELECT ");
+    if (!query) {
+        return 0;
+    }
+    query_len = query_space = strlen(query);
+    for (i=0; i<key_count; i++) {
+        if (!reg_check_column(entry_columns, keys[i], errPtr)) {
+            free(query);
+            return 0;
+        }
+        if ((i > 0 && !reg_strcat(&query, &query_len, &query_space, ", "))
+                || !reg_strcat(&query, &query_len, &query_space,
+                    (char*)keys[i])) {
+            free(query);
+            return 0;
+        }
+    }
+    if (!reg_strcat(&query, &query_len, &query_space,
+                " FROM registry.ports WHERE id=?")) {
+        free(query);
+        return 0;
+    }
+    vals = calloc(key_count, sizeof(char*));
+    if (!vals) {
+        free(query);
+        return 0;
+    }
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
+            && (sqlite3_bind_int64(stmt, 1, entry->id) == SQLITE_OK)) {
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_ROW:
+                result = 1;
+                for (i=0; i<key_count && result; i++) {
+                    const char* text =
+                        (const char*)sqlite3_column_text(stmt, i);
+                    if (text && !(vals[i] = strdup(text))) {
+                        result = 0;
+                    }
+                }
+                break;
+            case SQLITE_DONE:
+                errPtr->code = REG_INVALID;
+                errPtr->description = "an invalid entry was passed";
+                errPtr->free = NULL;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
+    } else {
+        reg_sqlite_error(reg->db, errPtr, query);
+    }
+    if (stmt) {
+        reg_stmt_release(stmt);
+    }
+    free(query);
+    if (result) {
+        *values = vals;
+    } else {
+        for (i=0; i<key_count; i++) {
+            free(vals[i]);
+        }
+        free(vals);
+    }
+    return result;
+}
+
 /**
  * Sets a named property of an entry. That property can be later retrieved using
  * `reg_entry_propget`. The property named must be one that exists in the table
@@ -710,34 +1127,34 @@ int reg_entry_propset(reg_entry* entry, char* key, char* value,
     int result = 0;
     sqlite3_stmt* stmt = NULL;
     char* query;
-    query = sqlite3_mprintf("UPDATE registry.ports SET %q = '%q' WHERE id=%lld",
-            key, value, entry->id);
-    if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_DONE:
-                    result = 1;
-                    break;
-                case SQLITE_BUSY:
-                    break;
-                default:
-                    if (sqlite3_reset(stmt) == SQLITE_CONSTRAINT) {
-                        errPtr->code = REG_CONSTRAINT;
-                        errPtr->description = "a constraint was disobeyed";
-                        errPtr->free = NULL;
-                    } else {
-                        reg_sqlite_error(reg->db, errPtr, query);
-                    }
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+    if (!reg_check_column(entry_columns, key, errPtr)) {
+        return 0;
+    }
+    query = sqlite3_mprintf("UPDATE registry.ports SET %s=? WHERE id=?", key);
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
+            && (sqlite3_bind_text(stmt, 1, value, -1, SQLITE_STATIC)
+                == SQLITE_OK)
+            && (sqlite3_bind_int64(stmt, 2, entry->id) == SQLITE_OK)) {
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_DONE:
+                result = 1;
+                break;
+            default:
+                if (sqlite3_reset(stmt) == SQLITE_CONSTRAINT) {
+                    errPtr->code = REG_CONSTRAINT;
+                    errPtr->description = "a constraint was disobeyed";
+                    errPtr->free = NULL;
+                } else {
+                    reg_sqlite_error(reg->db, errPtr, query);
+                }
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     sqlite3_free(query);
     return result;
@@ -761,33 +1178,28 @@ int reg_entry_addgroup(reg_entry* entry, char* name, char *version,
     sqlite3_stmt* stmt = NULL;
     char* insert = "INSERT INTO registry.portgroups (id, name, version, size, sha256) "
         "VALUES (?, ?, ?, ?, ?)";
-    if ((sqlite3_prepare_v2(reg->db, insert, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, insert, &stmt) == SQLITE_OK)
             && (sqlite3_bind_int64(stmt, 1, entry->id) == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC) == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 3, version, -1, SQLITE_STATIC) == SQLITE_OK)
             && (sqlite3_bind_int64(stmt, 4, size) == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 5, sha256, -1, SQLITE_STATIC) == SQLITE_OK)) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_DONE:
-                    sqlite3_reset(stmt);
-                    break;
-                case SQLITE_BUSY:
-                    break;
-                default:
-                    reg_sqlite_error(reg->db, errPtr, insert);
-                    result = 0;
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_DONE:
+                sqlite3_reset(stmt);
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, insert);
+                result = 0;
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, insert);
         result = 0;
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     return result;
 }
@@ -827,27 +1239,22 @@ int reg_entry_map(reg_entry* entry, char** files, int file_count,
     sqlite3_stmt* stmt = NULL;
     char* insert = "INSERT INTO registry.files (id, path, active) "
         "VALUES (?, ?, 0)";
-    if ((sqlite3_prepare_v2(reg->db, insert, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, insert, &stmt) == SQLITE_OK)
             && (sqlite3_bind_int64(stmt, 1, entry->id) == SQLITE_OK)) {
         int i;
         for (i=0; i<file_count && result; i++) {
             if (sqlite3_bind_text(stmt, 2, files[i], -1, SQLITE_STATIC)
                     == SQLITE_OK) {
-                int r;
-                do {
-                    r = sqlite3_step(stmt);
-                    switch (r) {
-                        case SQLITE_DONE:
-                            sqlite3_reset(stmt);
-                            break;
-                        case SQLITE_BUSY:
-                            break;
-                        default:
-                            reg_sqlite_error(reg->db, errPtr, insert);
-                            result = 0;
-                            break;
-                    }
-                } while (r == SQLITE_BUSY);
+                int r = sqlite3_step(stmt);
+                switch (r) {
+                    case SQLITE_DONE:
+                        sqlite3_reset(stmt);
+                        break;
+                    default:
+                        reg_sqlite_error(reg->db, errPtr, insert);
+                        result = 0;
+                        break;
+                }
             } else {
                 reg_sqlite_error(reg->db, errPtr, insert);
                 result = 0;
@@ -858,7 +1265,7 @@ int reg_entry_map(reg_entry* entry, char** files, int file_count,
         result = 0;
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     return result;
 }
@@ -883,33 +1290,28 @@ int reg_entry_unmap(reg_entry* entry, char** files, int file_count,
                   "INDEXED BY file_path "
 #endif
                   "WHERE path=? AND id=?";
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
             && (sqlite3_bind_int64(stmt, 2, entry->id) == SQLITE_OK)) {
         int i;
         for (i=0; i<file_count && result; i++) {
             if (sqlite3_bind_text(stmt, 1, files[i], -1, SQLITE_STATIC)
                     == SQLITE_OK) {
-                int r;
-                do {
-                    r = sqlite3_step(stmt);
-                    switch (r) {
-                        case SQLITE_DONE:
-                            if (sqlite3_changes(reg->db) == 0) {
-                                reg_throw(errPtr, REG_INVALID, "this entry "
-                                        "does not own the given file");
-                                result = 0;
-                            } else {
-                                sqlite3_reset(stmt);
-                            }
-                            break;
-                        case SQLITE_BUSY:
-                            break;
-                        default:
-                            reg_sqlite_error(reg->db, errPtr, query);
+                int r = sqlite3_step(stmt);
+                switch (r) {
+                    case SQLITE_DONE:
+                        if (sqlite3_changes(reg->db) == 0) {
+                            reg_throw(errPtr, REG_INVALID, "this entry "
+                                    "does not own the given file");
                             result = 0;
-                            break;
-                    }
-                } while (r == SQLITE_BUSY);
+                        } else {
+                            sqlite3_reset(stmt);
+                        }
+                        break;
+                    default:
+                        reg_sqlite_error(reg->db, errPtr, query);
+                        result = 0;
+                        break;
+                }
             } else {
                 reg_sqlite_error(reg->db, errPtr, query);
                 result = 0;
@@ -920,7 +1322,7 @@ int reg_entry_unmap(reg_entry* entry, char** files, int file_count,
         result = 0;
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     return result;
 }
@@ -940,7 +1342,7 @@ int reg_entry_imagefiles(reg_entry* entry, char*** files, reg_error* errPtr) {
     reg_registry* reg = entry->reg;
     sqlite3_stmt* stmt = NULL;
     char* query = "SELECT path FROM registry.files WHERE id=? ORDER BY path";
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
             && (sqlite3_bind_int64(stmt, 1, entry->id) == SQLITE_OK)) {
         char** result = malloc(10*sizeof(char*));
         int result_count = 0;
@@ -949,6 +1351,7 @@ int reg_entry_imagefiles(reg_entry* entry, char*** files, reg_error* errPtr) {
         const char *text;
         char* element;
         if (!result) {
+            reg_stmt_release(stmt);
             return -1;
         }
         do {
@@ -964,14 +1367,13 @@ int reg_entry_imagefiles(reg_entry* entry, char*** files, reg_error* errPtr) {
                     }
                     break;
                 case SQLITE_DONE:
-                case SQLITE_BUSY:
                     break;
                 default:
                     reg_sqlite_error(reg->db, errPtr, query);
                     break;
             }
-        } while (r == SQLITE_ROW || r == SQLITE_BUSY);
-        sqlite3_finalize(stmt);
+        } while (r == SQLITE_ROW);
+        reg_stmt_release(stmt);
         if (r == SQLITE_DONE) {
             *files = result;
             return result_count;
@@ -986,7 +1388,7 @@ int reg_entry_imagefiles(reg_entry* entry, char*** files, reg_error* errPtr) {
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
         if (stmt) {
-            sqlite3_finalize(stmt);
+            reg_stmt_release(stmt);
         }
         return -1;
     }
@@ -1008,7 +1410,7 @@ int reg_entry_files(reg_entry* entry, char*** files, reg_error* errPtr) {
     sqlite3_stmt* stmt = NULL;
     char* query = "SELECT actual_path FROM registry.files WHERE id=? "
         "AND active ORDER BY actual_path";
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
             && (sqlite3_bind_int64(stmt, 1, entry->id) == SQLITE_OK)) {
         char** result = malloc(10*sizeof(char*));
         int result_count = 0;
@@ -1017,6 +1419,7 @@ int reg_entry_files(reg_entry* entry, char*** files, reg_error* errPtr) {
         const char *text;
         char* element;
         if (!result) {
+            reg_stmt_release(stmt);
             return -1;
         }
         do {
@@ -1032,14 +1435,13 @@ int reg_entry_files(reg_entry* entry, char*** files, reg_error* errPtr) {
                     }
                     break;
                 case SQLITE_DONE:
-                case SQLITE_BUSY:
                     break;
                 default:
                     reg_sqlite_error(reg->db, errPtr, query);
                     break;
             }
-        } while (r == SQLITE_ROW || r == SQLITE_BUSY);
-        sqlite3_finalize(stmt);
+        } while (r == SQLITE_ROW);
+        reg_stmt_release(stmt);
         if (r == SQLITE_DONE) {
             *files = result;
             return result_count;
@@ -1054,7 +1456,7 @@ int reg_entry_files(reg_entry* entry, char*** files, reg_error* errPtr) {
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
         if (stmt) {
-            sqlite3_finalize(stmt);
+            reg_stmt_release(stmt);
         }
         return -1;
     }
@@ -1099,8 +1501,8 @@ int reg_entry_activate(reg_entry* entry, char** files, char** as_files,
         as_files = files;
     }
 
-    if (sqlite3_prepare_v2(reg->db, select_query, -1, &select, NULL) == SQLITE_OK){
-        if ((sqlite3_prepare_v2(reg->db, update_query, -1, &update, NULL)
+    if (reg_stmt_prepare(reg, select_query, &select) == SQLITE_OK) {
+        if ((reg_stmt_prepare(reg, update_query, &update)
                 == SQLITE_OK)
                 && (sqlite3_bind_int64(update, 3, entry->id) == SQLITE_OK)) {
             for (i=0; i<file_count && result; i++) {
@@ -1110,48 +1512,39 @@ int reg_entry_activate(reg_entry* entry, char** files, char** as_files,
                                 SQLITE_STATIC) == SQLITE_OK)
                         && (sqlite3_bind_text(update, 2, files[i], -1,
                                 SQLITE_STATIC) == SQLITE_OK)) {
-                    int r;
-                    do {
-                        r = sqlite3_step(select);
-                        switch (r) {
-                            case SQLITE_ROW:
-                                reg_throw(errPtr, REG_ALREADY_ACTIVE, "%s is "
-                                        "being used by another port", files[i]);
-                                result = 0;
-                                break;
-                            case SQLITE_DONE:
-                                do {
-                                    r = sqlite3_step(update);
-                                    switch (r) {
-                                        case SQLITE_DONE:
-                                            if (sqlite3_changes(reg->db) == 0) {
-                                                reg_throw(errPtr, REG_INVALID,
-                                                        "%s is not provided by "
-                                                        "this port", files[i]);
-                                                result = 0;
-                                            } else {
-                                                sqlite3_reset(select);
-                                                sqlite3_reset(update);
-                                            }
-                                            break;
-                                        case SQLITE_BUSY:
-                                            break;
-                                        case SQLITE_ERROR:
-                                            reg_sqlite_error(reg->db, errPtr,
-                                                    update_query);
-                                            result = 0;
-                                            break;
+                    int r = sqlite3_step(select);
+                    switch (r) {
+                        case SQLITE_ROW:
+                            reg_throw(errPtr, REG_ALREADY_ACTIVE, "%s is "
+                                    "being used by another port", files[i]);
+                            result = 0;
+                            break;
+                        case SQLITE_DONE:
+                            r = sqlite3_step(update);
+                            switch (r) {
+                                case SQLITE_DONE:
+                                    if (sqlite3_changes(reg->db) == 0) {
+                                        reg_throw(errPtr, REG_INVALID,
+                                                "%s is not provided by "
+                                                "this port", files[i]);
+                                        result = 0;
+                                    } else {
+                                        sqlite3_reset(select);
+                                        sqlite3_reset(update);
                                     }
-                                } while (r == SQLITE_BUSY);
-                                break;
-                            case SQLITE_BUSY:
-                                break;
-                            case SQLITE_ERROR:
-                                reg_sqlite_error(reg->db, errPtr, select_query);
-                                result = 0;
-                                break;
-                        }
-                    } while (r == SQLITE_BUSY);
+                                    break;
+                                default:
+                                    reg_sqlite_error(reg->db, errPtr,
+                                            update_query);
+                                    result = 0;
+                                    break;
+                            }
+                            break;
+                        default:
+                            reg_sqlite_error(reg->db, errPtr, select_query);
+                            result = 0;
+                            break;
+                    }
                 } else {
                     reg_sqlite_error(reg->db, errPtr, NULL);
                     result = 0;
@@ -1162,14 +1555,14 @@ int reg_entry_activate(reg_entry* entry, char** files, char** as_files,
             result = 0;
         }
         if (update) {
-            sqlite3_finalize(update);
+            reg_stmt_release(update);
         }
     } else {
         reg_sqlite_error(reg->db, errPtr, select_query);
         result = 0;
     }
     if (select) {
-        sqlite3_finalize(select);
+        reg_stmt_release(select);
     }
     return result;
 }
@@ -1200,32 +1593,27 @@ int reg_entry_deactivate(reg_entry* entry, char** files, int file_count,
         "INDEXED BY file_actual "
 #endif
         "SET active=0 WHERE actual_path=? AND id=?";
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
             && (sqlite3_bind_int64(stmt, 2, entry->id) == SQLITE_OK)) {
         for (i=0; i<file_count && result; i++) {
             if (sqlite3_bind_text(stmt, 1, files[i], -1, SQLITE_STATIC)
                     == SQLITE_OK) {
-                int r;
-                do {
-                    r = sqlite3_step(stmt);
-                    switch (r) {
-                        case SQLITE_DONE:
-                            if (sqlite3_changes(reg->db) == 0) {
-                                reg_throw(errPtr, REG_INVALID, "this entry "
-                                        "does not own the given file");
-                                result = 0;
-                            } else {
-                                sqlite3_reset(stmt);
-                            }
-                            break;
-                        case SQLITE_BUSY:
-                            break;
-                        default:
-                            reg_sqlite_error(reg->db, errPtr, query);
+                int r = sqlite3_step(stmt);
+                switch (r) {
+                    case SQLITE_DONE:
+                        if (sqlite3_changes(reg->db) == 0) {
+                            reg_throw(errPtr, REG_INVALID, "this entry "
+                                    "does not own the given file");
                             result = 0;
-                            break;
-                    }
-                } while (r == SQLITE_BUSY);
+                        } else {
+                            sqlite3_reset(stmt);
+                        }
+                        break;
+                    default:
+                        reg_sqlite_error(reg->db, errPtr, query);
+                        result = 0;
+                        break;
+                }
             } else {
                 reg_sqlite_error(reg->db, errPtr, query);
                 result = 0;
@@ -1236,7 +1624,7 @@ int reg_entry_deactivate(reg_entry* entry, char** files, int file_count,
         result = 0;
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     return result;
 }
@@ -1301,29 +1689,24 @@ int reg_entry_depends(reg_entry* entry, char* name, reg_error* errPtr) {
     int result = 0;
     sqlite3_stmt* stmt = NULL;
     char* query = "INSERT INTO registry.dependencies (id, name) VALUES (?,?)";
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
             && (sqlite3_bind_int64(stmt, 1, entry->id) == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC)
                 == SQLITE_OK)) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_DONE:
-                    result = 1;
-                    break;
-                case SQLITE_BUSY:
-                    break;
-                default:
-                    reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_DONE:
+                result = 1;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     return result;
 }
@@ -54,6 +54,12 @@ void reg_entry_free(reg_entry* entry);
 
 int reg_entry_search(reg_registry* reg, const char** keys, const char** vals,
         int key_count, int* strategies, reg_entry*** entries, reg_error* errPtr);
+int reg_entry_search_props(reg_registry* reg, const char** columns,
+        int column_count, const char** keys, const char** vals, int key_count,
+        int* strategies, char*** rows, reg_error* errPtr);
+int reg_entry_foreach(reg_registry* reg, const char** columns,
+        int column_count, const char** keys, const char** vals, int key_count,
+        int* strategies, row_function* fn, void* calldata, reg_error* errPtr);
 
 int reg_entry_imaged(reg_registry* reg, const char* name, const char* version,
         const char* revision, const char* variants, reg_entry*** entries,
@@ -64,9 +70,13 @@ int reg_entry_installed(reg_registry* reg, char* name, reg_entry*** entries,
 sqlite_int64 reg_entry_owner_id(reg_registry* reg, char* path, int cs);
 int reg_entry_owner(reg_registry* reg, char* path, int cs,
         reg_entry** entry, reg_error* errPtr);
+int reg_entry_owners(reg_registry* reg, char** paths, int path_count, int cs,
+        char*** owned, reg_entry*** owners, reg_error* errPtr);
 
 int reg_entry_propget(reg_entry* entry, char* key, char** value,
         reg_error* errPtr);
+int reg_entry_propget_many(reg_entry* entry, const char** keys, int key_count,
+        char*** values, reg_error* errPtr);
 int reg_entry_propset(reg_entry* entry, char* key, char* value,
         reg_error* errPtr);
 
@@ -39,6 +39,19 @@
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * Columns of registry.files that can be accessed using `reg_file_propget` and
+ * `reg_file_propset`.
+ */
+static const char* file_columns[] = {
+    "id",
+    "path",
+    "actual_path",
+    "active",
+    "binary",
+    NULL
+};
+
 /**
  * Converts a `sqlite3_stmt` into a `reg_file`. The first column of the stmt's
  * row must be the id of a file; the second column must be the path of a file;
@@ -116,37 +129,32 @@ reg_file* reg_file_open(reg_registry* reg, char* id, char* name,
         "WHERE id=? AND path=?";
     int lower_bound = 0;
 
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 1, id, -1, SQLITE_STATIC)
                 == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC)
                 == SQLITE_OK)) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_ROW:
-                    reg_stmt_to_file(reg, (void**)&file, stmt, &lower_bound,
-                            errPtr);
-                    break;
-                case SQLITE_DONE:
-                    errPtr->code = REG_NOT_FOUND;
-                    errPtr->description = sqlite3_mprintf("no matching file found for: "
-                            "id=%s, name=%s", id, name);
-                    errPtr->free = (reg_error_destructor*) sqlite3_free;
-                    break;
-                case SQLITE_BUSY:
-                    continue;
-                default:
-                    reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_ROW:
+                reg_stmt_to_file(reg, (void**)&file, stmt, &lower_bound,
+                        errPtr);
+                break;
+            case SQLITE_DONE:
+                errPtr->code = REG_NOT_FOUND;
+                errPtr->description = sqlite3_mprintf("no matching file found for: "
+                        "id=%s, name=%s", id, name);
+                errPtr->free = (reg_error_destructor*) sqlite3_free;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     return file;
 }
@@ -168,6 +176,45 @@ static int reg_all_files(reg_registry* reg, char* query, int query_len,
             reg_stmt_to_file, &lower_bound, NULL, errPtr);
 }
 
+/**
+ * Appends a WHERE clause matching the given search criteria to `query`.
+ *
+ * @param [in,out] query a reference to the query to append to
+ * @param [in] keys      a list of keys to search by
+ * @param [in] vals      a list of values to search by, matching keys
+ * @param [in] strats    a list of strategies to use when searching
+ * @param [in] key_count the number of key/value pairs passed
+ * @param [out] errPtr   on error, a description of the error that occurred
+ * @return               true if success; false if failure
+ */
+static int reg_file_search_where(char** query, char** keys, char** vals,
+        int* strats, int key_count, reg_error* errPtr) {
+    int i;
+    char* kwd = " WHERE ";
+    size_t query_len, query_space;
+
+    query_len = query_space = strlen(*query);
+    for (i = 0; i < key_count; i++) {
+        char* op;
+        char* cond;
+
+        /* get the strategy */
+        if ((op = reg_strategy_op(strats[i], errPtr)) == NULL) {
+            return 0;
+        }
+
+        cond = sqlite3_mprintf(op, keys[i], vals[i]);
+        if (!cond || !reg_strcat(query, &query_len, &query_space, kwd)
+            || !reg_strcat(query, &query_len, &query_space, cond)) {
+            sqlite3_free(cond);
+            return 0;
+        }
+        sqlite3_free(cond);
+        kwd = " AND ";
+    }
+    return 1;
+}
+
 /**
  * Searches the registry for files for which each key's value is equal to the
  * given value. To find all files, pass a key_count of 0.
@@ -186,10 +233,7 @@ static int reg_all_files(reg_registry* reg, char* query, int query_len,
  */
 int reg_file_search(reg_registry* reg, char** keys, char** vals, int* strats,
         int key_count, reg_file*** files, reg_error* errPtr) {
-    int i;
-    char* kwd = " WHERE ";
     char* query;
-    size_t query_len, query_space;
     int result;
 
     /* build the query */
@@ -197,34 +241,118 @@ int reg_file_search(reg_registry* reg, char** keys, char** vals, int* strats,
     if (!query) {
         return -1;
     }
-    query_len = query_space = strlen(query);
+    if (!reg_file_search_where(&query, keys, vals, strats, key_count,
+                errPtr)) {
+        free(query);
+        return -1;
+    }
 
-    for (i = 0; i < key_count; i++) {
-        char* op;
-        char* cond;
+    /* do the query */
+    result = reg_all_files(reg, query, -1, files, errPtr);
+    free(query);
+    return result;
+}
 
-        /* get the strategy */
-        if ((op = reg_strategy_op(strats[i], errPtr)) == NULL) {
+/**
+ * Searches the registry like `reg_file_search`, but instead of opening all
+ * matching files, calls `fn` with the values of each matching row in turn,
+ * `values[i]` holding the value of `columns[i]`. `fn` can return false to
+ * stop the search early. See `reg_foreach_row`.
+ *
+ * @param [in] reg          registry to search in
+ * @param [in] columns      the columns to select for each file
+ * @param [in] column_count the number of columns
+ * @param [in] keys         a list of keys to search by
+ * @param [in] vals         a list of values to search by, matching keys
+ * @param [in] strats       a list of strategies to use when searching
+ * @param [in] key_count    the number of key/value pairs passed
+ * @param [in] fn           function to call for each matching file
+ * @param [in] calldata     data passed along to `fn`
+ * @param [out] errPtr      on error, a description of the error that occurred
+ * @return                  true if success; false if failure
+ */
+int reg_file_foreach(reg_registry* reg, const char** columns,
+        int column_count, char** keys, char** vals, int* strats,
+        int key_count, row_function* fn, void* calldata, reg_error* errPtr) {
+    char* query;
+    size_t query_len, query_space;
+    int result;
+    int i;
+
+    if (column_count < 1) {
+        reg_throw(errPtr, REG_MISUSE, "no properties requested");
+        return 0;
+    }
+    query = strdup("SELECT ");
+    if (!query) {
+        return 0;
+    }
+    query_len = query_space = strlen(query);
+    for (i = 0; i < column_count; i++) {
+        if (!reg_check_column(file_columns, columns[i], errPtr)) {
             free(query);
-            return -1;
+            return 0;
         }
-
-        cond = sqlite3_mprintf(op, keys[i], vals[i]);
-        if (!cond || !reg_strcat(&query, &query_len, &query_space, kwd)
-            || !reg_strcat(&query, &query_len, &query_space, cond)) {
+        if ((i > 0 && !reg_strcat(&query, &query_len, &query_space, ", "))
+                || !reg_strcat(&query, &query_len, &query_space,
+                    (char*)columns[i])) {
             free(query);
-            return -1;
+            return 0;
         }
-        sqlite3_free(cond);
-        kwd = " AND ";
+    }
+    if (!reg_strcat(&query, &query_len, &query_space,
+                ", rowid AS reg_rowid FROM registry.files")
+            || !reg_file_search_where(&query, keys, vals, strats, key_count,
+                errPtr)) {
+        free(query);
+        return 0;
     }
 
-    /* do the query */
-    result = reg_all_files(reg, query, -1, files, errPtr);
+    result = reg_foreach_row(reg, query, -1, fn, calldata, errPtr);
     free(query);
     return result;
 }
 
+/**
+ * Counts the files matching the given search criteria, without opening them.
+ *
+ * @param [in] reg       registry to search in
+ * @param [in] keys      a list of keys to search by
+ * @param [in] vals      a list of values to search by, matching keys
+ * @param [in] strats    a list of strategies to use when searching
+ * @param [in] key_count the number of key/value pairs passed
+ * @param [out] errPtr   on error, a description of the error that occurred
+ * @return               the number of matching files if success; negative if
+ *                       failure
+ */
+int reg_file_count(reg_registry* reg, char** keys, char** vals, int* strats,
+        int key_count, reg_error* errPtr) {
+    sqlite3_stmt* stmt = NULL;
+    char* query;
+    int count = -1;
+
+    query = strdup("SELECT COUNT(*) FROM registry.files");
+    if (!query) {
+        return -1;
+    }
+    if (!reg_file_search_where(&query, keys, vals, strats, key_count,
+                errPtr)) {
+        free(query);
+        return -1;
+    }
+    if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW) {
+        count = sqlite3_column_int(stmt, 0);
+    } else {
+        reg_sqlite_error(reg->db, errPtr, query);
+    }
+    if (stmt) {
+        sqlite3_finalize(stmt);
+    }
+    free(query);
+    return count;
+}
+
 /**
  * Gets a named property of a file. That property can be set using
  * `reg_file_propset`. The property named must be one that exists in the table
@@ -243,8 +371,11 @@ int reg_file_propget(reg_file* file, char* key, char** value,
     sqlite3_stmt* stmt = NULL;
     char* query;
     const char *text;
+    if (!reg_check_column(file_columns, key, errPtr)) {
+        return 0;
+    }
     query = sqlite3_mprintf(
-            "SELECT %q FROM registry.files "
+            "SELECT %s FROM registry.files "
 #if SQLITE_VERSION_NUMBER >= 3006004
             /* if the version of SQLite supports it force the usage of the index
              * on path, rather than the one on id which has a lot less
@@ -253,38 +384,36 @@ int reg_file_propget(reg_file* file, char* key, char** value,
              * not use the correct index automatically. */
             "INDEXED BY file_path "
 #endif
-            "WHERE id=%lld AND path='%q'", key, file->key.id, file->key.path);
-    if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_ROW:
-                    text = (const char*)sqlite3_column_text(stmt, 0);
-                    if (text) {
-                        *value = strdup(text);
-                        result = 1;
-                    } else {
-                        reg_sqlite_error(reg->db, errPtr, query);
-                    }
-                    break;
-                case SQLITE_DONE:
-                    errPtr->code = REG_INVALID;
-                    errPtr->description = "an invalid file was passed";
-                    errPtr->free = NULL;
-                    break;
-                case SQLITE_BUSY:
-                    continue;
-                default:
+            "WHERE id=? AND path=?", key);
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
+            && (sqlite3_bind_int64(stmt, 1, file->key.id) == SQLITE_OK)
+            && (sqlite3_bind_text(stmt, 2, file->key.path, -1, SQLITE_STATIC)
+                == SQLITE_OK)) {
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_ROW:
+                text = (const char*)sqlite3_column_text(stmt, 0);
+                if (text) {
+                    *value = strdup(text);
+                    result = 1;
+                } else {
                     reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+                }
+                break;
+            case SQLITE_DONE:
+                errPtr->code = REG_INVALID;
+                errPtr->description = "an invalid file was passed";
+                errPtr->free = NULL;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     sqlite3_free(query);
     return result;
@@ -307,6 +436,9 @@ int reg_file_propset(reg_file* file, char* key, char* value,
     int result = 0;
     sqlite3_stmt* stmt = NULL;
     char* query;
+    if (!reg_check_column(file_columns, key, errPtr)) {
+        return 0;
+    }
     query = sqlite3_mprintf(
             "UPDATE registry.files "
 #if SQLITE_VERSION_NUMBER >= 3006004
@@ -317,33 +449,33 @@ int reg_file_propset(reg_file* file, char* key, char* value,
              * not use the correct index automatically. */
             "INDEXED BY file_path "
 #endif
-            "SET %q = '%q' WHERE id=%lld AND path='%q'", key, value, file->key.id, file->key.path);
-    if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_DONE:
-                    result = 1;
-                    break;
-                case SQLITE_BUSY:
-                    continue;
-                default:
-                    if (sqlite3_reset(stmt) == SQLITE_CONSTRAINT) {
-                        errPtr->code = REG_CONSTRAINT;
-                        errPtr->description = "a constraint was disobeyed";
-                        errPtr->free = NULL;
-                    } else {
-                        reg_sqlite_error(reg->db, errPtr, query);
-                    }
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+            "SET %s=? WHERE id=? AND path=?", key);
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
+            && (sqlite3_bind_text(stmt, 1, value, -1, SQLITE_STATIC)
+                == SQLITE_OK)
+            && (sqlite3_bind_int64(stmt, 2, file->key.id) == SQLITE_OK)
+            && (sqlite3_bind_text(stmt, 3, file->key.path, -1, SQLITE_STATIC)
+                == SQLITE_OK)) {
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_DONE:
+                result = 1;
+                break;
+            default:
+                if (sqlite3_reset(stmt) == SQLITE_CONSTRAINT) {
+                    errPtr->code = REG_CONSTRAINT;
+                    errPtr->description = "a constraint was disobeyed";
+                    errPtr->free = NULL;
+                } else {
+                    reg_sqlite_error(reg->db, errPtr, query);
+                }
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     sqlite3_free(query);
     return result;
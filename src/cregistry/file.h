@@ -54,6 +54,11 @@ reg_file* reg_file_open(reg_registry* reg, char* id, char* path,
 
 int reg_file_search(reg_registry* reg, char** keys, char** vals, int* strats,
         int key_count, reg_file*** files, reg_error* errPtr);
+int reg_file_foreach(reg_registry* reg, const char** columns,
+        int column_count, char** keys, char** vals, int* strats,
+        int key_count, row_function* fn, void* calldata, reg_error* errPtr);
+int reg_file_count(reg_registry* reg, char** keys, char** vals, int* strats,
+        int key_count, reg_error* errPtr);
 
 int reg_file_propget(reg_file* file, char* key, char** value,
         reg_error* errPtr);
@@ -38,6 +38,19 @@
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * Columns of registry.portgroups that can be accessed using
+ * `reg_portgroup_propget` and `reg_portgroup_propset`.
+ */
+static const char* portgroup_columns[] = {
+    "id",
+    "name",
+    "version",
+    "size",
+    "sha256",
+    NULL
+};
+
 /**
  * Converts a `sqlite3_stmt` into a `reg_portgroup`. The first column of the stmt's
  * row must be the id of a portgroup; the second either `SQLITE_NULL` or the
@@ -164,39 +177,38 @@ int reg_portgroup_propget(reg_portgroup* portgroup, char* key, char** value,
     sqlite3_stmt* stmt = NULL;
     char* query;
     const char *text;
-    query = sqlite3_mprintf("SELECT %q FROM registry.portgroups WHERE ROWID=%lld", key,
-            portgroup->id);
-    if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_ROW:
-                    text = (const char*)sqlite3_column_text(stmt, 0);
-                    if (text) {
-                        *value = strdup(text);
-                        result = 1;
-                    } else {
-                        reg_sqlite_error(reg->db, errPtr, query);
-                    }
-                    break;
-                case SQLITE_DONE:
-                    errPtr->code = REG_INVALID;
-                    errPtr->description = "an invalid portgroup was passed";
-                    errPtr->free = NULL;
-                    break;
-                case SQLITE_BUSY:
-                    continue;
-                default:
+    if (!reg_check_column(portgroup_columns, key, errPtr)) {
+        return 0;
+    }
+    query = sqlite3_mprintf("SELECT %s FROM registry.portgroups WHERE ROWID=?",
+            key);
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
+            && (sqlite3_bind_int64(stmt, 1, portgroup->id) == SQLITE_OK)) {
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_ROW:
+                text = (const char*)sqlite3_column_text(stmt, 0);
+                if (text) {
+                    *value = strdup(text);
+                    result = 1;
+                } else {
                     reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+                }
+                break;
+            case SQLITE_DONE:
+                errPtr->code = REG_INVALID;
+                errPtr->description = "an invalid portgroup was passed";
+                errPtr->free = NULL;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     sqlite3_free(query);
     return result;
@@ -222,34 +234,35 @@ int reg_portgroup_propset(reg_portgroup* portgroup, char* key, char* value,
     int result = 0;
     sqlite3_stmt* stmt = NULL;
     char* query;
-    query = sqlite3_mprintf("UPDATE registry.ports SET %q = '%q' WHERE ROWID=%lld",
-            key, value, portgroup->id);
-    if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_DONE:
-                    result = 1;
-                    break;
-                case SQLITE_BUSY:
-                    break;
-                default:
-                    if (sqlite3_reset(stmt) == SQLITE_CONSTRAINT) {
-                        errPtr->code = REG_CONSTRAINT;
-                        errPtr->description = "a constraint was disobeyed";
-                        errPtr->free = NULL;
-                    } else {
-                        reg_sqlite_error(reg->db, errPtr, query);
-                    }
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+    if (!reg_check_column(portgroup_columns, key, errPtr)) {
+        return 0;
+    }
+    query = sqlite3_mprintf("UPDATE registry.portgroups SET %s=? WHERE ROWID=?",
+            key);
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
+            && (sqlite3_bind_text(stmt, 1, value, -1, SQLITE_STATIC)
+                == SQLITE_OK)
+            && (sqlite3_bind_int64(stmt, 2, portgroup->id) == SQLITE_OK)) {
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_DONE:
+                result = 1;
+                break;
+            default:
+                if (sqlite3_reset(stmt) == SQLITE_CONSTRAINT) {
+                    errPtr->code = REG_CONSTRAINT;
+                    errPtr->description = "a constraint was disobeyed";
+                    errPtr->free = NULL;
+                } else {
+                    reg_sqlite_error(reg->db, errPtr, query);
+                }
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     sqlite3_free(query);
     return result;
@@ -275,7 +288,7 @@ reg_portgroup* reg_portgroup_open(reg_registry* reg, char *id, char* name, char*
     char* query;
     query = "SELECT ROWID FROM registry.portgroups WHERE id=? AND name=? AND version=? "
         "AND size=? AND sha256=?";
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 1, id, -1, SQLITE_STATIC)
                 == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC)
@@ -286,32 +299,27 @@ reg_portgroup* reg_portgroup_open(reg_registry* reg, char *id, char* name, char*
                 == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 5, sha256, -1, SQLITE_STATIC)
                 == SQLITE_OK)) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_ROW:
-                    reg_stmt_to_portgroup(reg, (void**)&portgroup, stmt, &lower_bound, errPtr);
-                    break;
-                case SQLITE_DONE:
-                    errPtr->code = REG_NOT_FOUND;
-                    errPtr->description = sqlite3_mprintf("no matching portgroup found for: " \
-                            "id=%s, name=%s, version=%s, size=%s, sha256=%s", \
-                            id, name, version, size, sha256);
-                    errPtr->free = (reg_error_destructor*) sqlite3_free;
-                    break;
-                case SQLITE_BUSY:
-                    continue;
-                default:
-                    reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_ROW:
+                reg_stmt_to_portgroup(reg, (void**)&portgroup, stmt, &lower_bound, errPtr);
+                break;
+            case SQLITE_DONE:
+                errPtr->code = REG_NOT_FOUND;
+                errPtr->description = sqlite3_mprintf("no matching portgroup found for: " \
+                        "id=%s, name=%s, version=%s, size=%s, sha256=%s", \
+                        id, name, version, size, sha256);
+                errPtr->free = (reg_error_destructor*) sqlite3_free;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     return portgroup;
 }
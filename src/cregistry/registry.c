@@ -113,6 +113,121 @@ void reg_throw(reg_error* errPtr, char* code, char* fmt, ...) {
     errPtr->free = (reg_error_destructor*)sqlite3_free;
 }
 
+/*
+ * Bounds for the busy handler. A connection that can't get a lock sleeps for
+ * REG_BUSY_MIN_DELAY ms at first, doubling the delay on each retry up to
+ * REG_BUSY_MAX_DELAY ms, and gives up with SQLITE_BUSY once it has waited for
+ * REG_BUSY_TIMEOUT ms in total.
+ */
+#define REG_BUSY_MIN_DELAY 1
+#define REG_BUSY_MAX_DELAY 250
+#define REG_BUSY_TIMEOUT 600000
+
+/**
+ * Busy handler installed on all registry connections. Sleeps with exponential
+ * backoff instead of retrying in a tight loop, so processes waiting for the
+ * registry don't take CPU time away from the one holding the lock. Time spent
+ * waiting is added to the statistics of the registry, if one is given.
+ *
+ * @param [in] userdata the `reg_registry` the connection belongs to, or NULL
+ * @param [in] count    number of times the handler was called for this lock
+ * @return              true to retry; false to give up
+ */
+static int reg_busy_handler(void* userdata, int count) {
+    reg_registry* reg = (reg_registry*)userdata;
+    int delay = REG_BUSY_MIN_DELAY;
+    int waited = 0;
+    int i;
+    for (i = 0; i < count; i++) {
+        waited += delay;
+        if (delay < REG_BUSY_MAX_DELAY) {
+            delay *= 2;
+        }
+    }
+    if (delay > REG_BUSY_MAX_DELAY) {
+        delay = REG_BUSY_MAX_DELAY;
+    }
+    if (waited >= REG_BUSY_TIMEOUT) {
+        return 0;
+    }
+    if (reg) {
+        if (count == 0) {
+            reg->lock_waits++;
+        }
+        reg->lock_wait_time += sqlite3_sleep(delay);
+    } else {
+        sqlite3_sleep(delay);
+    }
+    return 1;
+}
+
+/**
+ * Finalizes all statements in the statement cache of `reg` and empties it.
+ * Needs to be called before the registry database is detached.
+ *
+ * @param [in] reg registry whose statement cache should be emptied
+ */
+static void reg_stmt_flush(reg_registry* reg) {
+    Tcl_HashEntry* curr;
+    Tcl_HashSearch search;
+    for (curr = Tcl_FirstHashEntry(&reg->stmt_cache, &search); curr != NULL;
+            curr = Tcl_NextHashEntry(&search)) {
+        sqlite3_finalize(Tcl_GetHashValue(curr));
+    }
+    Tcl_DeleteHashTable(&reg->stmt_cache);
+    Tcl_InitHashTable(&reg->stmt_cache, TCL_STRING_KEYS);
+}
+
+/**
+ * Returns a prepared statement for `query`. Statements are cached per registry
+ * and keyed by their SQL text, so a query that has been run before does not
+ * have to be compiled again. Parameters must be bound using `sqlite3_bind_*`
+ * rather than being interpolated into `query`, or the cache will just fill up
+ * with single-use statements.
+ *
+ * The statement must be handed back using `reg_stmt_release` rather than
+ * `sqlite3_finalize` once the caller is done with it.
+ *
+ * @param [in] reg   registry whose connection should run the statement
+ * @param [in] query the SQL text of the statement
+ * @param [out] stmt the prepared statement; NULL if it couldn't be prepared
+ * @return           SQLITE_OK if success; a sqlite3 error code if failure
+ */
+int reg_stmt_prepare(reg_registry* reg, const char* query,
+        sqlite3_stmt** stmt) {
+    int is_new;
+    int r;
+    Tcl_HashEntry* hash = Tcl_CreateHashEntry(&reg->stmt_cache, query,
+            &is_new);
+    if (!is_new) {
+        *stmt = Tcl_GetHashValue(hash);
+        return SQLITE_OK;
+    }
+    r = sqlite3_prepare_v2(reg->db, query, -1, stmt, NULL);
+    if (r == SQLITE_OK) {
+        Tcl_SetHashValue(hash, *stmt);
+    } else {
+        Tcl_DeleteHashEntry(hash);
+        if (*stmt) {
+            sqlite3_finalize(*stmt);
+            *stmt = NULL;
+        }
+    }
+    return r;
+}
+
+/**
+ * Hands a statement obtained from `reg_stmt_prepare` back to the cache. The
+ * statement is reset (releasing any locks it holds) and its bindings are
+ * cleared, so pointers bound with `SQLITE_STATIC` don't outlive the caller.
+ *
+ * @param [in] stmt statement to release
+ */
+void reg_stmt_release(sqlite3_stmt* stmt) {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
 /**
  * Creates a new registry object. To start using a registry, one must first be
  * attached with `reg_attach`.
@@ -123,20 +238,31 @@ void reg_throw(reg_error* errPtr, char* code, char* fmt, ...) {
  */
 int reg_open(reg_registry** regPtr, reg_error* errPtr) {
     reg_registry* reg = malloc(sizeof(reg_registry));
+    int r;
     if (!reg) {
         return 0;
     }
-    if (sqlite3_open(NULL, &reg->db) == SQLITE_OK) {
+#if SQLITE_VERSION_NUMBER >= 3008000
+    /* URIs are needed to attach a registry as immutable */
+    r = sqlite3_open_v2(NULL, &reg->db, SQLITE_OPEN_READWRITE
+            | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI, NULL);
+#else
+    r = sqlite3_open(NULL, &reg->db);
+#endif
+    if (r == SQLITE_OK) {
         /* Enable extended result codes, requires SQLite >= 3.3.8
          * Check added for compatibility with Tiger. */
 #if SQLITE_VERSION_NUMBER >= 3003008
         sqlite3_extended_result_codes(reg->db, 1);
 #endif
 
-        sqlite3_busy_timeout(reg->db, 25);
+        sqlite3_busy_handler(reg->db, reg_busy_handler, reg);
 
         if (init_db(reg->db, errPtr)) {
             reg->status = reg_none;
+            reg->lock_waits = 0;
+            reg->lock_wait_time = 0;
+            Tcl_InitHashTable(&reg->stmt_cache, TCL_STRING_KEYS);
             *regPtr = reg;
             return 1;
         }
@@ -159,7 +285,9 @@ int reg_close(reg_registry* reg, reg_error* errPtr) {
     if ((reg->status & reg_attached) && !reg_detach(reg, errPtr)) {
         return 0;
     }
+    reg_stmt_flush(reg);
     if (sqlite3_close(reg->db) == SQLITE_OK) {
+        Tcl_DeleteHashTable(&reg->stmt_cache);
         free(reg);
         return 1;
     } else {
@@ -169,17 +297,63 @@ int reg_close(reg_registry* reg, reg_error* errPtr) {
     }
 }
 
+#if SQLITE_VERSION_NUMBER >= 3008000
+/**
+ * Builds the query attaching the registry database at path as immutable. It
+ * is then read without locking it, and without the -wal and -shm files of a
+ * WAL database.
+ *
+ * @param [in] path path to the registry db on disk
+ * @return          the query, to be freed with `sqlite3_free`
+ */
+static char* attach_immutable_query(const char* path) {
+    char* uri = malloc(3 * strlen(path) + 1);
+    char* query;
+    const char* p;
+    char* q = uri;
+    if (!uri) {
+        return NULL;
+    }
+    /* these are special in URIs */
+    for (p = path; *p; p++) {
+        if (*p == '%' || *p == '?' || *p == '#') {
+            q += sprintf(q, "%%%02X", (unsigned char)*p);
+        } else {
+            *q++ = *p;
+        }
+    }
+    *q = '\0';
+    query = sqlite3_mprintf("ATTACH DATABASE 'file:%q?immutable=1' AS "
+            "registry", uri);
+    free(uri);
+    return query;
+}
+#endif
+
 /**
  * Attaches a registry database to the registry object. Prior to calling this,
  * the registry object is not actually connected to the registry. This function
  * attaches it so it can be queried and manipulated.
  *
- * @param [in] reg     the registry to attach to
- * @param [in] path    path to the registry db on disk
- * @param [out] errPtr on error, a description of the error that occurred
- * @return             true if success; false if failure
+ * If `journal_mode` is "wal" or "delete", the database is switched to that
+ * journal mode if it isn't using it already. WAL mode allows readers to
+ * proceed while another process is writing. If it is NULL, the journal mode is
+ * left unchanged.
+ *
+ * Reading a WAL database needs its -wal and -shm files, which users who can't
+ * write to its directory can't create. They are kept once created, but if they
+ * are missing, such users attach the database as immutable instead. No process
+ * is using it then, but one that starts writing to it while it is attached can
+ * make it look corrupt.
+ *
+ * @param [in] reg          the registry to attach to
+ * @param [in] path         path to the registry db on disk
+ * @param [in] journal_mode journal mode to use, or NULL
+ * @param [out] errPtr      on error, a description of the error that occurred
+ * @return                  true if success; false if failure
  */
-int reg_attach(reg_registry* reg, const char* path, reg_error* errPtr) {
+int reg_attach(reg_registry* reg, const char* path, const char* journal_mode,
+        reg_error* errPtr) {
     struct stat sb;
     int initialized = 1; /* registry already exists */
     int can_write = 1; /* can write to this location */
@@ -207,41 +381,64 @@ int reg_attach(reg_registry* reg, const char* path, reg_error* errPtr) {
     if (initialized || can_write) {
         sqlite3_stmt* stmt = NULL;
         char* query = sqlite3_mprintf("ATTACH DATABASE '%q' AS registry", path);
-        int r;
-        do {
-            r = sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL);
-        } while (r == SQLITE_BUSY);
+        int r = sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL);
         if (r == SQLITE_OK) {
-            /* XXX: Busy waiting, consider using sqlite3_busy_handler/timeout */
-            do {
-                sqlite3_step(stmt);
-                r = sqlite3_reset(stmt);
-                switch (r) {
-                    case SQLITE_OK:
-                        if (initialized || (create_tables(reg->db, errPtr))) {
-                            Tcl_InitHashTable(&reg->open_entries,
-                                    sizeof(sqlite_int64)/sizeof(int));
-                            Tcl_InitHashTable(&reg->open_files,
-                                    TCL_STRING_KEYS);
-                            Tcl_InitHashTable(&reg->open_portgroups,
-                                    sizeof(sqlite_int64)/sizeof(int));
-                            reg->status |= reg_attached;
-                            result = 1;
-                        }
-                        break;
-                    case SQLITE_BUSY:
-                        break;
-                    default:
-                        reg_sqlite_error(reg->db, errPtr, query);
+            sqlite3_step(stmt);
+            r = sqlite3_reset(stmt);
+#if SQLITE_VERSION_NUMBER >= 3008000
+            if (initialized && ((r & 0xff) == SQLITE_READONLY
+                        || (r & 0xff) == SQLITE_CANTOPEN)
+                    && access(path, W_OK) != 0) {
+                char* immutable = attach_immutable_query(path);
+                sqlite3_finalize(stmt);
+                stmt = NULL;
+                if (immutable) {
+                    sqlite3_free(query);
+                    query = immutable;
+                    r = sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL);
+                    if (r == SQLITE_OK) {
+                        sqlite3_step(stmt);
+                        r = sqlite3_reset(stmt);
+                    }
+                    /* the journal mode can't be changed anyway */
+                    journal_mode = NULL;
                 }
-            } while (r == SQLITE_BUSY);
+            }
+#endif
+            switch (r) {
+                case SQLITE_OK:
+                    if (initialized || (create_tables(reg->db, errPtr))) {
+                        Tcl_InitHashTable(&reg->open_entries,
+                                sizeof(sqlite_int64)/sizeof(int));
+                        Tcl_InitHashTable(&reg->open_files,
+                                TCL_STRING_KEYS);
+                        Tcl_InitHashTable(&reg->open_portgroups,
+                                sizeof(sqlite_int64)/sizeof(int));
+                        reg->status |= reg_attached;
+                        result = 1;
+                    }
+                    break;
+                default:
+                    reg_sqlite_error(reg->db, errPtr, query);
+            }
 
             sqlite3_finalize(stmt);
             stmt = NULL;
 
             if (result) {
-                result &= update_db(reg->db, errPtr);
+                result &= update_db(reg->db, journal_mode, errPtr);
+            }
+#if SQLITE_VERSION_NUMBER >= 3007014
+            if (result) {
+                /* keep the -wal and -shm files of a WAL database when the
+                 * last connection closes: users who can't write to the
+                 * directory of the registry can't create them, but can read
+                 * the database through them once they exist */
+                int persist = 1;
+                sqlite3_file_control(reg->db, "registry",
+                        SQLITE_FCNTL_PERSIST_WAL, &persist);
             }
+#endif
         } else {
             reg_sqlite_error(reg->db, errPtr, query);
         }
@@ -273,45 +470,43 @@ int reg_detach(reg_registry* reg, reg_error* errPtr) {
         reg_throw(errPtr,REG_MISUSE,"no database is attached to this registry");
         return 0;
     }
+    /* cached statements refer to the attached database and would keep it from
+     * being detached */
+    reg_stmt_flush(reg);
     if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK) {
         int r;
         reg_entry* entry;
         Tcl_HashEntry* curr;
         Tcl_HashSearch search;
-        /* XXX: Busy waiting, consider using sqlite3_busy_handler/timeout */
-        do {
-            sqlite3_step(stmt);
-            r = sqlite3_reset(stmt);
-            switch (r) {
-                case SQLITE_OK:
-                    for (curr = Tcl_FirstHashEntry(&reg->open_entries, &search);
-                            curr != NULL; curr = Tcl_NextHashEntry(&search)) {
-                        entry = Tcl_GetHashValue(curr);
-                        if (entry->proc) {
-                            free(entry->proc);
-                        }
-                        free(entry);
+        sqlite3_step(stmt);
+        r = sqlite3_reset(stmt);
+        switch (r) {
+            case SQLITE_OK:
+                for (curr = Tcl_FirstHashEntry(&reg->open_entries, &search);
+                        curr != NULL; curr = Tcl_NextHashEntry(&search)) {
+                    entry = Tcl_GetHashValue(curr);
+                    if (entry->proc) {
+                        free(entry->proc);
                     }
-                    Tcl_DeleteHashTable(&reg->open_entries);
-                    for (curr = Tcl_FirstHashEntry(&reg->open_files, &search);
-                            curr != NULL; curr = Tcl_NextHashEntry(&search)) {
-                        reg_file* file = Tcl_GetHashValue(curr);
-
-                        free(file->proc);
-                        free(file->key.path);
-                        free(file);
-                    }
-                    Tcl_DeleteHashTable(&reg->open_files);
-                    reg->status &= ~reg_attached;
-                    result = 1;
-                    break;
-                case SQLITE_BUSY:
-                    break;
-                default:
-                    reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+                    free(entry);
+                }
+                Tcl_DeleteHashTable(&reg->open_entries);
+                for (curr = Tcl_FirstHashEntry(&reg->open_files, &search);
+                        curr != NULL; curr = Tcl_NextHashEntry(&search)) {
+                    reg_file* file = Tcl_GetHashValue(curr);
+
+                    free(file->proc);
+                    free(file->key.path);
+                    free(file);
+                }
+                Tcl_DeleteHashTable(&reg->open_files);
+                reg->status &= ~reg_attached;
+                result = 1;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
@@ -331,13 +526,9 @@ static int reg_start(reg_registry* reg, const char* query, reg_error* errPtr) {
         errPtr->free = NULL;
         return 0;
     } else {
-        int r;
-        do {
-            r = sqlite3_exec(reg->db, query, NULL, NULL, NULL);
-            if (r == SQLITE_OK) {
-                return 1;
-            }
-        } while (r == SQLITE_BUSY);
+        if (sqlite3_exec(reg->db, query, NULL, NULL, NULL) == SQLITE_OK) {
+            return 1;
+        }
         reg_sqlite_error(reg->db, errPtr, NULL);
         return 0;
     }
@@ -381,19 +572,15 @@ int reg_start_write(reg_registry* reg, reg_error* errPtr) {
 /**
  * Helper function for `reg_commit` and `reg_rollback`.
  */
-static int reg_end(reg_registry* reg, const char* query, reg_error* errPtr, int is_rollback) {
+static int reg_end(reg_registry* reg, const char* query, reg_error* errPtr) {
     if (!(reg->status & reg_transacting)) {
         reg_throw(errPtr, REG_MISUSE, "couldn't end transaction because no "
                 "transaction is open");
         return 0;
     } else {
-        int r;
-        do {
-            r = sqlite3_exec(reg->db, query, NULL, NULL, NULL);
-            if (r == SQLITE_OK) {
-                return 1;
-            }
-        } while (r == SQLITE_BUSY && !is_rollback);
+        if (sqlite3_exec(reg->db, query, NULL, NULL, NULL) == SQLITE_OK) {
+            return 1;
+        }
         reg_sqlite_error(reg->db, errPtr, NULL);
         return 0;
     }
@@ -408,7 +595,7 @@ static int reg_end(reg_registry* reg, const char* query, reg_error* errPtr, int
  * @return             true if success; false if failure
  */
 int reg_commit(reg_registry* reg, reg_error* errPtr) {
-    if (reg_end(reg, "COMMIT", errPtr, 0)) {
+    if (reg_end(reg, "COMMIT", errPtr)) {
         reg->status &= ~(reg_transacting | reg_can_write);
         return 1;
     } else {
@@ -425,7 +612,7 @@ int reg_commit(reg_registry* reg, reg_error* errPtr) {
  * @return             true if success; false if failure
  */
 int reg_rollback(reg_registry* reg, reg_error* errPtr) {
-    if (reg_end(reg, "ROLLBACK", errPtr, 1)) {
+    if (reg_end(reg, "ROLLBACK", errPtr)) {
         reg->status &= ~(reg_transacting | reg_can_write);
         return 1;
     } else {
@@ -448,6 +635,7 @@ int reg_vacuum(char *db_path) {
     reg_error err;
 
     if (sqlite3_open(db_path, &db) == SQLITE_OK) {
+        sqlite3_busy_handler(db, reg_busy_handler, NULL);
         if (!init_db(db, &err)) {
             sqlite3_close(db);
             return 0;
@@ -458,14 +646,11 @@ int reg_vacuum(char *db_path) {
 
     if (sqlite3_prepare_v2(db, "VACUUM", -1, &stmt, NULL) == SQLITE_OK) {
         int r;
-        /* XXX: Busy waiting, consider using sqlite3_busy_handler/timeout */
-        do {
-            sqlite3_step(stmt);
-            r = sqlite3_reset(stmt);
-            if (r == SQLITE_OK) {
-                result = 1;
-            }
-        } while (r == SQLITE_BUSY);
+        sqlite3_step(stmt);
+        r = sqlite3_reset(stmt);
+        if (r == SQLITE_OK) {
+            result = 1;
+        }
     }
     if (stmt) {
         sqlite3_finalize(stmt);
@@ -474,6 +659,35 @@ int reg_vacuum(char *db_path) {
     return result;
 }
 
+/**
+ * Gets the journal mode of the attached registry database, e.g. "delete" or
+ * "wal".
+ *
+ * @param [in] reg     registry to query
+ * @param [out] mode   the journal mode, to be freed by the caller
+ * @param [out] errPtr on error, a description of the error that occurred
+ * @return             true if success; false if failure
+ */
+int reg_journal_mode(reg_registry* reg, char** mode, reg_error* errPtr) {
+    int result = 0;
+    sqlite3_stmt* stmt = NULL;
+    char* query = "PRAGMA registry.journal_mode";
+    if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* text = (const char*)sqlite3_column_text(stmt, 0);
+        if (text && (*mode = strdup(text))) {
+            result = 1;
+        }
+    }
+    if (!result) {
+        reg_sqlite_error(reg->db, errPtr, query);
+    }
+    if (stmt) {
+        sqlite3_finalize(stmt);
+    }
+    return result;
+}
+
 /**
  * Functions for access to the metadata table
  */
@@ -491,38 +705,33 @@ int reg_get_metadata(reg_registry* reg, const char* key, char** value,
     sqlite3_stmt* stmt = NULL;
     char* query = "SELECT value FROM registry.metadata WHERE key=?";
     const char *text;
-    if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK
+    if (reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK
             && (sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC) == SQLITE_OK)) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_ROW:
-                    text = (const char*)sqlite3_column_text(stmt, 0);
-                    if (text) {
-                        *value = strdup(text);
-                        result = 1;
-                    } else {
-                        reg_sqlite_error(reg->db, errPtr, query);
-                    }
-                    break;
-                case SQLITE_DONE:
-                    errPtr->code = REG_NOT_FOUND;
-                    errPtr->description = "no such key in metadata";
-                    errPtr->free = NULL;
-                    break;
-                case SQLITE_BUSY:
-                    continue;
-                default:
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_ROW:
+                text = (const char*)sqlite3_column_text(stmt, 0);
+                if (text) {
+                    *value = strdup(text);
+                    result = 1;
+                } else {
                     reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+                }
+                break;
+            case SQLITE_DONE:
+                errPtr->code = REG_NOT_FOUND;
+                errPtr->description = "no such key in metadata";
+                errPtr->free = NULL;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     return result;
 }
@@ -543,36 +752,30 @@ int reg_set_metadata(reg_registry* reg, const char* key, const char* value,
     int get_returnval = reg_get_metadata(reg, key, &test_value, errPtr);
     if (get_returnval) {
         free(test_value);
-        query = sqlite3_mprintf("UPDATE registry.metadata SET value = '%q' WHERE key='%q'",
-            value, key);
+        query = "UPDATE registry.metadata SET value=?1 WHERE key=?2";
     } else if (errPtr->code == REG_NOT_FOUND) {
-        query = sqlite3_mprintf("INSERT INTO registry.metadata (key, value) VALUES ('%q', '%q')",
-            key, value);
+        query = "INSERT INTO registry.metadata (key, value) VALUES (?2, ?1)";
     } else {
         return get_returnval;
     }
-    if (sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_DONE:
-                    result = 1;
-                    break;
-                case SQLITE_BUSY:
-                    break;
-                default:
-                    reg_sqlite_error(reg->db, errPtr, query);
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
+            && (sqlite3_bind_text(stmt, 1, value, -1, SQLITE_STATIC) == SQLITE_OK)
+            && (sqlite3_bind_text(stmt, 2, key, -1, SQLITE_STATIC) == SQLITE_OK)) {
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_DONE:
+                result = 1;
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
-    sqlite3_free(query);
     return result;
 }
 
@@ -586,34 +789,29 @@ int reg_del_metadata(reg_registry* reg, const char* key, reg_error* errPtr) {
     int result = 1;
     sqlite3_stmt* stmt = NULL;
     char* query = "DELETE FROM registry.metadata WHERE key=?";
-    if ((sqlite3_prepare_v2(reg->db, query, -1, &stmt, NULL) == SQLITE_OK)
+    if ((reg_stmt_prepare(reg, query, &stmt) == SQLITE_OK)
             && (sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC) == SQLITE_OK)) {
-        int r;
-        do {
-            r = sqlite3_step(stmt);
-            switch (r) {
-                case SQLITE_DONE:
-                    if (sqlite3_changes(reg->db) == 0) {
-                        reg_throw(errPtr, REG_INVALID, "no such metadata key");
-                        result = 0;
-                    } else {
-                        sqlite3_reset(stmt);
-                    }
-                    break;
-                case SQLITE_BUSY:
-                    break;
-                default:
-                    reg_sqlite_error(reg->db, errPtr, query);
+        int r = sqlite3_step(stmt);
+        switch (r) {
+            case SQLITE_DONE:
+                if (sqlite3_changes(reg->db) == 0) {
+                    reg_throw(errPtr, REG_INVALID, "no such metadata key");
                     result = 0;
-                    break;
-            }
-        } while (r == SQLITE_BUSY);
+                } else {
+                    sqlite3_reset(stmt);
+                }
+                break;
+            default:
+                reg_sqlite_error(reg->db, errPtr, query);
+                result = 0;
+                break;
+        }
     } else {
         reg_sqlite_error(reg->db, errPtr, query);
         result = 0;
     }
     if (stmt) {
-        sqlite3_finalize(stmt);
+        reg_stmt_release(stmt);
     }
     return result;
 }
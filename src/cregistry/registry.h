@@ -67,6 +67,7 @@ void reg_throw(reg_error* errPtr, char* code, char* fmt, ...);
 typedef int (cast_function)(void* userdata, void** dst, void* src,
         void* calldata, reg_error* errPtr);
 typedef void (free_function)(void* userdata, void* item);
+typedef int (row_function)(void* calldata, char** values, int column_count);
 
 enum {
     reg_none = 0,
@@ -81,12 +82,16 @@ typedef struct {
     Tcl_HashTable open_entries;
     Tcl_HashTable open_files;
     Tcl_HashTable open_portgroups;
+    Tcl_HashTable stmt_cache;
+    int lock_waits; /* number of times a lock had to be waited for */
+    sqlite_int64 lock_wait_time; /* total time spent waiting, in ms */
 } reg_registry;
 
 int reg_open(reg_registry** regPtr, reg_error* errPtr);
 int reg_close(reg_registry* reg, reg_error* errPtr);
 
-int reg_attach(reg_registry* reg, const char* path, reg_error* errPtr);
+int reg_attach(reg_registry* reg, const char* path, const char* journal_mode,
+        reg_error* errPtr);
 int reg_detach(reg_registry* reg, reg_error* errPtr);
 
 int reg_start_read(reg_registry* reg, reg_error* errPtr);
@@ -95,6 +100,11 @@ int reg_commit(reg_registry* reg, reg_error* errPtr);
 int reg_rollback(reg_registry* reg, reg_error* errPtr);
 
 int reg_vacuum(char* db_path);
+int reg_journal_mode(reg_registry* reg, char** mode, reg_error* errPtr);
+
+int reg_stmt_prepare(reg_registry* reg, const char* query,
+        sqlite3_stmt** stmt);
+void reg_stmt_release(sqlite3_stmt* stmt);
 
 int reg_get_metadata(reg_registry* reg, const char* key, char** value, reg_error* errPtr);
 int reg_set_metadata(reg_registry* reg, const char* key, const char* value, reg_error* errPtr);
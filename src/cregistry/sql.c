@@ -36,6 +36,7 @@
 
 #include <sqlite3.h>
 #include <string.h>
+#include <strings.h>
 #include <tcl.h>
 #include <time.h>
 
@@ -66,9 +67,7 @@ int do_queries(sqlite3* db, char** queries, reg_error* errPtr) {
             break;
         }
 
-        do {
-            r = sqlite3_step(stmt);
-        } while (r == SQLITE_BUSY);
+        r = sqlite3_step(stmt);
 
         sqlite3_finalize(stmt);
 
@@ -231,16 +230,61 @@ static int rollback_db(sqlite3* db) {
     return 1;
 }
 
+/**
+ * Switches the registry database to the given journal mode unless it already
+ * uses it. Changing the journal mode needs exclusive access to the database,
+ * so failing to do so because another process is using the registry, or
+ * because the database is read-only, is not treated as an error; the switch
+ * will be tried again the next time the registry is opened.
+ *
+ * @param [in] db           database to update
+ * @param [in] journal_mode "wal" or "delete"
+ * @param [out] errPtr      on error, a description of the error that occurred
+ * @return                  true if success; false if failure
+ */
+static int update_journal_mode(sqlite3* db, const char* journal_mode,
+        reg_error* errPtr) {
+    sqlite3_stmt* stmt = NULL;
+    const char* current;
+    char* query;
+
+    if (strcmp(journal_mode, "wal") != 0
+            && strcmp(journal_mode, "delete") != 0) {
+        reg_throw(errPtr, REG_INVALID, "invalid journal mode: %s",
+                journal_mode);
+        return 0;
+    }
+
+    if (sqlite3_prepare_v2(db, "PRAGMA registry.journal_mode", -1, &stmt,
+                NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW
+            && (current = (const char*)sqlite3_column_text(stmt, 0)) != NULL
+            && strcasecmp(current, journal_mode) == 0) {
+        sqlite3_finalize(stmt);
+        return 1;
+    }
+    sqlite3_finalize(stmt);
+
+    query = sqlite3_mprintf("PRAGMA registry.journal_mode = %s",
+            journal_mode);
+    if (query) {
+        sqlite3_exec(db, query, NULL, NULL, NULL);
+        sqlite3_free(query);
+    }
+    return 1;
+}
+
 /**
  * Updates the database if necessary. This function queries the current database version
  * from the metadata table and executes SQL to update the schema to newer versions if needed.
- * After that, this function updates the database version number
+ * After that, this function updates the database version number. Finally, if
+ * `journal_mode` is given, the database is switched to that journal mode.
  *
- * @param [in] db      database to update
- * @param [out] errPtr on error, a description of the error that occurred
- * @return             true if success; false if failure
+ * @param [in] db           database to update
+ * @param [in] journal_mode "wal", "delete" or NULL to leave it unchanged
+ * @param [out] errPtr      on error, a description of the error that occurred
+ * @return                  true if success; false if failure
  */
-int update_db(sqlite3* db, reg_error* errPtr) {
+int update_db(sqlite3* db, const char* journal_mode, reg_error* errPtr) {
     const char* version;
     int r;
     int did_update = 0; /* true, if an update was done and the loop should be run again */
@@ -739,6 +783,9 @@ int update_db(sqlite3* db, reg_error* errPtr) {
         case SQLITE_OK:
         case SQLITE_DONE:
         case SQLITE_ROW:
+            if (journal_mode) {
+                return update_journal_mode(db, journal_mode, errPtr);
+            }
             return 1;
         default:
             reg_sqlite_error(db, errPtr, query);
@@ -756,8 +803,11 @@ int update_db(sqlite3* db, reg_error* errPtr) {
  * @return             true if success; false if failure
  */
 int init_db(sqlite3* db, reg_error* errPtr) {
-    /* no code that uses these tables is being built at this time */
     static char* queries[] = {
+        /* paths looked up in bulk by reg_entry_owners */
+        "CREATE TEMPORARY TABLE owner_paths (path TEXT)",
+
+        /* no code that uses these tables is being built at this time */
         /*"BEGIN",*/
 
         /* items cache */
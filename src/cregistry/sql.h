@@ -38,6 +38,6 @@
 
 int create_tables(sqlite3* db, reg_error* errPtr);
 int init_db(sqlite3* db, reg_error* errPtr);
-int update_db(sqlite3* db, reg_error* errPtr);
+int update_db(sqlite3* db, const char* journal_mode, reg_error* errPtr);
 
 #endif /* _SQL_H */
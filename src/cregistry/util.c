@@ -113,6 +113,28 @@ char* reg_strategy_op(reg_strategy strategy, reg_error* errPtr) {
     }
 }
 
+/**
+ * Checks that `key` is one of the given column names. Property names are
+ * formatted into queries verbatim, so they have to be validated this way
+ * before being used.
+ *
+ * @param [in] columns NULL-terminated list of valid column names
+ * @param [in] key     the column name to check
+ * @param [out] errPtr on error, a description of the error that occurred
+ * @return             true if `key` is a valid column; false otherwise
+ */
+int reg_check_column(const char** columns, const char* key,
+        reg_error* errPtr) {
+    const char** column;
+    for (column = columns; *column != NULL; column++) {
+        if (strcmp(*column, key) == 0) {
+            return 1;
+        }
+    }
+    reg_throw(errPtr, REG_INVALID, "invalid property name: %s", key);
+    return 0;
+}
+
 /**
  * Convenience method for returning all objects of a given type from the
  * registry.
@@ -154,13 +176,11 @@ int reg_all_objects(reg_registry* reg, char* query, int query_len,
                     break;
                 case SQLITE_DONE:
                     break;
-                case SQLITE_BUSY:
-                    continue;
                 default:
                     reg_sqlite_error(reg->db, errPtr, query);
                     break;
             }
-        } while (r == SQLITE_ROW || r == SQLITE_BUSY);
+        } while (r == SQLITE_ROW);
         sqlite3_finalize(stmt);
         if (r == SQLITE_DONE) {
             *objects = results;
@@ -181,3 +201,107 @@ int reg_all_objects(reg_registry* reg, char* query, int query_len,
     return -1;
 }
 
+
+/* number of rows reg_foreach_row reads before calling back for them */
+#define REG_FOREACH_CHUNK 256
+
+/**
+ * Calls `fn` for each row returned by a query, reading the rows in chunks of
+ * `REG_FOREACH_CHUNK` ordered by rowid. Unlike `reg_all_objects`, no list of
+ * results is built, so the memory needed doesn't depend on the number of rows
+ * returned. Each chunk is copied and its statement reset before `fn` is
+ * called, so that no read lock is held while the callbacks run: they may take
+ * a long time, and in rollback journal mode a pending read blocks writers.
+ * Rows changed between chunks are seen as they are when their chunk is read.
+ *
+ * The query must select from a single table, with the rowid selected last as
+ * `reg_rowid`, which isn't passed to `fn`. The values passed to `fn` are only
+ * valid for the duration of the call, and are NULL for NULL values. `fn`
+ * returns true to continue with the next row or false to stop early; stopping
+ * early is not considered a failure.
+ *
+ * @param [in] reg       registry to select rows from
+ * @param [in] query     the select query to execute
+ * @param [in] query_len length of the query (or -1 for automatic)
+ * @param [in] fn        function to call for each row
+ * @param [in] calldata  data passed along to `fn`
+ * @param [out] errPtr   on error, a description of the error that occurred
+ * @return               true if success; false if failure
+ */
+int reg_foreach_row(reg_registry* reg, char* query, int query_len,
+        row_function* fn, void* calldata, reg_error* errPtr) {
+    sqlite3_stmt* stmt = NULL;
+    char* chunk_query;
+    char** values;
+    sqlite3_int64 next_rowid = (-9223372036854775807LL - 1);
+    sqlite3_int64 last_rowid = 0;
+    int column_count;
+    int row_count = REG_FOREACH_CHUNK;
+    int stop = 0;
+    int result = 1;
+    int r = SQLITE_DONE;
+    int i;
+
+    chunk_query = sqlite3_mprintf("SELECT * FROM (%.*s) WHERE reg_rowid >= ? "
+            "ORDER BY reg_rowid LIMIT %d",
+            query_len < 0 ? (int)strlen(query) : query_len, query,
+            REG_FOREACH_CHUNK);
+    if (!chunk_query) {
+        return 0;
+    }
+    if (sqlite3_prepare_v2(reg->db, chunk_query, -1, &stmt, NULL)
+            != SQLITE_OK) {
+        if (stmt) {
+            sqlite3_finalize(stmt);
+        }
+        reg_sqlite_error(reg->db, errPtr, chunk_query);
+        sqlite3_free(chunk_query);
+        return 0;
+    }
+    /* the values of every column but the rowid, row after row */
+    column_count = sqlite3_column_count(stmt) - 1;
+    values = calloc((size_t)REG_FOREACH_CHUNK * column_count + 1,
+            sizeof(char*));
+    if (!values) {
+        sqlite3_finalize(stmt);
+        sqlite3_free(chunk_query);
+        return 0;
+    }
+    while (result && !stop && row_count == REG_FOREACH_CHUNK) {
+        sqlite3_bind_int64(stmt, 1, next_rowid);
+        row_count = 0;
+        while (result && (r = sqlite3_step(stmt)) == SQLITE_ROW) {
+            char** row = values + (size_t)row_count * column_count;
+            for (i = 0; i < column_count; i++) {
+                const char* text = (const char*)sqlite3_column_text(stmt, i);
+                if (text && !(row[i] = strdup(text))) {
+                    result = 0;
+                }
+            }
+            last_rowid = sqlite3_column_int64(stmt, column_count);
+            row_count++;
+        }
+        if (result && r != SQLITE_DONE) {
+            reg_sqlite_error(reg->db, errPtr, chunk_query);
+            result = 0;
+        }
+        /* end the read before calling back */
+        sqlite3_reset(stmt);
+        for (i = 0; i < row_count && result && !stop; i++) {
+            stop = !fn(calldata, values + (size_t)i * column_count,
+                    column_count);
+        }
+        for (i = 0; i < row_count * column_count; i++) {
+            free(values[i]);
+            values[i] = NULL;
+        }
+        if (last_rowid == 9223372036854775807LL) {
+            break;
+        }
+        next_rowid = last_rowid + 1;
+    }
+    free(values);
+    sqlite3_finalize(stmt);
+    sqlite3_free(chunk_query);
+    return result;
+}
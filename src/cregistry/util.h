@@ -47,6 +47,10 @@ int reg_all_objects(reg_registry* reg, char* query, int query_len,
         void*** objects, cast_function* fn, void* castcalldata,
         free_function* del, reg_error* errPtr);
 char* reg_strategy_op(reg_strategy strategy, reg_error* errPtr);
+int reg_check_column(const char** columns, const char* key,
+        reg_error* errPtr);
+int reg_foreach_row(reg_registry* reg, char* query, int query_len,
+        row_function* fn, void* calldata, reg_error* errPtr);
 
 #endif /* _CUTIL_H */
 
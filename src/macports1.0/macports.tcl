@@ -47,12 +47,12 @@ namespace eval macports {
     namespace export bootstrap_options user_options portinterp_options open_mports ui_priorities
     variable bootstrap_options "\
         portdbpath binpath auto_path extra_env sources_conf prefix portdbformat \
-        portarchivetype hfscompression portautoclean \
+        registry_wal portinfo_cache portarchivetype hfscompression portautoclean \
         porttrace portverbose keeplogs destroot_umask variants_conf rsync_server rsync_options \
         rsync_dir startupitem_autostart startupitem_type startupitem_install \
         place_worksymlink xcodeversion xcodebuildcmd \
         configureccache ccache_dir ccache_size configuredistcc configurepipe buildnicevalue buildmakejobs \
-        applications_dir frameworks_dir developer_dir universal_archs build_arch macosx_sdk_version macosx_deployment_target \
+        buildjobs_parallel_ports applications_dir frameworks_dir developer_dir universal_archs build_arch macosx_sdk_version macosx_deployment_target \
         macportsuser proxy_override_env proxy_http proxy_https proxy_ftp proxy_rsync proxy_skip \
         master_site_local patch_site_local archive_site_local buildfromsource \
         revupgrade_autorun revupgrade_mode revupgrade_check_id_loadcmds \
@@ -663,6 +663,7 @@ proc mportinit {{up_ui_options {}} {up_options {}} {up_variations {}}} {
         macports::configurepipe \
         macports::buildnicevalue \
         macports::buildmakejobs \
+        macports::buildjobs_parallel_ports \
         macports::universal_archs \
         macports::build_arch \
         macports::os_arch \
@@ -676,7 +677,7 @@ proc mportinit {{up_ui_options {}} {up_options {}} {up_variations {}}} {
         macports::macosx_sdk_version \
         macports::macosx_deployment_target \
         macports::archivefetch_pubkeys \
-        macports::ping_cache \
+        macports::host_stats \
         macports::host_cache \
         macports::delete_la_files \
         macports::cxx_stdlib \
@@ -918,6 +919,12 @@ Please edit sources.conf and change '$url' to '[string range $url 0 end-6]tarbal
         return -code error "unknown registry format '$portdbformat' set in macports.conf"
     }
 
+    # whether to keep the results of evaluating Portfiles
+    if {![info exists portinfo_cache]} {
+        set macports::portinfo_cache yes
+        global macports::portinfo_cache
+    }
+
     # Autoclean mode, whether to automatically call clean after "install"
     if {![info exists portautoclean]} {
         set macports::portautoclean yes
@@ -1084,6 +1091,9 @@ match macports.conf.default."
     if {![info exists macports::buildmakejobs]} {
         set macports::buildmakejobs 0
     }
+    if {![info exists macports::buildjobs_parallel_ports]} {
+        set macports::buildjobs_parallel_ports 1
+    }
 
     # default user to run as when privileges can be dropped
     if {![info exists macports::macportsuser]} {
@@ -1301,16 +1311,16 @@ match macports.conf.default."
     # add ccache to environment
     set env(CCACHE_DIR) $macports::ccache_dir
 
-    # load cached ping times
+    # load the statistics of earlier fetches
     try -pass_signal {
-        set pingfile -1
-        set pingfile [open ${macports::portdbpath}/pingtimes r]
-        array set macports::ping_cache [gets $pingfile]
+        set statsfile -1
+        set statsfile [open ${macports::portdbpath}/hoststats r]
+        array set macports::host_stats [gets $statsfile]
     } catch {*} {
-        array set macports::ping_cache {}
+        array set macports::host_stats {}
     } finally {
-        if {$pingfile != -1} {
-            close $pingfile
+        if {$statsfile != -1} {
+            close $statsfile
         }
     }
     if {![info exists macports::host_blacklist]} {
@@ -1337,7 +1347,11 @@ match macports.conf.default."
     # init registry
     set db_path [file join ${registry.path} registry registry.db]
     set db_exists [file exists $db_path]
-    registry::open $db_path
+    if {[info exists macports::registry_wal] && [string is true -strict $macports::registry_wal]} {
+        registry::open -journal wal $db_path
+    } else {
+        registry::open -journal delete $db_path
+    }
     # for the benefit of the portimage code that is called from multiple interpreters
     global registry_open
     set registry_open yes
@@ -1356,22 +1370,30 @@ match macports.conf.default."
 
 # call this just before you exit
 proc mportshutdown {} {
-    # save ping times
-    global macports::ping_cache macports::portdbpath
-    if {[file writable $macports::portdbpath]} {
+    # save the statistics of fetches, unless this is a child process building
+    # a port, whose fetches are recorded by the parent
+    global macports::host_stats macports::portdbpath
+    if {[file writable $macports::portdbpath] && ![info exists macports::host_fetches]} {
         catch {
-            foreach host [array names ping_cache] {
+            set stats_fresh {}
+            foreach host [array names host_stats] {
                 # don't save expired entries
-                if {[clock seconds] - [lindex $ping_cache($host) 1] < 86400} {
-                    lappend pinglist_fresh $host $ping_cache($host)
+                if {[clock seconds] - [lindex $host_stats($host) 2] < 30 * 86400} {
+                    lappend stats_fresh $host $host_stats($host)
                 }
             }
-            set pingfile [open ${macports::portdbpath}/pingtimes w]
-            puts $pingfile $pinglist_fresh
-            close $pingfile
+            set statsfile [open ${macports::portdbpath}/hoststats w]
+            puts $statsfile $stats_fresh
+            close $statsfile
         }
     }
 
+    if {![catch {registry::stats} stats] && [dict get $stats lock_waits] > 0} {
+        ui_debug "Waited [dict get $stats lock_wait_time] ms for registry locks ([dict get $stats lock_waits] times)"
+    }
+
+    _mports_close_binindex
+
     # close it down so the cleanup stuff is called, e.g. vacuuming the db
     registry::close
 }
@@ -1405,8 +1427,14 @@ proc macports::copy_xcode_plist {target_homedir} {
 }
 
 proc macports::worker_init {workername portpath porturl portbuildpath options variations} {
-    global macports::portinterp_options macports::portinterp_deferred_options
+    _worker_init_common $workername
+    _worker_init_vars $workername [list portpath $portpath porturl $porturl portbuildpath $portbuildpath]
+    _worker_init_deferred $workername
+    _worker_init_user $workername $options $variations
+}
 
+# Sets up the parts of a worker interpreter that are the same for all ports.
+proc macports::_worker_init_common {workername} {
     # Hide any Tcl commands that should be inaccessible to port1.0 and Portfiles
     # exit: It should not be possible to exit the interpreter
     interp hide $workername exit
@@ -1473,6 +1501,9 @@ proc macports::worker_init {workername portpath porturl portbuildpath options va
     $workername alias realpath realpath
     $workername alias _mportsearchpath _mportsearchpath
     $workername alias _portnameactive _portnameactive
+    $workername alias _mportdeptest _mportdeptest
+    $workername alias _mportdepport _mportdepport
+    $workername alias archive_available macports::archive_available
     $workername alias get_actual_cxx_stdlib macports::get_actual_cxx_stdlib
 
     # New Registry/Receipts stuff
@@ -1499,9 +1530,9 @@ proc macports::worker_init {workername portpath porturl portbuildpath options va
     # deferred options processing.
     $workername alias getoption macports::getoption
 
-    # ping cache
-    $workername alias get_pingtime macports::get_pingtime
-    $workername alias set_pingtime macports::set_pingtime
+    # fetch statistics
+    $workername alias get_host_score macports::get_host_score
+    $workername alias record_host_fetch macports::record_host_fetch
 
     # archive_sites.conf handling
     $workername alias get_archive_sites_conf_values macports::get_archive_sites_conf_values
@@ -1511,15 +1542,41 @@ proc macports::worker_init {workername portpath porturl portbuildpath options va
     # tool path cache
     $workername alias get_tool_path macports::get_tool_path
 
+    # results of these depend on the state of the system, so they are
+    # checked again before a cached evaluation is used (see
+    # _portinfo_cache_probe), or keep a port from being cached
+    foreach alias $macports::portinfo_cache_probed_aliases {
+        $workername alias $alias macports::_portinfo_cache_probe {*}[$workername alias $alias]
+    }
+    foreach alias $macports::portinfo_cache_unprobed_aliases {
+        $workername alias $alias macports::_portinfo_cache_unprobed {*}[$workername alias $alias]
+    }
+    $workername alias _portinfo_cache_traced macports::_portinfo_cache_traced
+    $workername alias _portinfo_cache_taint macports::_portinfo_cache_taint
+}
+
+# Sets the portinterp_options in a worker interpreter, taking the values of
+# those in the portvars dict from there.
+proc macports::_worker_init_vars {workername portvars} {
+    global macports::portinterp_options
+
     foreach opt $portinterp_options {
-        if {![info exists $opt]} {
+        if {[dict exists $portvars $opt]} {
+            set val [dict get $portvars $opt]
+        } else {
             global macports::$opt
+            if {![info exists $opt]} {
+                continue
+            }
+            set val [set $opt]
         }
-        if {[info exists $opt]} {
-            $workername eval [list set system_options($opt) [set $opt]]
-            $workername eval [list set $opt [set $opt]]
-        }
+        $workername eval [list set system_options($opt) $val]
+        $workername eval [list set $opt $val]
     }
+}
+
+proc macports::_worker_init_deferred {workername} {
+    global macports::portinterp_deferred_options
 
     foreach opt $portinterp_deferred_options {
         global macports::$opt
@@ -1535,7 +1592,9 @@ proc macports::worker_init {workername portpath porturl portbuildpath options va
         # define some value now
         $workername eval "set $opt ?"
     }
+}
 
+proc macports::_worker_init_user {workername options variations} {
     foreach {opt val} $options {
         $workername eval [list set user_options($opt) $val]
         $workername eval [list set $opt $val]
@@ -1546,6 +1605,337 @@ proc macports::worker_init {workername portpath porturl portbuildpath options va
     }
 }
 
+##
+# Worker interpreters are expensive to set up, mostly because of loading
+# port1.0, so those that only evaluated a Portfile are kept in a pool when
+# their port is closed and reset for the next port instead. The reset undoes
+# everything the Portfile changed, by comparing the namespaces, variables,
+# commands and procs with a snapshot of a worker taken right after it loaded
+# port1.0. Workers that ran targets, loaded further packages or changed
+# something the reset doesn't restore, like traces on array elements or on
+# commands, aren't reused.
+namespace eval macports {
+    # workers ready to be set up for a port
+    variable worker_pool [list]
+    # number of workers kept in the pool, 0 disables reusing them
+    variable worker_pool_size 4
+    # snapshot of a new worker, see worker_snapshot_lambda
+    variable worker_snapshot
+
+    # returns a snapshot of the interpreter it's applied in
+    variable worker_snapshot_lambda {{} {
+        set namespaces [dict create]
+        set vars [dict create]
+        set arraytraces [dict create]
+        set procs [dict create]
+        set commands [dict create]
+        set cmdtraces [dict create]
+        set queue [list ::]
+        while {[llength $queue] > 0} {
+            set queue [lassign $queue ns]
+            if {$ns eq "::tcl"} {
+                continue
+            }
+            dict set namespaces $ns 1
+            lappend queue {*}[namespace children $ns]
+
+            set prefix [expr {$ns eq "::" ? "::" : "${ns}::"}]
+            foreach var [info vars ${prefix}*] {
+                if {$var in {::env ::errorInfo ::errorCode} || [string match ::tcl_* $var]} {
+                    continue
+                }
+                set traces [trace info variable $var]
+                foreach trace $traces {
+                    trace remove variable $var {*}$trace
+                }
+                if {[array exists $var]} {
+                    dict set vars $var [list array [array get $var] $traces]
+                    set elemtraces [dict create]
+                    foreach elem [array names $var] {
+                        set elemtrace [trace info variable ${var}($elem)]
+                        if {$elemtrace ne {}} {
+                            dict set elemtraces $elem $elemtrace
+                        }
+                    }
+                    if {[dict size $elemtraces] > 0} {
+                        dict set arraytraces $var $elemtraces
+                    }
+                } elseif {[info exists $var]} {
+                    dict set vars $var [list scalar [set $var] $traces]
+                } else {
+                    dict set vars $var [list undefined {} $traces]
+                }
+                foreach trace [lreverse $traces] {
+                    trace add variable $var {*}$trace
+                }
+            }
+            foreach cmd [info commands ${prefix}*] {
+                if {[trace info command $cmd] ne {} || [trace info execution $cmd] ne {}} {
+                    dict set cmdtraces $cmd [list [trace info command $cmd] [trace info execution $cmd]]
+                }
+                if {[catch {info args $cmd} args]} {
+                    dict set commands $cmd 1
+                    continue
+                }
+                set arglist [list]
+                foreach arg $args {
+                    if {[info default $cmd $arg default]} {
+                        lappend arglist [list $arg $default]
+                    } else {
+                        lappend arglist $arg
+                    }
+                }
+                dict set procs $cmd [list $arglist [info body $cmd]]
+            }
+        }
+        # options get traces before they are set, and info vars doesn't list
+        # variables that only exist because of their traces
+        if {[array exists ::option_procs]} {
+            foreach option [array names ::option_procs] {
+                if {![dict exists $vars ::$option]} {
+                    dict set vars ::$option [list undefined {} [trace info variable ::$option]]
+                }
+            }
+        }
+        set packages [dict create]
+        foreach pkg [package names] {
+            if {![catch {package present $pkg}]} {
+                dict set packages $pkg 1
+            }
+        }
+        set channels [dict create]
+        foreach chan [file channels] {
+            dict set channels $chan 1
+        }
+        return [list $namespaces $vars $arraytraces $procs $commands $cmdtraces $packages $channels]
+    }}
+
+    # resets the interpreter it's applied in to a snapshot, returns 0 if that
+    # isn't possible
+    variable worker_reset_lambda {{snapshot} {
+        lassign $snapshot namespaces vars arraytraces procs commands cmdtraces packages channels
+        # the commands used here have to be the ones from the snapshot
+        foreach cmd {after array catch dict expr file foreach info lappend lassign list llength lreverse namespace package proc rename set string switch trace unset} {
+            if {![catch {info args ::$cmd}] && ![dict exists $procs ::$cmd]} {
+                return 0
+            }
+        }
+        foreach pkg [package names] {
+            if {![dict exists $packages $pkg] && [package provide $pkg] ne ""} {
+                return 0
+            }
+        }
+        foreach chan [file channels] {
+            if {![dict exists $channels $chan]} {
+                catch {close $chan}
+            }
+        }
+        foreach id [after info] {
+            after cancel $id
+        }
+
+        # remove what was added
+        set nscount 0
+        set cmdcount 0
+        set queue [list ::]
+        while {[llength $queue] > 0} {
+            set queue [lassign $queue ns]
+            if {$ns eq "::tcl"} {
+                continue
+            }
+            if {![dict exists $namespaces $ns]} {
+                namespace delete $ns
+                continue
+            }
+            incr nscount
+            lappend queue {*}[namespace children $ns]
+
+            set prefix [expr {$ns eq "::" ? "::" : "${ns}::"}]
+            foreach var [info vars ${prefix}*] {
+                if {![dict exists $vars $var] && $var ni {::env ::errorInfo ::errorCode}
+                        && ![string match ::tcl_* $var]} {
+                    foreach trace [trace info variable $var] {
+                        trace remove variable $var {*}$trace
+                    }
+                    unset -nocomplain $var
+                }
+            }
+            set nsprocs [dict create]
+            foreach cmd [info procs ${prefix}*] {
+                dict set nsprocs $cmd 1
+            }
+            foreach cmd [info commands ${prefix}*] {
+                if {![dict exists $procs $cmd] && ![dict exists $commands $cmd]} {
+                    rename $cmd {}
+                    continue
+                }
+                # traces on commands can't be told apart from the ones
+                # port1.0 set up, and the original of a command replaced by a
+                # proc can't be brought back
+                if {[trace info command $cmd] ne {} || [trace info execution $cmd] ne {}
+                        || [dict exists $cmdtraces $cmd]} {
+                    if {![dict exists $cmdtraces $cmd]
+                            || [list [trace info command $cmd] [trace info execution $cmd]] ne [dict get $cmdtraces $cmd]} {
+                        return 0
+                    }
+                }
+                if {[dict exists $commands $cmd]} {
+                    if {[dict exists $nsprocs $cmd]} {
+                        return 0
+                    }
+                    incr cmdcount
+                }
+            }
+        }
+
+        # and restore what was changed
+        if {$nscount != [dict size $namespaces] || $cmdcount != [dict size $commands]} {
+            return 0
+        }
+        dict for {cmd definition} $procs {
+            if {[catch {info body $cmd} body] || $body ne [lindex $definition 1]} {
+                proc $cmd {*}$definition
+                continue
+            }
+            set arglist [list]
+            foreach arg [info args $cmd] {
+                if {[info default $cmd $arg default]} {
+                    lappend arglist [list $arg $default]
+                } else {
+                    lappend arglist $arg
+                }
+            }
+            if {$arglist ne [lindex $definition 0]} {
+                proc $cmd {*}$definition
+            }
+        }
+        dict for {var state} $vars {
+            lassign $state type value traces
+            # element traces would be lost when the array is restored
+            if {$type eq "array" && [array exists $var]} {
+                set elemtraces [dict create]
+                foreach elem [array names $var] {
+                    set elemtrace [trace info variable ${var}($elem)]
+                    if {$elemtrace ne {}} {
+                        dict set elemtraces $elem $elemtrace
+                    }
+                }
+                set expected [expr {[dict exists $arraytraces $var] ? [dict get $arraytraces $var] : {}}]
+                if {[dict size $elemtraces] != [dict size $expected]} {
+                    return 0
+                }
+                dict for {elem elemtrace} $elemtraces {
+                    if {![dict exists $expected $elem] || [dict get $expected $elem] ne $elemtrace} {
+                        return 0
+                    }
+                }
+            }
+            set current_traces [trace info variable $var]
+            if {$current_traces eq {} && $traces eq {}} {
+                # without traces, the value can be checked first
+                switch -- $type {
+                    scalar {
+                        if {[info exists $var] && ![array exists $var] && [set $var] eq $value} {
+                            continue
+                        }
+                    }
+                    array {
+                        if {[array exists $var] && [array get $var] eq $value} {
+                            continue
+                        }
+                    }
+                    undefined {
+                        if {![info exists $var]} {
+                            continue
+                        }
+                    }
+                }
+            }
+            foreach trace $current_traces {
+                trace remove variable $var {*}$trace
+            }
+            unset -nocomplain $var
+            switch -- $type {
+                scalar {
+                    set $var $value
+                }
+                array {
+                    array set $var $value
+                }
+                undefined {
+                    namespace eval [namespace qualifiers $var] [list variable [namespace tail $var]]
+                }
+            }
+            foreach trace [lreverse $traces] {
+                trace add variable $var {*}$trace
+            }
+        }
+        return 1
+    }}
+}
+
+# Returns a new worker interpreter for the pool, which has port1.0 loaded but
+# hasn't been set up for a port yet.
+proc macports::_worker_create {} {
+    variable worker_snapshot
+    variable worker_snapshot_lambda
+
+    set workername [interp create]
+    _worker_init_common $workername
+    _worker_init_vars $workername {}
+    _worker_init_deferred $workername
+    $workername eval {package require port 1.0}
+    if {![info exists worker_snapshot]} {
+        set worker_snapshot [$workername eval [list apply $worker_snapshot_lambda]]
+    }
+    return $workername
+}
+
+# Returns a worker interpreter set up to evaluate the Portfile of mport, and
+# whether it can go back into the pool when the port is closed.
+proc macports::_worker_open {mport} {
+    variable worker_pool
+    variable worker_pool_size
+
+    set portpath [ditem_key $mport portpath]
+    set porturl [ditem_key $mport porturl]
+    set options [ditem_key $mport options]
+    set variations [ditem_key $mport variations]
+    set portbuildpath [getportbuildpath $portpath]
+
+    # port1.0 looks at the platform while it is being loaded, so ports
+    # pretending to be on another platform need a new worker
+    if {$worker_pool_size == 0 || [llength [dict filter $options key os.*]] > 0} {
+        set workername [interp create]
+        worker_init $workername $portpath $porturl $portbuildpath $options $variations
+        return [list $workername 0]
+    }
+
+    if {[llength $worker_pool] > 0} {
+        set worker_pool [lassign $worker_pool workername]
+    } else {
+        set workername [_worker_create]
+    }
+    _worker_init_vars $workername [list portpath $portpath porturl $porturl portbuildpath $portbuildpath]
+    _worker_init_user $workername $options $variations
+    return [list $workername 1]
+}
+
+# Resets a worker interpreter and puts it back into the pool, or deletes it.
+proc macports::_worker_release {workername} {
+    variable worker_pool
+    variable worker_pool_size
+    variable worker_snapshot
+    variable worker_reset_lambda
+
+    if {[llength $worker_pool] < $worker_pool_size && [interp hidden $workername] eq "exit"
+            && ![catch {$workername eval [list apply $worker_reset_lambda $worker_snapshot]} result] && $result == 1} {
+        lappend worker_pool $workername
+    } else {
+        interp delete $workername
+    }
+}
+
 # Create a thread with most configuration options set.
 # The newly created thread is sent portinterp_options vars and knows where to
 # find all packages we know.
@@ -1597,6 +1987,9 @@ proc macports::get_tar_flags {suffix} {
         .tlz {
             return "--use-compress-program [findBinary lzma {}] -"
         }
+        .tzst {
+            return "--use-compress-program [findBinary zstd {}] -"
+        }
         default {
             return -
         }
@@ -1867,48 +2260,490 @@ proc mportopen {porturl {options {}} {variations {}} {nocache {}}} {
         return -code error "Could not find Portfile in $portpath"
     }
 
-    set workername [interp create]
-
     set mport [ditem_create]
     lappend macports::open_mports $mport
     ditem_key $mport porturl $porturl
     ditem_key $mport portpath $portpath
-    ditem_key $mport workername $workername
     ditem_key $mport options $options
     ditem_key $mport variations $variations
     ditem_key $mport refcnt 1
 
-    macports::worker_init $workername $portpath $porturl [macports::getportbuildpath $portpath] $options $variations
+    if {[macports::_portinfo_cache_enabled]} {
+        set cachekey [macports::_portinfo_cache_key $porturl $options $variations]
+        if {$nocache eq "" && [macports::_portinfo_cache_lookup $mport $cachekey]} {
+            return $mport
+        }
+    }
 
+    if {[catch {macports::_mport_evaluate $mport [info exists cachekey]} result eOptions]} {
+        mportclose $mport
+        return -options $eOptions $result
+    }
+    if {[info exists cachekey]} {
+        macports::_portinfo_cache_store $mport $cachekey
+    }
+
+    return $mport
+}
+
+# Sets up a worker interpreter for mport and evaluates the Portfile in it. The
+# current directory has to be the port directory. If record is set, the
+# probes of the evaluation are kept in the portinfo_probes key of mport for
+# the cache.
+proc macports::_mport_evaluate {mport {record 0}} {
+    lassign [_worker_open $mport] workername poolable
+    ditem_key $mport workername $workername
+
+    if {$record} {
+        # record the probes for the cache
+        _portinfo_cache_record_begin $workername
+        try -pass_signal {
+            _mport_evaluate_worker $mport $workername
+        } finally {
+            ditem_key $mport portinfo_probes [_portinfo_cache_record_end $workername]
+        }
+    } else {
+        _mport_evaluate_worker $mport $workername
+    }
+    ditem_key $mport poolable $poolable
+}
+
+# Evaluates the Portfile of mport in workername.
+proc macports::_mport_evaluate_worker {mport workername} {
     $workername eval {source Portfile}
 
     # add the default universal variant if appropriate, and set up flags that
     # are conditional on whether universal is set
     $workername eval {universal_setup}
 
-    # evaluate the variants
-    if {[$workername eval {eval_variants variations}] != 0} {
-        mportclose $mport
-        error "Error evaluating variants"
+    # evaluate the variants
+    if {[$workername eval {eval_variants variations}] != 0} {
+        error "Error evaluating variants"
+    }
+
+    $workername eval {port::run_callbacks}
+
+    set actual_subport [$workername eval {set PortInfo(name)}]
+    if {[$workername eval {info exists user_options(subport)}]} {
+        # The supplied subport may have been set on the command line by the
+        # user, or simply obtained from the PortIndex or registry. Check that
+        # it's valid in case the user made a mistake.
+        set supplied_subport [$workername eval {set user_options(subport)}]
+        if {$supplied_subport ne $actual_subport} {
+            set portname [$workername eval {set name}]
+            error "$portname does not have a subport '$supplied_subport'"
+        }
+    }
+    ditem_key $mport provides $actual_subport
+}
+
+##
+# The Portfile evaluation cache keeps the PortInfo and a few other values of
+# evaluated ports in portdbpath/cache/portinfo, along with hashes of the
+# Portfile and the PortGroups it used. As long as none of them changed,
+# mportopen takes the values from the cache instead of evaluating the
+# Portfile again, and the port's worker interpreter is only created when
+# something actually needs it (see _mport_materialize). mportinfo, _mportkey,
+# _mport_archs and mportdepends don't, so looking at a port's information or
+# dependencies doesn't evaluate it.
+#
+# Besides their options and variations, the platform and configuration (see
+# _portinfo_cache_key) and the hashed files, Portfiles can depend on the
+# registry (active_variants) and on other files. The calls that look at them
+# while a port is evaluated are recorded along with their results as probes,
+# and a cached evaluation is only used if repeating the probes gives the same
+# results. Ports that run commands whose results can't be checked that way,
+# like exec or curl, aren't cached.
+namespace eval macports {
+    # values taken from a worker interpreter when its port is cached, and the
+    # scripts to get them
+    variable portinfo_cache_values {
+        subport {set subport}
+        supported_archs {set supported_archs}
+        depends_skip_archcheck {set depends_skip_archcheck}
+        canonical_archs {get_canonical_archs}
+        requested_variations {array get requested_variations}
+        depspec_context {_depspec_context}
+        registry_entry {list $subport $version $revision $portvariants}
+        archive_lookup {_archive_lookup}
+    }
+    # number of combinations of options and variations kept for each port
+    variable portinfo_cache_size 8
+
+    # worker aliases whose calls are recorded as probes
+    variable portinfo_cache_probed_aliases {
+        _mportsearchpath _portnameactive _mportdeptest _mportdepport
+        binaryInPath findBinary realpath get_compiler_version get_tool_path
+        mport_lookup registry_exists registry_exists_for_name registry_active
+        registry_file_registered registry_port_registered registry_list_depends
+        registry_fileinfo_for_index registry_fileinfo_for_file
+    }
+    # worker aliases that keep a port from being cached
+    variable portinfo_cache_unprobed_aliases {
+        mport_open mport_exec mport_info registry_open registry_prop_retr
+        archive_available
+    }
+    # traces put on worker commands while a port is evaluated for the cache:
+    # calls of the commands traced on leave are recorded as probes, those of
+    # the ones traced on enter keep the port from being cached
+    variable portinfo_cache_traces {
+        file leave _portinfo_cache_traced
+        glob leave _portinfo_cache_traced
+        readdir leave _portinfo_cache_traced
+        exec enter _portinfo_cache_taint
+        open enter _portinfo_cache_taint
+        socket enter _portinfo_cache_taint
+        system enter _portinfo_cache_taint
+        curl enter _portinfo_cache_taint
+    }
+    # file subcommands that only look at the file system, and those that
+    # don't look at it at all; any other use of file keeps the port from
+    # being cached
+    variable portinfo_cache_file_queries {
+        exists isdirectory isfile readable writable executable owned type size
+        readlink
+    }
+    variable portinfo_cache_file_pure {
+        dirname extension join nativename normalize pathtype rootname separator
+        split tail volumes
+    }
+    # probes of the ports being evaluated for the cache, by nesting depth:
+    # dicts of the commands and their return codes and results, or
+    # "uncacheable"
+    variable portinfo_cache_probes
+    variable portinfo_cache_depth 0
+}
+
+# Starts recording the probes of a port evaluated in workername.
+proc macports::_portinfo_cache_record_begin {workername} {
+    variable portinfo_cache_probes
+    variable portinfo_cache_depth
+    variable portinfo_cache_traces
+
+    set portinfo_cache_probes([incr portinfo_cache_depth]) [dict create]
+    # readdir, system and curl are only there once Pextlib is loaded, and
+    # the auto_load index shouldn't be read while open is traced
+    $workername eval {
+        package require Pextlib 1.0
+        auto_load_index
+    }
+    foreach {command op callback} $portinfo_cache_traces {
+        $workername eval [list trace add execution $command $op $callback]
+    }
+}
+
+# Stops recording probes in workername and returns the recorded ones.
+proc macports::_portinfo_cache_record_end {workername} {
+    variable portinfo_cache_probes
+    variable portinfo_cache_depth
+    variable portinfo_cache_traces
+
+    if {[interp exists $workername]} {
+        foreach {command op callback} $portinfo_cache_traces {
+            $workername eval [list trace remove execution $command $op $callback]
+        }
+    }
+    set probes $portinfo_cache_probes($portinfo_cache_depth)
+    unset portinfo_cache_probes($portinfo_cache_depth)
+    incr portinfo_cache_depth -1
+    return $probes
+}
+
+# Records that command returned code and result, if a port is being evaluated
+# for the cache.
+proc macports::_portinfo_cache_record {command code result} {
+    variable portinfo_cache_probes
+    variable portinfo_cache_depth
+
+    if {$portinfo_cache_depth == 0 || $portinfo_cache_probes($portinfo_cache_depth) eq "uncacheable"
+            || [dict exists $portinfo_cache_probes($portinfo_cache_depth) $command]} {
+        return
+    }
+    dict set portinfo_cache_probes($portinfo_cache_depth) $command [list $code $result]
+}
+
+# Keeps the port being evaluated, if any, from being cached.
+proc macports::_portinfo_cache_taint {args} {
+    variable portinfo_cache_probes
+    variable portinfo_cache_depth
+
+    if {$portinfo_cache_depth > 0} {
+        set portinfo_cache_probes($portinfo_cache_depth) uncacheable
+    }
+}
+
+# Target of the probed worker aliases: runs command and records its result.
+proc macports::_portinfo_cache_probe {args} {
+    set code [catch {uplevel #0 $args} result options]
+    _portinfo_cache_record $args $code $result
+    return -options $options $result
+}
+
+# Target of the unprobed worker aliases: runs command and keeps the port
+# being evaluated from being cached.
+proc macports::_portinfo_cache_unprobed {args} {
+    _portinfo_cache_taint
+    catch {uplevel #0 $args} result options
+    return -options $options $result
+}
+
+# Leave trace of the file, glob and readdir commands in a worker.
+proc macports::_portinfo_cache_traced {command code result op} {
+    variable portinfo_cache_file_queries
+    variable portinfo_cache_file_pure
+
+    set command [lreplace $command 0 0 [namespace tail [lindex $command 0]]]
+    if {[lindex $command 0] eq "file"} {
+        set subcommand [lindex $command 1]
+        if {$subcommand in $portinfo_cache_file_pure} {
+            return
+        } elseif {$subcommand ni $portinfo_cache_file_queries
+                  && !($subcommand in {atime mtime} && [llength $command] == 3)} {
+            _portinfo_cache_taint
+            return
+        }
+    }
+    _portinfo_cache_record $command $code $result
+}
+
+# Returns the first of probes, as recorded by _portinfo_cache_record, that
+# doesn't give the same result now, or an empty list if none of them changed.
+proc macports::_portinfo_cache_changed {probes} {
+    dict for {command recorded} $probes {
+        set code [catch {uplevel #0 $command} result]
+        if {[list $code $result] ne $recorded} {
+            return [list $command]
+        }
+    }
+    return {}
+}
+
+proc macports::_portinfo_cache_enabled {} {
+    global macports::portinfo_cache
+    return [string is true -strict $portinfo_cache]
+}
+
+# Returns the key identifying the evaluation of the port at porturl with the
+# given options and variations in the current configuration.
+proc macports::_portinfo_cache_key {porturl options variations} {
+    global macports::portinterp_options
+
+    set config [list]
+    foreach opt $portinterp_options {
+        # these differ between ports or sessions but don't affect the results
+        if {$opt in {porturl portpath portbuildpath current_phase user_ssh_auth_sock}} {
+            continue
+        }
+        global macports::$opt
+        if {[info exists $opt]} {
+            lappend config $opt [set $opt]
+        }
+    }
+    lappend config xcodeversion [getoption xcodeversion]
+
+    return [list [macports::version] $porturl $options $variations $config]
+}
+
+# Returns the SHA-256 of the contents of file, or an empty string if it can't
+# be read. Hashes are remembered as long as the size and mtime don't change.
+proc macports::_portinfo_cache_hash {file} {
+    variable portinfo_cache_hashes
+
+    if {[catch {file stat $file statinfo}]} {
+        return {}
+    }
+    set stamp [list $statinfo(size) $statinfo(mtime)]
+    if {![info exists portinfo_cache_hashes($file)] || [lindex $portinfo_cache_hashes($file) 0] ne $stamp} {
+        if {[catch {sha256 file $file} hash]} {
+            return {}
+        }
+        set portinfo_cache_hashes($file) [list $stamp $hash]
+    }
+    return [lindex $portinfo_cache_hashes($file) 1]
+}
+
+proc macports::_portinfo_cache_file {portpath} {
+    global macports::portdbpath
+    return [file join $portdbpath cache portinfo [file tail [file dirname $portpath]] [file tail $portpath]]
+}
+
+# Looks for a cache entry for mport matching key, and if one is found, sets up
+# mport with the cached values and returns 1.
+proc macports::_portinfo_cache_lookup {mport key} {
+    set portpath [ditem_key $mport portpath]
+    try -pass_signal {
+        set fd [open [_portinfo_cache_file $portpath] r]
+        try -pass_signal {
+            set entries [read $fd]
+        } finally {
+            close $fd
+        }
+        foreach entry $entries {
+            lassign $entry entrykey inputs portinfo values probes
+            if {$entrykey ne $key} {
+                continue
+            }
+            foreach {file hash} $inputs {
+                if {[_portinfo_cache_hash $file] ne $hash} {
+                    ui_debug "Cached evaluation of $portpath/Portfile is outdated: $file changed"
+                    return 0
+                }
+            }
+            set changed [_portinfo_cache_changed $probes]
+            if {$changed ne ""} {
+                ui_debug "Cached evaluation of $portpath/Portfile is outdated: result of [lindex $changed 0] changed"
+                return 0
+            }
+
+            ditem_key $mport portinfo $portinfo
+            ditem_key $mport cached_values $values
+            ditem_key $mport provides [dict get $portinfo name]
+            ditem_key $mport deferred 1
+            ditem_key $mport workername {}
+            trace add variable ::macports_dlist::${mport}(workername) read [list macports::_mport_materialize $mport]
+            ui_debug "Using cached evaluation of $portpath/Portfile"
+            return 1
+        }
+    } catch {{*} eCode eMessage} {
+        # missing or unreadable cache file
+    }
+    return 0
+}
+
+# Stores the results of evaluating the Portfile of mport under key.
+proc macports::_portinfo_cache_store {mport key} {
+    global macports::portdbpath
+    variable portinfo_cache_values
+    variable portinfo_cache_size
+
+    if {![file writable $portdbpath]} {
+        return
+    }
+    set workername [ditem_key $mport workername]
+    set portpath [ditem_key $mport portpath]
+    set probes [ditem_key $mport portinfo_probes]
+    if {$probes eq "uncacheable"} {
+        ui_debug "Not caching evaluation of $portpath/Portfile: it runs commands whose results can't be checked"
+        return
+    }
+    try -pass_signal {
+        set portinfolist [$workername eval {array get PortInfo}]
+        array set portinfo $portinfolist
+        set inputs [list [file join $portpath Portfile]]
+        if {[info exists portinfo(portgroups)]} {
+            foreach pg $portinfo(portgroups) {
+                set groupfile [lindex $pg 2]
+                if {$groupfile eq ""} {
+                    # the PortGroup couldn't be found, so there's nothing to
+                    # tell when it appears
+                    return
+                }
+                lappend inputs $groupfile
+            }
+        }
+        set hashes [list]
+        foreach file $inputs {
+            set hash [_portinfo_cache_hash $file]
+            if {$hash eq ""} {
+                return
+            }
+            lappend hashes $file $hash
+        }
+        set values [list]
+        foreach {name script} $portinfo_cache_values {
+            lappend values $name [$workername eval $script]
+        }
+
+        set cachefile [_portinfo_cache_file $portpath]
+        set entries [list [list $key $hashes $portinfolist $values $probes]]
+        if {![catch {open $cachefile r} fd]} {
+            catch {
+                foreach entry [read $fd] {
+                    if {[lindex $entry 0] ne $key && [llength $entries] < $portinfo_cache_size} {
+                        lappend entries $entry
+                    }
+                }
+            }
+            close $fd
+        }
+
+        file mkdir [file dirname $cachefile]
+        lassign [mkstemp ${cachefile}.XXXXXXXX] fd tmpfile
+        try -pass_signal {
+            puts $fd $entries
+        } finally {
+            close $fd
+        }
+        file attributes $tmpfile -permissions 0644
+        file rename -force $tmpfile $cachefile
+    } catch {{*} eCode eMessage} {
+        ui_debug "Failed to cache evaluation of $portpath/Portfile: $eMessage"
+        if {[info exists tmpfile]} {
+            catch {file delete $tmpfile}
+        }
+    }
+}
+
+# Read trace on the workername key of a port opened from the cache: creates
+# the worker interpreter and evaluates the Portfile on first use.
+proc macports::_mport_materialize {mport args} {
+    set var ::macports_dlist::${mport}(workername)
+    trace remove variable $var read [list macports::_mport_materialize $mport]
+
+    set portpath [ditem_key $mport portpath]
+    ui_debug "Evaluating cached port $portpath/Portfile"
+    set pwd [pwd]
+    cd $portpath
+    ditem_key $mport deferred 0
+    if {[catch {_mport_evaluate $mport} result eOptions]} {
+        if {[ditem_key $mport workername] ne ""} {
+            interp delete [ditem_key $mport workername]
+        }
+        ditem_key $mport workername {}
+        ditem_key $mport deferred 1
+        trace add variable $var read [list macports::_mport_materialize $mport]
+    } elseif {[ditem_contains $mport archive_available]} {
+        [ditem_key $mport workername] eval [list set portutil::archive_available_result \
+            [ditem_key $mport archive_available]]
+    }
+    cd $pwd
+    return -options $eOptions $result
+}
+
+# Returns the result of script in the worker interpreter of mport, or the
+# value kept for it under name if mport was opened from the cache and hasn't
+# been evaluated.
+proc macports::_mport_cached {mport name script} {
+    if {[ditem_key $mport deferred] == 1 && [dict exists [ditem_key $mport cached_values] $name]} {
+        return [dict get [ditem_key $mport cached_values] $name]
     }
+    return [[ditem_key $mport workername] eval $script]
+}
 
-    $workername eval {port::run_callbacks}
+# Returns what _mportdeptest and _mportdepport need to know about mport.
+proc macports::_mport_depspec_context {mport} {
+    return [_mport_cached $mport depspec_context {_depspec_context}]
+}
 
-    set actual_subport [$workername eval {set PortInfo(name)}]
-    if {[$workername eval {info exists user_options(subport)}]} {
-        # The supplied subport may have been set on the command line by the
-        # user, or simply obtained from the PortIndex or registry. Check that
-        # it's valid in case the user made a mistake.
-        set supplied_subport [$workername eval {set user_options(subport)}]
-        if {$supplied_subport ne $actual_subport} {
-            set portname [$workername eval {set name}]
-            mportclose $mport
-            error "$portname does not have a subport '$supplied_subport'"
+# Returns whether mport is installed, in the version and with the variants
+# it was opened with.
+proc macports::_mport_registry_exists {mport} {
+    return [registry::entry_exists {*}[_mport_cached $mport registry_entry \
+                {list $subport $version $revision $portvariants}]]
+}
+
+# Returns whether an archive of mport can be unarchived. For a port opened
+# from the cache, the answer is kept until the port is evaluated and then
+# given to its worker.
+proc macports::_mport_archive_available {mport} {
+    if {[ditem_key $mport deferred] == 1} {
+        if {![ditem_contains $mport archive_available]} {
+            ditem_key $mport archive_available [archive_available \
+                [_mport_cached $mport archive_lookup {_archive_lookup}]]
         }
+        return [ditem_key $mport archive_available]
     }
-    ditem_key $mport provides $actual_subport
-
-    return $mport
+    return [[ditem_key $mport workername] eval {_archive_available}]
 }
 
 # mportopen_installed
@@ -2028,6 +2863,134 @@ proc _mportsearchpath {depregex search_path {executable 0} {return_match 0}} {
 }
 
 
+### _mportdeptest is private; subject to change without notice
+# XXX - Architecture specific
+# XXX - Rely on information from internal defines in cctools/dyld:
+# define DEFAULT_FALLBACK_FRAMEWORK_PATH
+# /Library/Frameworks:/Library/Frameworks:/Network/Library/Frameworks:/System/Library/Frameworks
+# define DEFAULT_FALLBACK_LIBRARY_PATH /lib:/usr/local/lib:/lib:/usr/lib
+#   -- Since /usr/local is bad, using /lib:/usr/lib only.
+# Environment variables DYLD_FRAMEWORK_PATH, DYLD_LIBRARY_PATH,
+# DYLD_FALLBACK_FRAMEWORK_PATH, and DYLD_FALLBACK_LIBRARY_PATH take precedence
+
+# Determine if the lib, bin or path depspec is satisfied.
+# depspec -> the dependency test specification
+# context -> prefix, frameworks_dir and os.platform of the port declaring the
+#            dependency, as returned by its _depspec_context
+# return_match -> whether to return the matching file instead of 1
+proc _mportdeptest {depspec context {return_match 0}} {
+    global env
+    lassign $context prefix frameworks_dir platform
+    lassign [split $depspec :] type depregex
+
+    switch -- $type {
+        lib {
+            if {[info exists env(DYLD_FRAMEWORK_PATH)]} {
+                lappend search_path $env(DYLD_FRAMEWORK_PATH)
+            } else {
+                lappend search_path $frameworks_dir /Library/Frameworks /Network/Library/Frameworks /System/Library/Frameworks
+            }
+            if {[info exists env(DYLD_FALLBACK_FRAMEWORK_PATH)]} {
+                lappend search_path $env(DYLD_FALLBACK_FRAMEWORK_PATH)
+            }
+            if {[info exists env(DYLD_LIBRARY_PATH)]} {
+                lappend search_path $env(DYLD_LIBRARY_PATH)
+            }
+            lappend search_path /lib /usr/lib ${prefix}/lib
+            if {[info exists env(DYLD_FALLBACK_LIBRARY_PATH)]} {
+                lappend search_path $env(DYLD_FALLBACK_LIBRARY_PATH)
+            }
+
+            set i [string first . $depregex]
+            if {$i < 0} {set i [string length $depregex]}
+            set depname [string range $depregex 0 [expr {$i - 1}]]
+            set depversion [string range $depregex $i end]
+            regsub {\.} $depversion {\.} depversion
+            if {$platform eq "darwin"} {
+                set depregex \^${depname}${depversion}\\.dylib\$
+            } else {
+                set depregex \^${depname}\\.so${depversion}\$
+            }
+
+            return [_mportsearchpath $depregex $search_path 0 $return_match]
+        }
+        bin {
+            set search_path [split $env(PATH) :]
+            set depregex \^$depregex\$
+
+            return [_mportsearchpath $depregex $search_path 1 $return_match]
+        }
+        path {
+            # separate directory from regex
+            set fullname $depregex
+            regexp {^(.*)/(.*?)$} $fullname match search_path depregex
+            if {[string index $search_path 0] ne "/"} {
+                # Prepend prefix if not an absolute path
+                set search_path "${prefix}/${search_path}"
+            }
+            set depregex \^$depregex\$
+
+            return [_mportsearchpath $depregex $search_path 0 $return_match]
+        }
+        default {
+            return -code error "unknown depspec type: $type"
+        }
+    }
+}
+
+### _mportdepport is private; subject to change without notice
+
+# Returns the name of the port that will actually be satisfying depspec, or
+# an empty string if it is satisfied by a file that no port installed.
+# context is the same as for _mportdeptest.
+proc _mportdepport {depspec context} {
+    set speclist [split $depspec :]
+    set portname [lindex $speclist end]
+    if {[_portnameactive $portname]} {
+        return $portname
+    }
+
+    set depfile ""
+    if {[lindex $speclist 0] in {bin lib path}} {
+        set depfile [_mportdeptest $depspec $context 1]
+    }
+    if {$depfile eq ""} {
+        return $portname
+    }
+    set theport [registry::file_registered $depfile]
+    if {$theport != 0} {
+        return $theport
+    }
+    return ""
+}
+
+
+# Determine if an archive of a port can be unarchived, given what the port's
+# _archive_lookup returns.
+proc macports::archive_available {lookup} {
+    if {[dict get $lookup source_only]} {
+        return 0
+    }
+    set installed [expr {![dict get $lookup refresh]
+                         && [registry::entry_exists {*}[dict get $lookup entry]]}]
+    foreach {installedpath verifiedpath} [dict get $lookup paths] {
+        if {[file isfile [expr {$installed ? $installedpath : $verifiedpath}]]} {
+            return 1
+        }
+    }
+    if {[dict get $lookup porturl]} {
+        return 1
+    }
+    set url [dict get $lookup url]
+    # curl getsize can return -1 instead of throwing an error for
+    # nonexistent files on FTP sites.
+    if {$url ne "" && ![catch {curl getsize $url} size] && $size > 0} {
+        return 1
+    }
+    return 0
+}
+
+
 ### _mportinstalled is private; may change without notice
 
 # Determine if a port is already *installed*, as in "in the registry".
@@ -2075,12 +3038,11 @@ proc _mportispresent {mport depspec} {
     } else {
         # The receipt test failed, use one of the depspec regex mechanisms
         ui_debug "Didn't find receipt, going to depspec regex for: $portname"
-        set workername [ditem_key $mport workername]
         set type [lindex [split $depspec :] 0]
         switch -- $type {
-            lib {return [$workername eval "_libtest $depspec"]}
-            bin {return [$workername eval "_bintest $depspec"]}
-            path {return [$workername eval "_pathtest $depspec"]}
+            lib -
+            bin -
+            path {return [_mportdeptest $depspec [macports::_mport_depspec_context $mport]]}
             port {return 0}
             default {return -code error "unknown depspec type: $type"}
         }
@@ -2131,6 +3093,8 @@ proc _mportexec {target mport} {
     macports::push_log $mport
     # xxx: set the work path?
     set workername [ditem_key $mport workername]
+    # workers that ran targets aren't reused
+    ditem_key $mport poolable 0
     $workername eval {validate_macportsuser}
 
     # If the target doesn't need a toolchain (e.g. because an archive is
@@ -2164,10 +3128,164 @@ proc _mportexec {target mport} {
     }
 }
 
+# Returns the number of dependencies mportexec builds at once, from the -J
+# option of port or buildjobs_parallel_ports.
+proc macports::_parallel_ports {} {
+    global macports::global_options macports::buildjobs_parallel_ports
+    if {[info exists global_options(ports_parallel_jobs)]} {
+        set jobs $global_options(ports_parallel_jobs)
+    } else {
+        set jobs $buildjobs_parallel_ports
+    }
+    if {![string is integer -strict $jobs] || $jobs < 1} {
+        ui_warn "Invalid number of ports to build at once: $jobs"
+        return 1
+    }
+    # dry runs don't build anything
+    if {[macports::global_option_isset ports_dryrun]} {
+        return 1
+    }
+    return $jobs
+}
+
+# Starter given to dlist_eval_parallel by mportexec to install the dependency
+# mport, with at most jobs ports being built at once. Ports that have to be
+# built from source are built up to destroot in a child process (see
+# _build_worker), which runs while other dependencies are evaluated. Once it
+# succeeds, or right away for ports installed from an archive or already
+# installed, the port is installed and activated with _mportexec in this
+# process, so that only this process writes to the registry.
+proc macports::_mportexec_start {jobs mport callback} {
+    global macports::ui_options macports::global_options
+    set workername [ditem_key $mport workername]
+    if {[$workername eval {registry_exists $subport $version $revision $portvariants}]
+        || [$workername eval {_archive_available}]} {
+        {*}$callback [_mportexec activate $mport]
+        return
+    }
+
+    set uioptions [list]
+    foreach {key value} [array get ui_options] {
+        # questions can't be asked from the child, its input is the script
+        if {![string match questions_* $key]} {
+            lappend uioptions $key $value
+        }
+    }
+    lappend uioptions ports_noninteractive yes
+    lassign [mkstemp [file join [gettmpdir] macports-fetches.XXXXXXXX]] fd fetchesfile
+    close $fd
+    set script "[list set ::auto_path $::auto_path]
+package require macports
+[list macports::_build_worker $uioptions [array get global_options] \
+    [ditem_key $mport porturl] [ditem_key $mport options] \
+    [ditem_key $mport variations] [macports::_parallel_makejobs $jobs] $fetchesfile]
+"
+    ui_debug "Building [ditem_key $mport provides] in a child process"
+    set chan [open "|[list [info nameofexecutable] << $script 2>@1]" r]
+    fileevent $chan readable [list macports::_mportexec_readable $chan $mport $callback $fetchesfile]
+}
+
+# Passes on the output of a child process started by _mportexec_start and
+# installs its port once it exits successfully. The fetches the child made
+# are recorded here, in fetchesfile.
+proc macports::_mportexec_readable {chan mport callback fetchesfile} {
+    global macports::channels
+    if {[gets $chan line] >= 0} {
+        # the child already logged the message
+        foreach c $channels(msg) {
+            puts $c $line
+        }
+        return
+    }
+    if {![eof $chan]} {
+        return
+    }
+    fconfigure $chan -blocking 1
+    set failed [catch {close $chan} result]
+    if {![catch {open $fetchesfile r} fd]} {
+        catch {
+            foreach fetch [read $fd] {
+                record_host_fetch {*}$fetch
+            }
+        }
+        close $fd
+    }
+    file delete $fetchesfile
+    if {$failed} {
+        ui_debug "Child process building [ditem_key $mport provides] failed: $result"
+        {*}$callback 1
+        return
+    }
+    {*}$callback [_mportexec activate $mport]
+}
+
+# Returns the number of make jobs for each of jobs ports built at once, or 0
+# to leave buildmakejobs unchanged.
+proc macports::_parallel_makejobs {jobs} {
+    global macports::buildmakejobs
+    set total $buildmakejobs
+    if {$total == 0} {
+        set total [_cpu_count]
+        if {$total == 0} {
+            return 0
+        }
+    }
+    return [expr {max(1, $total / $jobs)}]
+}
+
+# Returns the number of CPUs available, or 0 if it can't be determined.
+# sysctl fails where there is no sysctlbyname(3), e.g. on Linux.
+proc macports::_cpu_count {} {
+    foreach name {hw.activecpu hw.ncpu} {
+        if {![catch {sysctl $name} count] && [string is integer -strict $count] && $count > 0} {
+            return $count
+        }
+    }
+    foreach cmd {{getconf _NPROCESSORS_ONLN} nproc} {
+        if {![catch {exec {*}$cmd 2>/dev/null} count] && [string is integer -strict $count] && $count > 0} {
+            return $count
+        }
+    }
+    return 0
+}
+
+# Runs in the child processes started by _mportexec_start: builds the port at
+# porturl up to destroot, without cleaning it, and exits with the status. The
+# fetches made are written to fetchesfile for the parent to record, so that
+# the children don't overwrite each other's hoststats.
+proc macports::_build_worker {uioptions globaloptions porturl options variations makejobs fetchesfile} {
+    global macports::portautoclean macports::buildmakejobs macports::host_fetches
+    array set ui_options $uioptions
+    array set global_options $globaloptions
+    mportinit ui_options global_options
+    set host_fetches [list]
+    set portautoclean no
+    if {$makejobs > 0} {
+        set buildmakejobs $makejobs
+    }
+
+    set status 1
+    if {[catch {mportopen $porturl $options $variations} mport]} {
+        ui_debug $::errorInfo
+        ui_error "Unable to open port: $mport"
+    } else {
+        set status [_mportexec destroot $mport]
+        mportclose $mport
+    }
+    catch {
+        set fd [open $fetchesfile w]
+        puts $fd $host_fetches
+        close $fd
+    }
+    mportshutdown
+    exit $status
+}
+
 # mportexec
 # Execute the specified target of the given mport.
 proc mportexec {mport target} {
     set workername [ditem_key $mport workername]
+    ditem_key $mport poolable 0
 
     # check for existence of macportsuser and use fallback if necessary
     $workername eval {validate_macportsuser}
@@ -2203,7 +3321,7 @@ proc mportexec {mport target} {
 
     # Before we build the port, we must build its dependencies.
     set dlist {}
-    if {[macports::_target_needs_deps $target] && [macports::_mport_has_deptypes $mport [macports::_deptypes_for_target $target $workername]]} {
+    if {[macports::_target_needs_deps $target] && [macports::_mport_has_deptypes $mport [macports::_deptypes_for_target $target $mport]]} {
         registry::exclusive_lock
         # see if we actually need to build this port
         if {$target ni {activate install} ||
@@ -2266,7 +3384,12 @@ proc mportexec {mport target} {
         }
 
         # install them
-        set result [dlist_eval $dlist _mportactive [list _mportexec activate]]
+        set jobs [macports::_parallel_ports]
+        if {$jobs > 1} {
+            set result [dlist_eval_parallel $dlist _mportactive [list macports::_mportexec_start $jobs] $jobs]
+        } else {
+            set result [dlist_eval $dlist _mportactive [list _mportexec activate]]
+        }
 
         registry::exclusive_unlock
 
@@ -2337,13 +3460,13 @@ proc mportexec {mport target} {
 # upgrade any dependencies of mport that are installed and needed for target
 proc macports::_upgrade_mport_deps {mport target} {
     set options [ditem_key $mport options]
-    set workername [ditem_key $mport workername]
-    set deptypes [macports::_deptypes_for_target $target $workername]
+    set deptypes [macports::_deptypes_for_target $target $mport]
     array set portinfo [mportinfo $mport]
     array set depscache {}
 
-    set required_archs [$workername eval {get_canonical_archs}]
+    set required_archs [macports::_mport_archs $mport]
     set depends_skip_archcheck [_mportkey $mport depends_skip_archcheck]
+    set depspec_context [macports::_mport_depspec_context $mport]
 
     # Pluralize "arch" appropriately.
     set s [expr {[llength $required_archs] == 1 ? "" : "s"}]
@@ -2355,7 +3478,7 @@ proc macports::_upgrade_mport_deps {mport target} {
             continue
         }
         foreach depspec $portinfo($deptype) {
-            set dep_portname [$workername eval "_get_dep_port $depspec"]
+            set dep_portname [_mportdepport $depspec $depspec_context]
             if {$dep_portname ne "" && ![info exists depscache(port:$dep_portname)] && [$test $dep_portname]} {
                 set variants {}
 
@@ -2730,6 +3853,9 @@ proc mportsync {{optionslist {}}} {
                         if {[file isfile ${indexfile}.quick]} {
                             file rename -force ${indexfile}.quick ${destdir}/tmp/ports/
                         }
+                        if {[file isfile ${indexfile}.bin]} {
+                            file rename -force ${indexfile}.bin ${destdir}/tmp/ports/
+                        }
                     }
                     file delete -force ${destdir}/ports
                     file rename ${destdir}/tmp/ports ${destdir}/ports
@@ -2778,6 +3904,9 @@ proc mportsync {{optionslist {}}} {
                         }
                         if {$ok} {
                             mports_generate_quickindex $indexfile
+                            if {[catch {binindex create $indexfile ${indexfile}.bin} result]} {
+                                ui_debug "Failed to generate binary index for ${indexfile}: $result"
+                            }
                         }
                     } catch {*} {
                         ui_debug "Synchronization of the PortIndex failed doing rsync"
@@ -2863,6 +3992,9 @@ proc mportsync {{optionslist {}}} {
                 set platindex "PortIndex_${macports::os_platform}_${macports::os_major}_${macports::os_arch}/PortIndex"
                 if {[file isfile ${destdir}/$platindex] && [file isfile ${destdir}/${platindex}.quick]} {
                     file rename -force ${destdir}/$platindex ${destdir}/${platindex}.quick $destdir
+                    if {[file isfile ${destdir}/${platindex}.bin]} {
+                        file rename -force ${destdir}/${platindex}.bin $destdir
+                    }
                 } else {
                     set needs_portindex true
                 }
@@ -2950,98 +4082,94 @@ proc mportsync {{optionslist {}}} {
 #         <tt>array set</tt> to create an associate array where the port names
 #         are the keys and the lines from portindex are the values.
 proc mportsearch {pattern {case_sensitive yes} {matchstyle regexp} {field name}} {
-    global macports::sources
+    global macports::sources macports::binary_index
     set matches [list]
     set easy [expr {$field eq "name"}]
 
     set found 0
+    set sourceno 0
     foreach source $sources {
         set source [lindex $source 0]
-        set protocol [macports::getprotocol $source]
+        set source_url [_mports_source_url $source]
+        if {[info exists binary_index($sourceno)]} {
+            set index $binary_index($sourceno)
+        } else {
+            unset -nocomplain index
+        }
+        incr sourceno 1
         try -pass_signal {
-            set fd [open [macports::getindex $source] r]
+            if {[info exists index]} {
+                set fd -1
+            } else {
+                set fd [open [macports::getindex $source] r]
+            }
 
             try -pass_signal {
                 incr found 1
-                while {[gets $fd line] >= 0} {
-                    array unset portinfo
-                    set name [lindex $line 0]
-                    set len  [lindex $line 1]
-                    set line [read $fd $len]
-
-                    if {$easy} {
-                        set target $name
-                    } else {
-                        array set portinfo $line
-                        if {![info exists portinfo($field)]} {
-                            continue
-                        }
-                        set target $portinfo($field)
-                    }
-
-                    switch -- $matchstyle {
-                        exact {
-                            if {$case_sensitive} {
-                                set compres [string compare $pattern $target]
+                if {[info exists index]} {
+                    # The binary index has the PortInfo already split up, and
+                    # its search index narrows down which entries can match.
+                    lassign [$index candidates $field $matchstyle $pattern] filtered candidates
+                    if {$filtered} {
+                        foreach entryno $candidates {
+                            lassign [$index entry $entryno] name line
+                            if {$easy} {
+                                set target $name
+                            } elseif {[dict exists $line $field]} {
+                                set target [dict get $line $field]
                             } else {
-                                set compres [string compare -nocase $pattern $target]
+                                continue
                             }
-                            set matchres [expr {0 == $compres}]
-                        }
-                        glob {
-                            if {$case_sensitive} {
-                                set matchres [string match $pattern $target]
-                            } else {
-                                set matchres [string match -nocase $pattern $target]
+                            if {[_mportsearch_match $pattern $target $case_sensitive $matchstyle]} {
+                                lappend matches {*}[_mportsearch_found $source_url $name $line]
                             }
                         }
-                        regexp {
-                            if {$case_sensitive} {
-                                set matchres [regexp -- $pattern $target]
-                            } else {
-                                set matchres [regexp -nocase -- $pattern $target]
+                    } elseif {$easy} {
+                        # only the matching entries are fetched
+                        set entryno 0
+                        foreach name [$index names] {
+                            if {[_mportsearch_match $pattern $name $case_sensitive $matchstyle]} {
+                                lappend matches {*}[_mportsearch_found $source_url {*}[$index entry $entryno]]
                             }
+                            incr entryno
                         }
-                        default {
-                            return -code error "mportsearch: Unsupported matching style: ${matchstyle}."
+                    } else {
+                        foreach {name line} [$index list] {
+                            if {[dict exists $line $field]
+                                && [_mportsearch_match $pattern [dict get $line $field] $case_sensitive $matchstyle]} {
+                                lappend matches {*}[_mportsearch_found $source_url $name $line]
+                            }
                         }
                     }
+                } else {
+                    while {[gets $fd line] >= 0} {
+                        array unset portinfo
+                        set name [lindex $line 0]
+                        set len  [lindex $line 1]
+                        set line [read $fd $len]
 
-                    if {$matchres == 1} {
                         if {$easy} {
+                            set target $name
+                        } else {
                             array set portinfo $line
-                        }
-                        switch -- $protocol {
-                            rsync {
-                                # Rsync files are local
-                                set source_url file://[macports::getsourcepath $source]
-                            }
-                            https -
-                            http -
-                            ftp {
-                                # snapshot tarball
-                                set source_url file://[macports::getsourcepath $source]
-                            }
-                            default {
-                                set source_url $source
+                            if {![info exists portinfo($field)]} {
+                                continue
                             }
+                            set target $portinfo($field)
                         }
-                        if {[info exists portinfo(portdir)]} {
-                            set porturl ${source_url}/$portinfo(portdir)
-                            lappend line porturl $porturl
-                            ui_debug "Found port in $porturl"
-                        } else {
-                            ui_debug "Found port info: $line"
+
+                        if {[_mportsearch_match $pattern $target $case_sensitive $matchstyle]} {
+                            lappend matches {*}[_mportsearch_found $source_url $name $line]
                         }
-                        lappend matches $name
-                        lappend matches $line
                     }
                 }
             } catch * {
                 ui_warn "It looks like your PortIndex file for $source may be corrupt."
                 throw
             } finally {
-                close $fd
+                if {$fd != -1} {
+                    close $fd
+                }
             }
         } catch {*} {
             ui_warn "Can't open index file for source: $source"
@@ -3054,13 +4182,84 @@ proc mportsearch {pattern {case_sensitive yes} {matchstyle regexp} {field name}}
     return $matches
 }
 
+##
+# Checks whether \a target matches \a pattern for mportsearch. Private API of
+# macports1.0.
+#
+# @return 1 on a match, 0 otherwise
+proc _mportsearch_match {pattern target case_sensitive matchstyle} {
+    switch -- $matchstyle {
+        exact {
+            if {$case_sensitive} {
+                set compres [string compare $pattern $target]
+            } else {
+                set compres [string compare -nocase $pattern $target]
+            }
+            return [expr {0 == $compres}]
+        }
+        glob {
+            if {$case_sensitive} {
+                return [string match $pattern $target]
+            } else {
+                return [string match -nocase $pattern $target]
+            }
+        }
+        regexp {
+            if {$case_sensitive} {
+                return [regexp -- $pattern $target]
+            } else {
+                return [regexp -nocase -- $pattern $target]
+            }
+        }
+        default {
+            return -code error "mportsearch: Unsupported matching style: ${matchstyle}."
+        }
+    }
+}
+
+##
+# Returns the name and PortInfo of a port found by mportsearch, adding its
+# porturl to the PortInfo. Private API of macports1.0.
+proc _mportsearch_found {source_url name line} {
+    array set portinfo $line
+    if {[info exists portinfo(portdir)]} {
+        set porturl ${source_url}/$portinfo(portdir)
+        lappend line porturl $porturl
+        ui_debug "Found port in $porturl"
+    } else {
+        ui_debug "Found port info: $line"
+    }
+    return [list $name $line]
+}
+
+##
+# Returns the URL the portdir entries in the PortIndex of \a source are
+# relative to. Private API of macports1.0.
+proc _mports_source_url {source} {
+    switch -- [macports::getprotocol $source] {
+        rsync {
+            # Rsync files are local
+            return file://[macports::getsourcepath $source]
+        }
+        https -
+        http -
+        ftp {
+            # snapshot tarball
+            return file://[macports::getsourcepath $source]
+        }
+        default {
+            return $source
+        }
+    }
+}
+
 ##
 # Returns the PortInfo for a single named port. The info comes from the
 # PortIndex, and name matching is case-insensitive. Unlike mportsearch, only
 # the first match is returned, but the return format is otherwise identical.
 # The advantage is that mportlookup is usually much faster than mportsearch,
-# due to the use of the quick index, which is a name-based index into the
-# PortIndex.
+# due to the use of the binary index or the quick index, which are name-based
+# indexes into the PortIndex.
 #
 # @param name name of the port to look up. Returns the first match while
 #             traversing the sources in-order.
@@ -3069,13 +4268,32 @@ proc mportsearch {pattern {case_sensitive yes} {matchstyle regexp} {field name}}
 #         info. See the return value of mportsearch().
 # @see mportsearch()
 proc mportlookup {name} {
-    global macports::sources macports::quick_index
+    global macports::sources macports::quick_index macports::binary_index
 
     set sourceno 0
     set matches [list]
     foreach source $sources {
         set source [lindex $source 0]
-        set protocol [macports::getprotocol $source]
+        if {[info exists binary_index($sourceno)]} {
+            # The binary index directly provides the split up PortInfo.
+            set index $binary_index($sourceno)
+            incr sourceno 1
+            try -pass_signal {
+                set entry [$index lookup $name]
+            } catch * {
+                ui_warn "It looks like your PortIndex file for $source may be corrupt."
+                set entry {}
+            }
+            if {$entry eq {}} {
+                continue
+            }
+            lassign $entry name line
+            if {[dict exists $line portdir]} {
+                lappend line porturl [_mports_source_url $source]/[dict get $line portdir]
+            }
+            lappend matches $name $line
+            break
+        }
         if {![info exists quick_index(${sourceno},[string tolower $name])]} {
             # no entry in this source, advance to next source
             incr sourceno 1
@@ -3097,21 +4315,8 @@ proc mportlookup {name} {
 
                 array set portinfo $line
 
-                switch -- $protocol {
-                    rsync {
-                        set source_url file://[macports::getsourcepath $source]
-                    }
-                    https -
-                    http -
-                    ftp {
-                        set source_url file://[macports::getsourcepath $source]
-                    }
-                    default {
-                        set source_url $source
-                    }
-                }
                 if {[info exists portinfo(portdir)]} {
-                    lappend line porturl ${source_url}/$portinfo(portdir)
+                    lappend line porturl [_mports_source_url $source]/$portinfo(portdir)
                 }
                 lappend matches $name
                 lappend matches $line
@@ -3140,49 +4345,58 @@ proc mportlookup {name} {
 #         info. See the return value of mportsearch().
 # @see mportsearch()
 proc mportlistall {} {
-    global macports::sources
+    global macports::sources macports::binary_index
     set matches [list]
 
     set found 0
+    set sourceno 0
     foreach source $sources {
         set source [lindex $source 0]
-        set protocol [macports::getprotocol $source]
+        set source_url [_mports_source_url $source]
+        if {[info exists binary_index($sourceno)]} {
+            set index $binary_index($sourceno)
+        } else {
+            unset -nocomplain index
+        }
+        incr sourceno 1
         try -pass_signal {
-            set fd [open [macports::getindex $source] r]
+            if {[info exists index]} {
+                set fd -1
+            } else {
+                set fd [open [macports::getindex $source] r]
+            }
 
             try -pass_signal {
                 incr found 1
-                while {[gets $fd line] >= 0} {
-                    array unset portinfo
-                    set name [lindex $line 0]
-                    set len  [lindex $line 1]
-                    set line [read $fd $len]
+                if {[info exists index]} {
+                    foreach {name line} [$index list] {
+                        if {[dict exists $line portdir]} {
+                            lappend line porturl ${source_url}/[dict get $line portdir]
+                        }
+                        lappend matches $name $line
+                    }
+                } else {
+                    while {[gets $fd line] >= 0} {
+                        array unset portinfo
+                        set name [lindex $line 0]
+                        set len  [lindex $line 1]
+                        set line [read $fd $len]
 
-                    array set portinfo $line
+                        array set portinfo $line
 
-                    switch -- $protocol {
-                        rsync {
-                            set source_url file://[macports::getsourcepath $source]
-                        }
-                        https -
-                        http -
-                        ftp {
-                            set source_url file://[macports::getsourcepath $source]
-                        }
-                        default {
-                            set source_url $source
+                        if {[info exists portinfo(portdir)]} {
+                            lappend line porturl ${source_url}/$portinfo(portdir)
                         }
+                        lappend matches $name $line
                     }
-                    if {[info exists portinfo(portdir)]} {
-                        lappend line porturl ${source_url}/$portinfo(portdir)
-                    }
-                    lappend matches $name $line
                 }
             } catch * {
                 ui_warn "It looks like your PortIndex file for $source may be corrupt."
                 throw
             } finally {
-                close $fd
+                if {$fd != -1} {
+                    close $fd
+                }
             }
         } catch {*} {
             ui_warn "Can't open index file for source: $source"
@@ -3196,13 +4410,14 @@ proc mportlistall {} {
 }
 
 ##
-# Loads PortIndex.quick from each source into the quick_index, generating it
-# first if necessary. Private API of macports1.0, do not use this from outside
-# macports1.0.
+# Loads the binary index, or if that isn't possible, PortIndex.quick from each
+# source into the quick_index, generating them first if necessary. Private API
+# of macports1.0, do not use this from outside macports1.0.
 proc _mports_load_quickindex {} {
     global macports::sources macports::quick_index
 
     unset -nocomplain macports::quick_index
+    _mports_close_binindex
 
     set sourceno 0
     foreach source $sources {
@@ -3214,6 +4429,10 @@ proc _mports_load_quickindex {} {
             incr sourceno
             continue
         }
+        if {[_mports_open_binindex $sourceno $index]} {
+            incr sourceno
+            continue
+        }
         if {![file exists ${index}.quick]} {
             ui_warn "No quick index file found, attempting to generate one for source: $source"
             try -pass_signal {
@@ -3245,6 +4464,43 @@ proc _mports_load_quickindex {} {
     }
 }
 
+##
+# Maps the binary index belonging to the PortIndex \a index into memory for
+# use by mportlookup, mportsearch and mportlistall, (re)generating it if it is
+# missing or out of date. Private API of macports1.0.
+#
+# @param sourceno number of the source \a index belongs to
+# @param index path to the PortIndex
+# @return 1 if the binary index is available, 0 if the text PortIndex has to
+#         be used instead
+proc _mports_open_binindex {sourceno index} {
+    global macports::binary_index
+
+    if {![catch {binindex open ${index}.bin $index} result]} {
+        set binary_index($sourceno) $result
+        return 1
+    }
+    if {[catch {binindex create $index ${index}.bin} result]
+            || [catch {binindex open ${index}.bin $index} result]} {
+        ui_debug "Not using a binary index for ${index}: $result"
+        return 0
+    }
+    set binary_index($sourceno) $result
+    return 1
+}
+
+##
+# Unmaps all binary indexes opened by _mports_open_binindex. Private API of
+# macports1.0.
+proc _mports_close_binindex {} {
+    global macports::binary_index
+
+    foreach sourceno [array names binary_index] {
+        $binary_index($sourceno) close
+    }
+    unset -nocomplain macports::binary_index
+}
+
 ##
 # Generates a PortIndex.quick file from a PortIndex by using the name field as
 # key. This allows fast indexing into the PortIndex when using the port name as
@@ -3304,6 +4560,9 @@ proc mports_generate_quickindex {index} {
 }
 
 proc mportinfo {mport} {
+    if {[ditem_key $mport deferred] == 1} {
+        return [ditem_key $mport portinfo]
+    }
     set workername [ditem_key $mport workername]
     return [$workername eval {array get ::PortInfo}]
 }
@@ -3316,10 +4575,16 @@ proc mportclose {mport} {
     ditem_key $mport refcnt $refcnt
     if {$refcnt == 0} {
         dlist_delete macports::open_mports $mport
-        set workername [ditem_key $mport workername]
-        # the hack in _mportexec might have already deleted the worker
-        if {[interp exists $workername]} {
-            interp delete $workername
+        # ports opened from the cache might not have a worker, nor ones that
+        # failed to get one
+        if {[ditem_key $mport deferred] != 1 && [ditem_key $mport workername] ne ""} {
+            set workername [ditem_key $mport workername]
+            # the hack in _mportexec might have already deleted the worker
+            if {[ditem_key $mport poolable] == 1 && [interp exists $workername]} {
+                macports::_worker_release $workername
+            } elseif {[interp exists $workername]} {
+                interp delete $workername
+            }
         }
         set porturl [ditem_key $mport porturl]
         #if {[info exists macports::extracted_portdirs($porturl)]} {
@@ -3345,6 +4610,9 @@ proc mportclose {mport} {
 # - returns a variable from the port's interpreter
 
 proc _mportkey {mport key} {
+    if {[ditem_key $mport deferred] == 1 && [dict exists [ditem_key $mport cached_values] $key]} {
+        return [dict get [ditem_key $mport cached_values] $key]
+    }
     set workername [ditem_key $mport workername]
     return [$workername eval [list set $key]]
 }
@@ -3385,8 +4653,7 @@ proc mportdepends {mport {target {}} {recurseDeps 1} {skipSatisfied 1} {accDeps
         }
     }
 
-    set workername [ditem_key $mport workername]
-    set deptypes [macports::_deptypes_for_target $target $workername]
+    set deptypes [macports::_deptypes_for_target $target $mport]
 
     set depPorts {}
     if {[llength $deptypes] > 0} {
@@ -3397,8 +4664,9 @@ proc mportdepends {mport {target {}} {recurseDeps 1} {skipSatisfied 1} {accDeps
         unset -nocomplain optionsarray(subport)
         set options [array get optionsarray]
         set variations [ditem_key $mport variations]
-        set required_archs [$workername eval {get_canonical_archs}]
+        set required_archs [macports::_mport_archs $mport]
         set depends_skip_archcheck [_mportkey $mport depends_skip_archcheck]
+        set depspec_context [macports::_mport_depspec_context $mport]
     }
 
     # Process the dependencies for each of the deptypes
@@ -3408,7 +4676,7 @@ proc mportdepends {mport {target {}} {recurseDeps 1} {skipSatisfied 1} {accDeps
         }
         foreach depspec $portinfo($deptype) {
             # get the portname that satisfies the depspec
-            set dep_portname [$workername eval "_get_dep_port $depspec"]
+            set dep_portname [_mportdepport $depspec $depspec_context]
             # skip port/archs combos we've already seen, and ones with the same port but less archs than ones we've seen (or noarch)
             set seenkey ${dep_portname},[join $required_archs ,]
             set seen 0
@@ -3500,7 +4768,7 @@ proc mportdepends {mport {target {}} {recurseDeps 1} {skipSatisfied 1} {accDeps
 
                 set supported_archs [_mportkey $depport supported_archs]
                 array unset variation_array
-                array set variation_array [[ditem_key $depport workername] eval {array get requested_variations}]
+                array set variation_array [macports::_mport_cached $depport requested_variations {array get requested_variations}]
                 mportclose $depport
                 set arch_mismatch 1
                 set has_universal 0
@@ -3546,7 +4814,9 @@ proc mportdepends {mport {target {}} {recurseDeps 1} {skipSatisfied 1} {accDeps
         foreach depport $depPorts {
             # Any of these may have been closed by a previous recursive call
             # and replaced by a universal version. This is fine, just skip.
-            if {[ditem_key $depport] ne ""} {
+            # Test a plain key, reading workername would evaluate ports
+            # opened from the cache.
+            if {[ditem_key $depport refcnt] ne ""} {
                 set res [mportdepends $depport {} $recurseDeps $skipSatisfied 1]
                 if {$res != 0} {
                     return $res
@@ -3577,8 +4847,7 @@ proc macports::_mport_supports_archs {mport required_archs} {
 
 # return the archs of the given mport
 proc macports::_mport_archs {mport} {
-    set workername [ditem_key $mport workername]
-    return [$workername eval {get_canonical_archs}]
+    return [_mport_cached $mport canonical_archs {get_canonical_archs}]
 }
 
 # check if the active version of a port supports the given archs
@@ -3717,7 +4986,7 @@ proc macports::_target_needs_toolchain {workername target} {
 }
 
 # Determine dependency types required for target
-proc macports::_deptypes_for_target {target workername} {
+proc macports::_deptypes_for_target {target mport} {
     switch -- $target {
         fetch       -
         checksum    {return depends_fetch}
@@ -3732,7 +5001,7 @@ proc macports::_deptypes_for_target {target workername} {
         mdmg        -
         mpkg        {
             if {[global_option_isset ports_binary_only] ||
-                (![global_option_isset ports_source_only] && [$workername eval {_archive_available}])} {
+                (![global_option_isset ports_source_only] && [_mport_archive_available $mport])} {
                 return "depends_lib depends_run"
             } else {
                 return "depends_fetch depends_extract depends_patch depends_build depends_lib depends_run"
@@ -3742,8 +5011,8 @@ proc macports::_deptypes_for_target {target workername} {
         activate    -
         {}          {
             if {[global_option_isset ports_binary_only] ||
-                [$workername eval {registry_exists $subport $version $revision $portvariants}]
-                || (![global_option_isset ports_source_only] && [$workername eval {_archive_available}])} {
+                [_mport_registry_exists $mport]
+                || (![global_option_isset ports_source_only] && [_mport_archive_available $mport])} {
                 return "depends_lib depends_run"
             } else {
                 return "depends_fetch depends_extract depends_patch depends_build depends_lib depends_run"
@@ -4366,19 +5635,19 @@ proc macports::_upgrade_dependencies {portinfoname depscachename variationslistn
     set saved_do_dependents [info exists options(ports_do_dependents)]
     unset -nocomplain options(ports_do_dependents)
 
-    set parentworker [ditem_key $parentmport workername]
+    set depspec_context [_mport_depspec_context $parentmport]
     # each required dep type is upgraded
     if {$build_needed && ![global_option_isset ports_binary_only]} {
-        set dtypes [_deptypes_for_target destroot $parentworker]
+        set dtypes [_deptypes_for_target destroot $parentmport]
     } else {
-        set dtypes [_deptypes_for_target install $parentworker]
+        set dtypes [_deptypes_for_target install $parentmport]
     }
 
     set status 0
     foreach dtype $dtypes {
         if {[info exists portinfo($dtype)]} {
             foreach i $portinfo($dtype) {
-                set d [$parentworker eval "_get_dep_port $i"]
+                set d [_mportdepport $i $depspec_context]
                 if {![info exists depscache(port:$d)] && ![info exists depscache($i)]} {
                     if {$d ne ""} {
                         set dspec port:$d
@@ -4836,8 +6105,7 @@ proc macports::revupgrade_scanandrebuild {broken_port_counts_name opts} {
     revupgrade_update_cxx_stdlib $fancy_output $revupgrade_progress
 
     set broken_files {}
-    set binaries [registry::file search active 1 binary 1]
-    set binary_count [llength $binaries]
+    set binary_count [registry::file count active 1 binary 1]
     if {$binary_count > 0} {
         ui_msg "$macports::ui_prefix Scanning binaries for linking errors"
         set handle [machista::create_handle]
@@ -4853,13 +6121,15 @@ proc macports::revupgrade_scanandrebuild {broken_port_counts_name opts} {
 
         try {
             set i 1
-            foreach b $binaries {
+            # iterate lazily; creating a file object for every binary in
+            # the registry up front is slow and uses a lot of memory
+            registry::file foreach {actual_path} {active 1 binary 1} {
                 if {$fancy_output} {
                     if {$binary_count < 10000 || $i % 10 == 1} {
                         $revupgrade_progress update $i $binary_count
                     }
                 }
-                set bpath [$b actual_path]
+                set bpath $actual_path
                 #ui_debug "${i}/${binary_count}: $bpath"
                 incr i
 
@@ -5362,9 +6632,11 @@ proc macports::revupgrade_buildgraph {port stackname adjlistname revadjlistname
     }
 }
 
-# get cached ping time for host, modified by blacklist and preferred list
-proc macports::get_pingtime {host} {
-    global macports::ping_cache macports::host_cache \
+# get the expected time in ms to fetch 1 MiB from host, from the statistics
+# of earlier fetches, modified by blacklist and preferred list. Returns -1
+# for blacklisted hosts and an empty string for unknown ones.
+proc macports::get_host_score {host} {
+    global macports::host_stats macports::host_cache \
            macports::host_blacklist macports::preferred_hosts
 
     if {[info exists host_cache($host)]} {
@@ -5382,19 +6654,57 @@ proc macports::get_pingtime {host} {
             return 1
         }
     }
-    if {[info exists ping_cache($host)]} {
-        # expire entries after 1 day
-        if {[clock seconds] - [lindex $ping_cache($host) 1] <= 86400} {
-            return [lindex $ping_cache($host) 0]
-        }
+    if {![info exists host_stats($host)]} {
+        return {}
     }
-    return {}
+    lassign $host_stats($host) throughput failures
+    if {$throughput > 0} {
+        set score [expr {1048576000.0 / $throughput}]
+    } else {
+        # never delivered a file, only failures
+        set score 10000.0
+    }
+    # a host that failed every time is 10 times as slow
+    return [expr {$score * (1 + 9 * $failures)}]
 }
 
-# cache a ping time of ms for host
-proc macports::set_pingtime {host ms} {
-    global macports::ping_cache
-    set ping_cache($host) [list $ms [clock seconds]]
+# record a fetch from host, status ok, error or cancelled when another host
+# delivered first, that got bytes in seconds. The throughput and the failure
+# rate are moving averages so that recent fetches matter most. Losing a race
+# says nothing about the host, it may only have been started later.
+proc macports::record_host_fetch {host status bytes seconds} {
+    global macports::host_stats macports::host_fetches
+    # child processes building ports pass their fetches on to the parent
+    if {[info exists host_fetches]} {
+        lappend host_fetches [list $host $status $bytes $seconds]
+    }
+    if {$status eq "cancelled"} {
+        return
+    }
+    if {[info exists host_stats($host)]} {
+        lassign $host_stats($host) throughput failures
+    } else {
+        set throughput 0
+        set failures 0
+    }
+    switch -- $status {
+        ok {
+            set failed 0.0
+            if {$seconds > 0} {
+                set sample [expr {$bytes / $seconds}]
+                if {$throughput > 0} {
+                    set throughput [expr {0.7 * $throughput + 0.3 * $sample}]
+                } else {
+                    set throughput $sample
+                }
+            }
+        }
+        default {
+            set failed 1.0
+        }
+    }
+    set failures [expr {0.7 * $failures + 0.3 * $failed}]
+    set host_stats($host) [list $throughput $failures [clock seconds]]
 }
 
 # get the version of a compiler (memoized)
@@ -280,6 +280,12 @@ proc dlist_get_next {dlist statusdict} {
 #   selector - the selector for determining eligibility
 
 proc dlist_eval {dlist testcond handler {canfail "0"} {selector "dlist_get_next"}} {
+	# Let the native dependency graph select the items if it's available,
+	# it doesn't have to look at the whole list for each item.
+	if {$selector eq "dlist_get_next" && [info commands dgraph] ne ""} {
+		return [macports_dlist::dlist_eval_graph $dlist $testcond $handler $canfail]
+	}
+
 	array set statusdict [list]
 	
 	# Do a pre-run seeing if any items automagically
@@ -333,6 +339,31 @@ proc dlist_eval {dlist testcond handler {canfail "0"} {selector "dlist_get_next"
 	return $dlist
 }
 
+# dlist_eval_parallel
+# Like dlist_eval with dlist_get_next as the selector, but evaluates up to
+# jobs eligible ditems at once. Instead of a handler returning a status,
+# starter is invoked as "starter ditem callback" and has to invoke callback
+# with the unix status code of the evaluation of ditem, 0 for success,
+# either before returning or later from the event loop, which runs while
+# ditems are being evaluated. If a ditem fails and canfail is 0, no more
+# ditems are started, the running ones are waited for, and the remaining
+# ditems are returned.
+#   dlist    - the dependency list to evaluate
+#   testcond - test condition to populate the status dictionary
+#              should return {-1, 0, 1}
+#   starter  - the command starting the evaluation of a ditem
+#   jobs     - the maximum number of ditems evaluated at once
+#   canfail  - If 1, then progress will not stop when a failure
+#              occures; if 0, then dlist_eval_parallel will stop
+#              starting ditems on the first failure
+
+proc dlist_eval_parallel {dlist testcond starter jobs {canfail "0"}} {
+	if {$jobs <= 1 || [info commands dgraph] eq ""} {
+		return [dlist_eval $dlist $testcond [list macports_dlist::dlist_eval_wait $starter] $canfail]
+	}
+	return [macports_dlist::dlist_eval_graph $dlist $testcond $starter $canfail $jobs]
+}
+
 
 ##### Private API #####
 # Anything below this point is subject to change without notice.
@@ -431,5 +462,153 @@ proc ditem_contains {ditem key args} {
 	}
 }
 
+# Same as dlist_eval with dlist_get_next as the selector, using the dgraph
+# command from Pextlib. If jobs is given, handler is a starter as described
+# for dlist_eval_parallel.
+proc dlist_eval_graph {dlist testcond handler canfail {jobs ""}} {
+	set nodes [list]
+	foreach ditem $dlist {
+		lappend nodes [list [ditem_key $ditem provides] [ditem_key $ditem requires] [ditem_key $ditem uses]]
+	}
+	set graph [dgraph create $nodes]
+	if {$jobs eq ""} {
+		catch {dlist_eval_graph_run $graph $dlist $testcond $handler $canfail} result options
+	} else {
+		catch {dlist_eval_parallel_run $graph $dlist $testcond $handler $canfail $jobs} result options
+	}
+	$graph close
+	return -options $options $result
+}
+
+proc dlist_eval_graph_run {graph dlist testcond handler canfail} {
+	# Do a pre-run seeing if any items automagically
+	# can evaluate to true.
+	if {$testcond ne ""} {
+		set index 0
+		foreach ditem $dlist {
+			if {[$testcond $ditem] == 1} {
+				$graph done $index 1
+			}
+			incr index
+		}
+	}
+
+	while {[set index [$graph next]] >= 0} {
+		set ditem [lindex $dlist $index]
+		# $handler should return a unix status code, 0 for success.
+		if {[catch {{*}$handler $ditem} result]} {
+			ui_debug $::errorInfo
+			ui_error $result
+			break
+		}
+		# No news is good news at this point.
+		if {$result eq {}} { set result 0 }
+
+		# Abort if we're not allowed to fail
+		if {$canfail == 0 && $result != 0} {
+			break
+		}
+
+		$graph done $index [expr {$result == 0}]
+	}
+	if {$index < 0 && [llength [$graph pending]] > 0} {
+		ui_debug "dlist_eval: all entries in dependency list have unsatisfied dependencies; can't process"
+	}
+
+	# Return the list of lusers
+	set lusers [list]
+	foreach index [$graph pending] {
+		lappend lusers [lindex $dlist $index]
+	}
+	return $lusers
+}
+
+# State of the evaluations run by dlist_eval_parallel_run, by graph: the
+# number of running ditems, whether to stop starting new ones, and a
+# variable set whenever one is done.
+variable parallel
+
+proc dlist_eval_parallel_run {graph dlist testcond starter canfail jobs} {
+	variable parallel
+
+	if {$testcond ne ""} {
+		set index 0
+		foreach ditem $dlist {
+			if {[$testcond $ditem] == 1} {
+				$graph done $index 1
+			}
+			incr index
+		}
+	}
+
+	set parallel($graph,running) 0
+	set parallel($graph,stop) 0
+	set parallel($graph,done) 0
+	set code [catch {
+		while {1} {
+			while {!$parallel($graph,stop) && $parallel($graph,running) < $jobs
+					&& [set index [$graph next]] >= 0} {
+				$graph start $index
+				incr parallel($graph,running)
+				if {[catch {{*}$starter [lindex $dlist $index] [list macports_dlist::dlist_eval_parallel_done $graph $index $canfail]} result]} {
+					ui_debug $::errorInfo
+					ui_error $result
+					incr parallel($graph,running) -1
+					set parallel($graph,stop) 1
+				}
+			}
+			if {$parallel($graph,running) == 0} {
+				break
+			}
+			vwait macports_dlist::parallel($graph,done)
+		}
+		if {!$parallel($graph,stop) && [llength [$graph pending]] > 0} {
+			ui_debug "dlist_eval: all entries in dependency list have unsatisfied dependencies; can't process"
+		}
+	} result options]
+	array unset parallel $graph,*
+	if {$code != 0} {
+		return -options $options $result
+	}
+
+	# Return the list of lusers
+	set lusers [list]
+	foreach index [$graph pending] {
+		lappend lusers [lindex $dlist $index]
+	}
+	return $lusers
+}
+
+# Callback given to the starter by dlist_eval_parallel_run.
+proc dlist_eval_parallel_done {graph index canfail status} {
+	variable parallel
+
+	# No news is good news at this point.
+	if {$status eq {}} { set status 0 }
+	incr parallel($graph,running) -1
+	# Abort if we're not allowed to fail, leaving the ditem pending
+	if {$canfail == 0 && $status != 0} {
+		set parallel($graph,stop) 1
+	} else {
+		$graph done $index [expr {$status == 0}]
+	}
+	set parallel($graph,done) 1
+}
+
+# Handler used by dlist_eval_parallel to evaluate one ditem at a time with
+# a starter.
+proc dlist_eval_wait {starter ditem} {
+	variable wait_status
+	variable wait_id
+	set id [incr wait_id]
+	{*}$starter $ditem [list set macports_dlist::wait_status($id)]
+	if {![info exists wait_status($id)]} {
+		vwait macports_dlist::wait_status($id)
+	}
+	set status $wait_status($id)
+	unset wait_status($id)
+	return $status
+}
+
 # End of macports_dlist namespace
 }
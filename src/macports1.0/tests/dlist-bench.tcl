@@ -0,0 +1,72 @@
+# Benchmark of dlist_eval ordering a synthetic dependency graph, the way
+# mportexec and port upgrade do, with the native dependency graph and with
+# dlist_get_next as the selector. The latter is much slower, so it orders
+# a smaller graph of tclnodes nodes.
+# Not run as part of the test suite.
+# Syntax:
+# tclsh dlist-bench.tcl ?nodes? ?tclnodes?
+
+set nodes [expr {$argc > 0 ? [lindex $argv 0] : 5000}]
+set tclnodes [expr {$argc > 1 ? [lindex $argv 1] : 500}]
+set argv [list]
+
+source ../macports_test_autoconf.tcl
+package require macports 1.0
+
+array set ui_options {}
+mportinit ui_options
+
+source ../macports_dlist.tcl
+
+# Each port depends on a few ports before it, mostly close ones the way
+# libraries pile up, and some have soft dependencies.
+proc make_dlist {count} {
+    expr {srand(1)}
+    set dlist [list]
+    for {set i 0} {$i < $count} {incr i} {
+        set ditem [ditem_create]
+        ditem_key $ditem provides port:port-$i
+        set requires [list]
+        if {$i > 0} {
+            set deps [expr {int(rand() * 5)}]
+            for {set d 0} {$d < $deps} {incr d} {
+                if {rand() < 0.7} {
+                    set dep [expr {$i - 1 - int(rand() * min($i, 20))}]
+                } else {
+                    set dep [expr {int(rand() * $i)}]
+                }
+                lappend requires port:port-$dep
+            }
+        }
+        ditem_key $ditem requires $requires
+        if {$i > 0 && rand() < 0.2} {
+            ditem_key $ditem uses port:port-[expr {int(rand() * $i)}]
+        }
+        lappend dlist $ditem
+    }
+    # reverse so that dependencies come late in the list, like the list of
+    # ports to upgrade given on the command line
+    return [lreverse $dlist]
+}
+
+proc handler {ditem} {
+    return 0
+}
+
+proc tcl_get_next {dlist statusdict} {
+    upvar $statusdict upstatus
+    return [dlist_get_next $dlist upstatus]
+}
+
+foreach {selector count} [list dlist_get_next $nodes tcl_get_next $tclnodes] {
+    set dlist [make_dlist $count]
+    set start [clock microseconds]
+    set left [dlist_eval $dlist {} handler 0 $selector]
+    set usec [expr {[clock microseconds] - $start}]
+    if {$left ne {}} {
+        puts "$selector: [llength $left] nodes not evaluated"
+    }
+    puts [format "%-32s %10.1f ms %10.3f ms each" \
+        "[expr {$selector eq "dlist_get_next" ? "dgraph" : "dlist_get_next"}], $count nodes" \
+        [expr {$usec / 1000.0}] [expr {$usec / 1000.0 / $count}]]
+}
@@ -0,0 +1,89 @@
+# Benchmark of opening and closing ports the way port upgrade outdated and
+# portindex do, with new worker interpreters for every port and with workers
+# taken from the pool. The Portfile evaluation cache is disabled so every
+# open evaluates its Portfile.
+# Not run as part of the test suite.
+# Syntax:
+# tclsh mportopen-bench.tcl ?ports?
+
+package require tcltest 2
+namespace import tcltest::*
+
+set pwd [file dirname [file normalize $argv0]]
+set ports [expr {$argc > 0 ? [lindex $argv 0] : 200}]
+set argv [list]
+
+source ../macports_test_autoconf.tcl
+package require macports 1.0
+source ./library.tcl
+
+proc write_ports {dir count} {
+    for {set i 0} {$i < $count} {incr i} {
+        set portdir [file join $dir category port-$i]
+        file mkdir $portdir
+        set fd [open [file join $portdir Portfile] w]
+        puts $fd "PortSystem          1.0
+
+name                port-$i
+version             1.$i.0
+revision            [expr {$i % 3}]
+categories          category devel
+platforms           darwin
+license             BSD
+maintainers         {example.org:someone @someone} openmaintainer
+description         The port-$i package
+long_description    port-$i is a package that does [string repeat {many things } 10]
+homepage            https://example.org/port-$i
+master_sites        \${homepage}
+checksums           rmd160  0000000000000000000000000000000000000000 \\
+                    sha256  0000000000000000000000000000000000000000000000000000000000000000 \\
+                    size    1234
+
+depends_build       port:pkgconfig
+depends_lib         port:port-[expr {$i / 2}] port:zlib
+
+configure.args      --disable-static --with-zlib=\${prefix}
+
+variant debug description {Build with debugging symbols} {
+    configure.args-append --enable-debug
+}
+
+post-destroot {
+    xinstall -d \${destroot}\${prefix}/share/doc/\${name}
+}"
+        close $fd
+    }
+}
+
+proc usec {script} {
+    set start [clock microseconds]
+    uplevel 1 $script
+    return [expr {[clock microseconds] - $start}]
+}
+
+proc open_all {dir count} {
+    for {set i 0} {$i < $count} {incr i} {
+        mportclose [mportopen file://[file join $dir category port-$i]]
+    }
+}
+
+file delete -force $pwd/tmpdir
+init_tmp_prefix $pwd $pwd/tmpdir
+array set ui_options {}
+mportinit ui_options
+set macports::portinfo_cache no
+
+set dir [file join $pwd mportopen-bench]
+file delete -force $dir
+write_ports $dir $ports
+
+set macports::worker_pool_size 0
+set cold [usec {open_all $dir $ports}]
+set macports::worker_pool_size 4
+set pooled [usec {open_all $dir $ports}]
+
+puts [format "%d ports, %.2f ms per port with new workers, %.2f ms with pooled workers, %.1fx" \
+    $ports [expr {$cold / 1000.0 / $ports}] [expr {$pooled / 1000.0 / $ports}] \
+    [expr {double($cold) / $pooled}]]
+
+file delete -force $dir $pwd/tmpdir
@@ -233,8 +233,13 @@ proc portarchivefetch::fetchfiles {args} {
                 ui_msg "$UI_PREFIX [format [msgcat::mc "Attempting to fetch %s from %s"] $archive ${site}]"
                 set file_url [portfetch::assemble_url $site $archive]
                 set effectiveURL ""
+                set start [clock milliseconds]
                 try {
                     curl fetch --effective-url effectiveURL {*}$fetch_options $file_url "${incoming_path}/${archive}.TMP"
+                    # failures aren't recorded, most are archives that were
+                    # never built rather than problems with the site
+                    portfetch::record_fetch $file_url ok [file size "${incoming_path}/${archive}.TMP"] \
+                        [expr {([clock milliseconds] - $start) / 1000.0}]
                     set fetched 1
                     break
                 } catch {{POSIX SIG SIGINT} eCode eMessage} {
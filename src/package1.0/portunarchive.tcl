@@ -163,13 +163,13 @@ proc portunarchive::unarchive_command_setup {args} {
                 return -code error "No '$pax' was found on this system!"
             }
         }
-        t(ar|bz|lz|xz|gz) {
+        t(ar|bz|lz|xz|gz|zst) {
             set tar "tar"
             if {[catch {set tar [findBinary $tar ${portutil::autoconf::tar_path}]} errmsg] == 0} {
                 ui_debug "Using $tar"
                 set unarchive.cmd "$tar"
                 set unarchive.pre_args {-xvpf}
-                if {[regexp {z2?$} ${unarchive.type}]} {
+                if {[regexp {z2?$|zst$} ${unarchive.type}]} {
                     set unarchive.args {-}
                     if {[regexp {bz2?$} ${unarchive.type}]} {
                         if {![catch {binaryInPath lbzip2}]} {
@@ -183,6 +183,8 @@ proc portunarchive::unarchive_command_setup {args} {
                         set gzip "lzma"
                     } elseif {[regexp {xz$} ${unarchive.type}]} {
                         set gzip "xz"
+                    } elseif {[regexp {zst$} ${unarchive.type}]} {
+                        set gzip "zstd"
                     } else {
                         set gzip "gzip"
                     }
@@ -243,15 +245,13 @@ proc portunarchive::unarchive_command_setup {args} {
 }
 
 proc portunarchive::unarchive_main {args} {
-    global UI_PREFIX unarchive.dir unarchive.file unarchive.pipe_cmd unarchive.skip
+    global UI_PREFIX unarchive.dir unarchive.file unarchive.path \
+           unarchive.pipe_cmd unarchive.skip
 
     if {${unarchive.skip}} {
         return 0
     }
 
-    # Setup unarchive command
-    unarchive_command_setup
-
     # Create destination directory for unpacking
     if {![file isdirectory ${unarchive.dir}]} {
         file mkdir ${unarchive.dir}
@@ -259,6 +259,18 @@ proc portunarchive::unarchive_main {args} {
 
     # Unpack the archive
     ui_info "$UI_PREFIX [format [msgcat::mc "Extracting %s"] ${unarchive.file}]"
+
+    # Tar archives are read in-process, unless there is something in the
+    # way that tar would have overwritten
+    if {[archive supported ${unarchive.path}] && [llength [readdir ${unarchive.dir}]] == 0} {
+        ui_debug "Extracting ${unarchive.path} in-process"
+        archive extract ${unarchive.path} ${unarchive.dir}
+        return 0
+    }
+
+    # Setup unarchive command
+    unarchive_command_setup
+
     if {${unarchive.pipe_cmd} eq ""} {
         command_exec unarchive
     } else {
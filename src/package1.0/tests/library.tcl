@@ -91,8 +91,8 @@ proc macports_worker_init {} {
     interp alias {} getoption {} macports::getoption
 
     # ping cache
-    interp alias {} get_pingtime {} macports::get_pingtime
-    interp alias {} set_pingtime {} macports::set_pingtime
+    interp alias {} get_host_score {} macports::get_host_score
+    interp alias {} record_host_fetch {} macports::record_host_fetch
 
     # archive_sites.conf handling
     interp alias {} get_archive_sites_conf_values {} macports::get_archive_sites_conf_values
@@ -83,9 +83,13 @@
 #include "sha1cmd.h"
 #include "rmd160cmd.h"
 #include "sha256cmd.h"
+#include "checksumcmd.h"
+#include "archivecmd.h"
+#include "fastcopy.h"
 #include "fs-traverse.h"
 #include "filemap.h"
 #include "curl.h"
+#include "dgraph.h"
 #include "xinstall.h"
 #include "vercomp.h"
 #include "readline.h"
@@ -99,6 +103,7 @@
 #include "system.h"
 #include "mktemp.h"
 #include "realpath.h"
+#include "binindex.h"
 
 #if HAVE_CRT_EXTERNS_H
 #include <crt_externs.h>
@@ -1091,6 +1096,9 @@ int Pextlib_Init(Tcl_Interp *interp)
 	Tcl_CreateObjCommand(interp, "rmd160", RMD160Cmd, NULL, NULL);
 	Tcl_CreateObjCommand(interp, "sha256", SHA256Cmd, NULL, NULL);
 	Tcl_CreateObjCommand(interp, "sha1", SHA1Cmd, NULL, NULL);
+	Tcl_CreateObjCommand(interp, "checksum", ChecksumCmd, NULL, NULL);
+	Tcl_CreateObjCommand(interp, "archive", ArchiveCmd, NULL, NULL);
+	Tcl_CreateObjCommand(interp, "fastcopy", FastcopyCmd, NULL, NULL);
 	Tcl_CreateObjCommand(interp, "umask", UmaskCmd, NULL, NULL);
 	Tcl_CreateObjCommand(interp, "pipe", PipeCmd, NULL, NULL);
 	Tcl_CreateObjCommand(interp, "curl", CurlCmd, NULL, NULL);
@@ -1098,6 +1106,8 @@ int Pextlib_Init(Tcl_Interp *interp)
 	Tcl_CreateObjCommand(interp, "unsetenv", UnsetEnvCmd, NULL, NULL);
 	Tcl_CreateObjCommand(interp, "lchown", lchownCmd, NULL, NULL);
 	Tcl_CreateObjCommand(interp, "realpath", RealpathCmd, NULL, NULL);
+	Tcl_CreateObjCommand(interp, "binindex", BinindexCmd, NULL, NULL);
+	Tcl_CreateObjCommand(interp, "dgraph", DgraphCmd, NULL, NULL);
 #ifdef __MACH__
     Tcl_CreateObjCommand(interp, "fileIsBinary", fileIsBinaryCmd, NULL, NULL);
 #endif
@@ -0,0 +1,2930 @@
+/*
+ * archivecmd.c
+ *
+ * Copyright (c) 2026 The MacPorts Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of MacPorts Team nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* required for futimes(3) and lutimes(3) */
+#define _BSD_SOURCE
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <limits.h>
+#include <pwd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if HAVE_LIBZ
+#include <zlib.h>
+#endif
+#if HAVE_LIBBZ2
+#include <bzlib.h>
+#endif
+#if HAVE_LIBLZMA
+#include <lzma.h>
+#endif
+#if HAVE_LIBZSTD
+#include <pthread.h>
+#include <zstd.h>
+#endif
+
+#include <tcl.h>
+
+#include "archivecmd.h"
+
+/*
+ * Archives are decompressed into a buffer that the tar reader takes headers
+ * from and that file data is written out of directly. Members are created
+ * at their final location as they come out of the stream, so activating a
+ * port no longer writes every file twice (once into a temporary directory by
+ * tar, then again if the rename into place has to cross file systems) and
+ * doesn't fork a decompressor and tar for every image.
+ */
+
+#define ARCHIVE_BUFFER_SIZE (256 * 1024)
+#define TAR_BLOCK_SIZE 512
+/* pax extended headers and GNU long names larger than this are refused */
+#define TAR_MAX_EXTENSION (1024 * 1024)
+
+/*
+ * tzst archives written by archive create start with the members whose
+ * names begin with "+", +CONTENTS and the other files describing the port,
+ * in frames of their own. A skippable frame at the end, listed in the seek
+ * table like the others, gives the number of these frames so that the
+ * members can be read without decompressing the rest of the archive:
+ *
+ *   metadata frames | data frames | index frame | seek table
+ *
+ * The index frame is ARCHIVE_INDEX_MAGIC, the length of what follows, the
+ * tag ARCHIVE_INDEX_TAG and the number of metadata frames, all little
+ * endian.
+ */
+#define ZSTD_SEEK_TABLE_MAGIC 0x184D2A5E
+#define ZSTD_SEEKABLE_MAGIC 0x8F92EAB1
+#define ZSTD_SEEKABLE_FOOTER_SIZE 9
+#define ARCHIVE_INDEX_MAGIC 0x184D2A50
+#define ARCHIVE_INDEX_TAG "MPmd"
+#define ARCHIVE_INDEX_SIZE 16
+
+typedef enum {
+    COMPRESSION_NONE, COMPRESSION_GZIP, COMPRESSION_BZIP2, COMPRESSION_XZ,
+    COMPRESSION_ZSTD
+} archive_compression;
+
+typedef struct {
+    int fd;
+    archive_compression compression;
+    /* compressed input, and for uncompressed archives the first bytes read
+     * while looking for a magic number */
+    unsigned char* in;
+    size_t in_len;
+    size_t in_pos;
+    int in_eof;
+    /* set while the decoder is in the middle of a stream, so that running
+     * out of input there can be reported as a truncated archive */
+    int in_stream;
+    /* if set, no more than in_left bytes of input are read */
+    int in_limited;
+    off_t in_left;
+    unsigned char* out;
+    size_t out_len;
+    size_t out_pos;
+    /* errno of the failed read, or 0 with message set for a corrupt or
+     * unsupported archive */
+    int error;
+    const char* message;
+#if HAVE_LIBZ
+    z_stream z;
+    int z_init;
+#endif
+#if HAVE_LIBBZ2
+    bz_stream bz;
+    int bz_init;
+#endif
+#if HAVE_LIBLZMA
+    lzma_stream lz;
+    int lz_init;
+#endif
+#if HAVE_LIBZSTD
+    ZSTD_DStream* zstd;
+#endif
+} archive_reader;
+
+/* a member of a tar archive */
+typedef struct {
+    /* absolute, normalised path and link target, or NULL */
+    char* path;
+    char* linkpath;
+    char type;
+    mode_t mode;
+    Tcl_WideInt uid;
+    Tcl_WideInt gid;
+    char uname[33];
+    char gname[33];
+    Tcl_WideInt size;
+    Tcl_WideInt mtime;
+} tar_entry;
+
+/* values of a pax extended header or GNU long name overriding the next
+ * header's */
+typedef struct {
+    char* path;
+    char* linkpath;
+    int has_size;
+    Tcl_WideInt size;
+    int has_mtime;
+    Tcl_WideInt mtime;
+    int has_uid;
+    Tcl_WideInt uid;
+    int has_gid;
+    Tcl_WideInt gid;
+    char* uname;
+    char* gname;
+} tar_overrides;
+
+/* a member requested with -files, or a directory leading to one */
+typedef struct {
+    char* dest;
+    int requested;
+    int seen;
+} extract_item;
+
+/* a directory whose mode and times are set once everything in it has been
+ * extracted, like tar does, so that creating its contents neither fails on a
+ * read-only directory nor changes its modification time */
+typedef struct {
+    char* path;
+    mode_t mode;
+    Tcl_WideInt mtime;
+} deferred_dir;
+
+/* device and inode of a file created during this extraction */
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+} inode_key;
+
+typedef struct {
+    Tcl_Interp* interp;
+    archive_reader* reader;
+    const char* directory;
+    /* extract_item by path, only used with -files */
+    int filtered;
+    Tcl_HashTable items;
+    /* destination by path for -rename without -files */
+    Tcl_HashTable renames;
+    /* directories created on the way to a member, which get their
+     * attributes when their own member comes */
+    Tcl_HashTable implied;
+    /* files created by this extraction, by inode_key */
+    Tcl_HashTable inodes;
+    /* number of symbolic links created, which no member is extracted
+     * through */
+    int symlinks;
+    deferred_dir* dirs;
+    size_t dirs_count;
+    size_t dirs_size;
+    Tcl_Obj* created;
+    int root;
+    /* last looked up owner and group names */
+    char uname[33];
+    uid_t uname_uid;
+    char gname[33];
+    gid_t gname_gid;
+} extract_state;
+
+/* ------------------------------------------------------------------------ */
+/* Decompression */
+
+/**
+ * Reads more compressed input if all of it has been consumed.
+ *
+ * @return 1 if there is input, 0 at the end of the file, -1 on error
+ */
+static int reader_fill(archive_reader* r) {
+    size_t wanted = ARCHIVE_BUFFER_SIZE;
+    ssize_t count;
+
+    if (r->in_pos < r->in_len) {
+        return 1;
+    }
+    if (r->in_eof) {
+        return 0;
+    }
+    if (r->in_limited && (off_t)wanted > r->in_left) {
+        wanted = (size_t)r->in_left;
+    }
+    do {
+        count = wanted > 0 ? read(r->fd, r->in, wanted) : 0;
+    } while (count < 0 && errno == EINTR);
+    if (count < 0) {
+        r->error = errno;
+        return -1;
+    }
+    r->in_len = (size_t)count;
+    r->in_pos = 0;
+    if (r->in_limited) {
+        r->in_left -= count;
+    }
+    if (count == 0) {
+        r->in_eof = 1;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Decompresses the next chunk of the archive into the output buffer.
+ *
+ * @return the number of bytes now in the buffer, 0 at the end of the archive,
+ *         -1 on error
+ */
+static ssize_t reader_refill(archive_reader* r) {
+    r->out_pos = 0;
+    r->out_len = 0;
+    for (;;) {
+        int more = reader_fill(r);
+        size_t avail;
+        if (more < 0) {
+            return -1;
+        }
+        if (more == 0 && r->compression != COMPRESSION_XZ) {
+            if (r->in_stream) {
+                r->message = "archive is truncated";
+                return -1;
+            }
+            return 0;
+        }
+        avail = r->in_len - r->in_pos;
+        switch (r->compression) {
+            case COMPRESSION_NONE:
+                memcpy(r->out, r->in + r->in_pos, avail);
+                r->in_pos += avail;
+                r->out_len = avail;
+                break;
+#if HAVE_LIBZ
+            case COMPRESSION_GZIP: {
+                int ret;
+                r->z.next_in = r->in + r->in_pos;
+                r->z.avail_in = (uInt)avail;
+                r->z.next_out = r->out;
+                r->z.avail_out = ARCHIVE_BUFFER_SIZE;
+                ret = inflate(&r->z, Z_NO_FLUSH);
+                r->in_pos = r->in_len - r->z.avail_in;
+                r->out_len = ARCHIVE_BUFFER_SIZE - r->z.avail_out;
+                if (ret == Z_STREAM_END) {
+                    /* gzip files may be concatenated */
+                    inflateReset(&r->z);
+                    r->in_stream = 0;
+                } else if (ret == Z_OK || ret == Z_BUF_ERROR) {
+                    r->in_stream = 1;
+                } else {
+                    r->message = "gzip data is corrupt";
+                    return -1;
+                }
+                break;
+            }
+#endif
+#if HAVE_LIBBZ2
+            case COMPRESSION_BZIP2: {
+                int ret;
+                r->bz.next_in = (char*)r->in + r->in_pos;
+                r->bz.avail_in = (unsigned int)avail;
+                r->bz.next_out = (char*)r->out;
+                r->bz.avail_out = ARCHIVE_BUFFER_SIZE;
+                ret = BZ2_bzDecompress(&r->bz);
+                r->in_pos = r->in_len - r->bz.avail_in;
+                r->out_len = ARCHIVE_BUFFER_SIZE - r->bz.avail_out;
+                if (ret == BZ_STREAM_END) {
+                    /* lbzip2 and pbzip2 write one stream per block */
+                    BZ2_bzDecompressEnd(&r->bz);
+                    if (BZ2_bzDecompressInit(&r->bz, 0, 0) != BZ_OK) {
+                        r->bz_init = 0;
+                        r->message = "could not initialize bzip2";
+                        return -1;
+                    }
+                    r->in_stream = 0;
+                } else if (ret == BZ_OK) {
+                    r->in_stream = 1;
+                } else {
+                    r->message = "bzip2 data is corrupt";
+                    return -1;
+                }
+                break;
+            }
+#endif
+#if HAVE_LIBLZMA
+            case COMPRESSION_XZ: {
+                lzma_ret ret;
+                r->lz.next_in = r->in + r->in_pos;
+                r->lz.avail_in = avail;
+                r->lz.next_out = r->out;
+                r->lz.avail_out = ARCHIVE_BUFFER_SIZE;
+                /* concatenated streams are only known to be complete once
+                 * the decoder is told there is no more input */
+                ret = lzma_code(&r->lz, more ? LZMA_RUN : LZMA_FINISH);
+                r->in_pos = r->in_len - r->lz.avail_in;
+                r->out_len = ARCHIVE_BUFFER_SIZE - r->lz.avail_out;
+                if (ret == LZMA_STREAM_END) {
+                    if (r->out_len == 0) {
+                        return 0;
+                    }
+                } else if (ret != LZMA_OK) {
+                    r->message = ret == LZMA_BUF_ERROR
+                        ? "archive is truncated" : "xz data is corrupt";
+                    return -1;
+                }
+                break;
+            }
+#endif
+#if HAVE_LIBZSTD
+            case COMPRESSION_ZSTD: {
+                ZSTD_inBuffer input = { r->in + r->in_pos, avail, 0 };
+                ZSTD_outBuffer output = { r->out, ARCHIVE_BUFFER_SIZE, 0 };
+                size_t ret = ZSTD_decompressStream(r->zstd, &output, &input);
+                if (ZSTD_isError(ret)) {
+                    r->message = "zstd data is corrupt";
+                    return -1;
+                }
+                r->in_pos += input.pos;
+                r->out_len = output.pos;
+                /* 0 means a frame was completely decoded and flushed */
+                r->in_stream = ret != 0;
+                break;
+            }
+#endif
+            default:
+                r->message = "unsupported compression";
+                return -1;
+        }
+        if (r->out_len > 0) {
+            return (ssize_t)r->out_len;
+        }
+    }
+}
+
+/**
+ * Gives access to up to len bytes of the decompressed archive, which stay
+ * valid until the next call on r.
+ *
+ * @return the number of bytes available at *data, 0 at the end of the
+ *         archive, -1 on error
+ */
+static ssize_t reader_next(archive_reader* r, const unsigned char** data,
+        size_t len) {
+    size_t avail;
+
+    if (r->out_pos == r->out_len) {
+        ssize_t count = reader_refill(r);
+        if (count <= 0) {
+            return count;
+        }
+    }
+    avail = r->out_len - r->out_pos;
+    if (avail > len) {
+        avail = len;
+    }
+    *data = r->out + r->out_pos;
+    r->out_pos += avail;
+    return (ssize_t)avail;
+}
+
+/**
+ * Reads exactly len bytes into buf, or skips them if buf is NULL.
+ *
+ * @return 1 on success, 0 if the archive ended before the first byte, -1 on
+ *         error, including the archive ending after it
+ */
+static int reader_read(archive_reader* r, void* buf, size_t len) {
+    unsigned char* p = buf;
+    size_t wanted = len;
+
+    while (len > 0) {
+        const unsigned char* data;
+        ssize_t count = reader_next(r, &data, len);
+        if (count == 0 && len != wanted) {
+            r->message = "archive is truncated";
+            return -1;
+        }
+        if (count <= 0) {
+            return (int)count;
+        }
+        if (p != NULL) {
+            memcpy(p, data, (size_t)count);
+            p += count;
+        }
+        len -= (size_t)count;
+    }
+    return 1;
+}
+
+static void reader_close(archive_reader* r) {
+#if HAVE_LIBZ
+    if (r->z_init) {
+        inflateEnd(&r->z);
+    }
+#endif
+#if HAVE_LIBBZ2
+    if (r->bz_init) {
+        BZ2_bzDecompressEnd(&r->bz);
+    }
+#endif
+#if HAVE_LIBLZMA
+    if (r->lz_init) {
+        lzma_end(&r->lz);
+    }
+#endif
+#if HAVE_LIBZSTD
+    if (r->zstd != NULL) {
+        ZSTD_freeDStream(r->zstd);
+    }
+#endif
+    if (r->fd != -1) {
+        close(r->fd);
+    }
+    free(r->in);
+    free(r->out);
+}
+
+/**
+ * Opens an archive, recognising its compression from its first bytes
+ * rather than from its name. If limit is positive, only that many bytes
+ * from the start of the file are read.
+ *
+ * @return 1 on success, 0 on error with r->error or r->message set
+ */
+static int reader_open(archive_reader* r, const char* path, off_t limit) {
+    static const unsigned char xz_magic[] = { 0xfd, '7', 'z', 'X', 'Z', 0 };
+    static const unsigned char zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+    const unsigned char* magic;
+    size_t len;
+
+    memset(r, 0, sizeof(*r));
+    r->in_limited = limit > 0;
+    r->in_left = limit;
+    r->fd = open(path, O_RDONLY | O_CLOEXEC);
+    r->in = malloc(ARCHIVE_BUFFER_SIZE);
+    r->out = malloc(ARCHIVE_BUFFER_SIZE);
+    if (r->fd == -1 || r->in == NULL || r->out == NULL) {
+        r->error = r->fd == -1 ? errno : ENOMEM;
+        return 0;
+    }
+    if (reader_fill(r) < 0) {
+        return 0;
+    }
+
+    magic = r->in;
+    len = r->in_len;
+    if (len >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        r->compression = COMPRESSION_GZIP;
+    } else if (len >= 3 && memcmp(magic, "BZh", 3) == 0) {
+        r->compression = COMPRESSION_BZIP2;
+    } else if ((len >= sizeof(xz_magic)
+                && memcmp(magic, xz_magic, sizeof(xz_magic)) == 0)
+            /* lzma_alone, as written by lzma(1), has no real magic number
+             * but always starts with these properties */
+            || (len >= 3 && magic[0] == 0x5d && magic[1] == 0
+                && magic[2] == 0)) {
+        r->compression = COMPRESSION_XZ;
+    } else if (len >= sizeof(zstd_magic)
+            && memcmp(magic, zstd_magic, sizeof(zstd_magic)) == 0) {
+        r->compression = COMPRESSION_ZSTD;
+    } else {
+        r->compression = COMPRESSION_NONE;
+    }
+
+    switch (r->compression) {
+        case COMPRESSION_NONE:
+            return 1;
+#if HAVE_LIBZ
+        case COMPRESSION_GZIP:
+            if (inflateInit2(&r->z, 15 + 16) == Z_OK) {
+                r->z_init = 1;
+                return 1;
+            }
+            break;
+#endif
+#if HAVE_LIBBZ2
+        case COMPRESSION_BZIP2:
+            if (BZ2_bzDecompressInit(&r->bz, 0, 0) == BZ_OK) {
+                r->bz_init = 1;
+                return 1;
+            }
+            break;
+#endif
+#if HAVE_LIBLZMA
+        case COMPRESSION_XZ: {
+            lzma_stream init = LZMA_STREAM_INIT;
+            r->lz = init;
+            if (lzma_auto_decoder(&r->lz, UINT64_MAX, LZMA_CONCATENATED)
+                    == LZMA_OK) {
+                r->lz_init = 1;
+                return 1;
+            }
+            break;
+        }
+#endif
+#if HAVE_LIBZSTD
+        case COMPRESSION_ZSTD:
+            r->zstd = ZSTD_createDStream();
+            if (r->zstd != NULL && !ZSTD_isError(ZSTD_initDStream(r->zstd))) {
+                return 1;
+            }
+            break;
+#endif
+        default:
+            r->message = "unsupported compression";
+            return 0;
+    }
+    r->message = "could not initialize decompression";
+    return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Tar */
+
+/**
+ * Parses a numeric header field, either octal or, as written by GNU tar for
+ * values that don't fit, base-256.
+ */
+static Tcl_WideInt tar_number(const unsigned char* field, size_t len) {
+    Tcl_WideInt value = 0;
+    size_t i = 0;
+
+    if (len > 0 && (field[0] & 0x80)) {
+        value = field[0] & 0x3f;
+        for (i = 1; i < len; i++) {
+            value = (value << 8) | field[i];
+        }
+        return (field[0] & 0x40) ? -value : value;
+    }
+    while (i < len && (field[i] == ' ' || field[i] == '\0')) {
+        i++;
+    }
+    for (; i < len && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = (value << 3) | (field[i] - '0');
+    }
+    return value;
+}
+
+static char* tar_strndup(const char* s, size_t len) {
+    size_t n = 0;
+    char* copy;
+
+    while (n < len && s[n] != '\0') {
+        n++;
+    }
+    copy = ckalloc(n + 1);
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+/**
+ * Turns a member name into the absolute path it is installed at: leading
+ * ./ and / are dropped, as are trailing slashes, and names leading out of
+ * the archive are refused.
+ *
+ * @return the path, or NULL if the name is unsafe; an empty name gives "/"
+ */
+static char* tar_normalize(const char* name) {
+    size_t len;
+    const char* p;
+    char* path;
+
+    for (;;) {
+        if (name[0] == '/') {
+            name++;
+        } else if (name[0] == '.' && name[1] == '/') {
+            name += 2;
+        } else if (name[0] == '.' && name[1] == '\0') {
+            name++;
+        } else {
+            break;
+        }
+    }
+    len = strlen(name);
+    while (len > 0 && name[len - 1] == '/') {
+        len--;
+    }
+    for (p = name; p < name + len; ) {
+        const char* end = memchr(p, '/', (size_t)(name + len - p));
+        size_t component = (end ? (size_t)(end - p) : (size_t)(name + len - p));
+        if (component == 2 && p[0] == '.' && p[1] == '.') {
+            return NULL;
+        }
+        p += component + 1;
+    }
+    path = ckalloc(len + 2);
+    path[0] = '/';
+    memcpy(path + 1, name, len);
+    path[len + 1] = '\0';
+    return path;
+}
+
+static void tar_overrides_free(tar_overrides* o) {
+    ckfree(o->path);
+    ckfree(o->linkpath);
+    ckfree(o->uname);
+    ckfree(o->gname);
+    memset(o, 0, sizeof(*o));
+}
+
+static void tar_entry_free(tar_entry* e) {
+    ckfree(e->path);
+    ckfree(e->linkpath);
+    e->path = NULL;
+    e->linkpath = NULL;
+}
+
+/**
+ * Parses the records of a pax extended header, "length key=value\n".
+ */
+static int tar_parse_pax(const char* data, size_t len, tar_overrides* o) {
+    const char* p = data;
+
+    while (p < data + len) {
+        const char* record = p;
+        const char* key;
+        const char* eq;
+        const char* value;
+        size_t record_len = 0;
+        size_t value_len;
+        char** string = NULL;
+
+        while (p < data + len && *p >= '0' && *p <= '9') {
+            record_len = record_len * 10 + (size_t)(*p++ - '0');
+        }
+        if (p >= data + len || *p != ' ' || record_len == 0
+                || record_len > (size_t)(data + len - record)) {
+            return 0;
+        }
+        key = p + 1;
+        p = record + record_len;
+        if (p[-1] != '\n') {
+            return 0;
+        }
+        eq = memchr(key, '=', (size_t)(p - key));
+        if (eq == NULL) {
+            return 0;
+        }
+        value = eq + 1;
+        value_len = (size_t)(p - 1 - value);
+
+#define PAX_KEY(name) \
+        ((size_t)(eq - key) == sizeof(name) - 1 \
+         && memcmp(key, name, sizeof(name) - 1) == 0)
+        if (PAX_KEY("path")) {
+            string = &o->path;
+        } else if (PAX_KEY("linkpath")) {
+            string = &o->linkpath;
+        } else if (PAX_KEY("uname")) {
+            string = &o->uname;
+        } else if (PAX_KEY("gname")) {
+            string = &o->gname;
+        } else if (PAX_KEY("size") || PAX_KEY("mtime") || PAX_KEY("uid")
+                || PAX_KEY("gid")) {
+            char number[32];
+            Tcl_WideInt n;
+            if (value_len >= sizeof(number)) {
+                return 0;
+            }
+            memcpy(number, value, value_len);
+            number[value_len] = '\0';
+            /* mtime may have a fractional part, which is ignored */
+            n = strtoll(number, NULL, 10);
+            if (PAX_KEY("size")) {
+                o->has_size = 1;
+                o->size = n;
+            } else if (PAX_KEY("mtime")) {
+                o->has_mtime = 1;
+                o->mtime = n;
+            } else if (PAX_KEY("uid")) {
+                o->has_uid = 1;
+                o->uid = n;
+            } else {
+                o->has_gid = 1;
+                o->gid = n;
+            }
+        }
+#undef PAX_KEY
+        if (string != NULL) {
+            ckfree(*string);
+            *string = tar_strndup(value, value_len);
+        }
+    }
+    return 1;
+}
+
+/**
+ * Reads the data of an extension header into a NUL-terminated buffer.
+ */
+static char* tar_read_extension(archive_reader* r, Tcl_WideInt size) {
+    size_t padded;
+    char* data;
+
+    if (size < 0 || size > TAR_MAX_EXTENSION) {
+        r->message = "extended header is too large";
+        return NULL;
+    }
+    padded = ((size_t)size + TAR_BLOCK_SIZE - 1) & ~(size_t)(TAR_BLOCK_SIZE - 1);
+    data = ckalloc(padded + 1);
+    if (reader_read(r, data, padded) != 1) {
+        if (r->error == 0 && r->message == NULL) {
+            r->message = "archive is truncated";
+        }
+        ckfree(data);
+        return NULL;
+    }
+    data[size] = '\0';
+    return data;
+}
+
+/**
+ * Reads the header of the next member, handling the pax and GNU extensions
+ * carrying long names and large values on the way. The member's data, if
+ * any, is next in the stream.
+ *
+ * @return 1 for a member, 0 at the end of the archive, -1 on error
+ */
+static int tar_next(archive_reader* r, tar_entry* e) {
+    tar_overrides o;
+    unsigned char header[TAR_BLOCK_SIZE];
+
+    memset(&o, 0, sizeof(o));
+    for (;;) {
+        unsigned int sum = 0;
+        int i;
+        int ret = reader_read(r, header, sizeof(header));
+        char name[256 + 1];
+        char* data;
+
+        if (ret < 0) {
+            tar_overrides_free(&o);
+            return -1;
+        }
+        if (ret == 0) {
+            /* a missing end of archive marker is tolerated like tar does */
+            tar_overrides_free(&o);
+            return 0;
+        }
+        for (i = 0; i < TAR_BLOCK_SIZE; i++) {
+            sum += header[i];
+        }
+        if (sum == 0) {
+            /* end of archive, there's a second zero block we don't need */
+            tar_overrides_free(&o);
+            return 0;
+        }
+        /* the checksum is computed with its own field filled with spaces */
+        for (i = 148; i < 156; i++) {
+            sum -= header[i];
+            sum += ' ';
+        }
+        if (sum != (unsigned int)tar_number(header + 148, 8)) {
+            r->message = "not a tar archive, or header checksum mismatch";
+            tar_overrides_free(&o);
+            return -1;
+        }
+
+        e->type = (char)header[156];
+        e->size = tar_number(header + 124, 12);
+        switch (e->type) {
+            case 'x':
+            case 'g':
+            case 'L':
+            case 'K':
+                data = tar_read_extension(r, e->size);
+                if (data == NULL) {
+                    tar_overrides_free(&o);
+                    return -1;
+                }
+                if (e->type == 'x') {
+                    if (!tar_parse_pax(data, (size_t)e->size, &o)) {
+                        r->message = "pax extended header is corrupt";
+                        ckfree(data);
+                        tar_overrides_free(&o);
+                        return -1;
+                    }
+                } else if (e->type == 'L') {
+                    ckfree(o.path);
+                    o.path = tar_strndup(data, (size_t)e->size);
+                } else if (e->type == 'K') {
+                    ckfree(o.linkpath);
+                    o.linkpath = tar_strndup(data, (size_t)e->size);
+                }
+                /* global pax headers carry nothing we use */
+                ckfree(data);
+                continue;
+        }
+
+        if (o.path != NULL) {
+            e->path = tar_normalize(o.path);
+        } else {
+            size_t len = 0;
+            /* POSIX ustar splits long names in a prefix and a name; GNU
+             * tar's "ustar  " uses that space for something else */
+            if (memcmp(header + 257, "ustar\0", 6) == 0
+                    && header[345] != '\0') {
+                char* prefix = tar_strndup((const char*)header + 345, 155);
+                len = strlen(prefix);
+                memcpy(name, prefix, len);
+                name[len++] = '/';
+                ckfree(prefix);
+            }
+            data = tar_strndup((const char*)header, 100);
+            memcpy(name + len, data, strlen(data) + 1);
+            ckfree(data);
+            e->path = tar_normalize(name);
+        }
+        if (e->path == NULL) {
+            r->message = "archive contains a path outside of it";
+            tar_overrides_free(&o);
+            return -1;
+        }
+        if (o.linkpath != NULL) {
+            e->linkpath = o.linkpath;
+            o.linkpath = NULL;
+        } else if (header[157] != '\0') {
+            e->linkpath = tar_strndup((const char*)header + 157, 100);
+        } else {
+            e->linkpath = NULL;
+        }
+        e->mode = (mode_t)tar_number(header + 100, 8);
+        e->uid = o.has_uid ? o.uid : tar_number(header + 108, 8);
+        e->gid = o.has_gid ? o.gid : tar_number(header + 116, 8);
+        if (o.has_size) {
+            e->size = o.size;
+        }
+        e->mtime = o.has_mtime ? o.mtime : tar_number(header + 136, 12);
+        if (o.uname != NULL) {
+            snprintf(e->uname, sizeof(e->uname), "%s", o.uname);
+        } else {
+            data = tar_strndup((const char*)header + 265, 32);
+            snprintf(e->uname, sizeof(e->uname), "%s", data);
+            ckfree(data);
+        }
+        if (o.gname != NULL) {
+            snprintf(e->gname, sizeof(e->gname), "%s", o.gname);
+        } else {
+            data = tar_strndup((const char*)header + 297, 32);
+            snprintf(e->gname, sizeof(e->gname), "%s", data);
+            ckfree(data);
+        }
+        /* links and directories never have data, whatever the size says */
+        if (e->type == '1' || e->type == '2' || e->type == '5') {
+            e->size = 0;
+        }
+        if (e->size < 0) {
+            r->message = "member has a negative size";
+            tar_entry_free(e);
+            tar_overrides_free(&o);
+            return -1;
+        }
+        tar_overrides_free(&o);
+        return 1;
+    }
+}
+
+/**
+ * Skips the data of the current member and its padding.
+ */
+static int tar_skip(archive_reader* r, Tcl_WideInt size) {
+    Tcl_WideInt padded = (size + TAR_BLOCK_SIZE - 1) & ~(Tcl_WideInt)(TAR_BLOCK_SIZE - 1);
+
+    while (padded > 0) {
+        const unsigned char* data;
+        ssize_t count = reader_next(r, &data,
+                padded > ARCHIVE_BUFFER_SIZE ? ARCHIVE_BUFFER_SIZE : (size_t)padded);
+        if (count <= 0) {
+            if (count == 0) {
+                r->message = "archive is truncated";
+            }
+            return 0;
+        }
+        padded -= count;
+    }
+    return 1;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Extraction */
+
+static void extract_error(extract_state* s, const char* path, int error) {
+    Tcl_ResetResult(s->interp);
+    Tcl_AppendResult(s->interp, path, ": ", strerror(error), NULL);
+}
+
+static void extract_archive_error(extract_state* s, const char* archive) {
+    Tcl_ResetResult(s->interp);
+    if (s->reader->error != 0) {
+        Tcl_AppendResult(s->interp, "Could not read archive: ", archive, ": ",
+                strerror(s->reader->error), NULL);
+    } else {
+        Tcl_AppendResult(s->interp, "Could not read archive: ", archive, ": ",
+                s->reader->message ? s->reader->message : "unknown error",
+                NULL);
+    }
+}
+
+static uid_t extract_uid(extract_state* s, const tar_entry* e) {
+    if (e->uname[0] != '\0') {
+        if (strcmp(e->uname, s->uname) != 0) {
+            struct passwd* pw = getpwnam(e->uname);
+            if (pw == NULL) {
+                return (uid_t)e->uid;
+            }
+            snprintf(s->uname, sizeof(s->uname), "%s", e->uname);
+            s->uname_uid = pw->pw_uid;
+        }
+        return s->uname_uid;
+    }
+    return (uid_t)e->uid;
+}
+
+static gid_t extract_gid(extract_state* s, const tar_entry* e) {
+    if (e->gname[0] != '\0') {
+        if (strcmp(e->gname, s->gname) != 0) {
+            struct group* gr = getgrnam(e->gname);
+            if (gr == NULL) {
+                return (gid_t)e->gid;
+            }
+            snprintf(s->gname, sizeof(s->gname), "%s", e->gname);
+            s->gname_gid = gr->gr_gid;
+        }
+        return s->gname_gid;
+    }
+    return (gid_t)e->gid;
+}
+
+static void extract_times(const tar_entry* e, struct timeval times[2]) {
+    gettimeofday(&times[0], NULL);
+    times[1].tv_sec = (time_t)e->mtime;
+    times[1].tv_usec = 0;
+}
+
+static void extract_remember(extract_state* s, const struct stat* st) {
+    inode_key key;
+    int is_new;
+
+    memset(&key, 0, sizeof(key));
+    key.dev = st->st_dev;
+    key.ino = st->st_ino;
+    Tcl_CreateHashEntry(&s->inodes, (const char*)&key, &is_new);
+}
+
+/**
+ * Decides what to do when the destination of a member already exists. On
+ * case-insensitive file systems two members differing only in case end up
+ * at the same place; the first one wins, as it did when images were
+ * extracted to a temporary directory first.
+ *
+ * @return 1 to skip the member, 0 after setting an error
+ */
+static int extract_exists(extract_state* s, const char* dest) {
+    struct stat st;
+    inode_key key;
+
+    if (lstat(dest, &st) == 0) {
+        memset(&key, 0, sizeof(key));
+        key.dev = st.st_dev;
+        key.ino = st.st_ino;
+        if (Tcl_FindHashEntry(&s->inodes, (const char*)&key) != NULL) {
+            return 1;
+        }
+    }
+    Tcl_ResetResult(s->interp);
+    Tcl_AppendResult(s->interp, "Could not extract ", dest,
+            ": file already exists", NULL);
+    return 0;
+}
+
+/**
+ * Refuses dest if one of its parents is a symbolic link the archive
+ * created, so that a member like a/x following a link a -> /etc can't write
+ * outside of the directory the archive is extracted to. Parents are looked
+ * up on disk and compared by device and inode, as on a case-insensitive
+ * file system A/x goes through a link a as well.
+ *
+ * @return 1 if dest is beneath such a link, after setting an error
+ */
+static int extract_through_symlink(extract_state* s, const char* dest) {
+    struct stat st;
+    inode_key key;
+    char* path;
+    char* slash;
+    int found = 0;
+
+    if (s->symlinks == 0) {
+        return 0;
+    }
+    path = ckalloc(strlen(dest) + 1);
+    strcpy(path, dest);
+    while (!found && (slash = strrchr(path, '/')) != NULL && slash != path) {
+        *slash = '\0';
+        if (lstat(path, &st) != 0 || !S_ISLNK(st.st_mode)) {
+            continue;
+        }
+        memset(&key, 0, sizeof(key));
+        key.dev = st.st_dev;
+        key.ino = st.st_ino;
+        found = Tcl_FindHashEntry(&s->inodes, (const char*)&key) != NULL;
+    }
+    if (found) {
+        Tcl_ResetResult(s->interp);
+        Tcl_AppendResult(s->interp, "Could not extract ", dest,
+                ": ", path, " is a symbolic link", NULL);
+    }
+    ckfree(path);
+    return found;
+}
+
+/**
+ * Creates the missing parent directories of dest, like mkdir -p.
+ */
+static int extract_parents(extract_state* s, const char* dest) {
+    char* path = ckalloc(strlen(dest) + 1);
+    char* slash;
+    int result = 1;
+
+    strcpy(path, dest);
+    slash = strrchr(path, '/');
+    if (slash == NULL || slash == path) {
+        ckfree(path);
+        return 1;
+    }
+    *slash = '\0';
+    if (mkdir(path, 0777) == 0) {
+        int is_new;
+        Tcl_CreateHashEntry(&s->implied, path, &is_new);
+    } else if (errno == ENOENT) {
+        if (extract_parents(s, path) && mkdir(path, 0777) == 0) {
+            int is_new;
+            Tcl_CreateHashEntry(&s->implied, path, &is_new);
+        } else if (errno != EEXIST) {
+            extract_error(s, path, errno);
+            result = 0;
+        }
+    } else if (errno != EEXIST) {
+        extract_error(s, path, errno);
+        result = 0;
+    }
+    ckfree(path);
+    return result;
+}
+
+static int extract_directory(extract_state* s, const tar_entry* e,
+        const char* dest) {
+    struct stat st;
+    deferred_dir* dir;
+    Tcl_HashEntry* implied;
+
+    if (extract_through_symlink(s, dest)) {
+        return 0;
+    }
+    if (stat(dest, &st) == 0) {
+        if (!S_ISDIR(st.st_mode)) {
+            Tcl_ResetResult(s->interp);
+            Tcl_AppendResult(s->interp, "Could not extract ", dest,
+                    ": file already exists", NULL);
+            return 0;
+        }
+        /* existing directories are left alone, except the ones created on
+         * the way to an earlier member */
+        implied = Tcl_FindHashEntry(&s->implied, dest);
+        if (implied == NULL) {
+            return 1;
+        }
+        Tcl_DeleteHashEntry(implied);
+    } else if (errno != ENOENT) {
+        extract_error(s, dest, errno);
+        return 0;
+    } else if (mkdir(dest, 0700) != 0) {
+        if (errno != ENOENT) {
+            extract_error(s, dest, errno);
+            return 0;
+        }
+        if (!extract_parents(s, dest)) {
+            return 0;
+        }
+        if (mkdir(dest, 0700) != 0) {
+            extract_error(s, dest, errno);
+            return 0;
+        }
+    }
+
+    if (s->root && chown(dest, extract_uid(s, e), extract_gid(s, e)) != 0) {
+        extract_error(s, dest, errno);
+        return 0;
+    }
+    if (s->dirs_count == s->dirs_size) {
+        s->dirs_size = s->dirs_size ? 2 * s->dirs_size : 64;
+        s->dirs = (deferred_dir*)ckrealloc((char*)s->dirs,
+                s->dirs_size * sizeof(*s->dirs));
+    }
+    dir = &s->dirs[s->dirs_count++];
+    dir->path = ckalloc(strlen(dest) + 1);
+    strcpy(dir->path, dest);
+    dir->mode = e->mode & 07777;
+    dir->mtime = e->mtime;
+    return 1;
+}
+
+/**
+ * Sets the mode and times of the extracted directories, deepest last
+ * created first.
+ */
+static int extract_finish_directories(extract_state* s) {
+    while (s->dirs_count > 0) {
+        deferred_dir* dir = &s->dirs[--s->dirs_count];
+        struct timeval times[2];
+        int ok;
+
+        gettimeofday(&times[0], NULL);
+        times[1].tv_sec = (time_t)dir->mtime;
+        times[1].tv_usec = 0;
+        ok = chmod(dir->path, dir->mode) == 0 && utimes(dir->path, times) == 0;
+        if (!ok) {
+            extract_error(s, dir->path, errno);
+        }
+        ckfree(dir->path);
+        if (!ok) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Creates dest with create, which returns -1 and sets errno on failure,
+ * creating missing parent directories and checking for members that
+ * collide on case-insensitive file systems.
+ *
+ * @return 1 if created, 2 if skipped, 0 on error
+ */
+static int extract_create(extract_state* s, const char* dest,
+        int (*create)(const tar_entry*, const char*, void*),
+        const tar_entry* e, void* data) {
+    if (extract_through_symlink(s, dest)) {
+        return 0;
+    }
+    if (create(e, dest, data) == 0) {
+        return 1;
+    }
+    if (errno == ENOENT) {
+        if (!extract_parents(s, dest)) {
+            return 0;
+        }
+        if (create(e, dest, data) == 0) {
+            return 1;
+        }
+    }
+    if (errno == EEXIST) {
+        return extract_exists(s, dest) ? 2 : 0;
+    }
+    extract_error(s, dest, errno);
+    return 0;
+}
+
+static int create_file(const tar_entry* e UNUSED, const char* dest,
+        void* data) {
+    int fd = open(dest, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+            0600);
+    *(int*)data = fd;
+    return fd == -1 ? -1 : 0;
+}
+
+static int create_symlink(const tar_entry* e, const char* dest,
+        void* data UNUSED) {
+    return symlink(e->linkpath, dest);
+}
+
+static int create_link(const tar_entry* e UNUSED, const char* dest,
+        void* data) {
+    return link((const char*)data, dest);
+}
+
+static int extract_file(extract_state* s, const tar_entry* e,
+        const char* dest) {
+    struct timeval times[2];
+    struct stat st;
+    Tcl_WideInt remaining = e->size;
+    int fd = -1;
+    int created = extract_create(s, dest, create_file, e, &fd);
+
+    if (created == 2) {
+        return tar_skip(s->reader, e->size) ? 1 : -1;
+    }
+    if (created != 1) {
+        return 0;
+    }
+    Tcl_ListObjAppendElement(NULL, s->created, Tcl_NewStringObj(dest, -1));
+
+    while (remaining > 0) {
+        const unsigned char* data;
+        ssize_t count = reader_next(s->reader, &data,
+                remaining > ARCHIVE_BUFFER_SIZE ? ARCHIVE_BUFFER_SIZE : (size_t)remaining);
+        if (count <= 0) {
+            if (count == 0) {
+                s->reader->message = "archive is truncated";
+            }
+            close(fd);
+            return -1;
+        }
+        remaining -= count;
+        while (count > 0) {
+            ssize_t written = write(fd, data, (size_t)count);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                extract_error(s, dest, errno);
+                close(fd);
+                return 0;
+            }
+            data += written;
+            count -= written;
+        }
+    }
+    /* the padding up to the next header */
+    if (e->size % TAR_BLOCK_SIZE != 0
+            && reader_read(s->reader, NULL,
+                TAR_BLOCK_SIZE - (size_t)(e->size % TAR_BLOCK_SIZE)) != 1) {
+        if (s->reader->error == 0 && s->reader->message == NULL) {
+            s->reader->message = "archive is truncated";
+        }
+        close(fd);
+        return -1;
+    }
+
+    /* chown first, it clears the set-id bits */
+    if (s->root && fchown(fd, extract_uid(s, e), extract_gid(s, e)) != 0) {
+        extract_error(s, dest, errno);
+        close(fd);
+        return 0;
+    }
+    extract_times(e, times);
+    if (fchmod(fd, e->mode & 07777) != 0 || futimes(fd, times) != 0
+            || fstat(fd, &st) != 0) {
+        extract_error(s, dest, errno);
+        close(fd);
+        return 0;
+    }
+    extract_remember(s, &st);
+    if (close(fd) != 0) {
+        extract_error(s, dest, errno);
+        return 0;
+    }
+    return 1;
+}
+
+static int extract_symlink(extract_state* s, const tar_entry* e,
+        const char* dest) {
+    struct timeval times[2];
+    struct stat st;
+    int created;
+
+    if (e->linkpath == NULL) {
+        Tcl_ResetResult(s->interp);
+        Tcl_AppendResult(s->interp, "Could not extract ", dest,
+                ": symbolic link has no target", NULL);
+        return 0;
+    }
+    created = extract_create(s, dest, create_symlink, e, NULL);
+    if (created != 1) {
+        return created == 2;
+    }
+    Tcl_ListObjAppendElement(NULL, s->created, Tcl_NewStringObj(dest, -1));
+    if (s->root && lchown(dest, extract_uid(s, e), extract_gid(s, e)) != 0) {
+        extract_error(s, dest, errno);
+        return 0;
+    }
+    extract_times(e, times);
+    if (lutimes(dest, times) != 0 || lstat(dest, &st) != 0) {
+        extract_error(s, dest, errno);
+        return 0;
+    }
+    extract_remember(s, &st);
+    s->symlinks++;
+    return 1;
+}
+
+static int extract_link(extract_state* s, const tar_entry* e,
+        const char* dest) {
+    char* target = e->linkpath != NULL ? tar_normalize(e->linkpath) : NULL;
+    Tcl_DString target_dest;
+    int created = 0;
+
+    Tcl_DStringInit(&target_dest);
+    if (target == NULL) {
+        Tcl_ResetResult(s->interp);
+        Tcl_AppendResult(s->interp, "Could not extract ", dest,
+                ": hard link has no valid target", NULL);
+    } else if (s->filtered) {
+        Tcl_HashEntry* entry = Tcl_FindHashEntry(&s->items, target);
+        extract_item* item = entry ? Tcl_GetHashValue(entry) : NULL;
+        if (item == NULL || !item->seen) {
+            Tcl_ResetResult(s->interp);
+            Tcl_AppendResult(s->interp, "Could not extract ", dest,
+                    ": hard link target ", target, " was not extracted", NULL);
+        } else {
+            Tcl_DStringAppend(&target_dest, item->dest, -1);
+            created = 1;
+        }
+    } else {
+        Tcl_HashEntry* entry = Tcl_FindHashEntry(&s->renames, target);
+        if (entry != NULL) {
+            Tcl_DStringAppend(&target_dest, s->directory, -1);
+            Tcl_DStringAppend(&target_dest, Tcl_GetHashValue(entry), -1);
+        } else {
+            Tcl_DStringAppend(&target_dest, s->directory, -1);
+            Tcl_DStringAppend(&target_dest, target, -1);
+        }
+        created = 1;
+    }
+    if (created && extract_through_symlink(s, Tcl_DStringValue(&target_dest))) {
+        created = 0;
+    }
+    if (created) {
+        created = extract_create(s, dest, create_link, e,
+                Tcl_DStringValue(&target_dest));
+        if (created == 1) {
+            Tcl_ListObjAppendElement(NULL, s->created,
+                    Tcl_NewStringObj(dest, -1));
+        }
+    }
+    Tcl_DStringFree(&target_dest);
+    ckfree(target);
+    return created != 0;
+}
+
+/**
+ * Adds a requested path, and the directories leading to it, to the members
+ * to extract.
+ */
+static void extract_request(extract_state* s, const char* path,
+        const char* dest) {
+    int is_new;
+    Tcl_HashEntry* entry = Tcl_CreateHashEntry(&s->items, path, &is_new);
+    extract_item* item;
+    char* parent;
+    char* slash;
+
+    if (is_new) {
+        item = (extract_item*)ckalloc(sizeof(*item));
+        item->seen = 0;
+        Tcl_SetHashValue(entry, item);
+    } else {
+        item = Tcl_GetHashValue(entry);
+        ckfree(item->dest);
+    }
+    item->requested = 1;
+    item->dest = ckalloc(strlen(s->directory) + strlen(dest) + 1);
+    strcpy(item->dest, s->directory);
+    strcat(item->dest, dest);
+
+    parent = ckalloc(strlen(path) + 1);
+    strcpy(parent, path);
+    while ((slash = strrchr(parent, '/')) != NULL && slash != parent) {
+        *slash = '\0';
+        entry = Tcl_CreateHashEntry(&s->items, parent, &is_new);
+        if (!is_new) {
+            break;
+        }
+        item = (extract_item*)ckalloc(sizeof(*item));
+        item->requested = 0;
+        item->seen = 0;
+        item->dest = ckalloc(strlen(s->directory) + strlen(parent) + 1);
+        strcpy(item->dest, s->directory);
+        strcat(item->dest, parent);
+        Tcl_SetHashValue(entry, item);
+    }
+    ckfree(parent);
+}
+
+/**
+ * archive extract subcommand
+ */
+static int ArchiveExtractCmd(Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    static const char* options[] = { "-files", "-rename", "-created", NULL };
+    enum { FILES, RENAME, CREATED } option;
+    const char* usage = "?-files paths? ?-rename list? ?-created varName? "
+        "path ?directory?";
+    Tcl_Obj* files = NULL;
+    Tcl_Obj* renames = NULL;
+    Tcl_Obj* created_var = NULL;
+    Tcl_Obj** listv;
+    int listc;
+    archive_reader reader;
+    extract_state s;
+    const char* archive;
+    int status = TCL_ERROR;
+    int i;
+
+    for (i = 2; i < objc - 1; i += 2) {
+        const char* arg = Tcl_GetString(objv[i]);
+        if (arg[0] != '-') {
+            break;
+        }
+        if (Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0,
+                    (int*)&option) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        switch (option) {
+            case FILES:
+                files = objv[i + 1];
+                break;
+            case RENAME:
+                renames = objv[i + 1];
+                break;
+            case CREATED:
+                created_var = objv[i + 1];
+                break;
+        }
+    }
+    if (i != objc - 1 && i != objc - 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, usage);
+        return TCL_ERROR;
+    }
+    archive = Tcl_GetString(objv[i]);
+
+    memset(&s, 0, sizeof(s));
+    s.interp = interp;
+    s.reader = &reader;
+    s.directory = i == objc - 2 ? Tcl_GetString(objv[i + 1]) : "";
+    /* "/" would give paths starting with two slashes */
+    if (strcmp(s.directory, "/") == 0) {
+        s.directory = "";
+    }
+    s.root = geteuid() == 0;
+    s.filtered = files != NULL;
+    Tcl_InitHashTable(&s.items, TCL_STRING_KEYS);
+    Tcl_InitHashTable(&s.renames, TCL_STRING_KEYS);
+    Tcl_InitHashTable(&s.implied, TCL_STRING_KEYS);
+    Tcl_InitHashTable(&s.inodes, sizeof(inode_key) / sizeof(int));
+    s.created = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(s.created);
+    memset(&reader, 0, sizeof(reader));
+    reader.fd = -1;
+
+    if (files != NULL) {
+        if (Tcl_ListObjGetElements(interp, files, &listc, &listv) != TCL_OK) {
+            goto cleanup;
+        }
+        for (i = 0; i < listc; i++) {
+            const char* path = Tcl_GetString(listv[i]);
+            extract_request(&s, path, path);
+        }
+    }
+    if (renames != NULL) {
+        if (Tcl_ListObjGetElements(interp, renames, &listc, &listv) != TCL_OK) {
+            goto cleanup;
+        }
+        if (listc % 2 != 0) {
+            Tcl_SetResult(interp, "rename list must have an even number of "
+                    "elements", TCL_STATIC);
+            goto cleanup;
+        }
+        for (i = 0; i < listc; i += 2) {
+            const char* path = Tcl_GetString(listv[i]);
+            const char* dest = Tcl_GetString(listv[i + 1]);
+            if (s.filtered) {
+                if (Tcl_FindHashEntry(&s.items, path) != NULL) {
+                    extract_request(&s, path, dest);
+                }
+            } else {
+                int is_new;
+                Tcl_HashEntry* entry = Tcl_CreateHashEntry(&s.renames, path,
+                        &is_new);
+                Tcl_SetHashValue(entry, (ClientData)dest);
+            }
+        }
+    }
+
+    if (!reader_open(&reader, archive, 0)) {
+        extract_archive_error(&s, archive);
+        goto cleanup;
+    }
+
+    for (;;) {
+        tar_entry e;
+        const char* dest;
+        Tcl_DString dest_buf;
+        extract_item* item = NULL;
+        int ok;
+        int ret;
+
+        /* let TclX deliver SIGINT and SIGTERM, so activation can be
+         * interrupted and rolled back */
+        if (Tcl_AsyncReady()) {
+            if (Tcl_AsyncInvoke(interp, TCL_OK) != TCL_OK) {
+                goto cleanup;
+            }
+        }
+
+        memset(&e, 0, sizeof(e));
+        ret = tar_next(&reader, &e);
+        if (ret == 0) {
+            break;
+        }
+        if (ret < 0) {
+            extract_archive_error(&s, archive);
+            goto cleanup;
+        }
+
+        Tcl_DStringInit(&dest_buf);
+        if (s.filtered) {
+            Tcl_HashEntry* entry = Tcl_FindHashEntry(&s.items, e.path);
+            item = entry ? Tcl_GetHashValue(entry) : NULL;
+            /* only directories are extracted on the way to requested
+             * members */
+            if (item == NULL || (!item->requested && e.type != '5')) {
+                ok = tar_skip(&reader, e.size);
+                tar_entry_free(&e);
+                if (!ok) {
+                    extract_archive_error(&s, archive);
+                    goto cleanup;
+                }
+                continue;
+            }
+            item->seen = 1;
+            dest = item->dest;
+        } else if (strcmp(e.path, "/") == 0) {
+            tar_entry_free(&e);
+            continue;
+        } else {
+            Tcl_HashEntry* entry = Tcl_FindHashEntry(&s.renames, e.path);
+            Tcl_DStringAppend(&dest_buf, s.directory, -1);
+            Tcl_DStringAppend(&dest_buf, entry ? Tcl_GetHashValue(entry)
+                    : e.path, -1);
+            dest = Tcl_DStringValue(&dest_buf);
+        }
+
+        Tcl_ResetResult(interp);
+        switch (e.type) {
+            case '0':
+            case '\0':
+            case '7':
+                ok = extract_file(&s, &e, dest);
+                break;
+            case '1':
+                ok = extract_link(&s, &e, dest);
+                break;
+            case '2':
+                ok = extract_symlink(&s, &e, dest);
+                break;
+            case '5':
+                ok = extract_directory(&s, &e, dest);
+                break;
+            default:
+                Tcl_AppendResult(interp, "Could not extract ", dest,
+                        ": unsupported type of archive member", NULL);
+                ok = 0;
+                break;
+        }
+        Tcl_DStringFree(&dest_buf);
+        tar_entry_free(&e);
+        if (ok < 0) {
+            extract_archive_error(&s, archive);
+            goto cleanup;
+        }
+        if (!ok) {
+            goto cleanup;
+        }
+    }
+
+    if (!extract_finish_directories(&s)) {
+        goto cleanup;
+    }
+    {
+        Tcl_Obj* missing = Tcl_NewListObj(0, NULL);
+        if (s.filtered) {
+            /* in the order they were given */
+            Tcl_ListObjGetElements(NULL, files, &listc, &listv);
+            for (i = 0; i < listc; i++) {
+                Tcl_HashEntry* entry = Tcl_FindHashEntry(&s.items,
+                        Tcl_GetString(listv[i]));
+                extract_item* item = Tcl_GetHashValue(entry);
+                if (!item->seen) {
+                    Tcl_ListObjAppendElement(NULL, missing, listv[i]);
+                    /* report duplicates once */
+                    item->seen = 1;
+                }
+            }
+        }
+        Tcl_SetObjResult(interp, missing);
+    }
+    status = TCL_OK;
+
+cleanup:
+    if (created_var != NULL) {
+        Tcl_ObjSetVar2(interp, created_var, NULL, s.created, 0);
+    }
+    Tcl_DecrRefCount(s.created);
+    reader_close(&reader);
+    {
+        Tcl_HashSearch search;
+        Tcl_HashEntry* entry;
+        for (entry = Tcl_FirstHashEntry(&s.items, &search); entry != NULL;
+                entry = Tcl_NextHashEntry(&search)) {
+            extract_item* item = Tcl_GetHashValue(entry);
+            ckfree(item->dest);
+            ckfree((char*)item);
+        }
+    }
+    Tcl_DeleteHashTable(&s.items);
+    Tcl_DeleteHashTable(&s.renames);
+    Tcl_DeleteHashTable(&s.implied);
+    Tcl_DeleteHashTable(&s.inodes);
+    /* directories of a failed extraction keep the mode they were created
+     * with, so that rolling back can remove what's in them */
+    for (i = 0; i < (int)s.dirs_count; i++) {
+        ckfree(s.dirs[i].path);
+    }
+    ckfree((char*)s.dirs);
+    return status;
+}
+
+static uint32_t get_le32(const unsigned char* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16
+        | (uint32_t)p[3] << 24;
+}
+
+/**
+ * Reads exactly len bytes at offset.
+ *
+ * @return 1 on success, 0 if the file is shorter, -1 on error
+ */
+static int read_at(int fd, unsigned char* buf, size_t len, off_t offset) {
+    while (len > 0) {
+        ssize_t count = pread(fd, buf, len, offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return (int)count;
+        }
+        buf += count;
+        len -= (size_t)count;
+        offset += count;
+    }
+    return 1;
+}
+
+/**
+ * Looks for the index of the metadata frames at the end of the archive at
+ * path, see the description of ARCHIVE_INDEX_MAGIC.
+ *
+ * @return the number of bytes at the start of the archive holding the
+ *         metadata members, or 0 if the archive has no index
+ */
+static off_t archive_metadata_length(const char* path) {
+    unsigned char footer[ZSTD_SEEKABLE_FOOTER_SIZE];
+    unsigned char index[ARCHIVE_INDEX_SIZE];
+    unsigned char* table = NULL;
+    const unsigned char* entry;
+    struct stat st;
+    size_t entry_size;
+    size_t frames;
+    size_t table_size;
+    size_t metadata_frames;
+    size_t i;
+    off_t length = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return 0;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(footer)
+            || read_at(fd, footer, sizeof(footer),
+                st.st_size - (off_t)sizeof(footer)) != 1
+            || get_le32(footer + 5) != ZSTD_SEEKABLE_MAGIC) {
+        goto cleanup;
+    }
+    /* entries have a checksum if the top bit of the descriptor is set */
+    entry_size = (footer[4] & 0x80) ? 12 : 8;
+    frames = get_le32(footer);
+    if (frames < 2 || (off_t)frames > st.st_size / (off_t)entry_size) {
+        goto cleanup;
+    }
+    table_size = 8 + frames * entry_size + sizeof(footer);
+    if ((off_t)(table_size + ARCHIVE_INDEX_SIZE) > st.st_size) {
+        goto cleanup;
+    }
+    table = malloc(table_size);
+    if (table == NULL
+            || read_at(fd, table, table_size,
+                st.st_size - (off_t)table_size) != 1
+            || get_le32(table) != ZSTD_SEEK_TABLE_MAGIC
+            || get_le32(table + 4) != table_size - 8) {
+        goto cleanup;
+    }
+
+    /* the index is the last frame before the seek table */
+    entry = table + 8 + (frames - 1) * entry_size;
+    if (get_le32(entry) != ARCHIVE_INDEX_SIZE || get_le32(entry + 4) != 0
+            || read_at(fd, index, sizeof(index), st.st_size
+                - (off_t)table_size - ARCHIVE_INDEX_SIZE) != 1
+            || get_le32(index) != ARCHIVE_INDEX_MAGIC
+            || get_le32(index + 4) != ARCHIVE_INDEX_SIZE - 8
+            || memcmp(index + 8, ARCHIVE_INDEX_TAG, 4) != 0) {
+        goto cleanup;
+    }
+    metadata_frames = get_le32(index + 12);
+    if (metadata_frames == 0 || metadata_frames >= frames) {
+        goto cleanup;
+    }
+    for (i = 0; i < metadata_frames; i++) {
+        length += get_le32(table + 8 + i * entry_size);
+    }
+
+cleanup:
+    free(table);
+    close(fd);
+    return length;
+}
+
+/**
+ * archive read subcommand
+ */
+static int ArchiveReadCmd(Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    archive_reader reader;
+    const char* archive;
+    char* member;
+    Tcl_DString contents;
+    off_t limit = 0;
+    int found = 0;
+    int status = TCL_ERROR;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "path member");
+        return TCL_ERROR;
+    }
+    archive = Tcl_GetString(objv[2]);
+    member = tar_normalize(Tcl_GetString(objv[3]));
+    if (member == NULL) {
+        Tcl_SetResult(interp, "invalid member name", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    Tcl_DStringInit(&contents);
+
+    /* members describing the port may be readable on their own */
+    if (member[1] == '+' && strchr(member + 1, '/') == NULL) {
+        limit = archive_metadata_length(archive);
+    }
+    if (!reader_open(&reader, archive, limit)) {
+        goto read_error;
+    }
+    while (!found) {
+        tar_entry e;
+        int ret;
+
+        memset(&e, 0, sizeof(e));
+        ret = tar_next(&reader, &e);
+        if (ret == 0) {
+            break;
+        }
+        if (ret < 0) {
+            goto read_error;
+        }
+        if (strcmp(e.path, member) == 0
+                && (e.type == '0' || e.type == '\0' || e.type == '7')) {
+            Tcl_DStringSetLength(&contents, (int)e.size);
+            if (reader_read(&reader, Tcl_DStringValue(&contents),
+                        (size_t)e.size) != 1) {
+                if (reader.error == 0 && reader.message == NULL) {
+                    reader.message = "archive is truncated";
+                }
+                tar_entry_free(&e);
+                goto read_error;
+            }
+            found = 1;
+        } else if (!tar_skip(&reader, e.size)) {
+            tar_entry_free(&e);
+            goto read_error;
+        }
+        tar_entry_free(&e);
+    }
+
+    if (found) {
+        /* decoded like the output of an external command would be */
+        Tcl_DString utf;
+        Tcl_ExternalToUtfDString(NULL, Tcl_DStringValue(&contents),
+                Tcl_DStringLength(&contents), &utf);
+        Tcl_DStringResult(interp, &utf);
+        status = TCL_OK;
+    } else {
+        Tcl_AppendResult(interp, Tcl_GetString(objv[3]), " not found in ",
+                archive, NULL);
+    }
+    goto cleanup;
+
+read_error:
+    if (reader.error != 0) {
+        Tcl_AppendResult(interp, "Could not read archive: ", archive, ": ",
+                strerror(reader.error), NULL);
+    } else {
+        Tcl_AppendResult(interp, "Could not read archive: ", archive, ": ",
+                reader.message ? reader.message : "unknown error", NULL);
+    }
+
+cleanup:
+    reader_close(&reader);
+    Tcl_DStringFree(&contents);
+    ckfree(member);
+    return status;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Creation */
+
+/*
+ * Archives are written as ustar, with pax extended headers for what doesn't
+ * fit in it. The tar data is cut in blocks; for tzst archives each block is
+ * compressed as an independent zstd frame by a pool of threads while the
+ * next blocks are being filled, and the frames are written out in order.
+ * An index of the frames in the zstd seekable format follows them, in a
+ * skippable frame that zstd(1) and other decoders ignore, so that a reader
+ * can find the frame holding a given offset without decompressing what
+ * comes before it. The metadata members come first and end their frame
+ * early, see ARCHIVE_INDEX_MAGIC.
+ */
+
+#define ARCHIVE_BLOCK_SIZE (4 * 1024 * 1024)
+#define ARCHIVE_DEFAULT_LEVEL 9
+
+typedef struct {
+    unsigned char* data;
+    size_t len;
+#if HAVE_LIBZSTD
+    unsigned char* compressed;
+    size_t compressed_len;
+    /* 0 until compressed, 1 once compressed, -1 if compressing failed */
+    int state;
+#endif
+} archive_block;
+
+typedef struct {
+    int fd;
+    /* set once the archive file has been created */
+    int created;
+    int compress;
+    size_t block_size;
+    /* block number n is blocks[n % blocks_count] */
+    archive_block* blocks;
+    size_t blocks_count;
+    /* blocks handed over for compression, taken by a thread, and written */
+    size_t filled;
+    size_t taken;
+    size_t written;
+    /* errno of a failed write, or 0 with message set */
+    int error;
+    const char* message;
+    /* number of frames holding the metadata members, 0 if not split */
+    size_t metadata_frames;
+#if HAVE_LIBZSTD
+    int level;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int stopping;
+    pthread_t* threads;
+    int threads_count;
+    /* compresses blocks as they're filled if there are no threads */
+    ZSTD_CCtx* cctx;
+    /* compressed and uncompressed size of every frame written, for the
+     * seek table */
+    unsigned char* seek_table;
+    size_t seek_table_len;
+    size_t seek_table_size;
+#endif
+} archive_writer;
+
+/* device and inode of a file archived, and the member name it was archived
+ * as, for hard links */
+typedef struct {
+    Tcl_HashTable links;
+    archive_writer* writer;
+    Tcl_Interp* interp;
+    uid_t uid;
+    char uname[33];
+    gid_t gid;
+    char gname[33];
+} create_state;
+
+static int write_all(int fd, const unsigned char* data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+    return 1;
+}
+
+#if HAVE_LIBZSTD
+static void put_le32(unsigned char* p, uint32_t value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+static int block_compress(ZSTD_CCtx* cctx, archive_block* block, int level) {
+    size_t ret;
+
+    ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+    ret = ZSTD_compress2(cctx, block->compressed,
+            ZSTD_compressBound(block->len), block->data, block->len);
+    if (ZSTD_isError(ret)) {
+        return 0;
+    }
+    block->compressed_len = ret;
+    return 1;
+}
+
+static void writer_seek_entry(archive_writer* w, size_t compressed_len,
+        size_t len) {
+    unsigned char* entry;
+
+    if (w->seek_table_len + 8 > w->seek_table_size) {
+        w->seek_table_size = w->seek_table_size * 2 + 64 * 8;
+        w->seek_table = (unsigned char*)ckrealloc((char*)w->seek_table,
+                w->seek_table_size);
+    }
+    entry = w->seek_table + w->seek_table_len;
+    put_le32(entry, (uint32_t)compressed_len);
+    put_le32(entry + 4, (uint32_t)len);
+    w->seek_table_len += 8;
+}
+
+static void* writer_thread(void* arg) {
+    archive_writer* w = arg;
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+
+    pthread_mutex_lock(&w->mutex);
+    for (;;) {
+        archive_block* block;
+        int ok;
+
+        while (w->taken == w->filled && !w->stopping) {
+            pthread_cond_wait(&w->cond, &w->mutex);
+        }
+        if (w->taken == w->filled) {
+            break;
+        }
+        block = &w->blocks[w->taken++ % w->blocks_count];
+        pthread_mutex_unlock(&w->mutex);
+        ok = cctx != NULL && block_compress(cctx, block, w->level);
+        pthread_mutex_lock(&w->mutex);
+        block->state = ok ? 1 : -1;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->mutex);
+    ZSTD_freeCCtx(cctx);
+    return NULL;
+}
+#endif
+
+/**
+ * Writes out the oldest block handed over, waiting for it to be compressed.
+ */
+static int writer_flush_one(archive_writer* w) {
+    archive_block* block = &w->blocks[w->written % w->blocks_count];
+
+#if HAVE_LIBZSTD
+    if (w->compress) {
+        pthread_mutex_lock(&w->mutex);
+        while (block->state == 0) {
+            pthread_cond_wait(&w->cond, &w->mutex);
+        }
+        pthread_mutex_unlock(&w->mutex);
+        if (block->state < 0) {
+            w->message = "zstd compression failed";
+            return 0;
+        }
+        if (!write_all(w->fd, block->compressed, block->compressed_len)) {
+            w->error = errno;
+            return 0;
+        }
+        writer_seek_entry(w, block->compressed_len, block->len);
+        block->state = 0;
+        block->len = 0;
+        w->written++;
+        return 1;
+    }
+#endif
+    if (!write_all(w->fd, block->data, block->len)) {
+        w->error = errno;
+        return 0;
+    }
+    block->len = 0;
+    w->written++;
+    return 1;
+}
+
+/**
+ * Hands the block being filled over for compression, or writes it if there
+ * is no compression.
+ */
+static int writer_submit(archive_writer* w) {
+#if HAVE_LIBZSTD
+    if (w->compress) {
+        archive_block* block = &w->blocks[w->filled % w->blocks_count];
+        if (w->threads_count == 0) {
+            block->state = block_compress(w->cctx, block, w->level) ? 1 : -1;
+            w->filled++;
+            w->taken++;
+        } else {
+            pthread_mutex_lock(&w->mutex);
+            w->filled++;
+            pthread_cond_broadcast(&w->cond);
+            pthread_mutex_unlock(&w->mutex);
+        }
+        /* wait for the oldest block once all are in use */
+        if (w->filled - w->written == w->blocks_count) {
+            return writer_flush_one(w);
+        }
+        return 1;
+    }
+#endif
+    w->filled++;
+    return writer_flush_one(w);
+}
+
+/**
+ * Ends the frame being filled early, so that everything written so far,
+ * the metadata members, can be decompressed without what follows.
+ */
+static int writer_split(archive_writer* w) {
+    archive_block* block = &w->blocks[w->filled % w->blocks_count];
+
+    if (!w->compress) {
+        return 1;
+    }
+    if (block->len > 0 && !writer_submit(w)) {
+        return 0;
+    }
+    w->metadata_frames = w->filled;
+    return 1;
+}
+
+/**
+ * Gives the free space left in the block being filled.
+ */
+static size_t writer_space(archive_writer* w, unsigned char** space) {
+    archive_block* block = &w->blocks[w->filled % w->blocks_count];
+
+    *space = block->data + block->len;
+    return w->block_size - block->len;
+}
+
+/**
+ * Accounts for len bytes written to the space given by writer_space.
+ */
+static int writer_commit(archive_writer* w, size_t len) {
+    archive_block* block = &w->blocks[w->filled % w->blocks_count];
+
+    block->len += len;
+    if (block->len == w->block_size) {
+        return writer_submit(w);
+    }
+    return 1;
+}
+
+static int writer_put(archive_writer* w, const void* data, size_t len) {
+    const unsigned char* p = data;
+
+    while (len > 0) {
+        unsigned char* space;
+        size_t count = writer_space(w, &space);
+        if (count > len) {
+            count = len;
+        }
+        memcpy(space, p, count);
+        p += count;
+        len -= count;
+        if (!writer_commit(w, count)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Pads the archive with zeros up to the next tar block.
+ */
+static int writer_pad(archive_writer* w, Tcl_WideInt size) {
+    static const unsigned char zeros[TAR_BLOCK_SIZE];
+
+    if (size % TAR_BLOCK_SIZE == 0) {
+        return 1;
+    }
+    return writer_put(w, zeros, TAR_BLOCK_SIZE - (size_t)(size % TAR_BLOCK_SIZE));
+}
+
+/**
+ * Stops the compression threads, after they're done with the blocks handed
+ * over if there was no error.
+ */
+static void writer_stop(archive_writer* w) {
+#if HAVE_LIBZSTD
+    int i;
+
+    if (w->threads_count > 0) {
+        pthread_mutex_lock(&w->mutex);
+        w->stopping = 1;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->mutex);
+        for (i = 0; i < w->threads_count; i++) {
+            pthread_join(w->threads[i], NULL);
+        }
+        w->threads_count = 0;
+    }
+#else
+    (void)w;
+#endif
+}
+
+static void writer_free(archive_writer* w) {
+    size_t i;
+
+    writer_stop(w);
+#if HAVE_LIBZSTD
+    if (w->threads != NULL) {
+        pthread_mutex_destroy(&w->mutex);
+        pthread_cond_destroy(&w->cond);
+        free(w->threads);
+    }
+    ZSTD_freeCCtx(w->cctx);
+    ckfree((char*)w->seek_table);
+#endif
+    for (i = 0; w->blocks != NULL && i < w->blocks_count; i++) {
+        free(w->blocks[i].data);
+#if HAVE_LIBZSTD
+        free(w->blocks[i].compressed);
+#endif
+    }
+    free(w->blocks);
+    if (w->fd != -1) {
+        close(w->fd);
+    }
+}
+
+/**
+ * Creates the archive at path, compressed with zstd if compress is set,
+ * using up to threads threads.
+ *
+ * @return 1 on success, 0 on error with w->error or w->message set
+ */
+static int writer_open(archive_writer* w, const char* path, int compress,
+        int level, int threads, size_t block_size) {
+    size_t i;
+
+    memset(w, 0, sizeof(*w));
+    w->fd = -1;
+    w->compress = compress;
+    w->block_size = block_size;
+    w->blocks_count = 1;
+#if HAVE_LIBZSTD
+    w->level = level;
+    if (compress && threads > 1) {
+        /* enough blocks for every thread to compress one while the next
+         * ones are being filled */
+        w->blocks_count = 2 * (size_t)threads;
+    }
+#else
+    (void)level;
+    (void)threads;
+#endif
+    w->blocks = calloc(w->blocks_count, sizeof(*w->blocks));
+    if (w->blocks == NULL) {
+        w->error = ENOMEM;
+        return 0;
+    }
+    for (i = 0; i < w->blocks_count; i++) {
+        w->blocks[i].data = malloc(block_size);
+        if (w->blocks[i].data == NULL) {
+            w->error = ENOMEM;
+            return 0;
+        }
+#if HAVE_LIBZSTD
+        if (compress) {
+            w->blocks[i].compressed = malloc(ZSTD_compressBound(block_size));
+            if (w->blocks[i].compressed == NULL) {
+                w->error = ENOMEM;
+                return 0;
+            }
+        }
+#endif
+    }
+
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (w->fd == -1) {
+        w->error = errno;
+        return 0;
+    }
+    w->created = 1;
+
+#if HAVE_LIBZSTD
+    if (compress) {
+        w->cctx = ZSTD_createCCtx();
+        if (w->cctx == NULL) {
+            w->error = ENOMEM;
+            return 0;
+        }
+    }
+    if (compress && threads > 1) {
+        w->threads = calloc((size_t)threads, sizeof(*w->threads));
+        if (w->threads == NULL) {
+            w->error = ENOMEM;
+            return 0;
+        }
+        pthread_mutex_init(&w->mutex, NULL);
+        pthread_cond_init(&w->cond, NULL);
+        for (w->threads_count = 0; w->threads_count < threads;
+                w->threads_count++) {
+            if (pthread_create(&w->threads[w->threads_count], NULL,
+                        writer_thread, w) != 0) {
+                break;
+            }
+        }
+        /* with no threads at all, blocks are compressed as they're filled;
+         * the ring then only ever holds one at a time */
+    }
+#endif
+    return 1;
+}
+
+/**
+ * Writes out what's left and, for compressed archives, the index of the
+ * metadata frames and the seek table.
+ */
+static int writer_close(archive_writer* w) {
+    archive_block* block = &w->blocks[w->filled % w->blocks_count];
+
+    if (block->len > 0 && !writer_submit(w)) {
+        return 0;
+    }
+    while (w->written < w->filled) {
+        if (!writer_flush_one(w)) {
+            return 0;
+        }
+    }
+    writer_stop(w);
+#if HAVE_LIBZSTD
+    if (w->compress) {
+        unsigned char index[ARCHIVE_INDEX_SIZE];
+        unsigned char header[8];
+        unsigned char footer[ZSTD_SEEKABLE_FOOTER_SIZE];
+        size_t frames;
+
+        if (w->metadata_frames > 0) {
+            put_le32(index, ARCHIVE_INDEX_MAGIC);
+            put_le32(index + 4, ARCHIVE_INDEX_SIZE - 8);
+            memcpy(index + 8, ARCHIVE_INDEX_TAG, 4);
+            put_le32(index + 12, (uint32_t)w->metadata_frames);
+            if (!write_all(w->fd, index, sizeof(index))) {
+                w->error = errno;
+                return 0;
+            }
+            writer_seek_entry(w, sizeof(index), 0);
+        }
+        frames = w->seek_table_len / 8;
+        put_le32(header, ZSTD_SEEK_TABLE_MAGIC);
+        put_le32(header + 4, (uint32_t)(w->seek_table_len + sizeof(footer)));
+        put_le32(footer, (uint32_t)frames);
+        /* no per frame checksums, the frames have their own */
+        footer[4] = 0;
+        put_le32(footer + 5, ZSTD_SEEKABLE_MAGIC);
+        if (!write_all(w->fd, header, sizeof(header))
+                || !write_all(w->fd, w->seek_table, w->seek_table_len)
+                || !write_all(w->fd, footer, sizeof(footer))) {
+            w->error = errno;
+            return 0;
+        }
+    }
+#endif
+    if (close(w->fd) != 0) {
+        w->fd = -1;
+        w->error = errno;
+        return 0;
+    }
+    w->fd = -1;
+    return 1;
+}
+
+static void tar_octal(unsigned char* field, size_t len, Tcl_WideInt value) {
+    size_t i;
+
+    field[len - 1] = '\0';
+    for (i = len - 1; i > 0; i--) {
+        field[i - 1] = (unsigned char)('0' + (value & 7));
+        value >>= 3;
+    }
+}
+
+/**
+ * Appends a "length key=value\n" pax record, length counting itself.
+ */
+static void pax_record(Tcl_DString* pax, const char* key, const char* value) {
+    size_t len = strlen(key) + strlen(value) + 3;
+    size_t total = len;
+    char number[24];
+
+    /* adding the digits of the length may add a digit to it */
+    do {
+        snprintf(number, sizeof(number), "%lu", (unsigned long)total);
+        total = len + strlen(number);
+        snprintf(number, sizeof(number), "%lu", (unsigned long)total);
+    } while (len + strlen(number) != total);
+    Tcl_DStringAppend(pax, number, -1);
+    Tcl_DStringAppend(pax, " ", 1);
+    Tcl_DStringAppend(pax, key, -1);
+    Tcl_DStringAppend(pax, "=", 1);
+    Tcl_DStringAppend(pax, value, -1);
+    Tcl_DStringAppend(pax, "\n", 1);
+}
+
+static void pax_number(Tcl_DString* pax, const char* key, Tcl_WideInt value) {
+    char number[24];
+
+    snprintf(number, sizeof(number), "%" TCL_LL_MODIFIER "d", value);
+    pax_record(pax, key, number);
+}
+
+static void tar_checksum(unsigned char* header) {
+    unsigned int sum = 0;
+    int i;
+
+    memset(header + 148, ' ', 8);
+    for (i = 0; i < TAR_BLOCK_SIZE; i++) {
+        sum += header[i];
+    }
+    tar_octal(header + 148, 7, sum);
+    header[155] = ' ';
+}
+
+/**
+ * Writes the header of a member, preceded by a pax extended header if some
+ * of its values don't fit in a ustar one.
+ */
+static int create_header(create_state* c, const char* name, char type,
+        const struct stat* st, Tcl_WideInt size, const char* linkname) {
+    unsigned char header[TAR_BLOCK_SIZE];
+    size_t name_len = strlen(name);
+    Tcl_DString pax;
+    int ok = 1;
+
+    memset(header, 0, sizeof(header));
+    Tcl_DStringInit(&pax);
+
+    if (name_len <= 100) {
+        memcpy(header, name, name_len);
+    } else {
+        /* ustar can split a name at a slash, in a prefix of up to 155 and a
+         * name of up to 100 characters */
+        const char* slash = NULL;
+        const char* p;
+        for (p = name + name_len - 1; p > name; p--) {
+            if (*p == '/' && p < name + name_len - 1) {
+                if ((size_t)(p - name) > 155) {
+                    continue;
+                }
+                if ((size_t)(name + name_len - p - 1) <= 100) {
+                    slash = p;
+                }
+                break;
+            }
+        }
+        if (slash != NULL) {
+            memcpy(header + 345, name, (size_t)(slash - name));
+            memcpy(header, slash + 1, (size_t)(name + name_len - slash - 1));
+        } else {
+            pax_record(&pax, "path", name);
+            memcpy(header, name, 100);
+        }
+    }
+    if (linkname != NULL) {
+        size_t len = strlen(linkname);
+        if (len > 100) {
+            pax_record(&pax, "linkpath", linkname);
+            len = 100;
+        }
+        memcpy(header + 157, linkname, len);
+    }
+
+    tar_octal(header + 100, 8, st->st_mode & 07777);
+    if (st->st_uid > 07777777) {
+        pax_number(&pax, "uid", st->st_uid);
+    } else {
+        tar_octal(header + 108, 8, st->st_uid);
+    }
+    if (st->st_gid > 07777777) {
+        pax_number(&pax, "gid", st->st_gid);
+    } else {
+        tar_octal(header + 116, 8, st->st_gid);
+    }
+    if (size > (Tcl_WideInt)077777777777) {
+        pax_number(&pax, "size", size);
+        tar_octal(header + 124, 12, 0);
+    } else {
+        tar_octal(header + 124, 12, size);
+    }
+    tar_octal(header + 136, 12, st->st_mtime > 0 ? st->st_mtime : 0);
+    header[156] = (unsigned char)type;
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+
+    if (st->st_uid != c->uid || c->uname[0] == '\0') {
+        struct passwd* pw = getpwuid(st->st_uid);
+        c->uid = st->st_uid;
+        snprintf(c->uname, sizeof(c->uname), "%s", pw ? pw->pw_name : "");
+    }
+    if (st->st_gid != c->gid || c->gname[0] == '\0') {
+        struct group* gr = getgrgid(st->st_gid);
+        c->gid = st->st_gid;
+        snprintf(c->gname, sizeof(c->gname), "%s", gr ? gr->gr_name : "");
+    }
+    memcpy(header + 265, c->uname, strlen(c->uname));
+    memcpy(header + 297, c->gname, strlen(c->gname));
+
+    if (Tcl_DStringLength(&pax) > 0) {
+        unsigned char pax_header[TAR_BLOCK_SIZE];
+        const char* base = strrchr(name, '/');
+        char pax_name[101];
+
+        memcpy(pax_header, header, sizeof(pax_header));
+        memset(pax_header, 0, 100);
+        memset(pax_header + 157, 0, 100);
+        memset(pax_header + 345, 0, 155);
+        snprintf(pax_name, sizeof(pax_name), "./PaxHeaders/%s",
+                base ? base + 1 : name);
+        memcpy(pax_header, pax_name, strlen(pax_name));
+        tar_octal(pax_header + 100, 8, 0644);
+        tar_octal(pax_header + 124, 12, Tcl_DStringLength(&pax));
+        pax_header[156] = 'x';
+        tar_checksum(pax_header);
+        ok = writer_put(c->writer, pax_header, sizeof(pax_header))
+            && writer_put(c->writer, Tcl_DStringValue(&pax),
+                    (size_t)Tcl_DStringLength(&pax))
+            && writer_pad(c->writer, Tcl_DStringLength(&pax));
+    }
+    Tcl_DStringFree(&pax);
+
+    tar_checksum(header);
+    return ok && writer_put(c->writer, header, sizeof(header));
+}
+
+static void create_error(create_state* c, const char* path, int error) {
+    Tcl_ResetResult(c->interp);
+    Tcl_AppendResult(c->interp, path, ": ", strerror(error), NULL);
+}
+
+static void create_writer_error(create_state* c, const char* archive) {
+    Tcl_ResetResult(c->interp);
+    Tcl_AppendResult(c->interp, "Could not write archive: ", archive, ": ",
+            c->writer->error != 0 ? strerror(c->writer->error)
+            : c->writer->message, NULL);
+}
+
+/**
+ * Archives the contents of the regular file at path.
+ *
+ * @return 1 on success, 0 after setting an error, -1 on a write error
+ */
+static int create_file_data(create_state* c, const char* path,
+        Tcl_WideInt size) {
+    Tcl_WideInt remaining = size;
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+
+    if (fd == -1) {
+        create_error(c, path, errno);
+        return 0;
+    }
+    while (remaining > 0) {
+        unsigned char* space;
+        size_t count = writer_space(c->writer, &space);
+        ssize_t got;
+
+        if ((Tcl_WideInt)count > remaining) {
+            count = (size_t)remaining;
+        }
+        got = read(fd, space, count);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            create_error(c, path, errno);
+            close(fd);
+            return 0;
+        }
+        if (got == 0) {
+            Tcl_ResetResult(c->interp);
+            Tcl_AppendResult(c->interp, path,
+                    ": file shrank while being archived", NULL);
+            close(fd);
+            return 0;
+        }
+        remaining -= got;
+        if (!writer_commit(c->writer, (size_t)got)) {
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+    return writer_pad(c->writer, size) ? 1 : -1;
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* at the top, the members describing the port come first */
+static int compare_root_names(const void* a, const void* b) {
+    const char* name_a = *(char* const*)a;
+    const char* name_b = *(char* const*)b;
+
+    if ((name_a[0] == '+') != (name_b[0] == '+')) {
+        return name_a[0] == '+' ? -1 : 1;
+    }
+    return strcmp(name_a, name_b);
+}
+
+/**
+ * Archives the file system object at path as member name, and everything
+ * below it if it's a directory, in name order so that archives of the same
+ * files are the same.
+ *
+ * @return 1 on success, 0 after setting an error, -1 on a write error
+ */
+static int create_tree(create_state* c, Tcl_DString* path, Tcl_DString* name) {
+    struct stat st;
+    int ret;
+
+    if (Tcl_AsyncReady()) {
+        if (Tcl_AsyncInvoke(c->interp, TCL_OK) != TCL_OK) {
+            return 0;
+        }
+    }
+    if (lstat(Tcl_DStringValue(path), &st) != 0) {
+        create_error(c, Tcl_DStringValue(path), errno);
+        return 0;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        DIR* dir;
+        struct dirent* entry;
+        char** names = NULL;
+        size_t names_count = 0;
+        size_t names_size = 0;
+        size_t i;
+        int path_len = Tcl_DStringLength(path);
+        int name_len = Tcl_DStringLength(name);
+        int root = strcmp(Tcl_DStringValue(name), ".") == 0;
+        int metadata;
+
+        Tcl_DStringAppend(name, "/", 1);
+        if (!create_header(c, Tcl_DStringValue(name), '5', &st, 0, NULL)) {
+            return -1;
+        }
+        dir = opendir(Tcl_DStringValue(path));
+        if (dir == NULL) {
+            create_error(c, Tcl_DStringValue(path), errno);
+            return 0;
+        }
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0
+                    || strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            if (names_count == names_size) {
+                names_size = names_size ? 2 * names_size : 16;
+                names = (char**)ckrealloc((char*)names,
+                        names_size * sizeof(*names));
+            }
+            names[names_count] = ckalloc(strlen(entry->d_name) + 1);
+            strcpy(names[names_count++], entry->d_name);
+        }
+        closedir(dir);
+        qsort(names, names_count, sizeof(*names),
+                root ? compare_root_names : compare_names);
+
+        ret = 1;
+        metadata = root && names_count > 0 && names[0][0] == '+';
+        for (i = 0; i < names_count; i++) {
+            if (ret == 1 && metadata && names[i][0] != '+') {
+                metadata = 0;
+                if (!writer_split(c->writer)) {
+                    ret = -1;
+                }
+            }
+            if (ret == 1) {
+                Tcl_DStringAppend(path, "/", 1);
+                Tcl_DStringAppend(path, names[i], -1);
+                Tcl_DStringAppend(name, names[i], -1);
+                ret = create_tree(c, path, name);
+                Tcl_DStringSetLength(path, path_len);
+                Tcl_DStringSetLength(name, name_len + 1);
+            }
+            ckfree(names[i]);
+        }
+        ckfree((char*)names);
+        Tcl_DStringSetLength(name, name_len);
+        return ret;
+    }
+
+    if (S_ISLNK(st.st_mode)) {
+        char target[PATH_MAX];
+        ssize_t len = readlink(Tcl_DStringValue(path), target,
+                sizeof(target) - 1);
+        if (len < 0) {
+            create_error(c, Tcl_DStringValue(path), errno);
+            return 0;
+        }
+        target[len] = '\0';
+        return create_header(c, Tcl_DStringValue(name), '2', &st, 0, target)
+            ? 1 : -1;
+    }
+
+    if (S_ISREG(st.st_mode)) {
+        if (st.st_nlink > 1) {
+            inode_key key;
+            int is_new;
+            Tcl_HashEntry* link;
+
+            memset(&key, 0, sizeof(key));
+            key.dev = st.st_dev;
+            key.ino = st.st_ino;
+            link = Tcl_CreateHashEntry(&c->links, (const char*)&key, &is_new);
+            if (!is_new) {
+                return create_header(c, Tcl_DStringValue(name), '1', &st, 0,
+                        Tcl_GetHashValue(link)) ? 1 : -1;
+            }
+            Tcl_SetHashValue(link, ckalloc(Tcl_DStringLength(name) + 1));
+            strcpy(Tcl_GetHashValue(link), Tcl_DStringValue(name));
+        }
+        if (!create_header(c, Tcl_DStringValue(name), '0', &st, st.st_size,
+                    NULL)) {
+            return -1;
+        }
+        return create_file_data(c, Tcl_DStringValue(path), st.st_size);
+    }
+
+    Tcl_ResetResult(c->interp);
+    Tcl_AppendResult(c->interp, Tcl_DStringValue(path),
+            ": unsupported file type", NULL);
+    return 0;
+}
+
+/**
+ * archive create subcommand
+ */
+static int ArchiveCreateCmd(Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    static const char* options[] = {
+        "-threads", "-level", "-blocksize", NULL
+    };
+    enum { THREADS, LEVEL, BLOCKSIZE } option;
+    const char* usage = "?-threads n? ?-level n? ?-blocksize bytes? "
+        "path directory";
+    int threads = 1;
+    int level = ARCHIVE_DEFAULT_LEVEL;
+    int block_size = ARCHIVE_BLOCK_SIZE;
+    int compress;
+    const char* archive;
+    const char* extension;
+    archive_writer writer;
+    create_state c;
+    Tcl_DString path;
+    Tcl_DString name;
+    int ret;
+    int i;
+
+    for (i = 2; i < objc - 2; i += 2) {
+        int value;
+        if (Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0,
+                    (int*)&option) != TCL_OK
+                || Tcl_GetIntFromObj(interp, objv[i + 1], &value) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        switch (option) {
+            case THREADS:
+                if (value < 1) {
+                    Tcl_SetResult(interp, "threads must be at least 1",
+                            TCL_STATIC);
+                    return TCL_ERROR;
+                }
+                threads = value;
+                break;
+            case LEVEL:
+                level = value;
+                break;
+            case BLOCKSIZE:
+                if (value < TAR_BLOCK_SIZE) {
+                    Tcl_SetResult(interp, "blocksize must be at least 512",
+                            TCL_STATIC);
+                    return TCL_ERROR;
+                }
+                block_size = value;
+                break;
+        }
+    }
+    if (i != objc - 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, usage);
+        return TCL_ERROR;
+    }
+    archive = Tcl_GetString(objv[objc - 2]);
+
+    extension = strrchr(archive, '.');
+    if (extension != NULL && strcmp(extension, ".tar") == 0) {
+        compress = 0;
+#if HAVE_LIBZSTD
+    } else if (extension != NULL && strcmp(extension, ".tzst") == 0) {
+        compress = 1;
+#endif
+    } else {
+        Tcl_AppendResult(interp, "Could not write archive: ", archive,
+                ": unsupported archive type", NULL);
+        return TCL_ERROR;
+    }
+
+    memset(&c, 0, sizeof(c));
+    c.writer = &writer;
+    c.interp = interp;
+    Tcl_InitHashTable(&c.links, sizeof(inode_key) / sizeof(int));
+    Tcl_DStringInit(&path);
+    Tcl_DStringInit(&name);
+
+    if (!writer_open(&writer, archive, compress, level, threads,
+                (size_t)block_size)) {
+        create_writer_error(&c, archive);
+        ret = 0;
+    } else {
+        static const unsigned char end[2 * TAR_BLOCK_SIZE];
+
+        Tcl_DStringAppend(&path, Tcl_GetString(objv[objc - 1]), -1);
+        /* like tar -cf archive . run in directory */
+        Tcl_DStringAppend(&name, ".", 1);
+        ret = create_tree(&c, &path, &name);
+        if (ret == 1 && (!writer_put(&writer, end, sizeof(end))
+                    || !writer_close(&writer))) {
+            ret = -1;
+        }
+        if (ret < 0) {
+            create_writer_error(&c, archive);
+        }
+    }
+    if (ret != 1 && writer.created) {
+        unlink(archive);
+    }
+    writer_free(&writer);
+    if (ret == 1) {
+        Tcl_ResetResult(interp);
+    }
+
+    {
+        Tcl_HashSearch search;
+        Tcl_HashEntry* entry;
+        for (entry = Tcl_FirstHashEntry(&c.links, &search); entry != NULL;
+                entry = Tcl_NextHashEntry(&search)) {
+            ckfree(Tcl_GetHashValue(entry));
+        }
+    }
+    Tcl_DeleteHashTable(&c.links);
+    Tcl_DStringFree(&path);
+    Tcl_DStringFree(&name);
+    return ret == 1 ? TCL_OK : TCL_ERROR;
+}
+
+/**
+ * archive supported subcommand
+ */
+static int ArchiveSupportedCmd(Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    static const struct {
+        const char* extension;
+        int supported;
+    } types[] = {
+        { ".tar", 1 },
+#if HAVE_LIBZ
+        { ".tgz", 1 },
+#endif
+#if HAVE_LIBBZ2
+        { ".tbz", 1 },
+        { ".tbz2", 1 },
+#endif
+#if HAVE_LIBLZMA
+        { ".txz", 1 },
+        { ".tlz", 1 },
+#endif
+#if HAVE_LIBZSTD
+        { ".tzst", 1 },
+#endif
+        { NULL, 0 }
+    };
+    const char* path;
+    const char* extension;
+    int supported = 0;
+    int i;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "path");
+        return TCL_ERROR;
+    }
+    path = Tcl_GetString(objv[2]);
+    extension = strrchr(path, '.');
+    if (extension != NULL && strchr(extension, '/') == NULL) {
+        for (i = 0; types[i].extension != NULL; i++) {
+            if (strcmp(extension, types[i].extension) == 0) {
+                supported = types[i].supported;
+                break;
+            }
+        }
+    }
+    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(supported));
+    return TCL_OK;
+}
+
+/**
+ * archive command entry point.
+ *
+ * @param interp		current interpreter
+ * @param objc			number of parameters
+ * @param objv			parameters
+ */
+int ArchiveCmd(ClientData clientData UNUSED, Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    static const char* cmds[] = {
+        "create", "extract", "read", "supported", NULL
+    };
+    enum { CREATE, EXTRACT, READ, SUPPORTED } cmd;
+
+    if (objc < 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "cmd ?arg ...?");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], cmds, "cmd", 0, (int*)&cmd)
+            != TCL_OK) {
+        return TCL_ERROR;
+    }
+    switch (cmd) {
+        case CREATE:
+            return ArchiveCreateCmd(interp, objc, objv);
+        case EXTRACT:
+            return ArchiveExtractCmd(interp, objc, objv);
+        case READ:
+            return ArchiveReadCmd(interp, objc, objv);
+        case SUPPORTED:
+            return ArchiveSupportedCmd(interp, objc, objv);
+    }
+    return TCL_OK;
+}
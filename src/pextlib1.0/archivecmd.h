@@ -0,0 +1,81 @@
+/*
+ * archivecmd.h
+ *
+ * Copyright (c) 2026 The MacPorts Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of MacPorts Team nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ARCHIVECMD_H
+#define _ARCHIVECMD_H
+
+#include <tcl.h>
+
+/**
+ * A native command reading and writing port archives without forking tar
+ * and a compressor.
+ *
+ * The syntax is:
+ * archive supported path
+ *	Return 1 if the archive type of path, as given by its extension, can be
+ *  read by this command, 0 otherwise. Only tar archives are, compressed with
+ *  whichever of gzip, bzip2, xz, lzma and zstd were available at build time.
+ *
+ * archive create ?-threads n? ?-level n? ?-blocksize bytes? path directory
+ *	Write the contents of directory, in sorted order and with member names
+ *  starting with ./, to the archive at path, a pax tar file (.tar) or, if zstd
+ *  was available at build time, a zstd compressed one (.tzst). The tar
+ *  stream of the latter is cut in blocks of the given size, 4 MiB by
+ *  default, compressed as independent frames at the given level, 9 by
+ *  default, by n threads and followed by a seek table in the zstd seekable
+ *  format. The members at the top whose names start with +, like
+ *  +CONTENTS, come first and end their frame early, and an index of these
+ *  frames is added before the seek table. The archive is removed again if
+ *  writing it fails.
+ *
+ * archive read path member
+ *	Return the contents of the regular file member, named as in the archive,
+ *  for example ./+CONTENTS. It is an error if there is no such member. In
+ *  archives with an index, members starting with + are read from their own
+ *  frames without decompressing the rest.
+ *
+ * archive extract ?-files paths? ?-rename list? ?-created varName?
+ *		path ?directory?
+ *	Extract the archive at path below directory, the root of the file
+ *  system by default. With -files, only the members at the given paths
+ *  (absolute, as recorded in +CONTENTS) and the directories leading to them
+ *  are extracted. -rename is a list of path and destination pairs, the
+ *  member at path being extracted as destination instead. Directories that
+ *  already exist are left alone, and existing files are never overwritten.
+ *  varName is set to the list of files, links and symlinks created, also
+ *  when extraction fails half way, so they can be removed again. Returns the
+ *  paths given with -files that are not in the archive.
+ */
+int ArchiveCmd(ClientData clientData, Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]);
+
+#endif
+	/* _ARCHIVECMD_H */
@@ -0,0 +1,1549 @@
+/*
+ * binindex.c
+ *
+ * Copyright (c) 2026 The MacPorts Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of MacPorts Team nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* required for mkstemp(3) and fchmod(2) */
+#define _XOPEN_SOURCE 500
+#define _DARWIN_C_SOURCE
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <tcl.h>
+
+#include "binindex.h"
+
+/*
+ * A binary index consists of a header, followed by the offsets of all
+ * records in PortIndex order, an open addressing hash table mapping
+ * lowercased port names to record offsets, and finally the records
+ * themselves. A record is a binindex_record header followed by the port
+ * name and the already split keys and values of its PortInfo, each stored
+ * as a 32 bit length, the bytes and a terminating NUL, padded to a multiple
+ * of four bytes. All integers are in host byte order; an index from a
+ * machine with a different byte order is simply rejected and rebuilt.
+ *
+ * The records are followed by a search index for the fields listed in
+ * search_fields, which maps each trigram (three consecutive ASCII
+ * characters, lowercased) to the sorted numbers of the records whose value
+ * for the field contains it, delta and varint encoded. Searches use it to
+ * find candidates that need to be checked against the actual pattern.
+ * Trigrams occurring in more than half of the records have no list, as they
+ * don't narrow down the search anyway. Values containing non-ASCII
+ * characters can match case-insensitively in ways trigrams don't capture,
+ * so their records are always candidates.
+ */
+
+#define BININDEX_MAGIC      "MPBINIDX"
+#define BININDEX_VERSION    2
+#define BININDEX_BYTE_ORDER 0x01020304
+
+typedef struct {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t version;
+    /* number of records */
+    uint32_t count;
+    /* number of hash table slots, a power of two */
+    uint32_t buckets;
+    uint32_t order_offset;
+    uint32_t table_offset;
+    /* size and mtime of the PortIndex the index was built from */
+    uint64_t index_size;
+    int64_t index_mtime;
+    /* size of the binary index itself */
+    uint64_t file_size;
+    uint32_t search_offset;
+    uint32_t reserved;
+} binindex_header;
+
+typedef struct {
+    /* hash of the lowercased name */
+    uint32_t hash;
+    /* size of the record including this header and padding */
+    uint32_t size;
+    uint32_t pair_count;
+    uint32_t reserved;
+} binindex_record;
+
+/* Search index for one field; offsets are relative to the search section,
+ * which starts with the number of fields and a reserved word. */
+typedef struct {
+    uint32_t name_offset;
+    uint32_t table_offset;
+    /* number of hash table slots, a power of two */
+    uint32_t buckets;
+    /* records always considered candidates */
+    uint32_t unindexed_offset;
+    uint32_t unindexed_count;
+    uint32_t reserved;
+} binindex_field;
+
+#define BININDEX_TRIGRAM_USED 0x1000000
+
+typedef struct {
+    /* the trigram or'ed with BININDEX_TRIGRAM_USED, 0 for an empty slot */
+    uint32_t key;
+    /* offset of the encoded record numbers, 0 for a trigram that is too
+     * common to be worth a list */
+    uint32_t offset;
+    uint32_t count;
+    uint32_t size;
+} binindex_trigram;
+
+static const char* search_fields[] = {
+    "name", "description", "long_description", "maintainers", "categories",
+    "variants", NULL
+};
+#define SEARCH_FIELD_COUNT (sizeof(search_fields) / sizeof(search_fields[0]) - 1)
+
+typedef struct {
+    Tcl_Command token;
+    char* map;
+    size_t size;
+    const binindex_header* header;
+    const uint32_t* order;
+    const uint32_t* table;
+} binindex;
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} binindex_buffer;
+
+#define ALIGN4(x) (((x) + 3) & ~(size_t)3)
+
+/**
+ * Hashes a port name, ignoring the case of ASCII letters (FNV-1a).
+ */
+static uint32_t binindex_hash(const char* name, size_t len) {
+    uint32_t hash = 2166136261U;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)name[i];
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        hash ^= c;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/**
+ * Appends len bytes to a buffer. Returns the offset the bytes were written
+ * at.
+ */
+static size_t buffer_append_bytes(binindex_buffer* buf, const void* data,
+        size_t len) {
+    size_t offset = buf->len;
+    if (buf->len + len > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 64;
+        while (cap < buf->len + len) {
+            cap *= 2;
+        }
+        buf->data = ckrealloc(buf->data, cap);
+        buf->cap = cap;
+    }
+    memcpy(buf->data + offset, data, len);
+    buf->len += len;
+    return offset;
+}
+
+/**
+ * Appends len bytes to a buffer, followed by padding to a multiple of four
+ * bytes. Returns the offset the bytes were written at.
+ */
+static size_t buffer_append(binindex_buffer* buf, const void* data,
+        size_t len) {
+    static const char padding[4] = { 0, 0, 0, 0 };
+    size_t offset = buffer_append_bytes(buf, data, len);
+    buffer_append_bytes(buf, padding, ALIGN4(buf->len) - buf->len);
+    return offset;
+}
+
+/**
+ * Appends a length prefixed string to a buffer. str must be NUL terminated,
+ * the terminator is stored as well.
+ */
+static void buffer_append_string(binindex_buffer* buf, const char* str,
+        size_t len) {
+    uint32_t len32 = (uint32_t)len;
+    buffer_append(buf, &len32, sizeof(len32));
+    buffer_append(buf, str, len + 1);
+}
+
+/**
+ * Appends an unsigned integer to a buffer in 7 bit groups, least
+ * significant first, with the high bit set on all but the last byte.
+ */
+static void buffer_append_varint(binindex_buffer* buf, uint32_t value) {
+    unsigned char bytes[5];
+    size_t len = 0;
+    while (value >= 0x80) {
+        bytes[len++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[len++] = (unsigned char)value;
+    buffer_append_bytes(buf, bytes, len);
+}
+
+/**
+ * Decodes an integer written by buffer_append_varint. Returns 0 if it would
+ * extend past end.
+ */
+static int read_varint(const unsigned char** cursor, const unsigned char* end,
+        uint32_t* value) {
+    const unsigned char* p = *cursor;
+    uint32_t result = 0;
+    int shift;
+    for (shift = 0; shift < 35 && p < end; shift += 7) {
+        result |= (uint32_t)(*p & 0x7f) << shift;
+        if (!(*p++ & 0x80)) {
+            *cursor = p;
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void buffer_free(binindex_buffer* buf) {
+    if (buf->data) {
+        ckfree(buf->data);
+    }
+    buf->data = NULL;
+    buf->len = buf->cap = 0;
+}
+
+static uint32_t lower_ascii(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (uint32_t)(c + 'a' - 'A') : c;
+}
+
+static uint32_t trigram_key(const char* p) {
+    return (lower_ascii((unsigned char)p[0]) << 16)
+        | (lower_ascii((unsigned char)p[1]) << 8)
+        | lower_ascii((unsigned char)p[2]) | BININDEX_TRIGRAM_USED;
+}
+
+static uint32_t trigram_slot(uint32_t key, uint32_t mask) {
+    uint32_t hash = key * 2654435761U;
+    return (hash ^ (hash >> 16)) & mask;
+}
+
+/* Record numbers collected for one trigram of one field while building */
+typedef struct {
+    binindex_buffer postings;
+    uint32_t last;
+    uint32_t count;
+} trigram_postings;
+
+typedef struct {
+    Tcl_HashTable trigrams[SEARCH_FIELD_COUNT];
+    binindex_buffer unindexed[SEARCH_FIELD_COUNT];
+    uint32_t unindexed_last[SEARCH_FIELD_COUNT];
+} search_builder;
+
+static void search_init(search_builder* sb) {
+    size_t i;
+    memset(sb, 0, sizeof(*sb));
+    for (i = 0; i < SEARCH_FIELD_COUNT; i++) {
+        Tcl_InitHashTable(&sb->trigrams[i], TCL_ONE_WORD_KEYS);
+    }
+}
+
+static void search_free(search_builder* sb) {
+    size_t i;
+    for (i = 0; i < SEARCH_FIELD_COUNT; i++) {
+        Tcl_HashSearch search;
+        Tcl_HashEntry* entry;
+        for (entry = Tcl_FirstHashEntry(&sb->trigrams[i], &search); entry;
+                entry = Tcl_NextHashEntry(&search)) {
+            trigram_postings* tp = Tcl_GetHashValue(entry);
+            buffer_free(&tp->postings);
+            ckfree((char*)tp);
+        }
+        Tcl_DeleteHashTable(&sb->trigrams[i]);
+        buffer_free(&sb->unindexed[i]);
+    }
+}
+
+/**
+ * Returns the number of the search index field called key, or -1 if it
+ * isn't indexed.
+ */
+static int search_field(const char* key) {
+    int i;
+    for (i = 0; search_fields[i]; i++) {
+        if (strcmp(search_fields[i], key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Adds the trigrams of value to the index of the given field for record
+ * number recno. Records must be added in ascending order.
+ */
+static void search_add(search_builder* sb, int field, uint32_t recno,
+        const char* value) {
+    size_t len = strlen(value);
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if ((unsigned char)value[i] >= 0x80) {
+            binindex_buffer* unindexed = &sb->unindexed[field];
+            if (unindexed->len == 0 || sb->unindexed_last[field] != recno) {
+                buffer_append(unindexed, &recno, sizeof(recno));
+                sb->unindexed_last[field] = recno;
+            }
+            return;
+        }
+    }
+    for (i = 0; i + 3 <= len; i++) {
+        uint32_t key = trigram_key(value + i);
+        int is_new;
+        Tcl_HashEntry* entry = Tcl_CreateHashEntry(&sb->trigrams[field],
+                (char*)(intptr_t)key, &is_new);
+        trigram_postings* tp;
+        if (is_new) {
+            tp = (trigram_postings*)ckalloc(sizeof(trigram_postings));
+            memset(tp, 0, sizeof(*tp));
+            Tcl_SetHashValue(entry, tp);
+        } else {
+            tp = Tcl_GetHashValue(entry);
+            if (tp->last == recno) {
+                continue;
+            }
+        }
+        buffer_append_varint(&tp->postings, recno - tp->last);
+        tp->last = recno;
+        tp->count++;
+    }
+}
+
+/**
+ * Appends the search section built up in sb to search. record_count is the
+ * total number of records.
+ */
+static void search_write(search_builder* sb, uint32_t record_count,
+        binindex_buffer* search) {
+    uint32_t header[2] = { SEARCH_FIELD_COUNT, 0 };
+    binindex_field fields[SEARCH_FIELD_COUNT];
+    size_t fields_offset;
+    size_t i;
+
+    memset(fields, 0, sizeof(fields));
+    buffer_append(search, header, sizeof(header));
+    fields_offset = buffer_append(search, fields, sizeof(fields));
+    for (i = 0; i < SEARCH_FIELD_COUNT; i++) {
+        binindex_field* field = &fields[i];
+        binindex_trigram* table;
+        Tcl_HashSearch hsearch;
+        Tcl_HashEntry* entry;
+        uint32_t buckets, mask;
+
+        field->name_offset = (uint32_t)search->len;
+        buffer_append_string(search, search_fields[i],
+                strlen(search_fields[i]));
+        field->unindexed_count = (uint32_t)(sb->unindexed[i].len
+                / sizeof(uint32_t));
+        field->unindexed_offset = (uint32_t)search->len;
+        if (sb->unindexed[i].len > 0) {
+            buffer_append(search, sb->unindexed[i].data, sb->unindexed[i].len);
+        }
+
+        for (buckets = 16; buckets < (uint32_t)sb->trigrams[i].numEntries * 2;
+                buckets *= 2);
+        mask = buckets - 1;
+        table = (binindex_trigram*)ckalloc(buckets * sizeof(binindex_trigram));
+        memset(table, 0, buckets * sizeof(binindex_trigram));
+        for (entry = Tcl_FirstHashEntry(&sb->trigrams[i], &hsearch); entry;
+                entry = Tcl_NextHashEntry(&hsearch)) {
+            uint32_t key = (uint32_t)(intptr_t)Tcl_GetHashKey(
+                    &sb->trigrams[i], entry);
+            trigram_postings* tp = Tcl_GetHashValue(entry);
+            uint32_t slot;
+            for (slot = trigram_slot(key, mask); table[slot].key;
+                    slot = (slot + 1) & mask);
+            table[slot].key = key;
+            table[slot].count = tp->count;
+            if (tp->count <= record_count / 2) {
+                table[slot].size = (uint32_t)tp->postings.len;
+                table[slot].offset = (uint32_t)buffer_append(search,
+                        tp->postings.data, tp->postings.len);
+            }
+        }
+        field->buckets = buckets;
+        field->table_offset = (uint32_t)buffer_append(search, table,
+                buckets * sizeof(binindex_trigram));
+        ckfree((char*)table);
+    }
+    memcpy(search->data + fields_offset, fields, sizeof(fields));
+}
+
+/**
+ * Sets the interpreter result to a "corrupt index" error.
+ */
+static int binindex_corrupt(Tcl_Interp* interp, const char* path) {
+    Tcl_SetObjResult(interp, Tcl_ObjPrintf("corrupt port index: %s", path));
+    Tcl_SetErrorCode(interp, "BININDEX", "CORRUPT", NULL);
+    return TCL_ERROR;
+}
+
+/**
+ * Sets the interpreter result to an error describing errno.
+ */
+static int binindex_posix_error(Tcl_Interp* interp, const char* action,
+        const char* path) {
+    Tcl_SetObjResult(interp, Tcl_ObjPrintf("can't %s \"%s\": %s", action,
+                path, Tcl_PosixError(interp)));
+    return TCL_ERROR;
+}
+
+/**
+ * Parses the text PortIndex in data into records appended to recs, and
+ * fills order with the offset of each record relative to the start of recs.
+ * The values of the searchable fields are added to sb.
+ * The format mirrors what mportsearch reads: a line holding the name and the
+ * length in characters of the following PortInfo line.
+ */
+static int binindex_parse(Tcl_Interp* interp, const char* path,
+        const char* data, size_t len, binindex_buffer* recs,
+        binindex_buffer* order, search_builder* sb) {
+    const char* p = data;
+    const char* end = data + len;
+    Tcl_DString line;
+    int result = TCL_OK;
+
+    Tcl_DStringInit(&line);
+    while (p < end && result == TCL_OK) {
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        const char* q;
+        const char* name;
+        int argc, info_chars, i;
+        const char** argv;
+        size_t name_len;
+        binindex_record rec;
+        size_t rec_offset;
+        uint32_t offset32;
+        uint32_t recno = (uint32_t)(order->len / sizeof(uint32_t));
+
+        if (!eol) {
+            eol = end;
+        }
+        Tcl_DStringSetLength(&line, 0);
+        Tcl_DStringAppend(&line, p, (int)(eol - p));
+        p = eol < end ? eol + 1 : end;
+        if (Tcl_SplitList(NULL, Tcl_DStringValue(&line), &argc, &argv)
+                != TCL_OK) {
+            continue;
+        }
+        if (argc != 2) {
+            /* the quick index skips these as well */
+            ckfree((char*)argv);
+            continue;
+        }
+        if (Tcl_GetInt(NULL, argv[1], &info_chars) != TCL_OK
+                || info_chars < 0) {
+            ckfree((char*)argv);
+            result = binindex_corrupt(interp, path);
+            break;
+        }
+
+        /* the PortInfo line is the next info_chars characters */
+        q = p;
+        for (i = 0; i < info_chars && q < end; i++) {
+            q = Tcl_UtfNext(q);
+        }
+        if (i < info_chars || q > end) {
+            ckfree((char*)argv);
+            result = binindex_corrupt(interp, path);
+            break;
+        }
+
+        rec_offset = recs->len;
+        name = argv[0];
+        name_len = strlen(name);
+        rec.hash = binindex_hash(name, name_len);
+        rec.size = 0;
+        rec.pair_count = 0;
+        rec.reserved = 0;
+        buffer_append(recs, &rec, sizeof(rec));
+        buffer_append_string(recs, name, name_len);
+        search_add(sb, search_field("name"), recno, name);
+        ckfree((char*)argv);
+
+        Tcl_DStringSetLength(&line, 0);
+        Tcl_DStringAppend(&line, p, (int)(q - p));
+        p = q;
+        if (Tcl_SplitList(NULL, Tcl_DStringValue(&line), &argc, &argv)
+                != TCL_OK) {
+            result = binindex_corrupt(interp, path);
+            break;
+        }
+        if (argc % 2 != 0) {
+            ckfree((char*)argv);
+            result = binindex_corrupt(interp, path);
+            break;
+        }
+        for (i = 0; i < argc; i++) {
+            buffer_append_string(recs, argv[i], strlen(argv[i]));
+        }
+        for (i = 0; i < argc; i += 2) {
+            /* searches on the name field use the port name instead */
+            int field = search_field(argv[i]);
+            if (field != -1 && strcmp(argv[i], "name") != 0) {
+                search_add(sb, field, recno, argv[i + 1]);
+            }
+        }
+        ckfree((char*)argv);
+
+        rec.pair_count = (uint32_t)argc / 2;
+        rec.size = (uint32_t)(recs->len - rec_offset);
+        memcpy(recs->data + rec_offset, &rec, sizeof(rec));
+
+        offset32 = (uint32_t)rec_offset;
+        buffer_append(order, &offset32, sizeof(offset32));
+        if (recs->len > UINT32_MAX / 2) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                        "port index too large: %s", path));
+            result = TCL_ERROR;
+        }
+    }
+    Tcl_DStringFree(&line);
+    return result;
+}
+
+/**
+ * Returns the name of the record at offset in recs.
+ */
+static const char* record_name(const char* recs, uint32_t offset,
+        uint32_t* len) {
+    const char* p = recs + offset + sizeof(binindex_record);
+    memcpy(len, p, sizeof(*len));
+    return p + sizeof(uint32_t);
+}
+
+/**
+ * binindex create textindex binindex
+ */
+static int BinindexCreateCmd(Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    Tcl_Channel chan;
+    Tcl_Obj* contents;
+    ClientData handle;
+    struct stat st;
+    const char* text_path;
+    const char* bin_path;
+    const char* data;
+    int data_len;
+    binindex_buffer recs = { NULL, 0, 0 };
+    binindex_buffer order = { NULL, 0, 0 };
+    binindex_buffer search = { NULL, 0, 0 };
+    search_builder sb;
+    uint32_t* table = NULL;
+    binindex_header header;
+    uint32_t count, buckets, mask, i;
+    size_t base;
+    Tcl_DString tmp;
+    int fd;
+    int ok;
+    int result = TCL_ERROR;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "textindex binindex");
+        return TCL_ERROR;
+    }
+    text_path = Tcl_GetString(objv[2]);
+    bin_path = Tcl_GetString(objv[3]);
+
+    /* read through a channel so the system encoding is applied just like
+     * when the text index is read from Tcl */
+    chan = Tcl_OpenFileChannel(interp, text_path, "r", 0);
+    if (!chan) {
+        return TCL_ERROR;
+    }
+    if (Tcl_GetChannelHandle(chan, TCL_READABLE, &handle) != TCL_OK
+            || fstat((int)(intptr_t)handle, &st) != 0) {
+        Tcl_Close(NULL, chan);
+        return binindex_posix_error(interp, "stat", text_path);
+    }
+    contents = Tcl_NewObj();
+    Tcl_IncrRefCount(contents);
+    if (Tcl_ReadChars(chan, contents, -1, 0) < 0) {
+        Tcl_DecrRefCount(contents);
+        Tcl_Close(NULL, chan);
+        return binindex_posix_error(interp, "read", text_path);
+    }
+    Tcl_Close(NULL, chan);
+
+    data = Tcl_GetStringFromObj(contents, &data_len);
+    search_init(&sb);
+    if (binindex_parse(interp, text_path, data, (size_t)data_len, &recs,
+                &order, &sb) != TCL_OK) {
+        goto cleanup;
+    }
+
+    count = (uint32_t)(order.len / sizeof(uint32_t));
+    for (buckets = 16; buckets < count * 2; buckets *= 2);
+    mask = buckets - 1;
+    base = sizeof(header) + order.len + buckets * sizeof(uint32_t);
+
+    /* fill the hash table; a later entry for the same name replaces an
+     * earlier one, as with the quick index */
+    table = (uint32_t*)ckalloc(buckets * sizeof(uint32_t));
+    memset(table, 0, buckets * sizeof(uint32_t));
+    for (i = 0; i < count; i++) {
+        uint32_t offset;
+        binindex_record rec;
+        const char* name;
+        uint32_t name_len;
+        uint32_t slot;
+
+        memcpy(&offset, order.data + i * sizeof(uint32_t), sizeof(offset));
+        memcpy(&rec, recs.data + offset, sizeof(rec));
+        name = record_name(recs.data, offset, &name_len);
+        for (slot = rec.hash & mask; table[slot]; slot = (slot + 1) & mask) {
+            uint32_t other = table[slot] - (uint32_t)base;
+            const char* other_name;
+            uint32_t other_len;
+            other_name = record_name(recs.data, other, &other_len);
+            if (other_len == name_len
+                    && strncasecmp(other_name, name, name_len) == 0) {
+                break;
+            }
+        }
+        table[slot] = offset + (uint32_t)base;
+        offset += (uint32_t)base;
+        memcpy(order.data + i * sizeof(uint32_t), &offset, sizeof(offset));
+    }
+
+    search_write(&sb, count, &search);
+    if (base + recs.len + search.len > UINT32_MAX) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                    "port index too large: %s", text_path));
+        goto cleanup;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BININDEX_MAGIC, sizeof(header.magic));
+    header.byte_order = BININDEX_BYTE_ORDER;
+    header.version = BININDEX_VERSION;
+    header.count = count;
+    header.buckets = buckets;
+    header.order_offset = sizeof(header);
+    header.table_offset = (uint32_t)(sizeof(header) + order.len);
+    header.index_size = (uint64_t)st.st_size;
+    header.index_mtime = (int64_t)st.st_mtime;
+    header.file_size = base + recs.len + search.len;
+    header.search_offset = (uint32_t)(base + recs.len);
+
+    /* write to a temporary file and rename it into place, so that
+     * processes that have the old index mapped are not affected */
+    Tcl_DStringInit(&tmp);
+    Tcl_DStringAppend(&tmp, bin_path, -1);
+    Tcl_DStringAppend(&tmp, ".XXXXXX", -1);
+    fd = mkstemp(Tcl_DStringValue(&tmp));
+    if (fd == -1) {
+        binindex_posix_error(interp, "create", Tcl_DStringValue(&tmp));
+        Tcl_DStringFree(&tmp);
+        goto cleanup;
+    }
+    ok = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header)
+        && write(fd, order.data, order.len) == (ssize_t)order.len
+        && write(fd, table, buckets * sizeof(uint32_t))
+            == (ssize_t)(buckets * sizeof(uint32_t))
+        && write(fd, recs.data, recs.len) == (ssize_t)recs.len
+        && write(fd, search.data, search.len) == (ssize_t)search.len
+        && fchmod(fd, 0644) == 0;
+    if (close(fd) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        binindex_posix_error(interp, "write", Tcl_DStringValue(&tmp));
+        unlink(Tcl_DStringValue(&tmp));
+        Tcl_DStringFree(&tmp);
+        goto cleanup;
+    }
+    if (rename(Tcl_DStringValue(&tmp), bin_path) != 0) {
+        binindex_posix_error(interp, "rename", Tcl_DStringValue(&tmp));
+        unlink(Tcl_DStringValue(&tmp));
+        Tcl_DStringFree(&tmp);
+        goto cleanup;
+    }
+    Tcl_DStringFree(&tmp);
+    result = TCL_OK;
+
+cleanup:
+    Tcl_DecrRefCount(contents);
+    search_free(&sb);
+    buffer_free(&recs);
+    buffer_free(&order);
+    buffer_free(&search);
+    if (table) {
+        ckfree((char*)table);
+    }
+    return result;
+}
+
+/**
+ * Reads a length prefixed string at *cursor, making sure it lies before
+ * end, and advances the cursor past it.
+ */
+static int read_string(const char** cursor, const char* end, const char** str,
+        uint32_t* len) {
+    const char* p = *cursor;
+    if (end - p < (ptrdiff_t)sizeof(uint32_t)) {
+        return 0;
+    }
+    memcpy(len, p, sizeof(*len));
+    p += sizeof(uint32_t);
+    if ((size_t)(end - p) <= *len || p[*len] != '\0') {
+        return 0;
+    }
+    *str = p;
+    *cursor = *cursor + ALIGN4(sizeof(uint32_t) + *len + 1);
+    return 1;
+}
+
+/**
+ * Returns the record at offset, or NULL if it doesn't fit into the index.
+ * On success, *end points just past the record.
+ */
+static const binindex_record* get_record(binindex* index, uint32_t offset,
+        const char** end) {
+    const binindex_record* rec;
+    if (offset % 4 != 0 || offset < sizeof(binindex_header)
+            || index->size - offset < sizeof(binindex_record)) {
+        return NULL;
+    }
+    rec = (const binindex_record*)(index->map + offset);
+    if (rec->size < sizeof(binindex_record)
+            || index->size - offset < rec->size) {
+        return NULL;
+    }
+    *end = index->map + offset + rec->size;
+    return rec;
+}
+
+/**
+ * Creates a {name info} list from the record at offset.
+ */
+static int record_obj(Tcl_Interp* interp, binindex* index, uint32_t offset,
+        Tcl_Obj** result) {
+    const char* end;
+    const binindex_record* rec = get_record(index, offset, &end);
+    const char* cursor;
+    const char* str;
+    uint32_t len, i;
+    Tcl_Obj* elems[2];
+
+    if (!rec) {
+        return binindex_corrupt(interp, Tcl_GetCommandName(interp,
+                    index->token));
+    }
+    cursor = (const char*)(rec + 1);
+    if (!read_string(&cursor, end, &str, &len)) {
+        return binindex_corrupt(interp, Tcl_GetCommandName(interp,
+                    index->token));
+    }
+    elems[0] = Tcl_NewStringObj(str, (int)len);
+    elems[1] = Tcl_NewListObj(0, NULL);
+    for (i = 0; i < rec->pair_count * 2; i++) {
+        if (!read_string(&cursor, end, &str, &len)) {
+            Tcl_DecrRefCount(elems[0]);
+            Tcl_DecrRefCount(elems[1]);
+            return binindex_corrupt(interp, Tcl_GetCommandName(interp,
+                        index->token));
+        }
+        Tcl_ListObjAppendElement(NULL, elems[1],
+                Tcl_NewStringObj(str, (int)len));
+    }
+    *result = Tcl_NewListObj(2, elems);
+    return TCL_OK;
+}
+
+/**
+ * Finds the record for the given port name, returning its offset or 0 if
+ * there is none.
+ */
+static uint32_t binindex_find(binindex* index, const char* name,
+        size_t name_len) {
+    uint32_t hash = binindex_hash(name, name_len);
+    uint32_t mask = index->header->buckets - 1;
+    uint32_t slot = hash & mask;
+    uint32_t probes;
+
+    for (probes = 0; probes < index->header->buckets; probes++) {
+        uint32_t offset = index->table[slot];
+        const binindex_record* rec;
+        const char* end;
+        const char* cursor;
+        const char* str;
+        uint32_t len;
+
+        if (offset == 0) {
+            break;
+        }
+        rec = get_record(index, offset, &end);
+        if (rec && rec->hash == hash) {
+            cursor = (const char*)(rec + 1);
+            if (read_string(&cursor, end, &str, &len) && len == name_len
+                    && strncasecmp(str, name, len) == 0) {
+                return offset;
+            }
+        }
+        slot = (slot + 1) & mask;
+    }
+    return 0;
+}
+
+/* Literal text collected while looking for trigrams in a search pattern */
+typedef struct {
+    Tcl_DString run;
+    binindex_buffer keys;
+} pattern_literals;
+
+/**
+ * Adds a character that the pattern requires to directly follow the
+ * previous one. Non-ASCII characters end the run, as they aren't indexed.
+ */
+static void literals_add(pattern_literals* lit, char c) {
+    if ((unsigned char)c >= 0x80) {
+        Tcl_DStringSetLength(&lit->run, 0);
+        return;
+    }
+    Tcl_DStringAppend(&lit->run, &c, 1);
+}
+
+/**
+ * Removes the last character of the run, for a character that turns out to
+ * be optional.
+ */
+static void literals_drop(pattern_literals* lit) {
+    int len = Tcl_DStringLength(&lit->run);
+    if (len > 0) {
+        Tcl_DStringSetLength(&lit->run, len - 1);
+    }
+}
+
+/**
+ * Ends the current run, adding its trigrams to the required ones.
+ */
+static void literals_flush(pattern_literals* lit) {
+    const char* run = Tcl_DStringValue(&lit->run);
+    int len = Tcl_DStringLength(&lit->run);
+    int i;
+    for (i = 0; i + 3 <= len; i++) {
+        uint32_t key = trigram_key(run + i);
+        buffer_append_bytes(&lit->keys, &key, sizeof(key));
+    }
+    Tcl_DStringSetLength(&lit->run, 0);
+}
+
+/**
+ * Skips a bracket expression, p pointing just after the opening bracket.
+ * Returns a pointer after the closing bracket, or NULL if there is none.
+ */
+static const char* skip_bracket(const char* p, const char* end) {
+    if (p < end && *p == '^') {
+        p++;
+    }
+    if (p < end && *p == ']') {
+        p++;
+    }
+    while (p < end) {
+        if (*p == '[' && p + 1 < end
+                && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+            char delim = p[1];
+            for (p += 2; p + 1 < end && !(p[0] == delim && p[1] == ']'); p++);
+            if (p + 1 >= end) {
+                return NULL;
+            }
+            p += 2;
+        } else if (*p == '\\') {
+            p += 2;
+        } else if (*p == ']') {
+            return p + 1;
+        } else {
+            p++;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Collects the literals a regular expression requires, up to the closing
+ * parenthesis of the current group if depth > 0. Only a conservative subset
+ * is understood; returns 0 if the expression can't be used for filtering,
+ * e.g. because of alternatives.
+ */
+static int regexp_literals(const char** pp, const char* end, int depth,
+        pattern_literals* lit) {
+    const char* p = *pp;
+    while (p < end) {
+        switch (*p) {
+            case '|':
+                return 0;
+            case '(':
+                {
+                    pattern_literals group;
+                    int ok;
+                    if (p + 1 < end && p[1] == '?') {
+                        /* options, lookahead constraints etc. */
+                        return 0;
+                    }
+                    literals_flush(lit);
+                    Tcl_DStringInit(&group.run);
+                    memset(&group.keys, 0, sizeof(group.keys));
+                    p++;
+                    ok = regexp_literals(&p, end, depth + 1, &group);
+                    /* an optional group doesn't require anything */
+                    if (ok && !(p < end
+                                && (*p == '?' || *p == '*' || *p == '{'))
+                            && group.keys.len > 0) {
+                        buffer_append_bytes(&lit->keys, group.keys.data,
+                                group.keys.len);
+                    }
+                    Tcl_DStringFree(&group.run);
+                    buffer_free(&group.keys);
+                    if (!ok) {
+                        return 0;
+                    }
+                }
+                break;
+            case ')':
+                if (depth == 0) {
+                    return 0;
+                }
+                literals_flush(lit);
+                *pp = p + 1;
+                return 1;
+            case '\\':
+                /* escapes of letters and digits are classes, constraints,
+                 * back references or character codes */
+                if (p + 1 >= end || isalnum((unsigned char)p[1])) {
+                    return 0;
+                }
+                literals_add(lit, p[1]);
+                p += 2;
+                break;
+            case '[':
+                literals_flush(lit);
+                p = skip_bracket(p + 1, end);
+                if (!p) {
+                    return 0;
+                }
+                break;
+            case '*':
+            case '?':
+                literals_drop(lit);
+                literals_flush(lit);
+                p++;
+                break;
+            case '{':
+                literals_drop(lit);
+                literals_flush(lit);
+                p = memchr(p, '}', (size_t)(end - p));
+                if (!p) {
+                    return 0;
+                }
+                p++;
+                break;
+            case '+':
+            case '.':
+            case '^':
+            case '$':
+                literals_flush(lit);
+                p++;
+                break;
+            default:
+                literals_add(lit, *p);
+                p++;
+                break;
+        }
+    }
+    if (depth > 0) {
+        return 0;
+    }
+    literals_flush(lit);
+    *pp = p;
+    return 1;
+}
+
+/**
+ * Collects the literals a glob pattern as used by string match requires.
+ */
+static int glob_literals(const char* p, const char* end,
+        pattern_literals* lit) {
+    while (p < end) {
+        switch (*p) {
+            case '*':
+            case '?':
+                literals_flush(lit);
+                p++;
+                break;
+            case '[':
+                literals_flush(lit);
+                p = skip_bracket(p + 1, end);
+                if (!p) {
+                    return 0;
+                }
+                break;
+            case '\\':
+                if (p + 1 >= end) {
+                    return 0;
+                }
+                literals_add(lit, p[1]);
+                p += 2;
+                break;
+            default:
+                literals_add(lit, *p);
+                p++;
+                break;
+        }
+    }
+    literals_flush(lit);
+    return 1;
+}
+
+static int compare_keys(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Returns a pointer to size bytes at offset in the search section, or NULL
+ * if they aren't within the index.
+ */
+static const char* search_data(binindex* index, uint32_t offset,
+        uint64_t size) {
+    uint64_t start = (uint64_t)index->header->search_offset + offset;
+    if (start > index->size || index->size - start < size) {
+        return NULL;
+    }
+    return index->map + start;
+}
+
+/**
+ * Finds the candidates for a search on field with the given style and
+ * pattern, i.e. the numbers of the entries that contain all trigrams the
+ * pattern requires. Sets *filtered to 0 if the index doesn't help for this
+ * search, in which case all entries have to be checked.
+ */
+static int binindex_candidates(Tcl_Interp* interp, binindex* index,
+        const char* field_name, const char* style, const char* pattern,
+        int* filtered, Tcl_Obj** result) {
+    pattern_literals lit;
+    const char* end = pattern + strlen(pattern);
+    const binindex_field* field = NULL;
+    const binindex_trigram* table;
+    const uint32_t* unindexed;
+    const binindex_trigram** lists = NULL;
+    uint32_t* candidates = NULL;
+    uint32_t* keys;
+    size_t key_count, list_count = 0, candidate_count = 0, i, j;
+    uint32_t field_count;
+    const char* data;
+    int ok;
+
+    *filtered = 0;
+    *result = Tcl_NewListObj(0, NULL);
+    if (index->header->search_offset == 0) {
+        return TCL_OK;
+    }
+
+    data = search_data(index, 0, sizeof(uint32_t));
+    if (!data) {
+        goto corrupt;
+    }
+    memcpy(&field_count, data, sizeof(field_count));
+    data = search_data(index, 2 * sizeof(uint32_t),
+            (uint64_t)field_count * sizeof(binindex_field));
+    if (!data) {
+        goto corrupt;
+    }
+    for (i = 0; i < field_count; i++) {
+        const binindex_field* f = (const binindex_field*)data + i;
+        const char* cursor = search_data(index, f->name_offset, 0);
+        const char* str;
+        uint32_t len;
+        if (!cursor || !read_string(&cursor, index->map + index->size, &str,
+                    &len)) {
+            goto corrupt;
+        }
+        if (strcmp(str, field_name) == 0) {
+            field = f;
+            break;
+        }
+    }
+    if (!field) {
+        return TCL_OK;
+    }
+
+    Tcl_DStringInit(&lit.run);
+    memset(&lit.keys, 0, sizeof(lit.keys));
+    if (strcmp(style, "exact") == 0) {
+        for (data = pattern; data < end; data++) {
+            literals_add(&lit, *data);
+        }
+        literals_flush(&lit);
+        ok = 1;
+    } else if (strcmp(style, "glob") == 0) {
+        ok = glob_literals(pattern, end, &lit);
+    } else if (strcmp(style, "regexp") == 0
+            && strncmp(pattern, "***", 3) != 0) {
+        data = pattern;
+        ok = regexp_literals(&data, end, 0, &lit);
+    } else {
+        ok = 0;
+    }
+    Tcl_DStringFree(&lit.run);
+    keys = (uint32_t*)lit.keys.data;
+    key_count = lit.keys.len / sizeof(uint32_t);
+    if (!ok || key_count == 0) {
+        buffer_free(&lit.keys);
+        return TCL_OK;
+    }
+    qsort(keys, key_count, sizeof(uint32_t), compare_keys);
+
+    table = (const binindex_trigram*)search_data(index, field->table_offset,
+            (uint64_t)field->buckets * sizeof(binindex_trigram));
+    unindexed = (const uint32_t*)search_data(index, field->unindexed_offset,
+            (uint64_t)field->unindexed_count * sizeof(uint32_t));
+    if (!table || !unindexed || field->buckets == 0
+            || (field->buckets & (field->buckets - 1)) != 0) {
+        buffer_free(&lit.keys);
+        goto corrupt;
+    }
+
+    /* look up the record lists of all required trigrams; a trigram that
+     * doesn't occur anywhere leaves only the unindexed records */
+    lists = (const binindex_trigram**)ckalloc(key_count
+            * sizeof(binindex_trigram*));
+    for (i = 0; i < key_count; i++) {
+        uint32_t mask = field->buckets - 1;
+        uint32_t slot = trigram_slot(keys[i], mask);
+        uint32_t probes;
+        const binindex_trigram* found = NULL;
+        if (i > 0 && keys[i] == keys[i - 1]) {
+            continue;
+        }
+        for (probes = 0; probes < field->buckets && table[slot].key;
+                probes++, slot = (slot + 1) & mask) {
+            if (table[slot].key == keys[i]) {
+                found = &table[slot];
+                break;
+            }
+        }
+        if (!found) {
+            list_count = 0;
+            *filtered = 1;
+            break;
+        }
+        if (found->offset != 0) {
+            /* keep the lists sorted by length, shortest first */
+            for (j = list_count; j > 0 && lists[j - 1]->count > found->count;
+                    j--) {
+                lists[j] = lists[j - 1];
+            }
+            lists[j] = found;
+            list_count++;
+        }
+    }
+    buffer_free(&lit.keys);
+    if (list_count > 0) {
+        *filtered = 1;
+    }
+
+    /* intersect the record lists */
+    for (i = 0; i < list_count; i++) {
+        const unsigned char* cursor = (const unsigned char*)search_data(index,
+                lists[i]->offset, lists[i]->size);
+        const unsigned char* list_end;
+        uint32_t recno = 0, n;
+        size_t kept = 0;
+        if (!cursor) {
+            goto corrupt;
+        }
+        list_end = cursor + lists[i]->size;
+        if (i == 0) {
+            candidates = (uint32_t*)ckalloc((lists[0]->count + 1)
+                    * sizeof(uint32_t));
+        }
+        j = 0;
+        for (n = 0; n < lists[i]->count; n++) {
+            uint32_t delta;
+            if (!read_varint(&cursor, list_end, &delta)) {
+                goto corrupt;
+            }
+            recno += delta;
+            if (i == 0) {
+                candidates[kept++] = recno;
+                continue;
+            }
+            while (j < candidate_count && candidates[j] < recno) {
+                j++;
+            }
+            if (j == candidate_count) {
+                break;
+            }
+            if (candidates[j] == recno) {
+                candidates[kept++] = recno;
+                j++;
+            }
+        }
+        candidate_count = kept;
+        if (candidate_count == 0) {
+            break;
+        }
+    }
+
+    if (*filtered) {
+        /* merge in the records that are always candidates */
+        i = j = 0;
+        while (i < candidate_count || j < field->unindexed_count) {
+            uint32_t recno;
+            if (j == field->unindexed_count
+                    || (i < candidate_count && candidates[i] < unindexed[j])) {
+                recno = candidates[i++];
+            } else {
+                if (i < candidate_count && candidates[i] == unindexed[j]) {
+                    i++;
+                }
+                recno = unindexed[j++];
+            }
+            if (recno >= index->header->count) {
+                goto corrupt;
+            }
+            Tcl_ListObjAppendElement(NULL, *result,
+                    Tcl_NewWideIntObj(recno));
+        }
+    }
+
+    if (lists) {
+        ckfree((char*)lists);
+    }
+    if (candidates) {
+        ckfree((char*)candidates);
+    }
+    return TCL_OK;
+
+corrupt:
+    if (lists) {
+        ckfree((char*)lists);
+    }
+    if (candidates) {
+        ckfree((char*)candidates);
+    }
+    Tcl_DecrRefCount(*result);
+    *result = NULL;
+    return binindex_corrupt(interp, Tcl_GetCommandName(interp, index->token));
+}
+
+static void BinindexDeleteProc(ClientData clientData) {
+    binindex* index = (binindex*)clientData;
+    munmap(index->map, index->size);
+    ckfree((char*)index);
+}
+
+/**
+ * $index subcommand ?arg ...?
+ */
+static int BinindexObjCmd(ClientData clientData, Tcl_Interp* interp,
+        int objc, Tcl_Obj* CONST objv[]) {
+    binindex* index = (binindex*)clientData;
+    static const char* cmds[] = {
+        "lookup", "entry", "names", "list", "count", "candidates", "close",
+        NULL
+    };
+    enum { LOOKUP, ENTRY, NAMES, LIST, COUNT, CANDIDATES, CLOSE } cmd;
+    Tcl_Obj* result;
+    Tcl_Obj* obj;
+    uint32_t i;
+
+    if (objc < 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "cmd ?arg ...?");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], cmds, "cmd", 0, (int*)&cmd)
+            != TCL_OK) {
+        return TCL_ERROR;
+    }
+    switch (cmd) {
+        case LOOKUP:
+            {
+                int name_len;
+                const char* name;
+                uint32_t offset;
+                if (objc != 3) {
+                    Tcl_WrongNumArgs(interp, 2, objv, "name");
+                    return TCL_ERROR;
+                }
+                name = Tcl_GetStringFromObj(objv[2], &name_len);
+                offset = binindex_find(index, name, (size_t)name_len);
+                if (offset == 0) {
+                    return TCL_OK;
+                }
+                if (record_obj(interp, index, offset, &obj) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                Tcl_SetObjResult(interp, obj);
+                return TCL_OK;
+            }
+        case ENTRY:
+            {
+                int n;
+                if (objc != 3) {
+                    Tcl_WrongNumArgs(interp, 2, objv, "index");
+                    return TCL_ERROR;
+                }
+                if (Tcl_GetIntFromObj(interp, objv[2], &n) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                if (n < 0 || (uint32_t)n >= index->header->count) {
+                    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                                "entry %d out of range", n));
+                    return TCL_ERROR;
+                }
+                if (record_obj(interp, index, index->order[n], &obj)
+                        != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                Tcl_SetObjResult(interp, obj);
+                return TCL_OK;
+            }
+        case NAMES:
+        case LIST:
+            if (objc != 2) {
+                Tcl_WrongNumArgs(interp, 2, objv, NULL);
+                return TCL_ERROR;
+            }
+            result = Tcl_NewListObj(0, NULL);
+            for (i = 0; i < index->header->count; i++) {
+                if (cmd == NAMES) {
+                    const char* end;
+                    const char* cursor;
+                    const char* str;
+                    uint32_t len;
+                    const binindex_record* rec = get_record(index,
+                            index->order[i], &end);
+                    cursor = rec ? (const char*)(rec + 1) : NULL;
+                    if (!rec || !read_string(&cursor, end, &str, &len)) {
+                        Tcl_DecrRefCount(result);
+                        return binindex_corrupt(interp,
+                                Tcl_GetString(objv[0]));
+                    }
+                    Tcl_ListObjAppendElement(NULL, result,
+                            Tcl_NewStringObj(str, (int)len));
+                } else {
+                    if (record_obj(interp, index, index->order[i], &obj)
+                            != TCL_OK) {
+                        Tcl_DecrRefCount(result);
+                        return TCL_ERROR;
+                    }
+                    Tcl_ListObjAppendList(NULL, result, obj);
+                    Tcl_DecrRefCount(obj);
+                }
+            }
+            Tcl_SetObjResult(interp, result);
+            return TCL_OK;
+        case COUNT:
+            if (objc != 2) {
+                Tcl_WrongNumArgs(interp, 2, objv, NULL);
+                return TCL_ERROR;
+            }
+            Tcl_SetObjResult(interp, Tcl_NewWideIntObj(index->header->count));
+            return TCL_OK;
+        case CANDIDATES:
+            {
+                int filtered;
+                Tcl_Obj* elems[2];
+                if (objc != 5) {
+                    Tcl_WrongNumArgs(interp, 2, objv,
+                            "field matchstyle pattern");
+                    return TCL_ERROR;
+                }
+                if (binindex_candidates(interp, index, Tcl_GetString(objv[2]),
+                            Tcl_GetString(objv[3]), Tcl_GetString(objv[4]),
+                            &filtered, &obj) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                elems[0] = Tcl_NewBooleanObj(filtered);
+                elems[1] = obj;
+                Tcl_SetObjResult(interp, Tcl_NewListObj(2, elems));
+                return TCL_OK;
+            }
+        case CLOSE:
+            if (objc != 2) {
+                Tcl_WrongNumArgs(interp, 2, objv, NULL);
+                return TCL_ERROR;
+            }
+            Tcl_DeleteCommandFromToken(interp, index->token);
+            return TCL_OK;
+    }
+    return TCL_OK;
+}
+
+/**
+ * binindex open binindex ?textindex?
+ */
+static int BinindexOpenCmd(Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    static unsigned int next_id = 0;
+    const char* bin_path;
+    const binindex_header* header;
+    binindex* index;
+    struct stat st;
+    char* map;
+    char cmd_name[32];
+    int fd;
+
+    if (objc != 3 && objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "binindex ?textindex?");
+        return TCL_ERROR;
+    }
+    bin_path = Tcl_GetString(objv[2]);
+
+    fd = open(bin_path, O_RDONLY);
+    if (fd == -1) {
+        return binindex_posix_error(interp, "open", bin_path);
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return binindex_posix_error(interp, "stat", bin_path);
+    }
+    if ((size_t)st.st_size < sizeof(binindex_header)) {
+        close(fd);
+        return binindex_corrupt(interp, bin_path);
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return binindex_posix_error(interp, "map", bin_path);
+    }
+
+    header = (const binindex_header*)map;
+    if (memcmp(header->magic, BININDEX_MAGIC, sizeof(header->magic)) != 0
+            || header->byte_order != BININDEX_BYTE_ORDER
+            || header->version != BININDEX_VERSION
+            || header->file_size != (uint64_t)st.st_size
+            || header->buckets == 0
+            || (header->buckets & (header->buckets - 1)) != 0
+            || header->order_offset != sizeof(binindex_header)
+            || header->table_offset < header->order_offset
+            || (header->table_offset - header->order_offset)
+                / sizeof(uint32_t) != header->count
+            || (uint64_t)st.st_size - header->table_offset
+                < (uint64_t)header->buckets * sizeof(uint32_t)
+            || header->search_offset % 4 != 0
+            || header->search_offset > (uint64_t)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        return binindex_corrupt(interp, bin_path);
+    }
+
+    if (objc == 4) {
+        const char* text_path = Tcl_GetString(objv[3]);
+        struct stat text_st;
+        if (stat(text_path, &text_st) != 0) {
+            munmap(map, (size_t)st.st_size);
+            return binindex_posix_error(interp, "stat", text_path);
+        }
+        if (header->index_size != (uint64_t)text_st.st_size
+                || header->index_mtime != (int64_t)text_st.st_mtime) {
+            munmap(map, (size_t)st.st_size);
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                        "binary index %s is out of date", bin_path));
+            Tcl_SetErrorCode(interp, "BININDEX", "STALE", NULL);
+            return TCL_ERROR;
+        }
+    }
+
+    index = (binindex*)ckalloc(sizeof(binindex));
+    index->map = map;
+    index->size = (size_t)st.st_size;
+    index->header = header;
+    index->order = (const uint32_t*)(map + header->order_offset);
+    index->table = (const uint32_t*)(map + header->table_offset);
+    snprintf(cmd_name, sizeof(cmd_name), "binindex%u", next_id++);
+    index->token = Tcl_CreateObjCommand(interp, cmd_name, BinindexObjCmd,
+            index, BinindexDeleteProc);
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(cmd_name, -1));
+    return TCL_OK;
+}
+
+/**
+ * binindex command entry point.
+ *
+ * @param interp		current interpreter
+ * @param objc			number of parameters
+ * @param objv			parameters
+ */
+int BinindexCmd(ClientData clientData UNUSED, Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    static const char* cmds[] = { "create", "open", NULL };
+    enum { CREATE, OPEN } cmd;
+
+    if (objc < 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "cmd ?arg ...?");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], cmds, "cmd", 0, (int*)&cmd)
+            != TCL_OK) {
+        return TCL_ERROR;
+    }
+    switch (cmd) {
+        case CREATE:
+            return BinindexCreateCmd(interp, objc, objv);
+        case OPEN:
+            return BinindexOpenCmd(interp, objc, objv);
+    }
+    return TCL_OK;
+}
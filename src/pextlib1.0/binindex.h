@@ -0,0 +1,76 @@
+/*
+ * binindex.h
+ *
+ * Copyright (c) 2026 The MacPorts Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of MacPorts Team nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _BININDEX_H
+#define _BININDEX_H
+
+#include <tcl.h>
+
+/**
+ * A native command to create and read binary PortIndex files.
+ *
+ * The syntax is:
+ * binindex create textindex binindex
+ *	Convert the PortIndex at textindex into a binary index written to
+ *  binindex. The binary index remembers the size and modification time of
+ *  the text index it was built from.
+ *
+ * binindex open binindex ?textindex?
+ *	Map binindex into memory and return the name of a new command giving
+ *  access to it. If textindex is given, fail with errorCode BININDEX STALE
+ *  unless binindex was built from the current version of textindex.
+ *
+ * The returned command supports:
+ * $index lookup name
+ *	Return {name info} for the port with the given name, where info is the
+ *  PortInfo list as stored in the PortIndex, or an empty list if there is
+ *  no such port. Names are matched case-insensitively.
+ * $index entry n
+ *	Return {name info} for the nth port in PortIndex order.
+ * $index names
+ *	Return the names of all ports in PortIndex order.
+ * $index list
+ *	Return name info pairs for all ports in PortIndex order.
+ * $index count
+ *	Return the number of ports.
+ * $index candidates field matchstyle pattern
+ *	Use the search index to narrow down which ports may match a search for
+ *  pattern (interpreted according to matchstyle, exact, glob or regexp, as
+ *  in mportsearch) in field. Returns a list of a boolean and the numbers of
+ *  the candidate entries; if the boolean is false, the index can't help and
+ *  all entries need to be checked. Candidates still have to be matched
+ *  against the pattern.
+ * $index close
+ *	Unmap the index and delete the command.
+ */
+int BinindexCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
+
+#endif /* _BININDEX_H */
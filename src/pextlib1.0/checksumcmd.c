@@ -0,0 +1,551 @@
+/*
+ * checksumcmd.c
+ *
+ * Copyright (c) 2026 The MacPorts Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of MacPorts Team nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* required for posix_memalign(3), posix_fadvise(2) and st_mtim */
+#define _XOPEN_SOURCE 700
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <tcl.h>
+
+#include "checksumcmd.h"
+#include "md5cmd.h"
+#include "rmd160cmd.h"
+#include "sha1cmd.h"
+#include "sha256cmd.h"
+
+/*
+ * Files are read in large chunks into a page aligned buffer, and each chunk
+ * is given to all the requested digests before the next one is read, so
+ * that every file is read only once whatever the number of checksums. The
+ * worker threads of checksum files each have their own buffer and never
+ * call Tcl; results are turned into Tcl objects once they're all done.
+ */
+
+#define CHECKSUM_BUFFER_SIZE (1024 * 1024)
+#define CHECKSUM_BUFFER_ALIGN 4096
+/* longest hex digest, sha256, and its terminating NUL */
+#define CHECKSUM_MAX_LENGTH 65
+
+/* file times in nanoseconds, or in seconds where there are none */
+#if defined(__APPLE__)
+#define CHECKSUM_NSEC(st, time) \
+    ((Tcl_WideInt)(st).time##spec.tv_sec * 1000000000 + (st).time##spec.tv_nsec)
+#elif defined(_POSIX_VERSION) && _POSIX_VERSION >= 200809L
+#define CHECKSUM_NSEC(st, time) \
+    ((Tcl_WideInt)(st).time.tv_sec * 1000000000 + (st).time.tv_nsec)
+#else
+#define CHECKSUM_NSEC(st, time) ((Tcl_WideInt)(st).time##e * 1000000000)
+#endif
+
+/* in the order of checksum_type_names */
+typedef enum {
+    CHECKSUM_MD5, CHECKSUM_SHA1, CHECKSUM_RMD160, CHECKSUM_SHA256, CHECKSUM_SIZE
+} checksum_type;
+
+static const char* checksum_type_names[] = {
+    "md5", "sha1", "rmd160", "sha256", "size", NULL
+};
+
+static const checksum_type checksum_default_types[] = {
+    CHECKSUM_SHA256, CHECKSUM_RMD160, CHECKSUM_SIZE
+};
+
+typedef struct {
+    /* the stream of each requested type, NULL for size */
+    void** streams;
+    /* the hex digest of each requested type, unused for size */
+    char (*values)[CHECKSUM_MAX_LENGTH];
+    /* number of bytes read */
+    Tcl_WideInt size;
+    /* errno of the failure, 0 on success */
+    int error;
+} checksum_result;
+
+typedef struct {
+    const checksum_type* types;
+    int types_count;
+    const char** paths;
+    checksum_result* results;
+    int paths_count;
+    /* next path to be read by a worker thread */
+    int next;
+    pthread_mutex_t mutex;
+} checksum_job;
+
+/**
+ * End all streams of result, writing their digests to result->values.
+ */
+static void checksum_streams_end(const checksum_type* types, int types_count,
+        checksum_result* result) {
+    int i;
+
+    for (i = 0; i < types_count; i++) {
+        switch (types[i]) {
+            case CHECKSUM_MD5:
+                MD5StreamEnd(result->streams[i], result->values[i]);
+                break;
+            case CHECKSUM_SHA1:
+                SHA1StreamEnd(result->streams[i], result->values[i]);
+                break;
+            case CHECKSUM_RMD160:
+                RMD160StreamEnd(result->streams[i], result->values[i]);
+                break;
+            case CHECKSUM_SHA256:
+                SHA256StreamEnd(result->streams[i], result->values[i]);
+                break;
+            case CHECKSUM_SIZE:
+                break;
+        }
+        result->streams[i] = NULL;
+    }
+}
+
+/**
+ * Create the streams of all types in result->streams. Return 0 or ENOMEM,
+ * in which case no stream is left allocated.
+ */
+static int checksum_streams_new(const checksum_type* types, int types_count,
+        checksum_result* result) {
+    int i;
+
+    for (i = 0; i < types_count; i++) {
+        switch (types[i]) {
+            case CHECKSUM_MD5:
+                result->streams[i] = MD5StreamNew();
+                break;
+            case CHECKSUM_SHA1:
+                result->streams[i] = SHA1StreamNew();
+                break;
+            case CHECKSUM_RMD160:
+                result->streams[i] = RMD160StreamNew();
+                break;
+            case CHECKSUM_SHA256:
+                result->streams[i] = SHA256StreamNew();
+                break;
+            case CHECKSUM_SIZE:
+                continue;
+        }
+        if (result->streams[i] == NULL) {
+            /* ending the streams is the only way to free them */
+            checksum_streams_end(types, i, result);
+            return ENOMEM;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Give data to all streams of result.
+ */
+static void checksum_streams_update(const checksum_type* types,
+        int types_count, checksum_result* result, const unsigned char* data,
+        size_t len) {
+    int i;
+
+    for (i = 0; i < types_count; i++) {
+        switch (types[i]) {
+            case CHECKSUM_MD5:
+                MD5StreamUpdate(result->streams[i], data, len);
+                break;
+            case CHECKSUM_SHA1:
+                SHA1StreamUpdate(result->streams[i], data, len);
+                break;
+            case CHECKSUM_RMD160:
+                RMD160StreamUpdate(result->streams[i], data, len);
+                break;
+            case CHECKSUM_SHA256:
+                SHA256StreamUpdate(result->streams[i], data, len);
+                break;
+            case CHECKSUM_SIZE:
+                break;
+        }
+    }
+    result->size += len;
+}
+
+/**
+ * Read path with buffer and compute its checksums into result, setting
+ * result->error on failure.
+ */
+static void checksum_path(const char* path, const checksum_type* types,
+        int types_count, unsigned char* buffer, checksum_result* result) {
+    ssize_t len;
+    int fd;
+
+    result->size = 0;
+    result->error = 0;
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        result->error = errno;
+        return;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    result->error = checksum_streams_new(types, types_count, result);
+    if (result->error != 0) {
+        close(fd);
+        return;
+    }
+    for (;;) {
+        len = read(fd, buffer, CHECKSUM_BUFFER_SIZE);
+        if (len > 0) {
+            checksum_streams_update(types, types_count, result, buffer,
+                    (size_t)len);
+        } else if (len == 0) {
+            break;
+        } else if (errno != EINTR) {
+            result->error = errno;
+            break;
+        }
+    }
+    /* the streams are freed even if reading failed */
+    checksum_streams_end(types, types_count, result);
+    close(fd);
+}
+
+/**
+ * Allocate the buffer used to read files, or return NULL.
+ */
+static unsigned char* checksum_buffer_new(void) {
+    void* buffer;
+
+    if (posix_memalign(&buffer, CHECKSUM_BUFFER_ALIGN, CHECKSUM_BUFFER_SIZE)
+            != 0) {
+        return NULL;
+    }
+    return buffer;
+}
+
+/**
+ * Worker thread of checksum files: read paths until there are none left.
+ */
+static void* checksum_worker(void* arg) {
+    checksum_job* job = arg;
+    unsigned char* buffer = checksum_buffer_new();
+    int index;
+
+    for (;;) {
+        pthread_mutex_lock(&job->mutex);
+        index = job->next++;
+        pthread_mutex_unlock(&job->mutex);
+        if (index >= job->paths_count) {
+            break;
+        }
+        if (buffer == NULL) {
+            job->results[index].error = ENOMEM;
+        } else {
+            checksum_path(job->paths[index], job->types, job->types_count,
+                    buffer, &job->results[index]);
+        }
+    }
+    free(buffer);
+    return NULL;
+}
+
+/**
+ * Compute the checksums of all paths of job, using up to threads threads.
+ */
+static void checksum_job_run(checksum_job* job, int threads) {
+    pthread_t* workers;
+    int started = 0;
+    int i;
+
+    if (threads > job->paths_count) {
+        threads = job->paths_count;
+    }
+    job->next = 0;
+    pthread_mutex_init(&job->mutex, NULL);
+    workers = threads > 1 ? calloc((size_t)threads, sizeof(*workers)) : NULL;
+    if (workers != NULL) {
+        for (i = 0; i < threads; i++) {
+            if (pthread_create(&workers[i], NULL, checksum_worker, job) != 0) {
+                break;
+            }
+            started++;
+        }
+    }
+    if (started == 0) {
+        /* no threads wanted or none could be started, read everything here */
+        checksum_worker(job);
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_destroy(&job->mutex);
+    free(workers);
+}
+
+/**
+ * Parse a list of checksum types. The array returned in typesPtr must be
+ * freed with ckfree.
+ */
+static int checksum_parse_types(Tcl_Interp* interp, Tcl_Obj* list,
+        checksum_type** typesPtr, int* countPtr) {
+    Tcl_Obj** objv;
+    checksum_type* types;
+    int objc;
+    int i;
+
+    if (Tcl_ListObjGetElements(interp, list, &objc, &objv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (objc == 0) {
+        Tcl_SetResult(interp, "no checksum types given", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    types = (checksum_type*)ckalloc(objc * sizeof(*types));
+    for (i = 0; i < objc; i++) {
+        int index;
+        if (Tcl_GetIndexFromObj(interp, objv[i], checksum_type_names, "type",
+                    0, &index) != TCL_OK) {
+            ckfree((char*)types);
+            return TCL_ERROR;
+        }
+        types[i] = (checksum_type)index;
+    }
+    *typesPtr = types;
+    *countPtr = objc;
+    return TCL_OK;
+}
+
+/**
+ * checksum file and checksum files.
+ */
+static int ChecksumFilesCmd(Tcl_Interp* interp, int many, int objc,
+        Tcl_Obj* CONST objv[]) {
+    static const char* options[] = { "-types", "-threads", NULL };
+    enum { TYPES, THREADS } option;
+    const char* usage = many ? "?-types types? ?-threads n? paths"
+        : "?-types types? path";
+    checksum_type* types = (checksum_type*)checksum_default_types;
+    int types_count = sizeof(checksum_default_types)
+        / sizeof(checksum_default_types[0]);
+    int threads = 1;
+    Tcl_Obj** paths;
+    int paths_count;
+    checksum_job job;
+    void** streams = NULL;
+    char (*values)[CHECKSUM_MAX_LENGTH] = NULL;
+    Tcl_Obj* result = NULL;
+    int status = TCL_ERROR;
+    int i, j;
+
+    memset(&job, 0, sizeof(job));
+    for (i = 2; i < objc - 1; i += 2) {
+        if (Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0,
+                    (int*)&option) != TCL_OK) {
+            goto cleanup;
+        }
+        if ((option == THREADS && !many) || i + 2 >= objc) {
+            Tcl_WrongNumArgs(interp, 2, objv, usage);
+            goto cleanup;
+        }
+        switch (option) {
+            case TYPES:
+                if (types != checksum_default_types) {
+                    ckfree((char*)types);
+                    types = (checksum_type*)checksum_default_types;
+                }
+                if (checksum_parse_types(interp, objv[i + 1], &types,
+                            &types_count) != TCL_OK) {
+                    goto cleanup;
+                }
+                break;
+            case THREADS:
+                if (Tcl_GetIntFromObj(interp, objv[i + 1], &threads)
+                        != TCL_OK) {
+                    goto cleanup;
+                }
+                if (threads < 1) {
+                    Tcl_SetResult(interp, "threads must be at least 1",
+                            TCL_STATIC);
+                    goto cleanup;
+                }
+                break;
+        }
+    }
+    if (i != objc - 1) {
+        Tcl_WrongNumArgs(interp, 2, objv, usage);
+        goto cleanup;
+    }
+    if (many) {
+        if (Tcl_ListObjGetElements(interp, objv[i], &paths_count, &paths)
+                != TCL_OK) {
+            goto cleanup;
+        }
+    } else {
+        paths = (Tcl_Obj**)&objv[i];
+        paths_count = 1;
+    }
+
+    job.types = types;
+    job.types_count = types_count;
+    job.paths_count = paths_count;
+    job.paths = (const char**)ckalloc((paths_count + 1) * sizeof(*job.paths));
+    job.results = (checksum_result*)ckalloc(
+            (paths_count + 1) * sizeof(*job.results));
+    streams = (void**)ckalloc(
+            ((size_t)paths_count * types_count + 1) * sizeof(*streams));
+    values = (char (*)[CHECKSUM_MAX_LENGTH])ckalloc(
+            ((size_t)paths_count * types_count + 1) * sizeof(*values));
+    for (j = 0; j < paths_count; j++) {
+        job.paths[j] = Tcl_GetString(paths[j]);
+        job.results[j].streams = streams + (size_t)j * types_count;
+        job.results[j].values = values + (size_t)j * types_count;
+        job.results[j].error = 0;
+    }
+
+    checksum_job_run(&job, threads);
+
+    result = Tcl_NewListObj(0, NULL);
+    for (j = 0; j < paths_count; j++) {
+        checksum_result* path_result = &job.results[j];
+        Tcl_Obj* list;
+        if (path_result->error != 0) {
+            Tcl_ResetResult(interp);
+            Tcl_AppendResult(interp, "Could not read file: ", job.paths[j],
+                    ": ", strerror(path_result->error), NULL);
+            goto cleanup;
+        }
+        list = Tcl_NewListObj(0, NULL);
+        for (i = 0; i < types_count; i++) {
+            Tcl_ListObjAppendElement(NULL, list,
+                    Tcl_NewStringObj(checksum_type_names[types[i]], -1));
+            if (types[i] == CHECKSUM_SIZE) {
+                Tcl_ListObjAppendElement(NULL, list,
+                        Tcl_NewWideIntObj(path_result->size));
+            } else {
+                Tcl_ListObjAppendElement(NULL, list,
+                        Tcl_NewStringObj(path_result->values[i], -1));
+            }
+        }
+        if (!many) {
+            Tcl_DecrRefCount(result);
+            result = list;
+            break;
+        }
+        Tcl_ListObjAppendElement(NULL, result, list);
+    }
+    Tcl_SetObjResult(interp, result);
+    result = NULL;
+    status = TCL_OK;
+
+cleanup:
+    if (result != NULL) {
+        Tcl_DecrRefCount(result);
+    }
+    if (types != checksum_default_types) {
+        ckfree((char*)types);
+    }
+    if (job.paths != NULL) {
+        ckfree((char*)job.paths);
+        ckfree((char*)job.results);
+        ckfree((char*)streams);
+        ckfree((char*)values);
+    }
+    return status;
+}
+
+/**
+ * checksum fingerprint.
+ */
+static int ChecksumFingerprintCmd(Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    struct stat st;
+    const char* path;
+    Tcl_Obj* result;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "path");
+        return TCL_ERROR;
+    }
+    path = Tcl_GetString(objv[2]);
+    if (stat(path, &st) != 0) {
+        Tcl_AppendResult(interp, "Could not stat file: ", path, ": ",
+                strerror(errno), NULL);
+        return TCL_ERROR;
+    }
+    result = Tcl_NewListObj(0, NULL);
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewWideIntObj(st.st_dev));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewWideIntObj(st.st_ino));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewWideIntObj(st.st_size));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewWideIntObj(
+                CHECKSUM_NSEC(st, st_mtim)));
+    Tcl_ListObjAppendElement(NULL, result, Tcl_NewWideIntObj(
+                CHECKSUM_NSEC(st, st_ctim)));
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
+
+/**
+ * checksum command entry point.
+ *
+ * @param interp		current interpreter
+ * @param objc			number of parameters
+ * @param objv			parameters
+ */
+int ChecksumCmd(ClientData clientData UNUSED, Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    static const char* cmds[] = { "file", "files", "fingerprint", NULL };
+    enum { FILE_, FILES, FINGERPRINT } cmd;
+
+    if (objc < 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "cmd ?arg ...?");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], cmds, "cmd", 0, (int*)&cmd)
+            != TCL_OK) {
+        return TCL_ERROR;
+    }
+    switch (cmd) {
+        case FILE_:
+            return ChecksumFilesCmd(interp, 0, objc, objv);
+        case FILES:
+            return ChecksumFilesCmd(interp, 1, objc, objv);
+        case FINGERPRINT:
+            return ChecksumFingerprintCmd(interp, objc, objv);
+    }
+    return TCL_OK;
+}
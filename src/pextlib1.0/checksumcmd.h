@@ -0,0 +1,61 @@
+/*
+ * checksumcmd.h
+ *
+ * Copyright (c) 2026 The MacPorts Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of MacPorts Team nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _CHECKSUMCMD_H
+#define _CHECKSUMCMD_H
+
+#include <tcl.h>
+
+/**
+ * A native command computing several checksums of files in one pass.
+ *
+ * The syntax is:
+ * checksum file ?-types types? path
+ *	Read path once and return a list of types and values, in the order of
+ *  types, which defaults to {sha256 rmd160 size}. The supported types are
+ *  md5, sha1, rmd160, sha256 and size, the size being the number of bytes
+ *  read.
+ *
+ * checksum files ?-types types? ?-threads n? paths
+ *	Same as checksum file for each of the paths, returning one list per
+ *  path. With -threads, up to n files are read at once by worker threads.
+ *  The default is to read them one after the other.
+ *
+ * checksum fingerprint path
+ *	Return the device, inode, size, modification time and status change
+ *  time of path, the times in nanoseconds where the system records them,
+ *  which checksums cached for a file are only valid for.
+ */
+int ChecksumCmd(ClientData clientData, Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]);
+
+#endif
+	/* _CHECKSUMCMD_H */
@@ -34,6 +34,10 @@
 #include <config.h>
 #endif
 
+/* required for ftruncate(2) and fileno(3) */
+#define _XOPEN_SOURCE 500
+#define _DARWIN_C_SOURCE
+
 #include <ctype.h>
 #include <errno.h>
 #include <pthread.h>
@@ -42,6 +46,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/select.h>
+#include <unistd.h>
 #include <utime.h>
 
 #include <curl/curl.h>
@@ -49,6 +54,8 @@
 #include <tcl.h>
 
 #include "curl.h"
+#include "rmd160cmd.h"
+#include "sha256cmd.h"
 
 /*
  * Some compiled-in constants that we may wish to change later, given more
@@ -81,6 +88,11 @@ static CURLM* theMHandle = NULL;
 /* We use a single global handle rather than creating and destroying handles to
  * take advantage of HTTP pipelining, especially to the packages servers. */
 static CURL* theHandle = NULL;
+/* The transfers of curl fetchmany share DNS lookups and SSL sessions through
+ * this handle. Their connections stay in the pool of theMHandle, so that
+ * consecutive calls can reuse them; sharing those too would bypass its limit
+ * of connections per host. */
+static CURLSH* theSHandle = NULL;
 
 /* ------------------------------------------------------------------------- **
  * Prototypes
@@ -88,6 +100,7 @@ static CURL* theHandle = NULL;
 int SetResultFromCurlErrorCode(Tcl_Interp* interp, CURLcode inErrorCode);
 int SetResultFromCurlMErrorCode(Tcl_Interp* interp, CURLMcode inErrorCode);
 int CurlFetchCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
+int CurlFetchManyCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
 int CurlIsNewerCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
 int CurlGetSizeCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
 int CurlPostCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
@@ -96,8 +109,62 @@ typedef struct {
 	Tcl_Interp *interp;
 	const char *proc;
 	double prevcalltime;
+	CURL *handle;
 } tcl_callback_t;
 
+/* options shared by the transfers of curl fetchmany */
+typedef struct {
+	int useepsv;
+	int ignoresslcert;
+	int remotetime;
+	const char* userPass;
+	const char* userAgent;
+	char* acceptEncoding;
+	struct curl_slist* headers;
+	long candidates;
+	double stagger;
+	bool digests;
+} fetch_options_t;
+
+/* digests of the data written by a transfer of curl fetchmany */
+typedef struct {
+	rmd160_stream_t* rmd160;
+	sha256_stream_t* sha256;
+	Tcl_WideInt size;
+} fetch_digests_t;
+
+struct fetch_transfer;
+
+/* a url of a transfer of curl fetchmany, racing the other urls of the
+ * transfer */
+typedef struct {
+	CURL* handle;
+	const char* url;
+	struct fetch_transfer* transfer;
+	bool added;
+	const char* status;
+	double startTime;
+	double seconds;
+	double bytes;
+	char errorString[CURL_ERROR_SIZE];
+} fetch_candidate_t;
+
+/* state of a transfer of curl fetchmany */
+typedef struct fetch_transfer {
+	FILE* file;
+	const char* path;
+	fetch_candidate_t* candidates;
+	int candidateCount;
+	int started;
+	int running;
+	double lastStart;
+	fetch_candidate_t* winner;
+	bool done;
+	tcl_callback_t progress;
+	fetch_digests_t digests;
+	char errorString[CURL_ERROR_SIZE];
+} fetch_transfer_t;
+
 static int CurlProgressHandler(tcl_callback_t *callback, double dltotal, double dlnow, double ultotal, double ulnow);
 static void CurlProgressCleanup(tcl_callback_t *callback);
 
@@ -180,7 +247,8 @@ CurlFetchCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		tcl_callback_t progressCallback = {
 			.interp = interp,
 			.proc = NULL,
-			.prevcalltime = 0.0
+			.prevcalltime = 0.0,
+			.handle = NULL
 		};
 		char* effectiveURL = NULL;
 		char* userAgent = PACKAGE_NAME "/" PACKAGE_VERSION " libcurl/" LIBCURL_VERSION;
@@ -345,6 +413,7 @@ CurlFetchCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		}
 		/* If we're re-using a handle, the previous call did ensure to reset it
 		 * to the default state using curl_easy_reset(3) */
+		progressCallback.handle = theHandle;
 
 		/* Setup the handle */
 		theCurlCode = curl_easy_setopt(theHandle, CURLOPT_URL, theURL);
@@ -730,6 +799,901 @@ CurlFetchCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 	return theResult;
 }
 
+/**
+ * Return the current time in seconds.
+ */
+static double
+CurlNow(void)
+{
+	Tcl_Time theTime;
+
+	Tcl_GetTime(&theTime);
+	return theTime.sec + theTime.usec / 1000000.0;
+}
+
+/**
+ * Free the digests of a transfer of curl fetchmany.
+ *
+ * @param digests		the digests
+ */
+static void
+CurlFreeDigests(fetch_digests_t* digests)
+{
+	char buf[65];
+
+	if (digests->rmd160 != NULL) {
+		RMD160StreamEnd(digests->rmd160, buf);
+		digests->rmd160 = NULL;
+	}
+	if (digests->sha256 != NULL) {
+		SHA256StreamEnd(digests->sha256, buf);
+		digests->sha256 = NULL;
+	}
+}
+
+/**
+ * Start the digests of a transfer of curl fetchmany over again.
+ *
+ * @param digests		the digests
+ * @return false if out of memory, the digests are then freed.
+ */
+static bool
+CurlResetDigests(fetch_digests_t* digests)
+{
+	CurlFreeDigests(digests);
+	digests->rmd160 = RMD160StreamNew();
+	digests->sha256 = SHA256StreamNew();
+	digests->size = 0;
+	if (digests->rmd160 == NULL || digests->sha256 == NULL) {
+		CurlFreeDigests(digests);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Return the digests of a transfer of curl fetchmany as a list of
+ * algorithms and values, and free them. The digests must not be freed
+ * already.
+ *
+ * @param digests		the digests
+ * @return the list.
+ */
+static Tcl_Obj*
+CurlEndDigests(fetch_digests_t* digests)
+{
+	Tcl_Obj* theList = Tcl_NewListObj(0, NULL);
+	char buf[65];
+
+	RMD160StreamEnd(digests->rmd160, buf);
+	digests->rmd160 = NULL;
+	Tcl_ListObjAppendElement(NULL, theList, Tcl_NewStringObj("rmd160", -1));
+	Tcl_ListObjAppendElement(NULL, theList, Tcl_NewStringObj(buf, -1));
+	SHA256StreamEnd(digests->sha256, buf);
+	digests->sha256 = NULL;
+	Tcl_ListObjAppendElement(NULL, theList, Tcl_NewStringObj("sha256", -1));
+	Tcl_ListObjAppendElement(NULL, theList, Tcl_NewStringObj(buf, -1));
+	Tcl_ListObjAppendElement(NULL, theList, Tcl_NewStringObj("size", -1));
+	Tcl_ListObjAppendElement(NULL, theList, Tcl_NewWideIntObj(digests->size));
+	return theList;
+}
+
+/**
+ * Write callback of the urls of a transfer of curl fetchmany. The first url
+ * to deliver data wins the race and writes to the file of the transfer, the
+ * others are aborted.
+ */
+static size_t
+CurlFetchManyWrite(char* data, size_t size, size_t nmemb, void* userdata)
+{
+	fetch_candidate_t* candidate = (fetch_candidate_t*) userdata;
+	fetch_transfer_t* transfer = candidate->transfer;
+
+	if (transfer->winner == NULL) {
+		transfer->winner = candidate;
+		transfer->progress.handle = candidate->handle;
+	}
+	if (transfer->winner != candidate) {
+		return 0;
+	}
+	/* feed the digests with what was written, so that the file doesn't
+	 * need to be read again to checksum it */
+	nmemb = fwrite(data, size, nmemb, transfer->file);
+	if (transfer->digests.sha256 != NULL) {
+		RMD160StreamUpdate(transfer->digests.rmd160, (const unsigned char*) data, size * nmemb);
+		SHA256StreamUpdate(transfer->digests.sha256, (const unsigned char*) data, size * nmemb);
+		transfer->digests.size += size * nmemb;
+	}
+	return nmemb;
+}
+
+/**
+ * Progress callback of the urls of a transfer of curl fetchmany, only the
+ * url that won the race reports progress.
+ */
+#if LIBCURL_VERSION_NUM >= 0x072000
+static int
+CurlFetchManyProgress(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+#else
+static int
+CurlFetchManyProgress(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow)
+#endif
+{
+	fetch_candidate_t* candidate = (fetch_candidate_t*) clientp;
+
+	if (candidate->transfer->winner != candidate) {
+		return 0;
+	}
+	return CurlProgressHandler(&candidate->transfer->progress, (double) dltotal, (double) dlnow,
+		(double) ultotal, (double) ulnow);
+}
+
+/**
+ * Set up the handle of a url of a transfer of curl fetchmany, like curl
+ * fetch does.
+ *
+ * @param candidate		the url, with its handle
+ * @param options		options shared by the transfers
+ * @return CURLE_OK or the code of the first error.
+ */
+static CURLcode
+CurlSetupFetchManyHandle(fetch_candidate_t* candidate, const fetch_options_t* options)
+{
+	CURL* handle = candidate->handle;
+	CURLcode theCurlCode;
+
+	theCurlCode = curl_easy_setopt(handle, CURLOPT_URL, candidate->url);
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_PRIVATE, candidate);
+	}
+	if (theCurlCode == CURLE_OK && theSHandle != NULL) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_SHARE, theSHandle);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_MAXREDIRS, 50L);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_COOKIEJAR, "/dev/null");
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_FAILONERROR, 1L);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_USERAGENT, options->userAgent);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, _CURL_CONNECTION_TIMEOUT);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_LOW_SPEED_LIMIT, _CURL_MINIMUM_XFER_SPEED);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_LOW_SPEED_TIME, _CURL_MINIMUM_XFER_TIMEOUT);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_HEADER, 0L);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, CurlFetchManyWrite);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_WRITEDATA, candidate);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_NOPROGRESS, (long) (candidate->transfer->progress.proc == NULL));
+	}
+	if (theCurlCode == CURLE_OK && candidate->transfer->progress.proc != NULL) {
+#if LIBCURL_VERSION_NUM >= 0x072000
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_XFERINFODATA, candidate);
+		if (theCurlCode == CURLE_OK) {
+			theCurlCode = curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, CurlFetchManyProgress);
+		}
+#else
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_PROGRESSDATA, candidate);
+		if (theCurlCode == CURLE_OK) {
+			theCurlCode = curl_easy_setopt(handle, CURLOPT_PROGRESSFUNCTION, CurlFetchManyProgress);
+		}
+#endif
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_FTP_USE_EPSV, (long) options->useepsv);
+	}
+	if (theCurlCode == CURLE_OK && options->ignoresslcert) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_SSL_VERIFYPEER, (long) 0);
+		if (theCurlCode == CURLE_OK) {
+			theCurlCode = curl_easy_setopt(handle, CURLOPT_SSL_VERIFYHOST, (long) 0);
+		}
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_FILETIME, (long) options->remotetime);
+	}
+	if (theCurlCode == CURLE_OK && options->userPass != NULL) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_USERPWD, options->userPass);
+	}
+#ifdef _CURL_ENCODING
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, _CURL_ENCODING, options->acceptEncoding);
+	}
+#endif
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_HTTPHEADER, options->headers);
+	}
+	if (theCurlCode == CURLE_OK) {
+		theCurlCode = curl_easy_setopt(handle, CURLOPT_ERRORBUFFER, candidate->errorString);
+	}
+
+	return theCurlCode;
+}
+
+/**
+ * Start the next url of a transfer of curl fetchmany.
+ *
+ * @param interp		current interpreter, for errors
+ * @param transfer		the transfer
+ * @param options		options shared by the transfers
+ * @param now			the current time
+ * @return TCL_OK or TCL_ERROR.
+ */
+static int
+CurlStartFetchManyCandidate(Tcl_Interp* interp, fetch_transfer_t* transfer, const fetch_options_t* options, double now)
+{
+	fetch_candidate_t* candidate = &transfer->candidates[transfer->started];
+	CURLcode theCurlCode;
+	CURLMcode theCurlMCode;
+
+	transfer->started++;
+	candidate->handle = curl_easy_init();
+	if (candidate->handle == NULL) {
+		Tcl_SetResult(interp, "error in curl_easy_init", TCL_STATIC);
+		return TCL_ERROR;
+	}
+	theCurlCode = CurlSetupFetchManyHandle(candidate, options);
+	if (theCurlCode != CURLE_OK) {
+		return SetResultFromCurlErrorCode(interp, theCurlCode);
+	}
+	theCurlMCode = curl_multi_add_handle(theMHandle, candidate->handle);
+	if (theCurlMCode != CURLM_OK) {
+		return SetResultFromCurlMErrorCode(interp, theCurlMCode);
+	}
+	candidate->added = true;
+	candidate->startTime = now;
+	transfer->running++;
+	transfer->lastStart = now;
+	return TCL_OK;
+}
+
+/**
+ * Stop a url of a transfer of curl fetchmany and record its outcome.
+ *
+ * @param candidate		the url
+ * @param status		"ok", "error" or "cancelled"
+ * @param now			the current time
+ */
+static void
+CurlStopFetchManyCandidate(fetch_candidate_t* candidate, const char* status, double now)
+{
+#if LIBCURL_VERSION_NUM >= 0x073700
+	curl_off_t bytes = 0;
+
+	curl_easy_getinfo(candidate->handle, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+	candidate->bytes = (double) bytes;
+#else
+	curl_easy_getinfo(candidate->handle, CURLINFO_SIZE_DOWNLOAD, &candidate->bytes);
+#endif
+	candidate->seconds = now - candidate->startTime;
+	candidate->status = status;
+	curl_multi_remove_handle(theMHandle, candidate->handle);
+	candidate->added = false;
+	candidate->transfer->running--;
+}
+
+/**
+ * Cancel the urls of a transfer of curl fetchmany that lost the race.
+ *
+ * @param transfer		the transfer, with a winner
+ * @param now			the current time
+ */
+static void
+CurlCancelFetchManyCandidates(fetch_transfer_t* transfer, double now)
+{
+	int i;
+
+	for (i = 0; i < transfer->started; i++) {
+		fetch_candidate_t* candidate = &transfer->candidates[i];
+		if (candidate->added && candidate != transfer->winner) {
+			CurlStopFetchManyCandidate(candidate, "cancelled", now);
+		}
+	}
+}
+
+/**
+ * Record the end of a transfer of curl fetchmany: close its file, set its
+ * modification time if requested and signal the progress callback.
+ *
+ * @param transfer		the transfer
+ * @param remotetime	whether to set the modification time of the file
+ */
+static void
+CurlFinishFetchManyTransfer(fetch_transfer_t* transfer, int remotetime)
+{
+	long theFileTime = 0;
+
+	transfer->done = true;
+	(void) fclose(transfer->file);
+	transfer->file = NULL;
+
+	if (transfer->errorString[0] == '\0' && remotetime) {
+		if (curl_easy_getinfo(transfer->winner->handle, CURLINFO_FILETIME, &theFileTime) == CURLE_OK
+				&& theFileTime > 0) {
+			struct utimbuf times;
+			times.actime = (time_t)theFileTime;
+			times.modtime = (time_t)theFileTime;
+			utime(transfer->path, &times); /* set the time we got */
+		}
+	}
+
+	if (transfer->progress.proc != NULL) {
+		CurlProgressCleanup(&transfer->progress);
+	}
+}
+
+/**
+ * Record the end of a url of a transfer of curl fetchmany. The transfer
+ * succeeds with the first url that completes, the others lost the race.
+ * If the url that delivered data first fails, the file is emptied for the
+ * remaining urls.
+ *
+ * @param candidate		the url
+ * @param result		the result of the url
+ * @param options		options shared by the transfers
+ */
+static void
+CurlFinishFetchManyCandidate(fetch_candidate_t* candidate, CURLcode result, const fetch_options_t* options)
+{
+	fetch_transfer_t* transfer = candidate->transfer;
+
+	if (result == CURLE_OK && (transfer->winner == NULL || transfer->winner == candidate)) {
+		CurlStopFetchManyCandidate(candidate, "ok", CurlNow());
+		transfer->winner = candidate;
+		transfer->errorString[0] = '\0';
+		CurlCancelFetchManyCandidates(transfer, CurlNow());
+		CurlFinishFetchManyTransfer(transfer, options->remotetime);
+	} else if (transfer->winner != NULL && transfer->winner != candidate
+			&& (result == CURLE_OK || result == CURLE_WRITE_ERROR)) {
+		CurlStopFetchManyCandidate(candidate, "cancelled", CurlNow());
+	} else {
+		CurlStopFetchManyCandidate(candidate, "error", CurlNow());
+		snprintf(transfer->errorString, sizeof(transfer->errorString), "%s",
+			candidate->errorString[0] != '\0' ? candidate->errorString : curl_easy_strerror(result));
+		if (transfer->winner == candidate) {
+			transfer->winner = NULL;
+			(void) fflush(transfer->file);
+			(void) ftruncate(fileno(transfer->file), 0);
+			rewind(transfer->file);
+			if (transfer->digests.sha256 != NULL) {
+				(void) CurlResetDigests(&transfer->digests);
+			}
+		}
+	}
+}
+
+/**
+ * Advance a transfer of curl fetchmany: start its first url right away and
+ * the next ones, up to options->candidates at once, after options->stagger
+ * seconds without data, or as soon as all those started failed. Once a url
+ * delivered data, the others are cancelled.
+ *
+ * @param interp		current interpreter, for errors
+ * @param transfer		the transfer
+ * @param options		options shared by the transfers
+ * @param now			the current time
+ * @param wait			lowered to the time until the next url should start
+ * @return TCL_OK or TCL_ERROR.
+ */
+static int
+CurlScheduleFetchManyTransfer(Tcl_Interp* interp, fetch_transfer_t* transfer, const fetch_options_t* options, double now, double* wait)
+{
+	if (transfer->winner != NULL) {
+		CurlCancelFetchManyCandidates(transfer, now);
+		return TCL_OK;
+	}
+
+	if (transfer->started < transfer->candidateCount) {
+		if (transfer->running == 0
+				|| (transfer->running < options->candidates
+					&& now - transfer->lastStart >= options->stagger)) {
+			if (CurlStartFetchManyCandidate(interp, transfer, options, now) != TCL_OK) {
+				return TCL_ERROR;
+			}
+		}
+		if (transfer->started < transfer->candidateCount
+				&& transfer->running < options->candidates
+				&& transfer->lastStart + options->stagger - now < *wait) {
+			*wait = transfer->lastStart + options->stagger - now;
+		}
+	} else if (transfer->running == 0) {
+		/* all urls failed */
+		if (transfer->candidateCount == 0) {
+			snprintf(transfer->errorString, sizeof(transfer->errorString), "no url to fetch");
+		}
+		CurlFinishFetchManyTransfer(transfer, 0);
+	}
+	return TCL_OK;
+}
+
+/**
+ * Call the report callback of curl fetchmany for each url that was started.
+ *
+ * @param interp		current interpreter
+ * @param reportProc	the callback
+ * @param transfers		the transfers
+ * @param count			the number of transfers
+ * @return the result of the callback.
+ */
+static int
+CurlReportFetchMany(Tcl_Interp* interp, const char* reportProc, fetch_transfer_t* transfers, int count)
+{
+	int theResult = TCL_OK;
+	int i, j;
+
+	for (i = 0; i < count && theResult == TCL_OK; i++) {
+		for (j = 0; j < transfers[i].started && theResult == TCL_OK; j++) {
+			fetch_candidate_t* candidate = &transfers[i].candidates[j];
+			Tcl_Obj* theCommand;
+
+			if (candidate->status == NULL) {
+				continue;
+			}
+			theCommand = Tcl_NewStringObj(reportProc, -1);
+			Tcl_IncrRefCount(theCommand);
+			theResult = Tcl_ListObjAppendElement(interp, theCommand, Tcl_NewStringObj(candidate->url, -1));
+			if (theResult == TCL_OK) {
+				Tcl_ListObjAppendElement(interp, theCommand, Tcl_NewStringObj(candidate->status, -1));
+				Tcl_ListObjAppendElement(interp, theCommand, Tcl_NewDoubleObj(candidate->bytes));
+				Tcl_ListObjAppendElement(interp, theCommand, Tcl_NewDoubleObj(candidate->seconds));
+				theResult = Tcl_EvalObjEx(interp, theCommand, TCL_EVAL_GLOBAL);
+			}
+			Tcl_DecrRefCount(theCommand);
+		}
+	}
+	return theResult;
+}
+
+/**
+ * curl fetchmany subcommand entry point.
+ *
+ * syntax: curl fetchmany [--disable-epsv] [--ignore-ssl-cert] [--remote-time] [-u userpass] [--user-agent useragentstring] [--append-http-header header] [--progress callback] [--enable-compression] [--max-connections n] [--max-host-connections n] [--candidates n] [--stagger ms] [--report callback] [--digests digestsvar] transfers
+ *
+ * @param interp		current interpreter
+ * @param objc			number of parameters
+ * @param objv			parameters
+ */
+int
+CurlFetchManyCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
+{
+	int theResult = TCL_OK;
+	fetch_transfer_t* theTransfers = NULL;
+	int theTransferCount = 0;
+	fetch_options_t theOptions = {
+		.useepsv = 1,
+		.ignoresslcert = 0,
+		.remotetime = 0,
+		.userPass = NULL,
+		.userAgent = PACKAGE_NAME "/" PACKAGE_VERSION " libcurl/" LIBCURL_VERSION,
+		.acceptEncoding = NULL,
+		.headers = NULL,
+		.candidates = 1,
+		.stagger = 0.25,
+		.digests = false
+	};
+	int i, j;
+
+	do {
+		const char* progressProc = NULL;
+		const char* reportProc = NULL;
+		const char* digestsVarName = NULL;
+		long maxConnections = 0;
+		long maxHostConnections = 2;
+		long stagger = 250;
+		Tcl_Obj** theTransferObjs;
+		CURLMcode theCurlMCode = CURLM_OK;
+		struct CURLMsg *info = NULL;
+		int running; /* number of running transfers */
+		int optioncrsr;
+		int lastoption;
+		Tcl_Obj* theResultList;
+
+		/* we might have options and then the list of transfers */
+		/* let's process the options first */
+
+		optioncrsr = 2;
+		lastoption = objc - 2;
+		while (optioncrsr <= lastoption) {
+			/* get the option */
+			const char* theOption = Tcl_GetString(objv[optioncrsr]);
+
+			if (strcmp(theOption, "--disable-epsv") == 0) {
+				theOptions.useepsv = 0;
+			} else if (strcmp(theOption, "--ignore-ssl-cert") == 0) {
+				theOptions.ignoresslcert = 1;
+			} else if (strcmp(theOption, "--remote-time") == 0) {
+				theOptions.remotetime = 1;
+			} else if (strcmp(theOption, "--enable-compression") == 0) {
+				theOptions.acceptEncoding = "";
+			} else if (strcmp(theOption, "-u") == 0
+					|| strcmp(theOption, "--user-agent") == 0
+					|| strcmp(theOption, "--append-http-header") == 0
+					|| strcmp(theOption, "--progress") == 0
+					|| strcmp(theOption, "--report") == 0
+					|| strcmp(theOption, "--digests") == 0
+					|| strcmp(theOption, "--max-connections") == 0
+					|| strcmp(theOption, "--max-host-connections") == 0
+					|| strcmp(theOption, "--candidates") == 0
+					|| strcmp(theOption, "--stagger") == 0) {
+				const char* theValue;
+
+				/* check we also have the parameter */
+				if (optioncrsr >= lastoption) {
+					Tcl_ResetResult(interp);
+					Tcl_AppendResult(interp, "curl fetchmany: ", theOption,
+						" option requires a parameter", NULL);
+					theResult = TCL_ERROR;
+					break;
+				}
+				optioncrsr++;
+				theValue = Tcl_GetString(objv[optioncrsr]);
+
+				if (strcmp(theOption, "-u") == 0) {
+					theOptions.userPass = theValue;
+				} else if (strcmp(theOption, "--user-agent") == 0) {
+					theOptions.userAgent = theValue;
+				} else if (strcmp(theOption, "--append-http-header") == 0) {
+					theOptions.headers = curl_slist_append(theOptions.headers, theValue);
+				} else if (strcmp(theOption, "--progress") == 0) {
+					progressProc = theValue;
+				} else if (strcmp(theOption, "--report") == 0) {
+					reportProc = theValue;
+				} else if (strcmp(theOption, "--digests") == 0) {
+					digestsVarName = theValue;
+					theOptions.digests = true;
+				} else if (strcmp(theOption, "--max-connections") == 0) {
+					theResult = Tcl_GetLongFromObj(interp, objv[optioncrsr], &maxConnections);
+				} else if (strcmp(theOption, "--max-host-connections") == 0) {
+					theResult = Tcl_GetLongFromObj(interp, objv[optioncrsr], &maxHostConnections);
+				} else if (strcmp(theOption, "--candidates") == 0) {
+					theResult = Tcl_GetLongFromObj(interp, objv[optioncrsr], &theOptions.candidates);
+				} else {
+					theResult = Tcl_GetLongFromObj(interp, objv[optioncrsr], &stagger);
+				}
+				if (theResult != TCL_OK) {
+					break;
+				}
+			} else {
+				Tcl_ResetResult(interp);
+				Tcl_AppendResult(interp, "curl fetchmany: unknown option ", theOption, NULL);
+				theResult = TCL_ERROR;
+				break;
+			}
+
+			optioncrsr++;
+		}
+
+		if (optioncrsr <= lastoption) {
+			/* something went wrong */
+			break;
+		}
+
+		if (objc < 3) {
+			Tcl_WrongNumArgs(interp, 1, objv, "fetchmany [options] transfers");
+			theResult = TCL_ERROR;
+			break;
+		}
+
+		if (progressProc != NULL && strcmp(progressProc, "builtin") == 0) {
+			Tcl_SetResult(interp,
+				"curl fetchmany: --progress builtin isn't supported",
+				TCL_STATIC);
+			theResult = TCL_ERROR;
+			break;
+		}
+
+		if (theOptions.candidates < 1) {
+			theOptions.candidates = 1;
+		}
+		theOptions.stagger = stagger / 1000.0;
+
+		/* Clear the Pragma: no-cache header */
+		theOptions.headers = curl_slist_append(theOptions.headers, "Pragma:");
+
+		/* Retrieve the transfers, {urls file} pairs */
+		theResult = Tcl_ListObjGetElements(interp, objv[objc - 1], &theTransferCount, &theTransferObjs);
+		if (theResult != TCL_OK) {
+			break;
+		}
+		theTransfers = (fetch_transfer_t*) calloc(theTransferCount ? theTransferCount : 1, sizeof(fetch_transfer_t));
+		if (theTransfers == NULL) {
+			Tcl_SetResult(interp, strerror(errno), TCL_VOLATILE);
+			theResult = TCL_ERROR;
+			break;
+		}
+
+		/* Create the CURL multi handle */
+		if (theMHandle == NULL) {
+			/* Re-use existing multi handle if theMHandle isn't NULL */
+			theMHandle = curl_multi_init();
+			if (theMHandle == NULL) {
+				theResult = TCL_ERROR;
+				Tcl_SetResult(interp, "error in curl_multi_init", TCL_STATIC);
+				break;
+			}
+		}
+
+		/* limit the number of connections, transfers beyond the limits wait
+		 * for a connection to be available; 0 means no limit */
+#if LIBCURL_VERSION_NUM >= 0x071e00
+		curl_multi_setopt(theMHandle, CURLMOPT_MAX_TOTAL_CONNECTIONS, maxConnections);
+		curl_multi_setopt(theMHandle, CURLMOPT_MAX_HOST_CONNECTIONS, maxHostConnections);
+#endif
+
+		for (i = 0; i < theTransferCount; i++) {
+			fetch_transfer_t* transfer = &theTransfers[i];
+			Tcl_Obj** thePair;
+			int thePairCount;
+			Tcl_Obj** theURLObjs;
+			int theURLCount;
+
+			if (Tcl_ListObjGetElements(interp, theTransferObjs[i], &thePairCount, &thePair) != TCL_OK) {
+				theResult = TCL_ERROR;
+				break;
+			}
+			if (thePairCount != 2) {
+				Tcl_SetResult(interp,
+					"curl fetchmany: transfers must be {urls file} pairs",
+					TCL_STATIC);
+				theResult = TCL_ERROR;
+				break;
+			}
+			if (Tcl_ListObjGetElements(interp, thePair[0], &theURLCount, &theURLObjs) != TCL_OK) {
+				theResult = TCL_ERROR;
+				break;
+			}
+			transfer->path = Tcl_GetString(thePair[1]);
+
+			/* Open the file, a transfer whose file can't be opened fails
+			 * without affecting the others */
+			transfer->file = fopen(transfer->path, "w");
+			if (transfer->file == NULL) {
+				snprintf(transfer->errorString, sizeof(transfer->errorString), "%s", strerror(errno));
+				transfer->done = true;
+				continue;
+			}
+
+			transfer->candidates = (fetch_candidate_t*) calloc(theURLCount ? theURLCount : 1, sizeof(fetch_candidate_t));
+			if (transfer->candidates == NULL) {
+				Tcl_SetResult(interp, strerror(errno), TCL_VOLATILE);
+				theResult = TCL_ERROR;
+				break;
+			}
+			transfer->candidateCount = theURLCount;
+			if (theOptions.digests && !CurlResetDigests(&transfer->digests)) {
+				Tcl_SetResult(interp, strerror(ENOMEM), TCL_VOLATILE);
+				theResult = TCL_ERROR;
+				break;
+			}
+			for (j = 0; j < theURLCount; j++) {
+				transfer->candidates[j].url = Tcl_GetString(theURLObjs[j]);
+				transfer->candidates[j].transfer = transfer;
+			}
+
+			/* the progress callback is given the index of the transfer */
+			transfer->progress.interp = interp;
+			if (progressProc != NULL) {
+				size_t len = strlen(progressProc) + 1 + 12 + 1;
+				char* proc = malloc(len);
+				if (proc == NULL) {
+					Tcl_SetResult(interp, strerror(errno), TCL_VOLATILE);
+					theResult = TCL_ERROR;
+					break;
+				}
+				snprintf(proc, len, "%s %d", progressProc, i);
+				transfer->progress.proc = proc;
+			}
+		}
+		if (theResult != TCL_OK) {
+			break;
+		}
+
+		/* select(2) the file descriptors used by curl and interleave with
+		 * checks for TclX signals, like curl fetch */
+		do {
+			int rc; /* select() return code */
+			int remaining;
+			int pending = 0;
+			double now = CurlNow();
+			double wait = 1.0;
+
+			/* arguments for select(2) */
+			int nfds;
+			fd_set readfds;
+			fd_set writefds;
+			fd_set errorfds;
+			struct timeval timeout;
+
+			long curl_timeout = -1;
+
+			/* start and cancel urls */
+			for (i = 0; i < theTransferCount; i++) {
+				if (theTransfers[i].done) {
+					continue;
+				}
+				theResult = CurlScheduleFetchManyTransfer(interp, &theTransfers[i], &theOptions, now, &wait);
+				if (theResult != TCL_OK) {
+					break;
+				}
+				if (!theTransfers[i].done) {
+					pending++;
+				}
+			}
+			if (theResult != TCL_OK || pending == 0) {
+				break;
+			}
+
+			/* timeout or activity */
+			theCurlMCode = curl_multi_perform(theMHandle, &running);
+			if (theCurlMCode != CURLM_OK) {
+				theResult = SetResultFromCurlMErrorCode(interp, theCurlMCode);
+				break;
+			}
+
+			/* process signals from TclX */
+			if (Tcl_AsyncReady()) {
+				theResult = Tcl_AsyncInvoke(interp, theResult);
+				if (theResult != TCL_OK) {
+					break;
+				}
+			}
+
+			/* collect the urls that completed, and go on with their
+			 * transfers right away */
+			rc = 0;
+			while ((info = curl_multi_info_read(theMHandle, &remaining)) != NULL) {
+				fetch_candidate_t* candidate = NULL;
+
+				if (info->msg != CURLMSG_DONE) {
+					continue;
+				}
+				curl_easy_getinfo(info->easy_handle, CURLINFO_PRIVATE, (char**) &candidate);
+				if (candidate == NULL || !candidate->added) {
+					continue;
+				}
+				CurlFinishFetchManyCandidate(candidate, info->data.result, &theOptions);
+				rc++;
+			}
+			if (rc > 0) {
+				continue;
+			}
+
+#if LIBCURL_VERSION_NUM >= 0x070f04
+			/* get the next timeout */
+			theCurlMCode = curl_multi_timeout(theMHandle, &curl_timeout);
+			if (theCurlMCode != CURLM_OK) {
+				theResult = SetResultFromCurlMErrorCode(interp, theCurlMCode);
+				break;
+			}
+#endif
+
+			/* wake up in time for the next url to start, and at most after
+			 * 1 second */
+			if (wait < 0) {
+				wait = 0;
+			}
+			if (curl_timeout >= 0 && curl_timeout / 1000.0 < wait) {
+				wait = curl_timeout / 1000.0;
+			}
+			timeout.tv_sec = (long) wait;
+			timeout.tv_usec = (long) ((wait - timeout.tv_sec) * 1000000);
+
+			/* get the fd sets for select(2) */
+			FD_ZERO(&readfds);
+			FD_ZERO(&writefds);
+			FD_ZERO(&errorfds);
+			theCurlMCode = curl_multi_fdset(theMHandle, &readfds, &writefds, &errorfds, &nfds);
+			if (theCurlMCode != CURLM_OK) {
+				theResult = SetResultFromCurlMErrorCode(interp, theCurlMCode);
+				break;
+			}
+
+			/* The value of nfds is guaranteed to be >= -1. Passing nfds + 1 to
+			 * select(2) makes the case of nfds == -1 a sleep. */
+			rc = select(nfds + 1, &readfds, &writefds, &errorfds, &timeout);
+			if (-1 == rc) {
+				/* check for signals first to avoid breaking our special
+				 * handling of SIGINT and SIGTERM */
+				if (Tcl_AsyncReady()) {
+					theResult = Tcl_AsyncInvoke(interp, theResult);
+					if (theResult != TCL_OK) {
+						break;
+					}
+				}
+				if (errno == EINTR) {
+					continue;
+				}
+
+				/* select error */
+				Tcl_SetResult(interp, strerror(errno), TCL_VOLATILE);
+				theResult = TCL_ERROR;
+				break;
+			}
+		} while (1);
+
+		if (theResult != TCL_OK) {
+			break;
+		}
+
+		if (reportProc != NULL) {
+			theResult = CurlReportFetchMany(interp, reportProc, theTransfers, theTransferCount);
+			if (theResult != TCL_OK) {
+				break;
+			}
+		}
+
+		/* the digests of the transfers that succeeded */
+		if (digestsVarName != NULL) {
+			Tcl_Obj* theDigestsList = Tcl_NewListObj(0, NULL);
+
+			for (i = 0; i < theTransferCount; i++) {
+				fetch_transfer_t* transfer = &theTransfers[i];
+
+				Tcl_ListObjAppendElement(interp, theDigestsList,
+					transfer->done && transfer->errorString[0] == '\0' && transfer->digests.sha256 != NULL
+						? CurlEndDigests(&transfer->digests) : Tcl_NewListObj(0, NULL));
+			}
+			if (Tcl_SetVar2Ex(interp, digestsVarName, NULL, theDigestsList, TCL_LEAVE_ERR_MSG) == NULL) {
+				theResult = TCL_ERROR;
+				break;
+			}
+		}
+
+		/* the result has an error message for each transfer, empty if it
+		 * succeeded */
+		theResultList = Tcl_NewListObj(0, NULL);
+		for (i = 0; i < theTransferCount; i++) {
+			Tcl_ListObjAppendElement(interp, theResultList, Tcl_NewStringObj(theTransfers[i].errorString, -1));
+		}
+		Tcl_SetObjResult(interp, theResultList);
+	} while (0);
+
+	for (i = 0; theTransfers != NULL && i < theTransferCount; i++) {
+		fetch_transfer_t* transfer = &theTransfers[i];
+
+		for (j = 0; j < transfer->started; j++) {
+			fetch_candidate_t* candidate = &transfer->candidates[j];
+
+			if (candidate->added) {
+				/* Remove the handle from the multi handle, but ignore errors
+				 * to avoid cluttering the real error info */
+				curl_multi_remove_handle(theMHandle, candidate->handle);
+			}
+			if (candidate->handle != NULL) {
+				curl_easy_cleanup(candidate->handle);
+			}
+		}
+		free(transfer->candidates);
+		CurlFreeDigests(&transfer->digests);
+		if (transfer->file != NULL) {
+			fclose(transfer->file);
+		}
+		free((char*) transfer->progress.proc);
+	}
+	free(theTransfers);
+	curl_slist_free_all(theOptions.headers);
+
+	return theResult;
+}
+
 /**
  * curl isnewer subcommand entry point.
  *
@@ -1195,7 +2159,8 @@ CurlPostCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		tcl_callback_t progressCallback = {
 			.interp = interp,
 			.proc = NULL,
-			.prevcalltime = 0.0
+			.prevcalltime = 0.0,
+			.handle = NULL
 		};
 		char* userAgent = PACKAGE_NAME "/" PACKAGE_VERSION " libcurl/" LIBCURL_VERSION;
 		int optioncrsr;
@@ -1280,6 +2245,7 @@ CurlPostCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		}
 		/* If we're re-using a handle, the previous call did ensure to reset it
 		 * to the default state using curl_easy_reset(3) */
+		progressCallback.handle = theHandle;
 
 		/* Setup the handle */
 		theCurlCode = curl_easy_setopt(theHandle, CURLOPT_URL, theURL);
@@ -1434,13 +2400,14 @@ CurlCmd(
 {
 	typedef enum {
 		kCurlFetch,
+		kCurlFetchMany,
 		kCurlIsNewer,
 		kCurlGetSize,
 		kCurlPost
 	} EOption;
 
 	static const char *options[] = {
-		"fetch", "isnewer", "getsize", "post", NULL
+		"fetch", "fetchmany", "isnewer", "getsize", "post", NULL
 	};
 	int theResult = TCL_OK;
 	EOption theOptionIndex;
@@ -1466,6 +2433,9 @@ CurlCmd(
 		case kCurlFetch:
 			theResult = CurlFetchCmd(interp, objc, objv);
 			break;
+		case kCurlFetchMany:
+			theResult = CurlFetchManyCmd(interp, objc, objv);
+			break;
 		case kCurlIsNewer:
 			theResult = CurlIsNewerCmd(interp, objc, objv);
 			break;
@@ -1489,6 +2459,14 @@ void
 CurlInit()
 {
 	curl_global_init(CURL_GLOBAL_ALL);
+
+	/* Tcl interpreters using the curl command don't run it concurrently, so
+	 * the share handle doesn't need lock functions */
+	theSHandle = curl_share_init();
+	if (theSHandle != NULL) {
+		curl_share_setopt(theSHandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+		curl_share_setopt(theSHandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	}
 }
 
 /* ========================================================================= **
@@ -1528,7 +2506,7 @@ static int CurlProgressHandler(
 	}
 
 	/* Only send updates once a second */
-	curl_easy_getinfo(theHandle, CURLINFO_TOTAL_TIME, &curtime);
+	curl_easy_getinfo(callback->handle, CURLINFO_TOTAL_TIME, &curtime);
 	if ((curtime - callback->prevcalltime) < _CURL_MINIMUM_PROGRESS_INTERVAL) {
 		return 0;
 	}
@@ -1562,9 +2540,9 @@ static int CurlProgressHandler(
 
 	/* Get the average speed from curl */
 	if (transferType == DOWNLOAD) {
-		curl_easy_getinfo(theHandle, CURLINFO_SPEED_DOWNLOAD, &speed);
+		curl_easy_getinfo(callback->handle, CURLINFO_SPEED_DOWNLOAD, &speed);
 	} else {
-		curl_easy_getinfo(theHandle, CURLINFO_SPEED_UPLOAD, &speed);
+		curl_easy_getinfo(callback->handle, CURLINFO_SPEED_UPLOAD, &speed);
 	}
 
 	/*
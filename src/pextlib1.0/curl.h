@@ -44,6 +44,25 @@
  *  --disable-epsv - like curl(1)
  *  -u user:pass - like curl(1)
  *
+ * curl fetchmany [options] transfers
+ *	Fetch several URLs at once. transfers is a list of {urls file} pairs,
+ *  where urls are mirrors of the same file. Return a list with the error
+ *  message of each transfer, empty if it succeeded. Connections are shared
+ *  between calls.
+ *  Besides the options of fetch:
+ *  --max-host-connections n - number of connections to a host, 2 by default
+ *  --max-connections n - total number of connections, unlimited by default
+ *  --progress callback - called with the index of the transfer first
+ *  --candidates n - number of urls of a transfer to race, 1 by default. The
+ *    next url starts after the stagger delay or when the others failed, the
+ *    first one to deliver data is kept and the others are cancelled.
+ *  --stagger ms - delay before starting the next url, 250 by default
+ *  --report callback - called for each url that was started with the url,
+ *    ok, error or cancelled, the number of bytes and the seconds it took
+ *  --digests var - set var to a list with the rmd160, sha256 and size of
+ *    each transfer computed while writing it, as a list of types and
+ *    values, empty if it failed
+ *
  * curl isnewer url date
  *	Determine if some resource is newer than date. Try to not fetch the resource
  *  if possible. The date is the number of seconds since epoch.
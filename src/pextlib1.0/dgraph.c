@@ -0,0 +1,559 @@
+/*
+ * dgraph.c
+ *
+ * Copyright (c) 2026 The MacPorts Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of MacPorts Team nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <tcl.h>
+
+#include "dgraph.h"
+
+/*
+ * dlist_get_next looks at every item of the dependency list and counts its
+ * unmet dependencies each time it is called. Instead, the graph keeps, for
+ * each node, the number of its requires and uses tokens that aren't
+ * provided successfully yet and the number of its uses tokens that a
+ * pending node still provides, and updates them when a node is done, using
+ * the lists of the nodes requiring and using each token. Nodes that become
+ * eligible are pushed on a heap ordered by their number of unmet uses
+ * tokens and then by their position, which gives the node dlist_get_next
+ * would pick. Entries aren't removed from the heap when a node's counts
+ * change; stale entries are skipped when they reach the top.
+ *
+ * Tokens are counted as many times as they appear in a list, like
+ * dlist_count_unmet does.
+ */
+
+typedef struct {
+    /* number of occurrences in the provides lists of pending nodes */
+    uint32_t pending;
+    /* whether the token was provided successfully */
+    int ok;
+    /* nodes having the token in their requires list, once per occurrence */
+    uint32_t* requirers;
+    uint32_t requirers_count;
+    uint32_t requirers_capacity;
+    /* nodes having the token in their uses list, once per occurrence */
+    uint32_t* users;
+    uint32_t users_count;
+    uint32_t users_capacity;
+} dgraph_token;
+
+typedef struct {
+    /* tokens provided by the node, then required, then used */
+    uint32_t* tokens;
+    uint32_t provides_count;
+    uint32_t requires_count;
+    uint32_t uses_count;
+    /* requires tokens not provided successfully */
+    uint32_t unmet_requires;
+    /* uses tokens not provided successfully */
+    uint32_t unmet_uses;
+    /* uses tokens provided by pending nodes */
+    uint32_t pending_uses;
+    int pending;
+    /* started but not done yet, so pending but not eligible */
+    int running;
+} dgraph_node;
+
+typedef struct {
+    uint32_t unmet_uses;
+    uint32_t node;
+} dgraph_entry;
+
+typedef struct {
+    Tcl_Command token;
+    dgraph_node* nodes;
+    uint32_t node_count;
+    dgraph_token* tokens;
+    uint32_t token_count;
+    /* binary heap of eligible nodes */
+    dgraph_entry* heap;
+    uint32_t heap_count;
+    uint32_t heap_capacity;
+} dgraph;
+
+/**
+ * Append a node number to a growing array.
+ */
+static void append_node(uint32_t** array, uint32_t* count, uint32_t* capacity,
+        uint32_t node) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 4;
+        *array = (uint32_t*)ckrealloc((char*)*array,
+                *capacity * sizeof(uint32_t));
+    }
+    (*array)[(*count)++] = node;
+}
+
+static int entry_less(const dgraph_entry* a, const dgraph_entry* b) {
+    return a->unmet_uses < b->unmet_uses
+        || (a->unmet_uses == b->unmet_uses && a->node < b->node);
+}
+
+static void heap_push(dgraph* graph, uint32_t node) {
+    dgraph_entry entry;
+    uint32_t i;
+
+    if (graph->heap_count == graph->heap_capacity) {
+        graph->heap_capacity = graph->heap_capacity
+            ? graph->heap_capacity * 2 : 64;
+        graph->heap = (dgraph_entry*)ckrealloc((char*)graph->heap,
+                graph->heap_capacity * sizeof(dgraph_entry));
+    }
+    entry.unmet_uses = graph->nodes[node].unmet_uses;
+    entry.node = node;
+    i = graph->heap_count++;
+    while (i > 0 && entry_less(&entry, &graph->heap[(i - 1) / 2])) {
+        graph->heap[i] = graph->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    graph->heap[i] = entry;
+}
+
+static void heap_pop(dgraph* graph) {
+    dgraph_entry last = graph->heap[--graph->heap_count];
+    uint32_t i = 0;
+
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= graph->heap_count) {
+            break;
+        }
+        if (child + 1 < graph->heap_count
+                && entry_less(&graph->heap[child + 1], &graph->heap[child])) {
+            child++;
+        }
+        if (!entry_less(&graph->heap[child], &last)) {
+            break;
+        }
+        graph->heap[i] = graph->heap[child];
+        i = child;
+    }
+    if (graph->heap_count > 0) {
+        graph->heap[i] = last;
+    }
+}
+
+/**
+ * Whether dlist_get_next would consider the node.
+ */
+static int eligible(const dgraph_node* node) {
+    return node->pending && !node->running && node->unmet_requires == 0
+        && (node->unmet_uses == 0 || node->pending_uses == 0);
+}
+
+/**
+ * Push the node on the heap if it is eligible, with its current count of
+ * unmet uses tokens.
+ */
+static void update_node(dgraph* graph, uint32_t node) {
+    if (eligible(&graph->nodes[node])) {
+        heap_push(graph, node);
+    }
+}
+
+/**
+ * Change whether a token was provided successfully.
+ */
+static void set_token_ok(dgraph* graph, uint32_t token, int ok) {
+    dgraph_token* t = &graph->tokens[token];
+    uint32_t i;
+
+    if (t->ok == ok) {
+        return;
+    }
+    t->ok = ok;
+    for (i = 0; i < t->requirers_count; i++) {
+        graph->nodes[t->requirers[i]].unmet_requires += ok ? -1 : 1;
+    }
+    for (i = 0; i < t->users_count; i++) {
+        graph->nodes[t->users[i]].unmet_uses += ok ? -1 : 1;
+    }
+    if (ok) {
+        for (i = 0; i < t->requirers_count; i++) {
+            update_node(graph, t->requirers[i]);
+        }
+    }
+    /* the number of unmet uses tokens is part of the order */
+    for (i = 0; i < t->users_count; i++) {
+        update_node(graph, t->users[i]);
+    }
+}
+
+static void DgraphDeleteProc(ClientData clientData) {
+    dgraph* graph = (dgraph*)clientData;
+    uint32_t i;
+
+    for (i = 0; i < graph->node_count; i++) {
+        ckfree((char*)graph->nodes[i].tokens);
+    }
+    for (i = 0; i < graph->token_count; i++) {
+        if (graph->tokens[i].requirers) {
+            ckfree((char*)graph->tokens[i].requirers);
+        }
+        if (graph->tokens[i].users) {
+            ckfree((char*)graph->tokens[i].users);
+        }
+    }
+    ckfree((char*)graph->nodes);
+    if (graph->tokens) {
+        ckfree((char*)graph->tokens);
+    }
+    if (graph->heap) {
+        ckfree((char*)graph->heap);
+    }
+    ckfree((char*)graph);
+}
+
+/**
+ * $graph next
+ */
+static int DgraphNextCmd(dgraph* graph, Tcl_Interp* interp) {
+    while (graph->heap_count > 0) {
+        const dgraph_entry* top = &graph->heap[0];
+        const dgraph_node* node = &graph->nodes[top->node];
+        if (eligible(node) && node->unmet_uses == top->unmet_uses) {
+            Tcl_SetObjResult(interp, Tcl_NewWideIntObj(top->node));
+            return TCL_OK;
+        }
+        /* stale entry */
+        heap_pop(graph);
+    }
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(-1));
+    return TCL_OK;
+}
+
+/**
+ * Get the node numbered by the given object.
+ */
+static int get_node(dgraph* graph, Tcl_Interp* interp, Tcl_Obj* obj,
+        dgraph_node** node) {
+    Tcl_WideInt number;
+
+    if (Tcl_GetWideIntFromObj(interp, obj, &number) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (number < 0 || number >= (Tcl_WideInt)graph->node_count) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                    "no node %s", Tcl_GetString(obj)));
+        return TCL_ERROR;
+    }
+    *node = &graph->nodes[number];
+    return TCL_OK;
+}
+
+/**
+ * $graph start node
+ *
+ * Mark a node as being evaluated, so that next returns other nodes until it
+ * is done.
+ */
+static int DgraphStartCmd(dgraph* graph, Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    dgraph_node* node;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "node");
+        return TCL_ERROR;
+    }
+    if (get_node(graph, interp, objv[2], &node) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (node->pending) {
+        node->running = 1;
+    }
+    Tcl_ResetResult(interp);
+    return TCL_OK;
+}
+
+/**
+ * $graph done node status
+ */
+static int DgraphDoneCmd(dgraph* graph, Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    dgraph_node* node;
+    int status;
+    uint32_t i;
+
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "node status");
+        return TCL_ERROR;
+    }
+    if (get_node(graph, interp, objv[2], &node) != TCL_OK
+            || Tcl_GetIntFromObj(interp, objv[3], &status) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (node->pending) {
+        node->pending = 0;
+        node->running = 0;
+        for (i = 0; i < node->provides_count; i++) {
+            dgraph_token* t = &graph->tokens[node->tokens[i]];
+            if (--t->pending == 0) {
+                uint32_t j;
+                for (j = 0; j < t->users_count; j++) {
+                    graph->nodes[t->users[j]].pending_uses--;
+                    update_node(graph, t->users[j]);
+                }
+            }
+        }
+    }
+    for (i = 0; i < node->provides_count; i++) {
+        set_token_ok(graph, node->tokens[i], status == 1);
+    }
+
+    Tcl_ResetResult(interp);
+    return TCL_OK;
+}
+
+/**
+ * $graph pending
+ */
+static int DgraphPendingCmd(dgraph* graph, Tcl_Interp* interp) {
+    Tcl_Obj* result = Tcl_NewListObj(0, NULL);
+    uint32_t i;
+
+    for (i = 0; i < graph->node_count; i++) {
+        if (graph->nodes[i].pending) {
+            Tcl_ListObjAppendElement(interp, result, Tcl_NewWideIntObj(i));
+        }
+    }
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
+
+/**
+ * $graph subcommand ?arg ...?
+ */
+static int DgraphObjCmd(ClientData clientData, Tcl_Interp* interp,
+        int objc, Tcl_Obj* CONST objv[]) {
+    dgraph* graph = (dgraph*)clientData;
+    static const char* cmds[] = {
+        "next", "start", "done", "pending", "close", NULL
+    };
+    enum { NEXT, START, DONE, PENDING, CLOSE } cmd;
+
+    if (objc < 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "cmd ?arg ...?");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], cmds, "cmd", 0, (int*)&cmd)
+            != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (cmd != START && cmd != DONE && objc != 2) {
+        Tcl_WrongNumArgs(interp, 2, objv, NULL);
+        return TCL_ERROR;
+    }
+    switch (cmd) {
+        case NEXT:
+            return DgraphNextCmd(graph, interp);
+        case START:
+            return DgraphStartCmd(graph, interp, objc, objv);
+        case DONE:
+            return DgraphDoneCmd(graph, interp, objc, objv);
+        case PENDING:
+            return DgraphPendingCmd(graph, interp);
+        case CLOSE:
+            Tcl_DeleteCommandFromToken(interp, graph->token);
+            return TCL_OK;
+    }
+    return TCL_OK;
+}
+
+/**
+ * dgraph create nodes
+ */
+static int DgraphCreateCmd(Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    static unsigned int next_id = 0;
+    Tcl_HashTable names;
+    Tcl_Obj** node_objs;
+    int node_count;
+    dgraph* graph;
+    char cmd_name[32];
+    uint32_t token_capacity = 0;
+    int i;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "nodes");
+        return TCL_ERROR;
+    }
+    if (Tcl_ListObjGetElements(interp, objv[2], &node_count, &node_objs)
+            != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    graph = (dgraph*)ckalloc(sizeof(dgraph));
+    memset(graph, 0, sizeof(dgraph));
+    graph->nodes = (dgraph_node*)ckalloc(
+            (node_count ? node_count : 1) * sizeof(dgraph_node));
+    memset(graph->nodes, 0, (node_count ? node_count : 1) * sizeof(dgraph_node));
+    Tcl_InitHashTable(&names, TCL_STRING_KEYS);
+
+    for (i = 0; i < node_count; i++) {
+        dgraph_node* node = &graph->nodes[i];
+        Tcl_Obj** lists;
+        int list_count;
+        Tcl_Obj** token_objs[3];
+        int token_counts[3];
+        uint32_t k = 0;
+        int l;
+
+        if (Tcl_ListObjGetElements(interp, node_objs[i], &list_count, &lists)
+                != TCL_OK) {
+            goto error;
+        }
+        if (list_count != 3) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                        "node %d isn't a {provides requires uses} list", i));
+            goto error;
+        }
+        for (l = 0; l < 3; l++) {
+            if (Tcl_ListObjGetElements(interp, lists[l], &token_counts[l],
+                        &token_objs[l]) != TCL_OK) {
+                goto error;
+            }
+        }
+        node->provides_count = token_counts[0];
+        node->requires_count = token_counts[1];
+        node->uses_count = token_counts[2];
+        node->tokens = (uint32_t*)ckalloc(
+                (token_counts[0] + token_counts[1] + token_counts[2] + 1)
+                * sizeof(uint32_t));
+        node->unmet_requires = token_counts[1];
+        node->unmet_uses = token_counts[2];
+        node->pending = 1;
+
+        for (l = 0; l < 3; l++) {
+            int j;
+            for (j = 0; j < token_counts[l]; j++) {
+                int is_new;
+                Tcl_HashEntry* entry = Tcl_CreateHashEntry(&names,
+                        Tcl_GetString(token_objs[l][j]), &is_new);
+                uint32_t token;
+                dgraph_token* t;
+
+                if (is_new) {
+                    token = graph->token_count++;
+                    if (graph->token_count > token_capacity) {
+                        token_capacity = token_capacity
+                            ? token_capacity * 2 : 64;
+                        graph->tokens = (dgraph_token*)ckrealloc(
+                                (char*)graph->tokens,
+                                token_capacity * sizeof(dgraph_token));
+                    }
+                    memset(&graph->tokens[token], 0, sizeof(dgraph_token));
+                    Tcl_SetHashValue(entry, (ClientData)(uintptr_t)token);
+                } else {
+                    token = (uint32_t)(uintptr_t)Tcl_GetHashValue(entry);
+                }
+                node->tokens[k++] = token;
+
+                t = &graph->tokens[token];
+                switch (l) {
+                    case 0:
+                        t->pending++;
+                        break;
+                    case 1:
+                        append_node(&t->requirers, &t->requirers_count,
+                                &t->requirers_capacity, i);
+                        break;
+                    case 2:
+                        append_node(&t->users, &t->users_count,
+                                &t->users_capacity, i);
+                        break;
+                }
+            }
+        }
+        graph->node_count++;
+    }
+    Tcl_DeleteHashTable(&names);
+
+    /* now that all providers are known, count the pending uses tokens */
+    for (i = 0; i < node_count; i++) {
+        dgraph_node* node = &graph->nodes[i];
+        uint32_t j;
+        for (j = 0; j < node->uses_count; j++) {
+            uint32_t token = node->tokens[node->provides_count
+                + node->requires_count + j];
+            if (graph->tokens[token].pending > 0) {
+                node->pending_uses++;
+            }
+        }
+        update_node(graph, i);
+    }
+
+    snprintf(cmd_name, sizeof(cmd_name), "dgraph%u", next_id++);
+    graph->token = Tcl_CreateObjCommand(interp, cmd_name, DgraphObjCmd,
+            graph, DgraphDeleteProc);
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(cmd_name, -1));
+    return TCL_OK;
+
+error:
+    Tcl_DeleteHashTable(&names);
+    DgraphDeleteProc(graph);
+    return TCL_ERROR;
+}
+
+/**
+ * dgraph command entry point.
+ *
+ * @param interp		current interpreter
+ * @param objc			number of parameters
+ * @param objv			parameters
+ */
+int DgraphCmd(ClientData clientData UNUSED, Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    static const char* cmds[] = { "create", NULL };
+    enum { CREATE } cmd;
+
+    if (objc < 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "cmd ?arg ...?");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], cmds, "cmd", 0, (int*)&cmd)
+            != TCL_OK) {
+        return TCL_ERROR;
+    }
+    switch (cmd) {
+        case CREATE:
+            return DgraphCreateCmd(interp, objc, objv);
+    }
+    return TCL_OK;
+}
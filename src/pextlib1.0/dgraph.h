@@ -0,0 +1,68 @@
+/*
+ * dgraph.h
+ *
+ * Copyright (c) 2026 The MacPorts Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of MacPorts Team nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DGRAPH_H
+#define _DGRAPH_H
+
+#include <tcl.h>
+
+/**
+ * A native command to schedule the evaluation of a dependency list, as
+ * done by dlist_eval with dlist_get_next in macports_dlist.
+ *
+ * The syntax is:
+ * dgraph create nodes
+ *	Create a graph from nodes, a list of {provides requires uses} lists of
+ *  tokens, and return the name of a new command giving access to it. Nodes
+ *  are numbered from 0 in the order of the list. All nodes are pending and
+ *  no token is provided yet.
+ *
+ * The returned command supports:
+ * $graph next
+ *	Return the number of the node dlist_get_next would select: the first
+ *  pending node whose requires tokens are all provided successfully, among
+ *  those with the fewest unprovided uses tokens, skipping nodes with
+ *  unprovided uses tokens that a pending node provides. Return -1 if there
+ *  is no such node.
+ * $graph start node
+ *	Mark node as being evaluated, so that next skips it while it stays
+ *  pending. Used to evaluate several nodes at once.
+ * $graph done node status
+ *	Mark node as evaluated, and its provides tokens as provided
+ *  successfully if status is 1, unsuccessfully otherwise.
+ * $graph pending
+ *	Return the numbers of the pending nodes, in order.
+ * $graph close
+ *	Delete the graph and the command.
+ */
+int DgraphCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
+
+#endif /* _DGRAPH_H */
@@ -0,0 +1,308 @@
+/*
+ * fastcopy.c
+ *
+ * Copyright (c) 2026 The MacPorts Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of MacPorts Team nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* required for copy_file_range(2) */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
+#if HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+#if HAVE_COPYFILE
+#include <copyfile.h>
+#endif
+
+#include <tcl.h>
+
+#include "fastcopy.h"
+
+/*
+ * Cloning shares the blocks of the source with the copy until either is
+ * modified, so it takes no time and no space whatever the size of the file.
+ * It is only possible within one file system, and only on those that
+ * support it through FICLONE, like Btrfs and XFS on Linux. The kernel copies
+ * are done without moving the data through user space, and some file
+ * systems (NFS 4.2, SMB) do them on the server. Each method carries on from
+ * the file offsets the previous one left, so falling back half way doesn't
+ * copy anything twice.
+ */
+
+#define FASTCOPY_BUFFER_SIZE (256 * 1024)
+/* the most sendfile(2) transfers at once on Linux */
+#define FASTCOPY_SENDFILE_MAX 0x7ffff000
+
+static const char* method_names[] = {
+    "clone", "copy_file_range", "sendfile", "buffered", NULL
+};
+
+/**
+ * Tells whether a method failed because it can't be used on these files,
+ * rather than because of an error the next method would run into as well.
+ */
+static int method_unsupported(int error) {
+    switch (error) {
+        case ENOSYS:
+        case EXDEV:
+        case EINVAL:
+        case EBADF:
+        case ENOTTY:
+        case EOPNOTSUPP:
+#if defined(ENOTSUP) && ENOTSUP != EOPNOTSUPP
+        case ENOTSUP:
+#endif
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Copies what's left with the kernel copy of the given method.
+ *
+ * @return 1 once size bytes were copied, 0 if the method can't be used or
+ *         stopped early, -1 on error
+ */
+static int copy_kernel(int from_fd, int to_fd, off_t* left,
+        fastcopy_method method) {
+#if HAVE_COPY_FILE_RANGE || HAVE_SYS_SENDFILE_H
+    while (*left > 0) {
+        size_t chunk = *left > FASTCOPY_SENDFILE_MAX
+            ? FASTCOPY_SENDFILE_MAX : (size_t)*left;
+        ssize_t count;
+
+        switch (method) {
+#if HAVE_COPY_FILE_RANGE
+            case FASTCOPY_COPY_FILE_RANGE:
+                count = copy_file_range(from_fd, NULL, to_fd, NULL, chunk, 0);
+                break;
+#endif
+#if HAVE_SYS_SENDFILE_H
+            case FASTCOPY_SENDFILE:
+                count = sendfile(to_fd, from_fd, NULL, chunk);
+                break;
+#endif
+            default:
+                return 0;
+        }
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            return method_unsupported(errno) ? 0 : -1;
+        }
+        if (count == 0) {
+            /* the source is shorter than it was, or the file system
+             * doesn't report its data this way (procfs and the like) */
+            return 0;
+        }
+        *left -= count;
+    }
+    return 1;
+#else
+    (void)from_fd;
+    (void)to_fd;
+    (void)left;
+    (void)method;
+    return 0;
+#endif
+}
+
+/**
+ * Reads and writes through a buffer until the end of the source.
+ */
+static int copy_buffered(int from_fd, int to_fd) {
+    char* buf = malloc(FASTCOPY_BUFFER_SIZE);
+    int ret = -1;
+
+    if (buf == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    for (;;) {
+        ssize_t count = read(from_fd, buf, FASTCOPY_BUFFER_SIZE);
+        char* p = buf;
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            ret = count == 0 ? 1 : -1;
+            break;
+        }
+        while (count > 0) {
+            ssize_t written = write(to_fd, p, (size_t)count);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                if (written == 0) {
+                    errno = EIO;
+                }
+                goto cleanup;
+            }
+            p += written;
+            count -= written;
+        }
+    }
+
+cleanup:
+    free(buf);
+    return ret;
+}
+
+int fastcopy_fd(int from_fd, int to_fd, off_t size, fastcopy_method* method) {
+    off_t left = size;
+
+    if (*method == FASTCOPY_CLONE) {
+#if defined(FICLONE)
+        if (ioctl(to_fd, FICLONE, from_fd) == 0) {
+            return 0;
+        }
+        if (!method_unsupported(errno)) {
+            return -1;
+        }
+#endif
+        *method = FASTCOPY_COPY_FILE_RANGE;
+    }
+    for (; *method < FASTCOPY_BUFFERED; (*method)++) {
+        int ret = copy_kernel(from_fd, to_fd, &left, *method);
+        if (ret != 0) {
+            return ret > 0 ? 0 : -1;
+        }
+    }
+    return copy_buffered(from_fd, to_fd) > 0 ? 0 : -1;
+}
+
+/**
+ * fastcopy command
+ */
+int FastcopyCmd(ClientData clientData UNUSED, Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]) {
+    static const char* options[] = { "-method", NULL };
+    fastcopy_method method = FASTCOPY_CLONE;
+    const char* source;
+    const char* target;
+    struct stat st;
+    struct timeval times[2];
+    int from_fd;
+    int to_fd = -1;
+    int i;
+
+    for (i = 1; i < objc - 2; i += 2) {
+        int option;
+        if (Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0,
+                    &option) != TCL_OK
+                || Tcl_GetIndexFromObj(interp, objv[i + 1], method_names,
+                    "method", 0, (int*)&method) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+    if (i != objc - 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "?-method method? source target");
+        return TCL_ERROR;
+    }
+    source = Tcl_GetString(objv[objc - 2]);
+    target = Tcl_GetString(objv[objc - 1]);
+
+    from_fd = open(source, O_RDONLY | O_CLOEXEC);
+    if (from_fd == -1 || fstat(from_fd, &st) != 0) {
+        goto error;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        errno = EINVAL;
+        goto error;
+    }
+    to_fd = open(target, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+            S_IRUSR | S_IWUSR);
+    if (to_fd == -1) {
+        goto error;
+    }
+    if (fastcopy_fd(from_fd, to_fd, st.st_size, &method) != 0) {
+        goto error_created;
+    }
+    /* the attributes file copy copies */
+    if (fchmod(to_fd, st.st_mode & (S_ISUID | S_ISGID | S_IRWXU | S_IRWXG
+                    | S_IRWXO)) != 0
+            && fchmod(to_fd, st.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO)) != 0) {
+        goto error_created;
+    }
+    if (close(to_fd) != 0) {
+        to_fd = -1;
+        goto error_created;
+    }
+    to_fd = -1;
+    times[0].tv_sec = st.st_atime;
+    times[0].tv_usec = 0;
+    times[1].tv_sec = st.st_mtime;
+    times[1].tv_usec = 0;
+    if (utimes(target, times) != 0) {
+        goto error_created;
+    }
+#if HAVE_COPYFILE
+    copyfile(source, target, NULL, COPYFILE_ACL | COPYFILE_XATTR);
+#endif
+    close(from_fd);
+    Tcl_SetResult(interp, (char*)method_names[method], TCL_STATIC);
+    return TCL_OK;
+
+error_created:
+    {
+        int saved_errno = errno;
+        if (to_fd != -1) {
+            close(to_fd);
+        }
+        unlink(target);
+        errno = saved_errno;
+    }
+error:
+    Tcl_SetErrno(errno);
+    Tcl_AppendResult(interp, "error copying \"", source, "\" to \"", target,
+            "\": ", Tcl_PosixError(interp), NULL);
+    if (from_fd != -1) {
+        close(from_fd);
+    }
+    return TCL_ERROR;
+}
@@ -0,0 +1,74 @@
+/*
+ * fastcopy.h
+ *
+ * Copyright (c) 2026 The MacPorts Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of MacPorts Team nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _FASTCOPY_H
+#define _FASTCOPY_H
+
+#include <sys/types.h>
+
+#include <tcl.h>
+
+/* the ways of copying data, from the cheapest to the most expensive */
+typedef enum {
+    FASTCOPY_CLONE, FASTCOPY_COPY_FILE_RANGE, FASTCOPY_SENDFILE,
+    FASTCOPY_BUFFERED
+} fastcopy_method;
+
+/**
+ * Copies the data of from_fd, size bytes long, to the empty file to_fd. The
+ * file is cloned if the file system can share its blocks between the two,
+ * otherwise the data is copied by the kernel with copy_file_range(2) or
+ * sendfile(2), and as a last resort read and written through a buffer. A
+ * method that isn't available is skipped, and one that stops half way is
+ * taken over by the next, so the methods before *method are never tried.
+ *
+ * @param method the first method to try; set to the one that copied the
+ *               end of the data
+ * @return 0 on success, -1 with errno set on error
+ */
+int fastcopy_fd(int from_fd, int to_fd, off_t size, fastcopy_method* method);
+
+/**
+ * A native command copying regular files with fastcopy_fd.
+ *
+ * The syntax is:
+ * fastcopy ?-method method? source target
+ *	Copy the regular file source to target, which must not exist yet, with
+ *  the permissions, access and modification times of source like file copy.
+ *  -method is the first method to try, one of clone, copy_file_range,
+ *  sendfile and buffered, clone by default. Returns the method that copied
+ *  the end of the data.
+ */
+int FastcopyCmd(ClientData clientData, Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[]);
+
+#endif
+	/* _FASTCOPY_H */
@@ -36,10 +36,14 @@
 /* needed for NAME_MAX and PATH_MAX on Linux */
 #define _XOPEN_SOURCE
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <strings.h>
 #include <unistd.h>
@@ -55,46 +59,186 @@
 /* ------------------------------------------------------------------------- **
  * Internal structures
  * ------------------------------------------------------------------------- */
-/* For the moment, we represent the map as a simple tree. */
+/*
+ * The map is a tree of directories. A directory is an array of entries
+ * sorted by name (case insensitively), so that looking a path component up
+ * is a binary search. Entries only hold indices: the names of the path
+ * components and the port names are each interned once in a string table,
+ * and directories live in a table of their own, which lets them be
+ * reallocated when they grow without updating their parent.
+ *
+ * The database file has the same layout (see SFileHeader), so opening it
+ * just maps it in memory and the tree is used from there. Directories are
+ * only copied to memory when they are changed, together with the
+ * directories on the way to them; entries of copied directories refer to
+ * their subdirectories that weren't copied by their offset in the file.
+ * Saving writes the copied directories and copies the rest of the file as
+ * it was, since in the file, a directory is followed by its subdirectories
+ * and refers to them by offsets relative to itself.
+ *
+ * Files in the format of version 1, where each node is a kind, a null
+ * terminated name and either a null terminated value or a big endian count
+ * of subnodes followed by the subnodes, are still loaded (into memory) and
+ * are saved in the new format.
+ */
 
-/** Constants saying whether a node is a leaf or not */
+/** Constants saying whether a node is a leaf or not (in version 1 files) */
 typedef enum {
 	kNode,
 	kLeaf
 } ENodeType;
 
+/** Flag set in SEntry.fKey for directories */
+#define kDirectoryFlag		0x80000000U
+
+/** Flag set in SEntry.fKey for directories in the mapped file */
+#define kMappedFlag			0x40000000U
+
+/** Mask for the index of the name in SEntry.fKey */
+#define kKeyMask			0x3FFFFFFFU
+
+/** Marker to check the byte order of database files */
+#define kByteOrderMark		0x01020304U
+
+/**
+ * Structure for an entry of a directory.
+ */
+typedef struct {
+	/** Index of the name of the directory or of the file in the key table,
+	 with kDirectoryFlag set for directories, and kMappedFlag for directories
+	 that are in the mapped file */
+	uint32_t		fKey;
+	/** For files, index of the value (the port name) in the value table.
+	 For directories, index of the directory in the directory table, its
+	 offset in the mapped file if kMappedFlag is set, or, in the file, its
+	 offset relative to the directory holding the entry */
+	uint32_t		fRef;
+} SEntry;
+
+/**
+ * Structure for a directory.
+ * Directories in the database file have the same layout, except that
+ * fCapacity is the size of the directory and all its subdirectories, which
+ * follow it.
+ */
+typedef struct {
+	/** Number of entries */
+	uint32_t		fCount;
+	/** Number of entries allocated */
+	uint32_t		fCapacity;
+	/** Array of entries, sorted by name */
+	SEntry			fEntries[1];
+} SDirectory;
+
+/**
+ * Structure to access directories in memory and in the file alike.
+ */
+typedef struct {
+	/** Number of entries */
+	uint32_t		fCount;
+	/** Array of entries, sorted by name */
+	const SEntry*	fEntries;
+	/** Offset of the directory in the mapped file, 0 if it's in memory */
+	uint32_t		fOffset;
+	/** Size of the directory and its subdirectories in the mapped file */
+	uint32_t		fSize;
+} SDirectoryView;
+
 /**
- * Structure for the header of a node.
+ * Structure for a table of interned strings.
+ * Each string is stored as a two bytes length followed by the characters and
+ * a null terminator. The strings of the mapped file come first, followed by
+ * those that were added in memory.
  */
 typedef struct {
-	/** Kind for this node */
-	ENodeType		fNodeType;
-	/** Name of the directory or of the file.
-	 The root has an empty string there. */
-	char			fKeySubpart[NAME_MAX+1];
-} SHeader;
+	/** The strings of the mapped file */
+	const char*		fMappedData;
+	/** Number of bytes of fMappedData */
+	uint32_t		fMappedDataSize;
+	/** Offset of each string of the mapped file in fMappedData */
+	const uint32_t*	fMappedOffsets;
+	/** Number of strings in the mapped file */
+	uint32_t		fMappedCount;
+	/** The strings added in memory */
+	char*			fData;
+	/** Number of bytes used in fData */
+	uint32_t		fDataSize;
+	/** Number of bytes allocated for fData */
+	uint32_t		fDataCapacity;
+	/** Offset of each string in fData */
+	uint32_t*		fOffsets;
+	/** Number of strings in fData */
+	uint32_t		fCount;
+	/** Number of offsets allocated */
+	uint32_t		fCapacity;
+	/** Hash table of the indices plus one of the strings in fData (0 is an
+	 empty bucket) */
+	uint32_t*		fBuckets;
+	/** Number of buckets, a power of two */
+	uint32_t		fBucketsCount;
+} SStringTable;
 
 /**
- * Structure for a node with subnode (i.e. a directory node).
+ * Structure for the tree.
  */
 typedef struct {
-	/** Header common to nodes and leaves */
-	SHeader			fHeader;
-	/** Number of subnodes */
-	unsigned int	fSubnodesCount;
-	/** Array of subnodes */
-	SHeader*		fSubnodes[1];
-} SNode;
+	/** Names of the directories and files */
+	SStringTable	fKeys;
+	/** Values, i.e. port names */
+	SStringTable	fValues;
+	/** Root directory, referred to like in the entry of a directory */
+	SEntry			fRoot;
+	/** Directories in memory */
+	SDirectory**	fDirectories;
+	/** Number of directories in memory (including unused ones) */
+	uint32_t		fDirectoriesCount;
+	/** Number of directories allocated */
+	uint32_t		fDirectoriesCapacity;
+	/** Indices of unused directories */
+	uint32_t*		fFreeDirectories;
+	/** Number of unused directories */
+	uint32_t		fFreeDirectoriesCount;
+	/** Number of unused directory indices allocated */
+	uint32_t		fFreeDirectoriesCapacity;
+	/** The mapped database file, or NULL */
+	char*			fMap;
+	/** Size of the mapped database file */
+	size_t			fMapSize;
+} STree;
 
 /**
- * Structure for a leaf (i.e. a file node).
+ * Structure for the header of database files.
+ * All numbers are in the byte order of the host, offsets are relative to
+ * the beginning of the file and are multiples of 4.
  */
 typedef struct {
-	/** Header common to nodes and leaves */
-	SHeader			fHeader;
-	/** Value, i.e. port name */
-	char			fValue[NAME_MAX+1];
-} SLeaf;
+	/** kFilemapSignature */
+	char			fSignature[24];
+	/** kFilemapVersion */
+	char			fVersion[4];
+	/** kByteOrderMark */
+	uint32_t		fByteOrder;
+	/** Size of the file */
+	uint32_t		fSize;
+	/** Offset of the root directory */
+	uint32_t		fRoot;
+	/** Number of keys */
+	uint32_t		fKeysCount;
+	/** Offset of the offsets of the keys in their data */
+	uint32_t		fKeysOffsets;
+	/** Offset of the data of the keys */
+	uint32_t		fKeysData;
+	/** Size of the data of the keys */
+	uint32_t		fKeysDataSize;
+	/** Number of values */
+	uint32_t		fValuesCount;
+	/** Offset of the offsets of the values in their data */
+	uint32_t		fValuesOffsets;
+	/** Offset of the data of the values */
+	uint32_t		fValuesData;
+	/** Size of the data of the values */
+	uint32_t		fValuesDataSize;
+} SFileHeader;
 
 /**
  * Structure for the internal representation of filemaps.
@@ -107,8 +251,8 @@ typedef struct {
 	char	fFilemapPath[PATH_MAX];
 	/** File descriptor on lock. */
 	int 	fLockFD;
-	/** Root of the filemap */
-	SNode*	fRoot;
+	/** The filemap */
+	STree	fTree;
 	/** If the filemap is read only */
 	char	fIsReadOnly;
 	/** If the filemap was changed */
@@ -118,6 +262,18 @@ typedef struct {
 	char	fIsRAMOnly;
 } SFilemapObject;
 
+/**
+ * Structure for the contents of a database file being saved.
+ */
+typedef struct {
+	/** The bytes */
+	char*	fBytes;
+	/** Number of bytes used */
+	size_t	fSize;
+	/** Number of bytes allocated */
+	size_t	fCapacity;
+} SBuffer;
+
 /** Error codes */
 enum {
 	kSignatureMismatch_Err		= -100000,
@@ -126,34 +282,39 @@ enum {
 	kUnknownNodeKind_Err		= -100003,
 	kNameTooLong_Err			= -100004,
 	kEOFWhileLoadingDB_Err		= -100005,
-	kUnknownOption_Err			= -100006
+	kUnknownOption_Err			= -100006,
+	kCorruptedDB_Err			= -100007
 };
 
 /* Constants relative to the storage format. */
 /** Signature at the beginning of filemap in files */
 static const char kFilemapSignature[24] = "org.darwinports.filemap";
 /** Version */
-static const char kFilemapVersion[4] = { 0x0, 0x1, 0x0, 0x0 };
+static const char kFilemapVersion[4] = { 0x0, 0x2, 0x0, 0x0 };
+/** Version of the format that isn't mapped */
+static const char kFilemapVersion1[4] = { 0x0, 0x1, 0x0, 0x0 };
 
 /* ------------------------------------------------------------------------- **
  * Prototypes
  * ------------------------------------------------------------------------- */
-int Load(const char* inDatabasePath, SNode** outTree);
-void Create(SNode** outTree);
+int Load(const char* inDatabasePath, STree* outTree);
+int LoadVersion1(int inDatabaseFd, ssize_t inFileSize, STree* ioTree);
+int Map(int inDatabaseFd, size_t inFileSize, STree* ioTree);
+void Create(STree* outTree);
 int LoadNode(
-		char** const ioDatabaseBuffer,
-		SHeader** outNode, ssize_t* ioBytesLeft);
-int Save(const char* inDatabasePath, SNode* inTree);
-int SaveNode(int inDatabaseFd, SHeader* inNode);
-void Free(SNode** ioRoot);
-int Set(SNode** ioRoot, const char* inPath, const char* inValue);
-const char* Get(SNode* inRoot, const char* inPath);
-Tcl_Obj* List(SNode* inRoot, const char* inValue);
+		STree* ioTree, uint32_t inDirectory,
+		char** const ioDatabaseBuffer, ssize_t* ioBytesLeft);
+int Save(const char* inDatabasePath, STree* inTree);
+int SaveNode(SBuffer* ioBuffer, STree* inTree, SEntry inDirectory);
+void Free(STree* ioTree);
+int Set(STree* ioTree, const char* inPath, const char* inValue);
+const char* Get(STree* inTree, const char* inPath);
+Tcl_Obj* List(STree* inTree, const char* inValue);
 void ListSubtree(
-		SHeader* inRoot, const char* inValue,
-		Tcl_Obj* outList, const char* inSubpath,
-		unsigned int inSubpathLen);
-int Delete(SNode** ioRoot, const char* inPath);
+		STree* inTree, SEntry inDirectory,
+		const char* inMatches, Tcl_Obj* outList,
+		Tcl_DString* ioSubpath);
+int Delete(STree* ioTree, uint32_t inDirectory, const char* inPath);
 void FreeFilemapInternalRep(Tcl_Obj* inObjPtr);
 void DupFilemapInternalRep(Tcl_Obj* inSrcPtr, Tcl_Obj* inDupPtr);
 void UpdateStringOfFilemap(Tcl_Obj* inObjPtr);
@@ -183,14 +344,623 @@ Tcl_ObjType tclFilemapType = {
 	SetFilemapFromAny
 };
 
+/* ========================================================================= **
+ * String tables
+ * ========================================================================= */
+
+/**
+ * Grow an array so that it can hold at least inNeeded elements.
+ *
+ * @param inArray		the array (can be NULL).
+ * @param ioCapacity	number of elements allocated, updated by this function.
+ * @param inNeeded		number of elements needed.
+ * @param inElementSize	size of an element.
+ * @return the (possibly moved) array.
+ */
+static void*
+GrowArray(void* inArray, uint32_t* ioCapacity, uint32_t inNeeded, size_t inElementSize)
+{
+	uint32_t theCapacity = *ioCapacity;
+
+	if (inNeeded <= theCapacity)
+	{
+		return inArray;
+	}
+
+	if (theCapacity < 4)
+	{
+		theCapacity = 4;
+	}
+	while (theCapacity < inNeeded)
+	{
+		theCapacity *= 2;
+	}
+	*ioCapacity = theCapacity;
+
+	return ckrealloc((char*) inArray, theCapacity * inElementSize);
+}
+
+/**
+ * Hash a string (FNV-1a).
+ *
+ * @param inString	the string.
+ * @param inLength	length of the string.
+ * @return the hash.
+ */
+static uint32_t
+HashString(const char* inString, unsigned int inLength)
+{
+	uint32_t theHash = 2166136261U;
+	unsigned int indexChars;
+
+	for (indexChars = 0; indexChars < inLength; indexChars++)
+	{
+		theHash ^= (unsigned char) inString[indexChars];
+		theHash *= 16777619U;
+	}
+
+	return theHash;
+}
+
+/**
+ * Initialize an empty string table.
+ *
+ * @param outTable	the table.
+ */
+static void
+InitStrings(SStringTable* outTable)
+{
+	(void) memset(outTable, 0, sizeof(*outTable));
+}
+
+/**
+ * Free a string table.
+ *
+ * @param ioTable	the table.
+ */
+static void
+FreeStrings(SStringTable* ioTable)
+{
+	if (ioTable->fData)
+	{
+		ckfree(ioTable->fData);
+	}
+	if (ioTable->fOffsets)
+	{
+		ckfree((char*) ioTable->fOffsets);
+	}
+	if (ioTable->fBuckets)
+	{
+		ckfree((char*) ioTable->fBuckets);
+	}
+	InitStrings(ioTable);
+}
+
+/**
+ * Return the string at some offset of string data.
+ *
+ * @param inData		the data.
+ * @param inDataSize	size of the data.
+ * @param inOffset		offset of the string.
+ * @param outLength		on output, length of the string (can be NULL).
+ * @return the (null terminated) string, an empty string if the offset is
+ *		   invalid.
+ */
+static const char*
+StringAtOffset(
+		const char* inData, uint32_t inDataSize, uint32_t inOffset,
+		unsigned int* outLength)
+{
+	uint16_t theLength = 0;
+
+	if ((inOffset <= inDataSize) && (inDataSize - inOffset > sizeof(theLength)))
+	{
+		(void) memcpy(&theLength, inData + inOffset, sizeof(theLength));
+		if ((inDataSize - inOffset - sizeof(theLength) > theLength)
+			&& (inData[inOffset + sizeof(theLength) + theLength] == '\0'))
+		{
+			if (outLength)
+			{
+				*outLength = theLength;
+			}
+			return inData + inOffset + sizeof(theLength);
+		}
+	}
+
+	if (outLength)
+	{
+		*outLength = 0;
+	}
+	return "";
+}
+
+/**
+ * Return a string from a table.
+ * The pointer is valid until a string is added to the table.
+ *
+ * @param inTable	the table.
+ * @param inIndex	index of the string.
+ * @param outLength	on output, length of the string (can be NULL).
+ * @return the (null terminated) string, an empty string if the index is
+ *		   invalid.
+ */
+static const char*
+StringAt(const SStringTable* inTable, uint32_t inIndex, unsigned int* outLength)
+{
+	if (inIndex < inTable->fMappedCount)
+	{
+		return StringAtOffset(
+				inTable->fMappedData, inTable->fMappedDataSize,
+				inTable->fMappedOffsets[inIndex], outLength);
+	}
+	inIndex -= inTable->fMappedCount;
+	if (inIndex < inTable->fCount)
+	{
+		return StringAtOffset(
+				inTable->fData, inTable->fDataSize,
+				inTable->fOffsets[inIndex], outLength);
+	}
+
+	if (outLength)
+	{
+		*outLength = 0;
+	}
+	return "";
+}
+
+/**
+ * Return the index of a string in a table, adding it if it isn't there yet.
+ * Strings are compared exactly. Strings of the mapped file are not looked
+ * up, they are only added once more to the table.
+ *
+ * @param ioTable	the table.
+ * @param inString	the string.
+ * @param inLength	length of the string (at most NAME_MAX).
+ * @return the index of the string.
+ */
+static uint32_t
+InternString(SStringTable* ioTable, const char* inString, unsigned int inLength)
+{
+	uint32_t theHash = HashString(inString, inLength);
+	uint32_t theMask;
+	uint32_t theBucket;
+	uint32_t theIndex;
+	uint16_t theLength = (uint16_t) inLength;
+
+	/* keep the hash table at most half full */
+	if (ioTable->fBucketsCount < (ioTable->fCount + 1) * 2)
+	{
+		uint32_t theCount = ioTable->fBucketsCount ? ioTable->fBucketsCount * 2 : 64;
+		uint32_t indexStrings;
+
+		if (ioTable->fBuckets)
+		{
+			ckfree((char*) ioTable->fBuckets);
+		}
+		ioTable->fBuckets = (uint32_t*) ckalloc(theCount * sizeof(uint32_t));
+		(void) memset(ioTable->fBuckets, 0, theCount * sizeof(uint32_t));
+		ioTable->fBucketsCount = theCount;
+
+		/* rehash everything */
+		for (indexStrings = 0; indexStrings < ioTable->fCount; indexStrings++)
+		{
+			unsigned int theOtherLength;
+			const char* theOther = StringAtOffset(
+					ioTable->fData, ioTable->fDataSize,
+					ioTable->fOffsets[indexStrings], &theOtherLength);
+
+			theBucket = HashString(theOther, theOtherLength) & (theCount - 1);
+			while (ioTable->fBuckets[theBucket] != 0)
+			{
+				theBucket = (theBucket + 1) & (theCount - 1);
+			}
+			ioTable->fBuckets[theBucket] = indexStrings + 1;
+		}
+	}
+
+	/* look it up */
+	theMask = ioTable->fBucketsCount - 1;
+	theBucket = theHash & theMask;
+	while (ioTable->fBuckets[theBucket] != 0)
+	{
+		unsigned int theOtherLength;
+		const char* theOther;
+
+		theIndex = ioTable->fBuckets[theBucket] - 1;
+		theOther = StringAtOffset(
+				ioTable->fData, ioTable->fDataSize,
+				ioTable->fOffsets[theIndex], &theOtherLength);
+		if ((theOtherLength == inLength) && (memcmp(theOther, inString, inLength) == 0))
+		{
+			return ioTable->fMappedCount + theIndex;
+		}
+		theBucket = (theBucket + 1) & theMask;
+	}
+
+	/* add it */
+	theIndex = ioTable->fCount;
+	ioTable->fOffsets = (uint32_t*) GrowArray(
+			ioTable->fOffsets, &ioTable->fCapacity,
+			theIndex + 1, sizeof(uint32_t));
+	ioTable->fData = (char*) GrowArray(
+			ioTable->fData, &ioTable->fDataCapacity,
+			ioTable->fDataSize + sizeof(theLength) + inLength + 1, 1);
+	ioTable->fOffsets[theIndex] = ioTable->fDataSize;
+	(void) memcpy(ioTable->fData + ioTable->fDataSize, &theLength, sizeof(theLength));
+	(void) memcpy(ioTable->fData + ioTable->fDataSize + sizeof(theLength), inString, inLength);
+	ioTable->fData[ioTable->fDataSize + sizeof(theLength) + inLength] = '\0';
+	ioTable->fDataSize += sizeof(theLength) + inLength + 1;
+	ioTable->fCount++;
+	ioTable->fBuckets[theBucket] = theIndex + 1;
+
+	return ioTable->fMappedCount + theIndex;
+}
+
 /* ========================================================================= **
  * Tree access functions
  * ========================================================================= */
 
+/**
+ * Compare the name of an entry with a path component, the way entries are
+ * sorted: case insensitively, a name sorting before the names it's a prefix
+ * of.
+ *
+ * @param inKey			name of the entry.
+ * @param inKeyLength	length of the name.
+ * @param inPart		path component (not null terminated).
+ * @param inPartLength	length of the path component.
+ * @return <0, 0 or >0 like strcmp.
+ */
+static int
+CompareKey(
+		const char* inKey, unsigned int inKeyLength,
+		const char* inPart, unsigned int inPartLength)
+{
+	int theCompResult = strncasecmp(
+			inKey, inPart,
+			inKeyLength < inPartLength ? inKeyLength : inPartLength);
+	if (theCompResult == 0)
+	{
+		theCompResult = (int) inKeyLength - (int) inPartLength;
+	}
+
+	return theCompResult;
+}
+
+/**
+ * Access a directory, in memory or in the mapped file.
+ * Directories of the file that are out of its bounds are seen as empty.
+ *
+ * @param inTree		the tree.
+ * @param inDirectory	entry referring to the directory.
+ * @param outView		on output, the directory.
+ */
+static void
+GetDirectory(const STree* inTree, SEntry inDirectory, SDirectoryView* outView)
+{
+	if (inDirectory.fKey & kMappedFlag)
+	{
+		uint32_t theOffset = inDirectory.fRef;
+		const SDirectory* theDirectory;
+
+		outView->fCount = 0;
+		outView->fEntries = NULL;
+		outView->fOffset = 0;
+		outView->fSize = 0;
+		if ((theOffset % 4 != 0) || (theOffset == 0)
+			|| (theOffset > inTree->fMapSize - offsetof(SDirectory, fEntries)))
+		{
+			return;
+		}
+		theDirectory = (const SDirectory*) (inTree->fMap + theOffset);
+		if ((theDirectory->fCapacity % 4 == 0)
+			&& (theDirectory->fCapacity >= offsetof(SDirectory, fEntries))
+			&& (theDirectory->fCapacity <= inTree->fMapSize - theOffset)
+			&& (theDirectory->fCount
+				<= (theDirectory->fCapacity - offsetof(SDirectory, fEntries))
+					/ sizeof(SEntry)))
+		{
+			outView->fCount = theDirectory->fCount;
+			outView->fEntries = theDirectory->fEntries;
+			outView->fOffset = theOffset;
+			outView->fSize = theDirectory->fCapacity;
+		}
+	} else {
+		SDirectory* theDirectory = inTree->fDirectories[inDirectory.fRef];
+
+		outView->fCount = theDirectory->fCount;
+		outView->fEntries = theDirectory->fEntries;
+		outView->fOffset = 0;
+		outView->fSize = 0;
+	}
+}
+
+/**
+ * Return an entry of a directory, with the reference to the subdirectory
+ * made absolute for directories of the mapped file.
+ * A subdirectory of the file has to be within the extent of its directory,
+ * after its entries, so that a corrupted file can't make walking the tree
+ * loop; subdirectories that aren't are seen as empty.
+ *
+ * @param inView		the directory.
+ * @param inIndex		index of the entry.
+ * @return the entry.
+ */
+static SEntry
+EntryAt(const SDirectoryView* inView, uint32_t inIndex)
+{
+	SEntry theEntry = inView->fEntries[inIndex];
+
+	if ((inView->fOffset != 0) && (theEntry.fKey & kDirectoryFlag))
+	{
+		uint32_t theRelativeOffset = theEntry.fRef;
+		const char* theParent =
+			(const char*) inView->fEntries - offsetof(SDirectory, fEntries);
+
+		theEntry.fKey |= kMappedFlag;
+		theEntry.fRef = 0;
+		if ((theRelativeOffset % 4 == 0)
+			&& (theRelativeOffset >= offsetof(SDirectory, fEntries) + inView->fCount * sizeof(SEntry))
+			&& (theRelativeOffset <= inView->fSize - offsetof(SDirectory, fEntries)))
+		{
+			const SDirectory* theDirectory =
+				(const SDirectory*) (theParent + theRelativeOffset);
+			if (theDirectory->fCapacity <= inView->fSize - theRelativeOffset)
+			{
+				theEntry.fRef = inView->fOffset + theRelativeOffset;
+			}
+		}
+	}
+
+	return theEntry;
+}
+
+/**
+ * Look an entry up in a directory.
+ *
+ * @param inTree		the tree.
+ * @param inView		the directory.
+ * @param inPart		name of the entry (not null terminated).
+ * @param inPartLength	length of the name.
+ * @param outIndex		on output, index of the entry if it was found,
+ *						index where it should be inserted otherwise.
+ * @return 1 if the entry was found, 0 otherwise.
+ */
+static int
+FindEntry(
+		STree* inTree, const SDirectoryView* inView,
+		const char* inPart, unsigned int inPartLength,
+		uint32_t* outIndex)
+{
+	uint32_t theLow = 0;
+	uint32_t theHigh = inView->fCount;
+
+	while (theLow < theHigh)
+	{
+		uint32_t theMiddle = theLow + (theHigh - theLow) / 2;
+		unsigned int theKeyLength;
+		const char* theKey = StringAt(
+				&inTree->fKeys,
+				inView->fEntries[theMiddle].fKey & kKeyMask,
+				&theKeyLength);
+		int theCompResult = CompareKey(theKey, theKeyLength, inPart, inPartLength);
+
+		if (theCompResult == 0)
+		{
+			*outIndex = theMiddle;
+			return 1;
+		} else if (theCompResult < 0) {
+			theLow = theMiddle + 1;
+		} else {
+			theHigh = theMiddle;
+		}
+	}
+
+	*outIndex = theLow;
+	return 0;
+}
+
+/**
+ * Insert an entry in a directory in memory.
+ *
+ * @param ioTree		the tree.
+ * @param inDirectory	index of the directory.
+ * @param inIndex		where to insert the entry.
+ * @param inEntry		the entry.
+ */
+static void
+InsertEntry(STree* ioTree, uint32_t inDirectory, uint32_t inIndex, SEntry inEntry)
+{
+	SDirectory* theDirectory = ioTree->fDirectories[inDirectory];
+
+	if (theDirectory->fCount == theDirectory->fCapacity)
+	{
+		theDirectory->fCapacity *= 2;
+		theDirectory = (SDirectory*) ckrealloc(
+				(char*) theDirectory,
+				sizeof(SDirectory) + (theDirectory->fCapacity - 1) * sizeof(SEntry));
+		ioTree->fDirectories[inDirectory] = theDirectory;
+	}
+
+	(void) memmove(
+			&theDirectory->fEntries[inIndex + 1],
+			&theDirectory->fEntries[inIndex],
+			(theDirectory->fCount - inIndex) * sizeof(SEntry));
+	theDirectory->fEntries[inIndex] = inEntry;
+	theDirectory->fCount++;
+}
+
+/**
+ * Remove an entry from a directory in memory.
+ * The directory the entry refers to, if any, isn't freed.
+ *
+ * @param ioTree		the tree.
+ * @param inDirectory	index of the directory.
+ * @param inIndex		index of the entry.
+ */
+static void
+RemoveEntry(STree* ioTree, uint32_t inDirectory, uint32_t inIndex)
+{
+	SDirectory* theDirectory = ioTree->fDirectories[inDirectory];
+
+	theDirectory->fCount--;
+	(void) memmove(
+			&theDirectory->fEntries[inIndex],
+			&theDirectory->fEntries[inIndex + 1],
+			(theDirectory->fCount - inIndex) * sizeof(SEntry));
+}
+
+/**
+ * Create an empty directory in memory.
+ *
+ * @param ioTree		the tree.
+ * @param inCapacity	number of entries to allocate.
+ * @return the index of the directory.
+ */
+static uint32_t
+NewDirectory(STree* ioTree, uint32_t inCapacity)
+{
+	uint32_t theIndex;
+	SDirectory* theDirectory;
+
+	if (inCapacity < 1)
+	{
+		inCapacity = 1;
+	}
+	theDirectory = (SDirectory*) ckalloc(
+			sizeof(SDirectory) + (inCapacity - 1) * sizeof(SEntry));
+	theDirectory->fCount = 0;
+	theDirectory->fCapacity = inCapacity;
+
+	if (ioTree->fFreeDirectoriesCount > 0)
+	{
+		theIndex = ioTree->fFreeDirectories[--ioTree->fFreeDirectoriesCount];
+	} else {
+		theIndex = ioTree->fDirectoriesCount++;
+		ioTree->fDirectories = (SDirectory**) GrowArray(
+				ioTree->fDirectories, &ioTree->fDirectoriesCapacity,
+				ioTree->fDirectoriesCount, sizeof(SDirectory*));
+	}
+	ioTree->fDirectories[theIndex] = theDirectory;
+
+	return theIndex;
+}
+
+/**
+ * Recursive function to free a directory in memory.
+ * Its subdirectories in the mapped file are left alone.
+ *
+ * @param ioTree		the tree.
+ * @param inDirectory	index of the directory.
+ */
+static void
+FreeDirectory(STree* ioTree, uint32_t inDirectory)
+{
+	SDirectory* theDirectory = ioTree->fDirectories[inDirectory];
+	uint32_t indexEntries;
+
+	for (indexEntries = 0; indexEntries < theDirectory->fCount; indexEntries++)
+	{
+		SEntry theEntry = theDirectory->fEntries[indexEntries];
+		if ((theEntry.fKey & (kDirectoryFlag | kMappedFlag)) == kDirectoryFlag)
+		{
+			FreeDirectory(ioTree, theEntry.fRef);
+		}
+	}
+
+	ckfree((char*) theDirectory);
+	ioTree->fDirectories[inDirectory] = NULL;
+	ioTree->fFreeDirectories = (uint32_t*) GrowArray(
+			ioTree->fFreeDirectories, &ioTree->fFreeDirectoriesCapacity,
+			ioTree->fFreeDirectoriesCount + 1, sizeof(uint32_t));
+	ioTree->fFreeDirectories[ioTree->fFreeDirectoriesCount++] = inDirectory;
+}
+
+/**
+ * Make sure a directory is in memory, copying it from the mapped file if
+ * required, so that it can be changed.
+ *
+ * @param ioTree		the tree.
+ * @param ioEntry		entry referring to the directory, updated to refer
+ *						to the copy.
+ * @return the index of the directory in memory.
+ */
+static uint32_t
+CopyDirectory(STree* ioTree, SEntry* ioEntry)
+{
+	SDirectoryView theView;
+	SDirectory* theDirectory;
+	uint32_t theIndex;
+	uint32_t indexEntries;
+
+	if (!(ioEntry->fKey & kMappedFlag))
+	{
+		return ioEntry->fRef;
+	}
+
+	GetDirectory(ioTree, *ioEntry, &theView);
+	theIndex = NewDirectory(ioTree, theView.fCount);
+	theDirectory = ioTree->fDirectories[theIndex];
+	for (indexEntries = 0; indexEntries < theView.fCount; indexEntries++)
+	{
+		theDirectory->fEntries[indexEntries] = EntryAt(&theView, indexEntries);
+	}
+	theDirectory->fCount = theView.fCount;
+
+	ioEntry->fKey &= ~kMappedFlag;
+	ioEntry->fRef = theIndex;
+
+	return theIndex;
+}
+
+/**
+ * Split the next component off a path.
+ *
+ * @param ioPath		the path, on output, what follows the component.
+ * @param outPart		on output, the component (not null terminated).
+ * @param outPartLength	on output, the length of the component.
+ * @return '/' if the component is a directory name, '\0' if it's a file name
+ *		   and -1 if there is no component left.
+ */
+static int
+NextComponent(const char** ioPath, const char** outPart, unsigned int* outPartLength)
+{
+	const char* beginCursor = *ioPath;
+	const char* endCursor;
+
+	/* jump to first non / character in the path */
+	while (*beginCursor == '/')
+	{
+		beginCursor++;
+	}
+	if (*beginCursor == '\0')
+	{
+		return -1;
+	}
+
+	/* find end of path element and determine if we have a file name or a
+		directory name (i.e. if there is a leading / or not) */
+	endCursor = beginCursor;
+	while ((*endCursor != '/') && (*endCursor != '\0'))
+	{
+		endCursor++;
+	}
+
+	*outPart = beginCursor;
+	*outPartLength = endCursor - beginCursor;
+	if (*endCursor == '/')
+	{
+		*ioPath = endCursor + 1;
+		return '/';
+	}
+	*ioPath = endCursor;
+	return '\0';
+}
+
 /**
  * Load the database from a file.
- * This function reads the whole file into a buffer, checks the header and then
- * calls LoadNode.
+ * This function checks the header of the file and maps it, or loads it if
+ * it's in the format of version 1.
  *
  * @param inDatabasePath	path to the database file.
  * @param outTree			on output, tree in memory
@@ -198,16 +968,16 @@ Tcl_ObjType tclFilemapType = {
 int
 Load(
 		const char* inDatabasePath,
-		SNode** outTree)
+		STree* outTree)
 {
 	int theErr = 0;
-	char* theFileBuffer = NULL;
 	int theFD = -1;
-	
+
+	Create(outTree);
+
 	do {
 		struct stat theFileInfo;
-		char* theFileCursor;
-		ssize_t theFileSize;
+		char theHeader[sizeof(kFilemapSignature) + sizeof(kFilemapVersion)];
 
 		/* Open the file for reading, creating it if necessary. */
 		theFD = open(inDatabasePath, O_RDONLY | O_CREAT, 0664);
@@ -223,58 +993,205 @@ Load(
 			theErr = errno;
 			break;
 		}
-		
-		theFileSize = theFileInfo.st_size;
-		if (theFileSize == 0)
+
+		if (theFileInfo.st_size == 0)
 		{
-			SNode* theRoot = (SNode*) ckalloc(sizeof(SNode) - sizeof(SHeader*));
-			theRoot->fSubnodesCount = 0;
-			theRoot->fHeader.fNodeType = kNode;
-			theRoot->fHeader.fKeySubpart[0] = '\0';
-			*outTree = theRoot;
 			break;
 		}
-		
-		if (theFileSize < (ssize_t) (sizeof(kFilemapSignature) + sizeof(kFilemapVersion)))
+
+		if (theFileInfo.st_size < (off_t) sizeof(theHeader))
 		{
 			theErr = kUnknownVersion_Err;
 			break;
 		}
-		
-		/* allocate a buffer to put the whole file.
-			(note: the tree itself is just as big as the file) */
-		theFileBuffer = (char*) ckalloc(theFileSize);
-		
-		/* read the whole file */
-		if (read(theFD, theFileBuffer, theFileSize) != theFileSize)
+
+		if (read(theFD, theHeader, sizeof(theHeader)) != sizeof(theHeader))
 		{
 			theErr = errno;
 			break;
 		}
-		
+
 		/* check the signature */
-		if (memcmp(theFileBuffer, kFilemapSignature, sizeof(kFilemapSignature)) != 0)
+		if (memcmp(theHeader, kFilemapSignature, sizeof(kFilemapSignature)) != 0)
 		{
 			theErr = kSignatureMismatch_Err;
 			break;
 		}
-		
-		theFileCursor = theFileBuffer;
-		theFileCursor += sizeof(kFilemapSignature);
-		theFileSize -= sizeof(kFilemapSignature);
-		
+
 		/* check the version */
-		if (memcmp(theFileCursor, kFilemapVersion, sizeof(kFilemapVersion)) != 0)
+		if (memcmp(
+				theHeader + sizeof(kFilemapSignature),
+				kFilemapVersion,
+				sizeof(kFilemapVersion)) == 0)
 		{
+			theErr = Map(theFD, theFileInfo.st_size, outTree);
+		} else if (memcmp(
+				theHeader + sizeof(kFilemapSignature),
+				kFilemapVersion1,
+				sizeof(kFilemapVersion1)) == 0) {
+			theErr = LoadVersion1(theFD, theFileInfo.st_size, outTree);
+		} else {
 			theErr = kUnknownVersion_Err;
+		}
+	} while (0);
+
+	/* close the file if required */
+	if (theFD >= 0)
+	{
+		(void) close(theFD);
+	}
+
+	return theErr;
+}
+
+/**
+ * Map a database file and use it as the tree.
+ *
+ * @param inDatabaseFd		file descriptor of the database.
+ * @param inFileSize		size of the file.
+ * @param ioTree			the (empty) tree.
+ */
+int
+Map(
+		int inDatabaseFd,
+		size_t inFileSize,
+		STree* ioTree)
+{
+	const SFileHeader* theHeader;
+	char* theMap;
+
+	if ((inFileSize < sizeof(SFileHeader)) || (inFileSize > UINT32_MAX))
+	{
+		return kCorruptedDB_Err;
+	}
+
+	theMap = mmap(NULL, inFileSize, PROT_READ, MAP_SHARED, inDatabaseFd, 0);
+	if (theMap == MAP_FAILED)
+	{
+		return errno;
+	}
+	ioTree->fMap = theMap;
+	ioTree->fMapSize = inFileSize;
+
+	theHeader = (const SFileHeader*) theMap;
+	if (theHeader->fByteOrder != kByteOrderMark)
+	{
+		/* written on a machine with the other byte order */
+		return kUnknownVersion_Err;
+	}
+
+	/* check that the tables are in the file, the rest is checked when it's
+		accessed */
+	if ((theHeader->fSize != inFileSize)
+		|| (theHeader->fKeysOffsets % 4 != 0)
+		|| (theHeader->fKeysOffsets > inFileSize)
+		|| (theHeader->fKeysCount > (inFileSize - theHeader->fKeysOffsets) / 4)
+		|| (theHeader->fKeysData > inFileSize)
+		|| (theHeader->fKeysDataSize > inFileSize - theHeader->fKeysData)
+		|| (theHeader->fValuesOffsets % 4 != 0)
+		|| (theHeader->fValuesOffsets > inFileSize)
+		|| (theHeader->fValuesCount > (inFileSize - theHeader->fValuesOffsets) / 4)
+		|| (theHeader->fValuesData > inFileSize)
+		|| (theHeader->fValuesDataSize > inFileSize - theHeader->fValuesData)
+		|| (theHeader->fKeysCount > kKeyMask))
+	{
+		return kCorruptedDB_Err;
+	}
+
+	ioTree->fKeys.fMappedData = theMap + theHeader->fKeysData;
+	ioTree->fKeys.fMappedDataSize = theHeader->fKeysDataSize;
+	ioTree->fKeys.fMappedOffsets = (const uint32_t*) (theMap + theHeader->fKeysOffsets);
+	ioTree->fKeys.fMappedCount = theHeader->fKeysCount;
+	ioTree->fValues.fMappedData = theMap + theHeader->fValuesData;
+	ioTree->fValues.fMappedDataSize = theHeader->fValuesDataSize;
+	ioTree->fValues.fMappedOffsets = (const uint32_t*) (theMap + theHeader->fValuesOffsets);
+	ioTree->fValues.fMappedCount = theHeader->fValuesCount;
+
+	/* use the root of the file instead of the empty one */
+	FreeDirectory(ioTree, ioTree->fRoot.fRef);
+	ioTree->fRoot.fKey = kDirectoryFlag | kMappedFlag;
+	ioTree->fRoot.fRef = theHeader->fRoot;
+
+	return 0;
+}
+
+/**
+ * Load a database file in the format of version 1.
+ * This function reads the whole file into a buffer, and calls LoadNode for
+ * the entries of the root.
+ *
+ * @param inDatabaseFd		file descriptor of the database.
+ * @param inFileSize		size of the file.
+ * @param ioTree			the (empty) tree.
+ */
+int
+LoadVersion1(
+		int inDatabaseFd,
+		ssize_t inFileSize,
+		STree* ioTree)
+{
+	int theErr = 0;
+	char* theFileBuffer = NULL;
+
+	do {
+		char* theFileCursor;
+		ssize_t theFileSize = inFileSize;
+		char* theKeyEnd;
+		unsigned int theSubnodesCount;
+		unsigned int indexSubnodes;
+
+		/* allocate a buffer to put the whole file. */
+		theFileBuffer = (char*) ckalloc(theFileSize);
+
+		/* read the whole file */
+		if ((lseek(inDatabaseFd, 0, SEEK_SET) != 0)
+			|| (read(inDatabaseFd, theFileBuffer, theFileSize) != theFileSize))
+		{
+			theErr = errno;
 			break;
 		}
-		
-		theFileCursor += sizeof(kFilemapVersion);
-		theFileSize -= sizeof(kFilemapVersion);
-		
+
+		/* skip the signature and the version */
+		theFileCursor = theFileBuffer;
+		theFileCursor += sizeof(kFilemapSignature) + sizeof(kFilemapVersion1);
+		theFileSize -= sizeof(kFilemapSignature) + sizeof(kFilemapVersion1);
+
+		/* the root is a node, its key is ignored */
+		if (theFileSize == 0)
+		{
+			theErr = kEOFWhileLoadingDB_Err;
+			break;
+		}
+		if (*theFileCursor != kNode)
+		{
+			theErr = kUnknownNodeKind_Err;
+			break;
+		}
+		theKeyEnd = memchr(theFileCursor + 1, '\0', theFileSize - 1);
+		if ((theKeyEnd == NULL) || ((theFileCursor + theFileSize) - (theKeyEnd + 1) < 4))
+		{
+			theErr = kEOFWhileLoadingDB_Err;
+			break;
+		}
+		theFileSize -= (theKeyEnd + 1) - theFileCursor;
+		theFileCursor = theKeyEnd + 1;
+		theSubnodesCount =
+				(((unsigned char) theFileCursor[0]) << 24)
+			|	(((unsigned char) theFileCursor[1]) << 16)
+			|	(((unsigned char) theFileCursor[2]) << 8)
+			|	(((unsigned char) theFileCursor[3]));
+		theFileCursor += 4;
+		theFileSize -= 4;
+
 		/* load the tree recursively */
-		theErr = LoadNode(&theFileCursor, (SHeader**) outTree, &theFileSize);
+		for (indexSubnodes = 0; indexSubnodes < theSubnodesCount; indexSubnodes++)
+		{
+			theErr = LoadNode(ioTree, ioTree->fRoot.fRef, &theFileCursor, &theFileSize);
+			if (theErr != 0)
+			{
+				break;
+			}
+		}
 	} while (0);
 
 	if (theFileBuffer)
@@ -282,12 +1199,6 @@ Load(
 		ckfree(theFileBuffer);
 	}
 
-	/* close the file if required */
-	if (theFD >= 0)
-	{
-		(void) close(theFD);
-	}
-
 	return theErr;
 }
 
@@ -298,28 +1209,31 @@ Load(
  */
 void
 Create(
-		SNode** outTree)
+		STree* outTree)
 {
-	SNode* theRoot = (SNode*) ckalloc(sizeof(SNode) - sizeof(SHeader*));
-	theRoot->fSubnodesCount = 0;
-	theRoot->fHeader.fNodeType = kNode;
-	theRoot->fHeader.fKeySubpart[0] = '\0';
-	*outTree = theRoot;
+	(void) memset(outTree, 0, sizeof(*outTree));
+	InitStrings(&outTree->fKeys);
+	InitStrings(&outTree->fValues);
+	outTree->fRoot.fKey = kDirectoryFlag;
+	outTree->fRoot.fRef = NewDirectory(outTree, 1);
 }
 
 /**
- * Recursive function to load the database from a buffer.
+ * Recursive function to load a node of a version 1 database from a buffer
+ * and add it to a directory.
  *
+ * @param ioTree			the tree.
+ * @param inDirectory		index of the directory the node belongs to.
  * @param ioDatabaseBuffer	pointer to the buffer (where the node starts),
  *							updated by this function.
- * @param outNode			on output, a tree in memory.
  * @param ioBytesLeft		number of bytes remaining in the buffer (updated
  *							by this function).
  */
 int
 LoadNode(
+		STree* ioTree,
+		uint32_t inDirectory,
 		char** const ioDatabaseBuffer,
-		SHeader** outNode,
 		ssize_t* ioBytesLeft)
 {
 	int theErr = 0;
@@ -328,7 +1242,13 @@ LoadNode(
 
 	do {
 		char theKind;
+		char* theKeySubpart;
 		unsigned int theKeySubpartSize;
+		char* theEnd;
+		SEntry theEntry;
+		SDirectory* theDirectory;
+		uint32_t theIndex;
+		int isDuplicate = 0;
 
 		/* get the kind (it's one byte) */
 		if (theBytesLeft == 0)
@@ -338,79 +1258,89 @@ LoadNode(
 		}
 		theBytesLeft--;
 		theKind = *theDatabaseBuffer++;
-		
+
 		if ((theKind != kLeaf) && (theKind != kNode))
 		{
 			theErr = kUnknownNodeKind_Err;
 			break;
 		}
 
-		/* get the key subpart size (it's a null terminated string) */
-		theKeySubpartSize = strlen(theDatabaseBuffer);
+		/* get the key subpart (it's a null terminated string) */
+		theEnd = memchr(theDatabaseBuffer, '\0', theBytesLeft);
+		if (theEnd == NULL)
+		{
+			theErr = kEOFWhileLoadingDB_Err;
+			break;
+		}
+		theKeySubpart = theDatabaseBuffer;
+		theKeySubpartSize = theEnd - theDatabaseBuffer;
 		if (theKeySubpartSize > NAME_MAX)
 		{
 			theErr = kNameTooLong_Err;
 			break;
 		}
-		if (theKeySubpartSize > (unsigned int) theBytesLeft)
+		theBytesLeft -= theKeySubpartSize + 1;
+		theDatabaseBuffer += theKeySubpartSize + 1;
+
+		theEntry.fKey = InternString(&ioTree->fKeys, theKeySubpart, theKeySubpartSize);
+
+		/* entries are saved in order, but check it anyway since lookups rely
+			on it */
+		theDirectory = ioTree->fDirectories[inDirectory];
+		theIndex = theDirectory->fCount;
+		if (theIndex > 0)
 		{
-			/* it's not very good to have overrun the buffer. OTOH, we're just reading ... */
-			theErr = kEOFWhileLoadingDB_Err;
-			break;
+			unsigned int theLastKeyLength;
+			const char* theLastKey = StringAt(
+					&ioTree->fKeys,
+					theDirectory->fEntries[theIndex - 1].fKey & kKeyMask,
+					&theLastKeyLength);
+			if (CompareKey(theLastKey, theLastKeyLength, theKeySubpart, theKeySubpartSize) >= 0)
+			{
+				SDirectoryView theView;
+				SEntry theDirectoryEntry;
+
+				/* keep the first of duplicate entries, like lookups did */
+				theDirectoryEntry.fKey = kDirectoryFlag;
+				theDirectoryEntry.fRef = inDirectory;
+				GetDirectory(ioTree, theDirectoryEntry, &theView);
+				isDuplicate = FindEntry(
+						ioTree, &theView,
+						theKeySubpart, theKeySubpartSize, &theIndex);
+			}
 		}
-		theBytesLeft -= theKeySubpartSize;
 
 		if (theKind == kLeaf)
 		{
-			SLeaf* theLeaf;
 			unsigned int theValueSize;
 
-			/* create the leaf */
-			theLeaf = (SLeaf*) ckalloc(sizeof(SLeaf));
-			
-			theLeaf->fHeader.fNodeType = kLeaf;
-			
-			/* copy the key */
-			(void) memcpy(
-					theLeaf->fHeader.fKeySubpart,
-					theDatabaseBuffer,
-					theKeySubpartSize + 1);
-			theDatabaseBuffer += theKeySubpartSize + 1;
-			
-			/* get the value size */
-			theValueSize = strlen(theDatabaseBuffer);
-			if (theValueSize > NAME_MAX)
+			/* get the value */
+			theEnd = memchr(theDatabaseBuffer, '\0', theBytesLeft);
+			if (theEnd == NULL)
 			{
-				theErr = kNameTooLong_Err;
+				theErr = kEOFWhileLoadingDB_Err;
 				break;
 			}
-			if (theValueSize > (unsigned int) theBytesLeft)
+			theValueSize = theEnd - theDatabaseBuffer;
+			if (theValueSize > NAME_MAX)
 			{
-				theErr = kEOFWhileLoadingDB_Err;
+				theErr = kNameTooLong_Err;
 				break;
 			}
-			theBytesLeft -= theValueSize;
-			
-			/* copy the value */
-			(void) memcpy(
-					theLeaf->fValue,
-					(const char*) theDatabaseBuffer,
-					theValueSize + 1);
+
+			theEntry.fRef = InternString(&ioTree->fValues, theDatabaseBuffer, theValueSize);
+			theBytesLeft -= theValueSize + 1;
 			theDatabaseBuffer += theValueSize + 1;
-			
-			*outNode = (SHeader*) theLeaf;
+
+			if (!isDuplicate)
+			{
+				InsertEntry(ioTree, inDirectory, theIndex, theEntry);
+			}
 		} else {
 			/* it's a node */
-			char* theKeysubpartPointer = theDatabaseBuffer;
-			
 			unsigned int subnodesCount;
-			SNode* theNode;
-			SHeader** theNodeCursor;
 			unsigned int indexSubnodes;
 
-			/* skip to the number of nodes */
-			theDatabaseBuffer += theKeySubpartSize + 1;
-			
 			/* get the number of nodes, it's a 4 bytes integer */
 			if (theBytesLeft < 4)
 			{
@@ -422,64 +1352,161 @@ LoadNode(
 				|	(((unsigned char) theDatabaseBuffer[1]) << 16)
 				|	(((unsigned char) theDatabaseBuffer[2]) << 8)
 				|	(((unsigned char) theDatabaseBuffer[3]));
-		
+
 			theDatabaseBuffer += 4;
 			theBytesLeft -= 4;
-			
-			/* create the node */
-			theNode = (SNode*) ckalloc(
-				sizeof(SNode) + (subnodesCount - 1) * sizeof(SHeader*));
-			
-			theNode->fHeader.fNodeType = kNode;
 
-			/* copy the key */
-			(void) memcpy(
-					theNode->fHeader.fKeySubpart,
-					theKeysubpartPointer,
-					theKeySubpartSize + 1);
-			
-			/* process the subnodes */
-			theNode->fSubnodesCount = subnodesCount;
-			theNodeCursor = theNode->fSubnodes;
+			/* create the directory */
+			theEntry.fKey |= kDirectoryFlag;
+			theEntry.fRef = NewDirectory(ioTree, 1);
 
 			/* call us recursively. */
 			for (indexSubnodes = 0; indexSubnodes < subnodesCount; indexSubnodes++)
 			{
-				theErr = LoadNode(&theDatabaseBuffer, theNodeCursor, &theBytesLeft);
+				theErr = LoadNode(ioTree, theEntry.fRef, &theDatabaseBuffer, &theBytesLeft);
 				if (theErr != 0)
 				{
 					break;
 				}
-				theNodeCursor++;
 			}
 
-			*outNode = (SHeader*) theNode;
-		}
-	} while (0);
-	
-	*ioDatabaseBuffer = theDatabaseBuffer;
-	*ioBytesLeft = theBytesLeft;
-	
-	return theErr;
+			if (isDuplicate)
+			{
+				FreeDirectory(ioTree, theEntry.fRef);
+			} else {
+				InsertEntry(ioTree, inDirectory, theIndex, theEntry);
+			}
+		}
+	} while (0);
+
+	*ioDatabaseBuffer = theDatabaseBuffer;
+	*ioBytesLeft = theBytesLeft;
+
+	return theErr;
+}
+
+/**
+ * Append bytes to a buffer.
+ *
+ * @param ioBuffer		the buffer.
+ * @param inBytes		bytes to append, NULL to append zeros.
+ * @param inSize		number of bytes.
+ * @return the offset of the bytes in the buffer.
+ */
+static size_t
+AppendBytes(SBuffer* ioBuffer, const void* inBytes, size_t inSize)
+{
+	size_t theOffset = ioBuffer->fSize;
+
+	if (ioBuffer->fSize + inSize > ioBuffer->fCapacity)
+	{
+		size_t theCapacity = ioBuffer->fCapacity ? ioBuffer->fCapacity : 65536;
+		while (theCapacity < ioBuffer->fSize + inSize)
+		{
+			theCapacity *= 2;
+		}
+		ioBuffer->fBytes = ckrealloc(ioBuffer->fBytes, theCapacity);
+		ioBuffer->fCapacity = theCapacity;
+	}
+
+	if (inBytes)
+	{
+		(void) memcpy(ioBuffer->fBytes + theOffset, inBytes, inSize);
+	} else {
+		(void) memset(ioBuffer->fBytes + theOffset, 0, inSize);
+	}
+	ioBuffer->fSize += inSize;
+
+	return theOffset;
+}
+
+/**
+ * Append a string table to a buffer.
+ *
+ * @param ioBuffer		the buffer.
+ * @param inTable		the table.
+ * @param outCount		on output, number of strings.
+ * @param outOffsets	on output, offset of the offsets of the strings.
+ * @param outData		on output, offset of the data.
+ * @param outDataSize	on output, size of the data.
+ */
+static void
+AppendStrings(
+		SBuffer* ioBuffer, const SStringTable* inTable,
+		uint32_t* outCount, uint32_t* outOffsets,
+		uint32_t* outData, uint32_t* outDataSize)
+{
+	uint32_t indexStrings;
+
+	/* the strings of the mapped file keep their offsets, the others follow */
+	*outData = AppendBytes(ioBuffer, inTable->fMappedData, inTable->fMappedDataSize);
+	(void) AppendBytes(ioBuffer, inTable->fData, inTable->fDataSize);
+	*outDataSize = inTable->fMappedDataSize + inTable->fDataSize;
+	(void) AppendBytes(ioBuffer, NULL, (4 - ioBuffer->fSize % 4) % 4);
+
+	*outCount = inTable->fMappedCount + inTable->fCount;
+	*outOffsets = AppendBytes(
+			ioBuffer, inTable->fMappedOffsets,
+			inTable->fMappedCount * sizeof(uint32_t));
+	for (indexStrings = 0; indexStrings < inTable->fCount; indexStrings++)
+	{
+		uint32_t theOffset = inTable->fMappedDataSize + inTable->fOffsets[indexStrings];
+		(void) AppendBytes(ioBuffer, &theOffset, sizeof(theOffset));
+	}
 }
 
 /**
  * Save the database to the file.
- * This function saves the header and then calls SaveNode.
+ * This function builds the new file in memory, with the header, the string
+ * tables and then, with SaveNode, the tree, and then writes it.
  *
- * @param inDatabasePath	file descriptor of the open file (the cursor is reset)
+ * @param inDatabasePath	path to the database file.
  * @param inTree			tree of the database.
  */
 int
 Save(
 		const char* inDatabasePath,
-		SNode* inTree)
+		STree* inTree)
 {
 	int theErr = 0;
 	int theFD = -1;
 	char theTempFilePath[PATH_MAX];
-	
+	SBuffer theBuffer = { NULL, 0, 0 };
+
 	do {
+		SFileHeader theHeader;
+
+		(void) memset(&theHeader, 0, sizeof(theHeader));
+		(void) memcpy(theHeader.fSignature, kFilemapSignature, sizeof(kFilemapSignature));
+		(void) memcpy(theHeader.fVersion, kFilemapVersion, sizeof(kFilemapVersion));
+		theHeader.fByteOrder = kByteOrderMark;
+		(void) AppendBytes(&theBuffer, NULL, sizeof(theHeader));
+
+		AppendStrings(
+				&theBuffer, &inTree->fKeys,
+				&theHeader.fKeysCount, &theHeader.fKeysOffsets,
+				&theHeader.fKeysData, &theHeader.fKeysDataSize);
+		AppendStrings(
+				&theBuffer, &inTree->fValues,
+				&theHeader.fValuesCount, &theHeader.fValuesOffsets,
+				&theHeader.fValuesData, &theHeader.fValuesDataSize);
+
+		/* then, recursively, the tree */
+		theHeader.fRoot = theBuffer.fSize;
+		theErr = SaveNode(&theBuffer, inTree, inTree->fRoot);
+		if (theErr != 0)
+		{
+			break;
+		}
+
+		if (theBuffer.fSize > UINT32_MAX)
+		{
+			theErr = EFBIG;
+			break;
+		}
+		theHeader.fSize = theBuffer.fSize;
+		(void) memcpy(theBuffer.fBytes, &theHeader, sizeof(theHeader));
+
 		/* Create the temporary file */
 		theTempFilePath[sizeof(theTempFilePath) - 1] = 0;
 		(void) snprintf(
@@ -495,34 +1522,18 @@ Save(
 			theErr = errno;
 			break;
 		}
-		
-		/* Write the signature */
-		if (write(theFD, kFilemapSignature, sizeof(kFilemapSignature))
-				!= sizeof(kFilemapSignature))
-		{
-			theErr = errno;
-			break;
-		}
-		
-		/* Write the version */
-		if (write(theFD, kFilemapVersion, sizeof(kFilemapVersion))
-				!= sizeof(kFilemapVersion))
+
+		/* Write it */
+		if (write(theFD, theBuffer.fBytes, theBuffer.fSize) != (ssize_t) theBuffer.fSize)
 		{
 			theErr = errno;
 			break;
 		}
-		
-		/* then, write, recursively, the tree */
-		theErr = SaveNode(theFD, (SHeader*) inTree);
-		if (theErr != 0)
-		{
-			break;
-		}
-		
+
 		/* Close the file */
 		(void) close(theFD);
 		theFD = -1;
-		
+
 		/* Atomically swap the temporary file with the new copy */
 		if (rename(theTempFilePath, inDatabasePath) < 0)
 		{
@@ -530,588 +1541,462 @@ Save(
 			break;
 		}
 	} while (0);
-	
+
 	/* close the copy if required */
 	if (theFD >= 0)
 	{
 		(void) close(theFD);
 	}
+	if (theBuffer.fBytes)
+	{
+		ckfree(theBuffer.fBytes);
+	}
 
 	return theErr;
 }
 
 /**
- * Recursive function to save the database to a file.
+ * Recursive function to save a directory and its subdirectories to a
+ * buffer.
+ * Directories that are still in the mapped file are copied as they are.
  *
- * @param inDatabaseFd	file descriptor of the open file.
- * @param inNode		node to save.
+ * @param ioBuffer		the buffer.
+ * @param inTree		the tree.
+ * @param inDirectory	entry referring to the directory to save.
  */
 int
 SaveNode(
-		int inDatabaseFd,
-		SHeader* inNode)
+		SBuffer* ioBuffer,
+		STree* inTree,
+		SEntry inDirectory)
 {
 	int theErr = 0;
-	
-	do {
-		char theKind = inNode->fNodeType;
-		int theKeySize = strlen(inNode->fKeySubpart) + 1;
+	SDirectoryView theView;
+	size_t theOffset;
+	uint32_t indexEntries;
 
-		/* write the kind */
-		if (write(inDatabaseFd, &theKind, sizeof(theKind)) != sizeof(theKind))
-		{
-			theErr = errno;
-			break;
-		}
-		
-		/* write the key */
-		if (write(inDatabaseFd, inNode->fKeySubpart, theKeySize) != theKeySize)
+	if (inDirectory.fKey & kMappedFlag)
+	{
+		GetDirectory(inTree, inDirectory, &theView);
+		if (theView.fOffset == 0)
 		{
-			theErr = errno;
-			break;
+			return kCorruptedDB_Err;
 		}
-		
-		if (theKind == kLeaf)
+		(void) AppendBytes(ioBuffer, inTree->fMap + theView.fOffset, theView.fSize);
+		return 0;
+	}
+
+	/* the directory, with its size and the offsets of its subdirectories
+		filled in once they're saved */
+	GetDirectory(inTree, inDirectory, &theView);
+	theOffset = AppendBytes(ioBuffer, NULL, offsetof(SDirectory, fEntries));
+	(void) memcpy(ioBuffer->fBytes + theOffset, &theView.fCount, sizeof(uint32_t));
+	for (indexEntries = 0; indexEntries < theView.fCount; indexEntries++)
+	{
+		SEntry theEntry = theView.fEntries[indexEntries];
+		theEntry.fKey &= ~kMappedFlag;
+		(void) AppendBytes(ioBuffer, &theEntry, sizeof(theEntry));
+	}
+
+	for (indexEntries = 0; (theErr == 0) && (indexEntries < theView.fCount); indexEntries++)
+	{
+		/* the directory may have moved */
+		SEntry theEntry = inTree->fDirectories[inDirectory.fRef]->fEntries[indexEntries];
+
+		if (theEntry.fKey & kDirectoryFlag)
 		{
-			/* it's a leaf */
-			SLeaf* theLeaf = (SLeaf*) inNode;
-			int theValueSize = strlen(theLeaf->fValue) + 1;
+			uint32_t theRelativeOffset = ioBuffer->fSize - theOffset;
 
-			if (write(inDatabaseFd, theLeaf->fValue, theValueSize) != theValueSize)
-			{
-				theErr = errno;
-				break;
-			}
-		} else {
-			/* it's a node */
-			SNode* theNode = (SNode*) inNode;
-			unsigned int theSubnodesCount = theNode->fSubnodesCount;
-			SHeader** theSubnodeCursor = theNode->fSubnodes;
-			unsigned char theSubnodesCountAsBytes[4];
-			unsigned int indexSubnodes;
-			
-			theSubnodesCountAsBytes[0] = (theSubnodesCount >> 24) & 0xFF;
-			theSubnodesCountAsBytes[1] = (theSubnodesCount >> 16) & 0xFF;
-			theSubnodesCountAsBytes[2] = (theSubnodesCount >> 8) & 0xFF;
-			theSubnodesCountAsBytes[3] = theSubnodesCount & 0xFF;
-			
-			if (write(inDatabaseFd, theSubnodesCountAsBytes, sizeof(theSubnodesCountAsBytes))
-				!= sizeof(theSubnodesCountAsBytes))
-			{
-				theErr = errno;
-				break;
-			}
-			
-			/* iterate on the subnodes */
-			for (indexSubnodes = 0; indexSubnodes < theSubnodesCount; indexSubnodes++)
-			{
-				theErr = SaveNode(inDatabaseFd, *theSubnodeCursor);
-				if (theErr != 0)
-				{
-					break;
-				}
-				
-				theSubnodeCursor++;
-			}
+			(void) memcpy(
+					ioBuffer->fBytes + theOffset + offsetof(SDirectory, fEntries)
+						+ indexEntries * sizeof(SEntry) + offsetof(SEntry, fRef),
+					&theRelativeOffset,
+					sizeof(theRelativeOffset));
+			theErr = SaveNode(ioBuffer, inTree, theEntry);
 		}
-	} while (0);
-	
+	}
+
+	if (theErr == 0)
+	{
+		uint32_t theSize = ioBuffer->fSize - theOffset;
+		(void) memcpy(
+				ioBuffer->fBytes + theOffset + offsetof(SDirectory, fCapacity),
+				&theSize,
+				sizeof(theSize));
+	}
+
 	return theErr;
 }
 
 /**
- * Recursive function to dispose the tree.
+ * Dispose the tree.
  *
- * @param ioRoot		on input, the tree to free, on output, 0L
+ * @param ioTree		the tree to free.
  */
 void
-Free(SNode** ioRoot)
+Free(STree* ioTree)
 {
-	SNode* theRoot = *ioRoot;
-	if (theRoot != 0)
+	if (ioTree->fDirectories != NULL)
 	{
-		SHeader** theSubnodeCursor = theRoot->fSubnodes;
-		unsigned int nbSubnodes = theRoot->fSubnodesCount;
-		SHeader* theSubnode = NULL;
-		unsigned int indexSubnodes;
-	
-		for (indexSubnodes = 0; indexSubnodes < nbSubnodes; indexSubnodes++)
+		uint32_t indexDirectories;
+
+		for (indexDirectories = 0;
+			indexDirectories < ioTree->fDirectoriesCount;
+			indexDirectories++)
 		{
-			theSubnode = *theSubnodeCursor;
-			if (theSubnode)
+			if (ioTree->fDirectories[indexDirectories] != NULL)
 			{
-				if (theSubnode->fNodeType == kNode)
-				{	
-					Free((SNode**) theSubnodeCursor);
-				} else {
-					ckfree((char*) theSubnode);
-					*theSubnodeCursor = 0;
-				}
-				
-				theSubnodeCursor++;
+				ckfree((char*) ioTree->fDirectories[indexDirectories]);
 			}
 		}
-		
-		ckfree((char*) theRoot);
+		ckfree((char*) ioTree->fDirectories);
+	}
+	if (ioTree->fFreeDirectories != NULL)
+	{
+		ckfree((char*) ioTree->fFreeDirectories);
 	}
-	*ioRoot = 0;
+	if (ioTree->fMap != NULL)
+	{
+		(void) munmap(ioTree->fMap, ioTree->fMapSize);
+	}
+	FreeStrings(&ioTree->fKeys);
+	FreeStrings(&ioTree->fValues);
+	(void) memset(ioTree, 0, sizeof(*ioTree));
 }
 
 /**
- * Recursive function to set a value.
+ * Set a value.
+ * The directories on the path are copied to memory if they're still in the
+ * mapped file.
  *
- * @param ioRoot		pointer to the current root of the subtree.
- *						Can be modified.
+ * @param ioTree		the tree.
  * @param inPath		path to the value to set.
  * @param inValue		value to set in the map.
  * @return 0 if everything is fine, an error code otherwise.
  */
 int
-Set(SNode** ioRoot, const char* inPath, const char* inValue)
+Set(STree* ioTree, const char* inPath, const char* inValue)
 {
 	int theResult = 0;
-	SNode* theRoot = *ioRoot;
-
-	do {
-		const char* beginCursor = inPath;
-		SHeader* theSubnode = NULL;
-		SHeader** theSubnodeCursor = theRoot->fSubnodes;
-		unsigned int nbSubnodes = theRoot->fSubnodesCount;
-		unsigned int indexSubnodes;
-		const char* endCursor;
-		char theCurrentChar;
-		int partLength;
-		
-		/* jump to first non / character in the path */
-		do {
-			theCurrentChar = *beginCursor++;
-		} while (theCurrentChar == '/');
+	uint32_t theDirectory = CopyDirectory(ioTree, &ioTree->fRoot);
+	const char* thePath = inPath;
 
-		/* one char too far */
-		beginCursor--;
-		
-		if (theCurrentChar == '\0')
+	while (1)
+	{
+		const char* thePart;
+		unsigned int thePartLength;
+		int theKind = NextComponent(&thePath, &thePart, &thePartLength);
+		SDirectoryView theView;
+		SEntry theDirectoryEntry;
+		uint32_t theIndex;
+		SEntry* theEntry;
+
+		if (theKind < 0)
 		{
 			/* eek. we've been provided an empty path. return an error */
 			theResult = EISDIR;
 			break;
 		}
-		
-		/* find end of path element and determine if we have a file name or a
-			directory name (i.e. if there is a leading / or not) */
-		endCursor = beginCursor;
-
-		do {
-			theCurrentChar = *endCursor++;
-		} while ((theCurrentChar != '/') && (theCurrentChar != '\0'));
-
-		/* one char too far */
-		endCursor--;
-		partLength = endCursor - beginCursor;
-
-		/* do we have a node for this entry? */
-		for (indexSubnodes = 0; indexSubnodes < nbSubnodes; indexSubnodes++)
+		if (thePartLength > NAME_MAX)
 		{
-			int theCompResult;
-			theSubnode = *theSubnodeCursor++;
-			theCompResult = strncasecmp(theSubnode->fKeySubpart, beginCursor, partLength);
-			if (theCompResult == 0)
-			{
-				/* first partLength bytes are equal, we need to check that fKeySubpart
-					is not longer */
-				theCompResult = theSubnode->fKeySubpart[partLength];
-			}
-			if (theCompResult == 0)
-			{
-				/* found it. */
-				--theSubnodeCursor;
-				break;
-			} else if (theCompResult > 0) {
-				theSubnode = NULL;
-				break;
-			}
-			
-			theSubnode = NULL;
+			theResult = kNameTooLong_Err;
+			break;
 		}
-		
-		if (theSubnode == NULL)
-		{
-			/* not found. We need to create a node for this entry */
-			theRoot =
-				(SNode*) ckrealloc(
-							(char*) theRoot,
-							sizeof(SNode) + (sizeof(SHeader*) * nbSubnodes));
-			*ioRoot = theRoot;
-			/* Push the pointers after the current node lower. */
-			(void) memmove(
-						&theRoot->fSubnodes[indexSubnodes + 1],
-						(const void*) &theRoot->fSubnodes[indexSubnodes],
-						(nbSubnodes - indexSubnodes) * sizeof(SHeader*));
-			nbSubnodes++;
-			theRoot->fSubnodesCount = nbSubnodes;
-
-			if (theCurrentChar == '/')
+
+		/* do we have an entry for this component? */
+		theDirectoryEntry.fKey = kDirectoryFlag;
+		theDirectoryEntry.fRef = theDirectory;
+		GetDirectory(ioTree, theDirectoryEntry, &theView);
+		if (!FindEntry(ioTree, &theView, thePart, thePartLength, &theIndex))
+		{
+			/* not found. We need to create one */
+			SEntry theNewEntry;
+
+			theNewEntry.fKey = InternString(&ioTree->fKeys, thePart, thePartLength);
+			if (theKind == '/')
 			{
-				/* It's a directory node that we need. */
-				theSubnode = (SHeader*) ckalloc(sizeof(SNode) - sizeof(SHeader*));
-				theSubnode->fNodeType = kNode;
-				((SNode*) theSubnode)->fSubnodesCount = 0;
+				/* It's a directory that we need. */
+				theNewEntry.fKey |= kDirectoryFlag;
+				theNewEntry.fRef = NewDirectory(ioTree, 1);
 			} else {
-				theSubnode = (SHeader*) ckalloc(sizeof(SLeaf));
-				theSubnode->fNodeType = kLeaf;
-				((SLeaf*) theSubnode)->fValue[NAME_MAX] = 0;
+				theNewEntry.fRef = 0;
 			}
-			
-			(void) memcpy(
-					theSubnode->fKeySubpart,
-					beginCursor,
-					partLength);
-			/* add the null terminator */
-			theSubnode->fKeySubpart[partLength] = 0;
-			
-			/* put the node in the parent node */
-			theRoot->fSubnodes[indexSubnodes] = theSubnode;
-			theSubnodeCursor = &theRoot->fSubnodes[indexSubnodes];
+			InsertEntry(ioTree, theDirectory, theIndex, theNewEntry);
 		}
-		
-		if (theCurrentChar == '/')
+		theEntry = &ioTree->fDirectories[theDirectory]->fEntries[theIndex];
+
+		if (theKind == '/')
 		{
-			if (theSubnode->fNodeType != kNode)
+			if (!(theEntry->fKey & kDirectoryFlag))
 			{
 				theResult = ENOTDIR;
 				break;
 			}
-			
-			/* if it's a directory, call us recursively */
-			theResult = Set((SNode**) theSubnodeCursor, (endCursor + 1), inValue);
+
+			/* if it's a directory, continue with the rest of the path */
+			theDirectory = CopyDirectory(ioTree, theEntry);
 		} else {
-			if (theSubnode->fNodeType != kLeaf)
+			size_t theValueLength = strlen(inValue);
+
+			if (theEntry->fKey & kDirectoryFlag)
 			{
 				theResult = EISDIR;
 				break;
 			}
 
-			/* if it's a file, set the value */
-			strncpy(((SLeaf*) theSubnode)->fValue, inValue, NAME_MAX);
+			/* if it's a file, set the value (truncated like it always was) */
+			if (theValueLength > NAME_MAX)
+			{
+				theValueLength = NAME_MAX;
+			}
+			theEntry->fRef = InternString(&ioTree->fValues, inValue, theValueLength);
+			break;
 		}
-	} while (0);
-	
+	}
+
 	return theResult;
 }
 
 /**
- * Recursive function to retrieve a value.
+ * Retrieve a value.
  * This function will return NULL if the value is not in the map.
  * The pointer to the value is valid until the tree is changed.
  *
- * @param inRoot		the current root of the subtree.
+ * @param inTree		the tree.
  * @param inPath		path to the value to retrieve.
  * @return the value or NULL if it's not in the map.
  */
 const char*
-Get(SNode* inRoot, const char* inPath)
+Get(STree* inTree, const char* inPath)
 {
-	const char* theResult = NULL;
-	
-	do {
-		const char* beginCursor = inPath;
-		SHeader* theSubnode = NULL;
-		SHeader** theSubnodeCursor = inRoot->fSubnodes;
-		unsigned int nbSubnodes = inRoot->fSubnodesCount;
-		unsigned int indexSubnodes;
-		const char* endCursor;
-		char theCurrentChar;
-		int partLength;
-		
-		/* jump to first non / character in the path */
-		do {
-			theCurrentChar = *beginCursor++;
-		} while (theCurrentChar == '/');
+	SEntry theDirectory = inTree->fRoot;
+	const char* thePath = inPath;
 
-		/* one char too far */
-		beginCursor--;
-		
-		if (theCurrentChar == '\0')
+	while (1)
+	{
+		const char* thePart;
+		unsigned int thePartLength;
+		int theKind = NextComponent(&thePath, &thePart, &thePartLength);
+		SDirectoryView theView;
+		uint32_t theIndex;
+		SEntry theEntry;
+
+		if (theKind < 0)
 		{
 			/* eek. we've been provided an empty path. we return NULL then. */
-			break;
+			return NULL;
 		}
-		
-		/* find end of path element and determine if we have a file name or a
-			directory name (i.e. if there is a leading / or not) */
-		endCursor = beginCursor;
 
-		do {
-			theCurrentChar = *endCursor++;
-		} while ((theCurrentChar != '/') && (theCurrentChar != '\0'));
-
-		/* one char too far */
-		endCursor--;
-		partLength = endCursor - beginCursor;
-
-		/* do we have a node for this entry? */
-		for (indexSubnodes = 0; indexSubnodes < nbSubnodes; indexSubnodes++)
+		GetDirectory(inTree, theDirectory, &theView);
+		if (!FindEntry(inTree, &theView, thePart, thePartLength, &theIndex))
 		{
-			int theCompResult;
-			theSubnode = *theSubnodeCursor++;
-			theCompResult = strncasecmp(theSubnode->fKeySubpart, beginCursor, partLength);
-			if (theCompResult == 0)
-			{
-				/* first partLength bytes are equal, we need to check that fKeySubpart
-					is not longer */
-				theCompResult = theSubnode->fKeySubpart[partLength];
-			}
-			if (theCompResult == 0)
-			{
-				/* found it. */
-				--theSubnodeCursor;
-				break;
-			} else if (theCompResult > 0) {
-				theSubnode = NULL;
-				break;
-			}
-			
-			theSubnode = NULL;
+			/* not found. */
+			return NULL;
 		}
-		
-		if (theSubnode == NULL)
+		theEntry = EntryAt(&theView, theIndex);
+
+		if ((theKind == '/') != ((theEntry.fKey & kDirectoryFlag) != 0))
 		{
-			/* not found. */
-			break;
+			return NULL;
 		}
-		
-		if (theCurrentChar == '/')
+		if (theKind != '/')
 		{
-			if (theSubnode->fNodeType != kNode)
-			{
-				break;
-			}
-			
-			/* if it's a directory, call us recursively */
-			theResult = Get((SNode*) theSubnode, (endCursor + 1));
-		} else {
-			if (theSubnode->fNodeType != kLeaf)
-			{
-				break;
-			}
-
 			/* if it's a file, return the value */
-			theResult = ((SLeaf*) theSubnode)->fValue;
+			return StringAt(&inTree->fValues, theEntry.fRef, NULL);
 		}
-	} while (0);
-	
-	return theResult;
+
+		/* if it's a directory, continue with the rest of the path */
+		theDirectory = theEntry;
+	}
 }
 
 /**
  * Return the list of paths for a given value.
  *
- * @param inRoot		the root of the tree.
+ * @param inTree		the tree.
  * @param inValue		value of the keys to find.
  * @return the list of paths which has value for their value.
  */
 Tcl_Obj*
-List(SNode* inRoot, const char* inValue)
+List(STree* inTree, const char* inValue)
 {
 	/* Create the result (a list) */
 	Tcl_Obj* theResult = Tcl_NewListObj(0, NULL);
-	
-	/* Call the recursive function */
-	ListSubtree((SHeader*) inRoot, inValue, theResult, "", 0);
-	
+	uint32_t theValuesCount = inTree->fValues.fMappedCount + inTree->fValues.fCount;
+	char* theMatches;
+	int hasMatches = 0;
+	uint32_t indexValues;
+
+	if (theValuesCount == 0)
+	{
+		return theResult;
+	}
+
+	/* Find the interned values that match, so that the tree only needs to be
+		searched if there are any and by comparing indices */
+	theMatches = ckalloc(theValuesCount);
+	for (indexValues = 0; indexValues < theValuesCount; indexValues++)
+	{
+		theMatches[indexValues] =
+			(strcasecmp(StringAt(&inTree->fValues, indexValues, NULL), inValue) == 0);
+		hasMatches |= theMatches[indexValues];
+	}
+
+	if (hasMatches)
+	{
+		Tcl_DString theSubpath;
+
+		Tcl_DStringInit(&theSubpath);
+		Tcl_DStringAppend(&theSubpath, "/", 1);
+
+		/* Call the recursive function */
+		ListSubtree(inTree, inTree->fRoot, theMatches, theResult, &theSubpath);
+
+		Tcl_DStringFree(&theSubpath);
+	}
+	ckfree(theMatches);
+
 	return theResult;
 }
 
 /**
  * Recursive function to return the list of paths for a given value.
  *
- * @param inRoot		the current root of the tree.
- * @param inValue		value of the keys to find.
+ * @param inTree		the tree.
+ * @param inDirectory	entry referring to the current directory.
+ * @param inMatches		whether each value matches.
  * @param outList		the list to populate with paths.
- * @param inSubpath		the path of the current root.
- * @param inSubpathLen	the length, without the terminator, of the path.
+ * @param ioSubpath		the path of the current directory, with a trailing
+ *						slash (it's restored when this function returns).
  */
 void
 ListSubtree(
-	SHeader* inRoot,
-	const char* inValue,
+	STree* inTree,
+	SEntry inDirectory,
+	const char* inMatches,
 	Tcl_Obj* outList,
-	const char* inSubpath,
-	unsigned int inSubpathLen)
+	Tcl_DString* ioSubpath)
 {
-	if (inRoot->fNodeType == kLeaf)
-	{
-		/* it's a leaf. Does the value match? */
-		if (strcasecmp(((SLeaf*) inRoot)->fValue, inValue) == 0)
-		{
-			/* It matches. */
-			char* thePath = ckalloc(inSubpathLen + NAME_MAX + 1);
-			(void) memcpy(thePath, inSubpath, inSubpathLen);
-			(void) strcpy(
-						&thePath[inSubpathLen],
-						(const char*) inRoot->fKeySubpart);
-			
-			Tcl_ListObjAppendElement(
-					NULL,
-					outList,
-					Tcl_NewStringObj(thePath, -1) );
-
-			ckfree(thePath);
-		}
-	} else {
-		/* it's a node. */
-		SNode* theNode = (SNode*) inRoot;
+	SDirectoryView theView;
+	int theSubpathLength = Tcl_DStringLength(ioSubpath);
+	uint32_t theValuesCount = inTree->fValues.fMappedCount + inTree->fValues.fCount;
+	uint32_t indexEntries;
 
-		unsigned int theKeySubpartLen = strlen(inRoot->fKeySubpart);
-		unsigned int thePathLen = inSubpathLen + theKeySubpartLen + 1;
-		char* thePath = ckalloc(thePathLen + 1);
-
-		SHeader** theSubnodeCursor = theNode->fSubnodes;
-		unsigned int nbSubnodes = theNode->fSubnodesCount;
-		unsigned int indexSubnodes;
+	GetDirectory(inTree, inDirectory, &theView);
 
-		/* Let's build the path */
-		(void) memcpy(thePath, inSubpath, inSubpathLen);
-		(void) memcpy(
-					&thePath[inSubpathLen],
-					inRoot->fKeySubpart,
-					theKeySubpartLen);
-		inSubpathLen += theKeySubpartLen;
-		thePath[thePathLen - 1] = '/';
-		thePath[thePathLen] = '\0';
+	/* Iteration on the entries */
+	for (indexEntries = 0; indexEntries < theView.fCount; indexEntries++)
+	{
+		SEntry theEntry = EntryAt(&theView, indexEntries);
+		unsigned int theKeyLength;
+		const char* theKey;
 
-		/* Iteration on the nodes */
-		for (indexSubnodes = 0; indexSubnodes < nbSubnodes; indexSubnodes++)
+		if (!(theEntry.fKey & kDirectoryFlag)
+			&& ((theEntry.fRef >= theValuesCount) || !inMatches[theEntry.fRef]))
 		{
-			ListSubtree(*theSubnodeCursor, inValue, outList, thePath, thePathLen);
+			continue;
+		}
 
-			theSubnodeCursor++;
+		theKey = StringAt(&inTree->fKeys, theEntry.fKey & kKeyMask, &theKeyLength);
+		Tcl_DStringAppend(ioSubpath, theKey, theKeyLength);
+		if (theEntry.fKey & kDirectoryFlag)
+		{
+			/* it's a directory. */
+			Tcl_DStringAppend(ioSubpath, "/", 1);
+			ListSubtree(inTree, theEntry, inMatches, outList, ioSubpath);
+		} else {
+			/* it's a file, and it matches. */
+			Tcl_ListObjAppendElement(
+					NULL,
+					outList,
+					Tcl_NewStringObj(
+						Tcl_DStringValue(ioSubpath),
+						Tcl_DStringLength(ioSubpath)));
 		}
-		
-		/* clean up */
-		ckfree(thePath);
+		Tcl_DStringSetLength(ioSubpath, theSubpathLength);
 	}
 }
 
 /**
  * Recursive function to delete a value.
  * This function will return an error if the value is not in the map.
- * This function also prunes the tree (i.e. will delete any node with no subnode).
+ * This function also prunes the tree (i.e. will delete any directory without
+ * entries).
  *
- * @param ioRoot		pointer to the current root of the subtree.
- *						Can be modified.
+ * @param ioTree		the tree.
+ * @param inDirectory	index of the directory the path is relative to, which
+ *						is in memory.
  * @param inPath		path to the value to delete.
  * @return an error code if a problem occurred (like the value is not in the
  * tree), 0 otherwise.
  */
 int
-Delete(SNode** ioRoot, const char* inPath)
+Delete(STree* ioTree, uint32_t inDirectory, const char* inPath)
 {
 	int theResult = 0;
-	SNode* theRoot = *ioRoot;
+	const char* thePath = inPath;
 
 	do {
-		const char* beginCursor = inPath;
-		SHeader* theSubnode = NULL;
-		SHeader** theSubnodeCursor = theRoot->fSubnodes;
-		unsigned int nbSubnodes = theRoot->fSubnodesCount;
-		unsigned int indexSubnodes;
-		const char* endCursor;
-		char theCurrentChar;
-		int partLength;
-		
-		/* jump to first non / character in the path */
-		do {
-			theCurrentChar = *beginCursor++;
-		} while (theCurrentChar == '/');
-
-		/* one char too far */
-		beginCursor--;
-		
-		if (theCurrentChar == '\0')
+		const char* thePart;
+		unsigned int thePartLength;
+		int theKind = NextComponent(&thePath, &thePart, &thePartLength);
+		SDirectoryView theView;
+		SEntry theDirectoryEntry;
+		uint32_t theIndex;
+		SEntry theEntry;
+
+		if (theKind < 0)
 		{
 			/* eek. we've been provided an empty path. return an error */
 			theResult = EISDIR;
 			break;
 		}
-		
-		/* find end of path element and determine if we have a file name or a
-			directory name (i.e. if there is a leading / or not) */
-		endCursor = beginCursor;
-
-		do {
-			theCurrentChar = *endCursor++;
-		} while ((theCurrentChar != '/') && (theCurrentChar != '\0'));
-
-		/* one char too far */
-		endCursor--;
-		partLength = endCursor - beginCursor;
 
-		/* do we have a node for this entry? */
-		for (indexSubnodes = 0; indexSubnodes < nbSubnodes; indexSubnodes++)
-		{
-			int theCompResult;
-			theSubnode = *theSubnodeCursor++;
-			theCompResult = strncasecmp(theSubnode->fKeySubpart, beginCursor, partLength);
-			if (theCompResult == 0)
-			{
-				/* first partLength bytes are equal, we need to check that fKeySubpart
-					is not longer */
-				theCompResult = theSubnode->fKeySubpart[partLength];
-			}
-			if (theCompResult == 0)
-			{
-				/* found it. */
-				--theSubnodeCursor;
-				break;
-			} else if (theCompResult > 0) {
-				theSubnode = NULL;
-				break;
-			}
-			
-			theSubnode = NULL;
-		}
-		
-		if (theSubnode == NULL)
+		/* do we have an entry for this component? */
+		theDirectoryEntry.fKey = kDirectoryFlag;
+		theDirectoryEntry.fRef = inDirectory;
+		GetDirectory(ioTree, theDirectoryEntry, &theView);
+		if (!FindEntry(ioTree, &theView, thePart, thePartLength, &theIndex))
 		{
 			/* not found. Return an error */
 			theResult = kKeyNotFound_Err;
 			break;
 		}
+		theEntry = theView.fEntries[theIndex];
 
-		if (theCurrentChar == '/')
+		if (theKind == '/')
 		{
+			uint32_t theSubdirectory;
+
+			if (!(theEntry.fKey & kDirectoryFlag))
+			{
+				theResult = ENOTDIR;
+				break;
+			}
+
 			/* if it's a directory, call us recursively */
-			SNode* theSubnodePointer = (SNode*) theSubnode;
-			theResult = Delete(&theSubnodePointer, (endCursor + 1));
+			theSubdirectory = CopyDirectory(
+					ioTree,
+					&ioTree->fDirectories[inDirectory]->fEntries[theIndex]);
+			theResult = Delete(ioTree, theSubdirectory, thePath);
 
 			/* Then prune the entry if it's empty */
-			if (theSubnodePointer->fSubnodesCount == 0)
+			if (ioTree->fDirectories[theSubdirectory]->fCount == 0)
 			{
-				ckfree((char*) theSubnodePointer);
-				nbSubnodes--;
-				theRoot->fSubnodesCount = nbSubnodes;
-				(void) memmove(
-					&theRoot->fSubnodes[indexSubnodes],
-					&theRoot->fSubnodes[indexSubnodes+1],
-					(nbSubnodes - indexSubnodes) * sizeof(SHeader*));
-				
-				/* we don't realloc. */
-			} else {
-				*theSubnodeCursor = (SHeader*) theSubnodePointer;
+				FreeDirectory(ioTree, theSubdirectory);
+				RemoveEntry(ioTree, inDirectory, theIndex);
 			}
 		} else {
-			/* if it's a file, simply delete the entry */
-			ckfree((char*) theSubnode);
-			nbSubnodes--;
-			theRoot->fSubnodesCount = nbSubnodes;
-			(void) memmove(
-				&theRoot->fSubnodes[indexSubnodes],
-				&theRoot->fSubnodes[indexSubnodes+1],
-				(nbSubnodes - indexSubnodes) * sizeof(SHeader*));
+			/* if it's a file, simply delete the entry (or the whole
+				directory) */
+			if ((theEntry.fKey & (kDirectoryFlag | kMappedFlag)) == kDirectoryFlag)
+			{
+				FreeDirectory(ioTree, theEntry.fRef);
+			}
+			RemoveEntry(ioTree, inDirectory, theIndex);
 		}
 	} while (0);
-	
+
 	return theResult;
 }
 
@@ -1131,7 +2016,6 @@ FreeFilemapInternalRep(Tcl_Obj* inObjPtr)
 	SFilemapObject* theObject = (SFilemapObject*) inObjPtr->internalRep.otherValuePtr;
 	if ((--theObject->fRefCount) == 0)
 	{
-		SNode* theRoot = theObject->fRoot;
 		int theFD = theObject->fLockFD;
 		if (theFD >= 0)
 		{
@@ -1141,7 +2025,8 @@ FreeFilemapInternalRep(Tcl_Obj* inObjPtr)
 		}
 		
 		/* free it */
-		Free(&theRoot);
+		Free(&theObject->fTree);
+		ckfree((char*) theObject);
 	}
 	
 	inObjPtr->internalRep.otherValuePtr = NULL;
@@ -1263,6 +2148,11 @@ SetResultFromErrorCode(Tcl_Interp* interp, int inErrorCode)
 			theResult = TCL_ERROR;
 			break;
 
+		case kCorruptedDB_Err:
+			Tcl_SetResult(interp, "database is corrupted", TCL_STATIC);
+			theResult = TCL_ERROR;
+			break;
+
 		case 0:
 			Tcl_SetResult(interp, "", TCL_STATIC);
 			theResult = TCL_OK;
@@ -1347,7 +2237,7 @@ FilemapCloseCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		} else {
 			theErr = Save(
 						theFilemapObject->fFilemapPath,
-						theFilemapObject->fRoot);
+						&theFilemapObject->fTree);
 		}
 		
 		/* Return any error. */
@@ -1375,7 +2265,6 @@ FilemapCreateCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 {
 	Tcl_Obj* theObject;
 	SFilemapObject* theFilemapObject;
-	SNode* theRoot = NULL;
 
 	/*	first (second) parameter is the variable name */
 	if (objc != 3) {
@@ -1383,15 +2272,12 @@ FilemapCreateCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		return TCL_ERROR;
 	}	
 
-	/* Create an empty root */
-	Create(&theRoot);
-
-	/* Create the object */
+	/* Create the object, with an empty tree */
 	theObject = Tcl_NewObj();
 	theFilemapObject = (SFilemapObject*) ckalloc(sizeof(SFilemapObject));
 	theFilemapObject->fRefCount = 1;
 	theFilemapObject->fLockFD = -1;
-	theFilemapObject->fRoot = theRoot;
+	Create(&theFilemapObject->fTree);
 	theFilemapObject->fIsReadOnly = 0;
 	theFilemapObject->fIsRAMOnly = 1;
 	theFilemapObject->fIsDirty = 0;
@@ -1442,7 +2328,7 @@ FilemapExistsCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		}
 		
 		/* Retrieve the value */
-		theValue = Get(theFilemapObject->fRoot, Tcl_GetString(objv[3]));
+		theValue = Get(&theFilemapObject->fTree, Tcl_GetString(objv[3]));
 		
 		/* Say if we found it */
 	    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(theValue != NULL));
@@ -1484,7 +2370,7 @@ FilemapGetCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		}
 		
 		/* Retrieve the value */
-		theValue = Get(theFilemapObject->fRoot, Tcl_GetString(objv[3]));
+		theValue = Get(&theFilemapObject->fTree, Tcl_GetString(objv[3]));
 		
 		/* Return it. */
 		Tcl_SetResult(interp, (char*) theValue, TCL_VOLATILE);
@@ -1563,7 +2449,7 @@ FilemapListCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		}
 
 		/* Build the list */
-		theList = List(theFilemapObject->fRoot, Tcl_GetString(objv[3]));
+		theList = List(&theFilemapObject->fTree, Tcl_GetString(objv[3]));
 
 		/* Return the list. */
 		Tcl_SetObjResult(interp, theList);
@@ -1608,7 +2494,7 @@ FilemapOpenCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		SFilemapObject* theFilemapObject;
 		int theLockFD = -1;
 		struct flock theLock;
-		SNode* theRoot = NULL;
+		STree theTree;
 		char theLockPath[PATH_MAX];
 	
 		thePath = Tcl_GetString(objv[3]);
@@ -1669,13 +2555,10 @@ FilemapOpenCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		}
 		
 		/* load the map from the file */
-		theErr = Load(thePath, &theRoot);
+		theErr = Load(thePath, &theTree);
 		if (theErr != 0)
 		{
-			if (theRoot)
-			{
-				Free(&theRoot);
-			}
+			Free(&theTree);
 			
 			/* Close the lock */
 			(void) close(theLockFD);
@@ -1691,7 +2574,7 @@ FilemapOpenCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 			thePath,
 			sizeof(theFilemapObject->fFilemapPath));
 		theFilemapObject->fLockFD = theLockFD;
-		theFilemapObject->fRoot = theRoot;
+		theFilemapObject->fTree = theTree;
 		theFilemapObject->fIsReadOnly = isReadOnly;
 		theFilemapObject->fIsDirty = 0;
 		theFilemapObject->fIsRAMOnly = 0;
@@ -1748,10 +2631,10 @@ FilemapRevertCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		}
 		
 		/* Free the tree */
-		Free(&theFilemapObject->fRoot);
+		Free(&theFilemapObject->fTree);
 		
 		/* Reload the map from the file */
-		theErr = Load(theFilemapObject->fFilemapPath, &theFilemapObject->fRoot);
+		theErr = Load(theFilemapObject->fFilemapPath, &theFilemapObject->fTree);
 		
 		/* The file tree is not dirty */
 		theFilemapObject->fIsDirty = 0;
@@ -1806,7 +2689,16 @@ FilemapSaveCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 			/* Save the filemap to file */
 			theErr = Save(
 					theFilemapObject->fFilemapPath,
-					theFilemapObject->fRoot);
+					&theFilemapObject->fTree);
+
+			/* Map the new file instead of the old one, which was replaced */
+			if (theErr == 0)
+			{
+				Free(&theFilemapObject->fTree);
+				theErr = Load(
+						theFilemapObject->fFilemapPath,
+						&theFilemapObject->fTree);
+			}
 		
 			/* The file tree is not dirty */
 			theFilemapObject->fIsDirty = 0;
@@ -1861,7 +2753,7 @@ FilemapSetCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 		} else {
 			/* Set the value */
 			theErr = Set(
-							&theFilemapObject->fRoot,
+							&theFilemapObject->fTree,
 							Tcl_GetString(objv[3]),
 							Tcl_GetString(objv[4]));
 			
@@ -1913,7 +2805,12 @@ FilemapUnsetCmd(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 			theErr = EPERM;
 		} else {
 			/* Delete the value */
-			theErr = Delete(&theFilemapObject->fRoot, Tcl_GetString(objv[3]));
+			theErr = Delete(
+						&theFilemapObject->fTree,
+						CopyDirectory(
+							&theFilemapObject->fTree,
+							&theFilemapObject->fTree.fRoot),
+						Tcl_GetString(objv[3]));
 			
 			/* The map is now dirty */
 			theFilemapObject->fIsDirty = 1;
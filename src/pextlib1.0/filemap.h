@@ -39,9 +39,10 @@
  * filemaps are dictionaries (what Tcl calls arrays) with case unsensitive keys
  * that are file paths and values that are port names.
  * This object is not thread safe (i.e. calls are not synchronous).
- * Get/Set/Unset operations depend on the number of elements in each directory,
- * they are nevertheless very fast.
+ * Get/Set/Unset operations are a binary search in each directory of the path.
  * List is a O(n) operation (the slow operation).
+ * Database files are mapped in memory when they are opened; directories are
+ * copied to memory when they are changed.
  *
  * The syntax is:
  * filemap create filemapVarName
@@ -57,17 +57,26 @@
 #include "md_wrappers.h"
 CHECKSUMEnd(MD5, MD5_CTX, MD5_DIGEST_LENGTH)
 CHECKSUMFile(MD5, MD5_CTX)
+CHECKSUMStream(MD5, md5_stream, MD5_CTX, MD5Init, MD5Update, MD5End)
 
 #elif defined(HAVE_LIBMD) && defined(HAVE_MD5_H)
 #include <sys/types.h>
 #include <md5.h>
+
+#include "md_wrappers.h"
+CHECKSUMStream(MD5, md5_stream, MD5_CTX, MD5Init, MD5Update, MD5End)
 #elif defined(HAVE_LIBCRYPTO) && defined(HAVE_OPENSSL_MD5_H)
+#include <openssl/evp.h>
 #include <openssl/md5.h>
 
 #include "md_wrappers.h"
 CHECKSUMEnd(MD5_, MD5_CTX, MD5_DIGEST_LENGTH)
 CHECKSUMFile(MD5_, MD5_CTX)
+CHECKSUMStreamEVP(MD5, md5_stream, EVP_md5)
 #define MD5File(x,y) MD5_File(x,y)
+#define MD5Init(x) MD5_Init(x)
+#define MD5Update(x,y,z) MD5_Update(x,y,z)
+#define MD5End(x,y) MD5_End(x,y)
 #else
 #error CommonCrypto, libmd or libcrypto required
 #endif
@@ -29,4 +29,17 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stddef.h>
+
 int MD5Cmd(ClientData, Tcl_Interp *, int, Tcl_Obj *CONST objv[]);
+
+/**
+ * Incremental md5 of data given in pieces. MD5StreamNew returns NULL if it
+ * runs out of memory. MD5StreamEnd writes the hex digest to buf, which holds
+ * 33 characters, and frees the stream.
+ */
+typedef struct md5_stream md5_stream_t;
+
+md5_stream_t *MD5StreamNew(void);
+void MD5StreamUpdate(md5_stream_t *stream, const unsigned char *data, size_t len);
+void MD5StreamEnd(md5_stream_t *stream, char *buf);
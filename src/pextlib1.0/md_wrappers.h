@@ -88,5 +88,85 @@ static char *algo##Data(const u_char *str, u_int32_t len, char *buf)		\
     return algo##End(&ctx, buf);						\
 }
 
+/* incremental digests, as declared by the commands' headers:
+ * algo_stream_t* ALGOStreamNew(void)
+ * void ALGOStreamUpdate(algo_stream_t*, const unsigned char*, size_t)
+ * void ALGOStreamEnd(algo_stream_t*, char* buf)
+ */
+#define CHECKSUMStream(algo, stream, ctxtype, init, update, end)	\
+struct stream {											\
+    ctxtype ctx;										\
+};														\
+														\
+stream##_t *algo##StreamNew(void)						\
+{														\
+    stream##_t *s = malloc(sizeof(*s));					\
+														\
+    if (s != NULL)										\
+        init(&s->ctx);									\
+    return s;											\
+}														\
+														\
+void algo##StreamUpdate(stream##_t *s, const unsigned char *data, size_t len)	\
+{														\
+    update(&s->ctx, data, len);							\
+}														\
+														\
+void algo##StreamEnd(stream##_t *s, char *buf)			\
+{														\
+    end(&s->ctx, buf);									\
+    free(s);											\
+}
+
+#ifdef EVP_MAX_MD_SIZE
+/* the same through EVP, the digest functions of libcrypto are deprecated
+ * since OpenSSL 3.0 */
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define EVP_MD_CTX_new() EVP_MD_CTX_create()
+#define EVP_MD_CTX_free(c) EVP_MD_CTX_destroy(c)
+#endif
+
+#define CHECKSUMStreamEVP(algo, stream, md)				\
+struct stream {											\
+    EVP_MD_CTX *ctx;									\
+};														\
+														\
+stream##_t *algo##StreamNew(void)						\
+{														\
+    stream##_t *s = malloc(sizeof(*s));					\
+														\
+    if (!s)												\
+        return 0;										\
+    s->ctx = EVP_MD_CTX_new();							\
+    if (!s->ctx || EVP_DigestInit_ex(s->ctx, md(), NULL) != 1) {	\
+        EVP_MD_CTX_free(s->ctx);						\
+        free(s);										\
+        return 0;										\
+    }													\
+    return s;											\
+}														\
+														\
+void algo##StreamUpdate(stream##_t *s, const unsigned char *data, size_t len)	\
+{														\
+    EVP_DigestUpdate(s->ctx, data, len);				\
+}														\
+														\
+void algo##StreamEnd(stream##_t *s, char *buf)			\
+{														\
+    unsigned char digest[EVP_MAX_MD_SIZE];				\
+    unsigned int i, len = 0;							\
+    static const char hex[]="0123456789abcdef";			\
+														\
+    EVP_DigestFinal_ex(s->ctx, digest, &len);			\
+    for (i = 0; i < len; i++) {							\
+        buf[i+i] = hex[digest[i] >> 4];					\
+        buf[i+i+1] = hex[digest[i] & 0x0f];				\
+    }													\
+    buf[i+i] = '\0';									\
+    EVP_MD_CTX_free(s->ctx);							\
+    free(s);											\
+}
+#endif
+
 #endif
 /* _MD_WRAPPERS_H */
@@ -150,6 +150,11 @@ RMD160Final(u_char digest[20], RMD160_CTX *ctx)
 	memset(ctx, 0, sizeof (*ctx));
 }
 
+/*
+ * The left and right lines are independent until they are combined at the
+ * end, so their rounds are interleaved to let the processor execute both at
+ * once instead of waiting on the dependencies of one line.
+ */
 void
 RMD160Transform(u_int32_t state[5], const u_char block[64])
 {
@@ -168,196 +173,182 @@ RMD160Transform(u_int32_t state[5], const u_char block[64])
 		    (u_int32_t)(block[i*4 + 3]) << 24);
 #endif
 
-	a = state[0];
-	b = state[1];
-	c = state[2];
-	d = state[3];
-	e = state[4];
+	a = aa = state[0];
+	b = bb = state[1];
+	c = cc = state[2];
+	d = dd = state[3];
+	e = ee = state[4];
 
-	/* Round 1 */
+	/* Round 1 and parallel round 1 */
 	R(a, b, c, d, e, F0, K0, 11,  0);
+	R(aa, bb, cc, dd, ee, F4, KK0,  8,  5);
 	R(e, a, b, c, d, F0, K0, 14,  1);
+	R(ee, aa, bb, cc, dd, F4, KK0,  9, 14);
 	R(d, e, a, b, c, F0, K0, 15,  2);
+	R(dd, ee, aa, bb, cc, F4, KK0,  9,  7);
 	R(c, d, e, a, b, F0, K0, 12,  3);
+	R(cc, dd, ee, aa, bb, F4, KK0, 11,  0);
 	R(b, c, d, e, a, F0, K0,  5,  4);
+	R(bb, cc, dd, ee, aa, F4, KK0, 13,  9);
 	R(a, b, c, d, e, F0, K0,  8,  5);
+	R(aa, bb, cc, dd, ee, F4, KK0, 15,  2);
 	R(e, a, b, c, d, F0, K0,  7,  6);
+	R(ee, aa, bb, cc, dd, F4, KK0, 15, 11);
 	R(d, e, a, b, c, F0, K0,  9,  7);
+	R(dd, ee, aa, bb, cc, F4, KK0,  5,  4);
 	R(c, d, e, a, b, F0, K0, 11,  8);
+	R(cc, dd, ee, aa, bb, F4, KK0,  7, 13);
 	R(b, c, d, e, a, F0, K0, 13,  9);
+	R(bb, cc, dd, ee, aa, F4, KK0,  7,  6);
 	R(a, b, c, d, e, F0, K0, 14, 10);
+	R(aa, bb, cc, dd, ee, F4, KK0,  8, 15);
 	R(e, a, b, c, d, F0, K0, 15, 11);
+	R(ee, aa, bb, cc, dd, F4, KK0, 11,  8);
 	R(d, e, a, b, c, F0, K0,  6, 12);
+	R(dd, ee, aa, bb, cc, F4, KK0, 14,  1);
 	R(c, d, e, a, b, F0, K0,  7, 13);
+	R(cc, dd, ee, aa, bb, F4, KK0, 14, 10);
 	R(b, c, d, e, a, F0, K0,  9, 14);
-	R(a, b, c, d, e, F0, K0,  8, 15); /* #15 */
-	/* Round 2 */
+	R(bb, cc, dd, ee, aa, F4, KK0, 12,  3);
+	R(a, b, c, d, e, F0, K0,  8, 15);
+	R(aa, bb, cc, dd, ee, F4, KK0,  6, 12); /* #15 */
+	/* Round 2 and parallel round 2 */
 	R(e, a, b, c, d, F1, K1,  7,  7);
+	R(ee, aa, bb, cc, dd, F3, KK1,  9,  6);
 	R(d, e, a, b, c, F1, K1,  6,  4);
+	R(dd, ee, aa, bb, cc, F3, KK1, 13, 11);
 	R(c, d, e, a, b, F1, K1,  8, 13);
+	R(cc, dd, ee, aa, bb, F3, KK1, 15,  3);
 	R(b, c, d, e, a, F1, K1, 13,  1);
+	R(bb, cc, dd, ee, aa, F3, KK1,  7,  7);
 	R(a, b, c, d, e, F1, K1, 11, 10);
+	R(aa, bb, cc, dd, ee, F3, KK1, 12,  0);
 	R(e, a, b, c, d, F1, K1,  9,  6);
+	R(ee, aa, bb, cc, dd, F3, KK1,  8, 13);
 	R(d, e, a, b, c, F1, K1,  7, 15);
+	R(dd, ee, aa, bb, cc, F3, KK1,  9,  5);
 	R(c, d, e, a, b, F1, K1, 15,  3);
+	R(cc, dd, ee, aa, bb, F3, KK1, 11, 10);
 	R(b, c, d, e, a, F1, K1,  7, 12);
+	R(bb, cc, dd, ee, aa, F3, KK1,  7, 14);
 	R(a, b, c, d, e, F1, K1, 12,  0);
+	R(aa, bb, cc, dd, ee, F3, KK1,  7, 15);
 	R(e, a, b, c, d, F1, K1, 15,  9);
+	R(ee, aa, bb, cc, dd, F3, KK1, 12,  8);
 	R(d, e, a, b, c, F1, K1,  9,  5);
+	R(dd, ee, aa, bb, cc, F3, KK1,  7, 12);
 	R(c, d, e, a, b, F1, K1, 11,  2);
+	R(cc, dd, ee, aa, bb, F3, KK1,  6,  4);
 	R(b, c, d, e, a, F1, K1,  7, 14);
+	R(bb, cc, dd, ee, aa, F3, KK1, 15,  9);
 	R(a, b, c, d, e, F1, K1, 13, 11);
-	R(e, a, b, c, d, F1, K1, 12,  8); /* #31 */
-	/* Round 3 */
+	R(aa, bb, cc, dd, ee, F3, KK1, 13,  1);
+	R(e, a, b, c, d, F1, K1, 12,  8);
+	R(ee, aa, bb, cc, dd, F3, KK1, 11,  2); /* #31 */
+	/* Round 3 and parallel round 3 */
 	R(d, e, a, b, c, F2, K2, 11,  3);
+	R(dd, ee, aa, bb, cc, F2, KK2,  9, 15);
 	R(c, d, e, a, b, F2, K2, 13, 10);
+	R(cc, dd, ee, aa, bb, F2, KK2,  7,  5);
 	R(b, c, d, e, a, F2, K2,  6, 14);
+	R(bb, cc, dd, ee, aa, F2, KK2, 15,  1);
 	R(a, b, c, d, e, F2, K2,  7,  4);
+	R(aa, bb, cc, dd, ee, F2, KK2, 11,  3);
 	R(e, a, b, c, d, F2, K2, 14,  9);
+	R(ee, aa, bb, cc, dd, F2, KK2,  8,  7);
 	R(d, e, a, b, c, F2, K2,  9, 15);
+	R(dd, ee, aa, bb, cc, F2, KK2,  6, 14);
 	R(c, d, e, a, b, F2, K2, 13,  8);
+	R(cc, dd, ee, aa, bb, F2, KK2,  6,  6);
 	R(b, c, d, e, a, F2, K2, 15,  1);
+	R(bb, cc, dd, ee, aa, F2, KK2, 14,  9);
 	R(a, b, c, d, e, F2, K2, 14,  2);
+	R(aa, bb, cc, dd, ee, F2, KK2, 12, 11);
 	R(e, a, b, c, d, F2, K2,  8,  7);
+	R(ee, aa, bb, cc, dd, F2, KK2, 13,  8);
 	R(d, e, a, b, c, F2, K2, 13,  0);
+	R(dd, ee, aa, bb, cc, F2, KK2,  5, 12);
 	R(c, d, e, a, b, F2, K2,  6,  6);
+	R(cc, dd, ee, aa, bb, F2, KK2, 14,  2);
 	R(b, c, d, e, a, F2, K2,  5, 13);
+	R(bb, cc, dd, ee, aa, F2, KK2, 13, 10);
 	R(a, b, c, d, e, F2, K2, 12, 11);
+	R(aa, bb, cc, dd, ee, F2, KK2, 13,  0);
 	R(e, a, b, c, d, F2, K2,  7,  5);
-	R(d, e, a, b, c, F2, K2,  5, 12); /* #47 */
-	/* Round 4 */
+	R(ee, aa, bb, cc, dd, F2, KK2,  7,  4);
+	R(d, e, a, b, c, F2, K2,  5, 12);
+	R(dd, ee, aa, bb, cc, F2, KK2,  5, 13); /* #47 */
+	/* Round 4 and parallel round 4 */
 	R(c, d, e, a, b, F3, K3, 11,  1);
+	R(cc, dd, ee, aa, bb, F1, KK3, 15,  8);
 	R(b, c, d, e, a, F3, K3, 12,  9);
+	R(bb, cc, dd, ee, aa, F1, KK3,  5,  6);
 	R(a, b, c, d, e, F3, K3, 14, 11);
+	R(aa, bb, cc, dd, ee, F1, KK3,  8,  4);
 	R(e, a, b, c, d, F3, K3, 15, 10);
+	R(ee, aa, bb, cc, dd, F1, KK3, 11,  1);
 	R(d, e, a, b, c, F3, K3, 14,  0);
+	R(dd, ee, aa, bb, cc, F1, KK3, 14,  3);
 	R(c, d, e, a, b, F3, K3, 15,  8);
+	R(cc, dd, ee, aa, bb, F1, KK3, 14, 11);
 	R(b, c, d, e, a, F3, K3,  9, 12);
+	R(bb, cc, dd, ee, aa, F1, KK3,  6, 15);
 	R(a, b, c, d, e, F3, K3,  8,  4);
+	R(aa, bb, cc, dd, ee, F1, KK3, 14,  0);
 	R(e, a, b, c, d, F3, K3,  9, 13);
+	R(ee, aa, bb, cc, dd, F1, KK3,  6,  5);
 	R(d, e, a, b, c, F3, K3, 14,  3);
+	R(dd, ee, aa, bb, cc, F1, KK3,  9, 12);
 	R(c, d, e, a, b, F3, K3,  5,  7);
+	R(cc, dd, ee, aa, bb, F1, KK3, 12,  2);
 	R(b, c, d, e, a, F3, K3,  6, 15);
+	R(bb, cc, dd, ee, aa, F1, KK3,  9, 13);
 	R(a, b, c, d, e, F3, K3,  8, 14);
+	R(aa, bb, cc, dd, ee, F1, KK3, 12,  9);
 	R(e, a, b, c, d, F3, K3,  6,  5);
+	R(ee, aa, bb, cc, dd, F1, KK3,  5,  7);
 	R(d, e, a, b, c, F3, K3,  5,  6);
-	R(c, d, e, a, b, F3, K3, 12,  2); /* #63 */
-	/* Round 5 */
+	R(dd, ee, aa, bb, cc, F1, KK3, 15, 10);
+	R(c, d, e, a, b, F3, K3, 12,  2);
+	R(cc, dd, ee, aa, bb, F1, KK3,  8, 14); /* #63 */
+	/* Round 5 and parallel round 5 */
 	R(b, c, d, e, a, F4, K4,  9,  4);
+	R(bb, cc, dd, ee, aa, F0, KK4,  8, 12);
 	R(a, b, c, d, e, F4, K4, 15,  0);
+	R(aa, bb, cc, dd, ee, F0, KK4,  5, 15);
 	R(e, a, b, c, d, F4, K4,  5,  5);
+	R(ee, aa, bb, cc, dd, F0, KK4, 12, 10);
 	R(d, e, a, b, c, F4, K4, 11,  9);
+	R(dd, ee, aa, bb, cc, F0, KK4,  9,  4);
 	R(c, d, e, a, b, F4, K4,  6,  7);
+	R(cc, dd, ee, aa, bb, F0, KK4, 12,  1);
 	R(b, c, d, e, a, F4, K4,  8, 12);
+	R(bb, cc, dd, ee, aa, F0, KK4,  5,  5);
 	R(a, b, c, d, e, F4, K4, 13,  2);
+	R(aa, bb, cc, dd, ee, F0, KK4, 14,  8);
 	R(e, a, b, c, d, F4, K4, 12, 10);
+	R(ee, aa, bb, cc, dd, F0, KK4,  6,  7);
 	R(d, e, a, b, c, F4, K4,  5, 14);
+	R(dd, ee, aa, bb, cc, F0, KK4,  8,  6);
 	R(c, d, e, a, b, F4, K4, 12,  1);
+	R(cc, dd, ee, aa, bb, F0, KK4, 13,  2);
 	R(b, c, d, e, a, F4, K4, 13,  3);
+	R(bb, cc, dd, ee, aa, F0, KK4,  6, 13);
 	R(a, b, c, d, e, F4, K4, 14,  8);
+	R(aa, bb, cc, dd, ee, F0, KK4,  5, 14);
 	R(e, a, b, c, d, F4, K4, 11, 11);
+	R(ee, aa, bb, cc, dd, F0, KK4, 15,  0);
 	R(d, e, a, b, c, F4, K4,  8,  6);
+	R(dd, ee, aa, bb, cc, F0, KK4, 13,  3);
 	R(c, d, e, a, b, F4, K4,  5, 15);
-	R(b, c, d, e, a, F4, K4,  6, 13); /* #79 */
-
-	aa = a ; bb = b; cc = c; dd = d; ee = e;
-
-	a = state[0];
-	b = state[1];
-	c = state[2];
-	d = state[3];
-	e = state[4];
-
-	/* Parallel round 1 */
-	R(a, b, c, d, e, F4, KK0,  8,  5);
-	R(e, a, b, c, d, F4, KK0,  9, 14);
-	R(d, e, a, b, c, F4, KK0,  9,  7);
-	R(c, d, e, a, b, F4, KK0, 11,  0);
-	R(b, c, d, e, a, F4, KK0, 13,  9);
-	R(a, b, c, d, e, F4, KK0, 15,  2);
-	R(e, a, b, c, d, F4, KK0, 15, 11);
-	R(d, e, a, b, c, F4, KK0,  5,  4);
-	R(c, d, e, a, b, F4, KK0,  7, 13);
-	R(b, c, d, e, a, F4, KK0,  7,  6);
-	R(a, b, c, d, e, F4, KK0,  8, 15);
-	R(e, a, b, c, d, F4, KK0, 11,  8);
-	R(d, e, a, b, c, F4, KK0, 14,  1);
-	R(c, d, e, a, b, F4, KK0, 14, 10);
-	R(b, c, d, e, a, F4, KK0, 12,  3);
-	R(a, b, c, d, e, F4, KK0,  6, 12); /* #15 */
-	/* Parallel round 2 */
-	R(e, a, b, c, d, F3, KK1,  9,  6);
-	R(d, e, a, b, c, F3, KK1, 13, 11);
-	R(c, d, e, a, b, F3, KK1, 15,  3);
-	R(b, c, d, e, a, F3, KK1,  7,  7);
-	R(a, b, c, d, e, F3, KK1, 12,  0);
-	R(e, a, b, c, d, F3, KK1,  8, 13);
-	R(d, e, a, b, c, F3, KK1,  9,  5);
-	R(c, d, e, a, b, F3, KK1, 11, 10);
-	R(b, c, d, e, a, F3, KK1,  7, 14);
-	R(a, b, c, d, e, F3, KK1,  7, 15);
-	R(e, a, b, c, d, F3, KK1, 12,  8);
-	R(d, e, a, b, c, F3, KK1,  7, 12);
-	R(c, d, e, a, b, F3, KK1,  6,  4);
-	R(b, c, d, e, a, F3, KK1, 15,  9);
-	R(a, b, c, d, e, F3, KK1, 13,  1);
-	R(e, a, b, c, d, F3, KK1, 11,  2); /* #31 */
-	/* Parallel round 3 */
-	R(d, e, a, b, c, F2, KK2,  9, 15);
-	R(c, d, e, a, b, F2, KK2,  7,  5);
-	R(b, c, d, e, a, F2, KK2, 15,  1);
-	R(a, b, c, d, e, F2, KK2, 11,  3);
-	R(e, a, b, c, d, F2, KK2,  8,  7);
-	R(d, e, a, b, c, F2, KK2,  6, 14);
-	R(c, d, e, a, b, F2, KK2,  6,  6);
-	R(b, c, d, e, a, F2, KK2, 14,  9);
-	R(a, b, c, d, e, F2, KK2, 12, 11);
-	R(e, a, b, c, d, F2, KK2, 13,  8);
-	R(d, e, a, b, c, F2, KK2,  5, 12);
-	R(c, d, e, a, b, F2, KK2, 14,  2);
-	R(b, c, d, e, a, F2, KK2, 13, 10);
-	R(a, b, c, d, e, F2, KK2, 13,  0);
-	R(e, a, b, c, d, F2, KK2,  7,  4);
-	R(d, e, a, b, c, F2, KK2,  5, 13); /* #47 */
-	/* Parallel round 4 */
-	R(c, d, e, a, b, F1, KK3, 15,  8);
-	R(b, c, d, e, a, F1, KK3,  5,  6);
-	R(a, b, c, d, e, F1, KK3,  8,  4);
-	R(e, a, b, c, d, F1, KK3, 11,  1);
-	R(d, e, a, b, c, F1, KK3, 14,  3);
-	R(c, d, e, a, b, F1, KK3, 14, 11);
-	R(b, c, d, e, a, F1, KK3,  6, 15);
-	R(a, b, c, d, e, F1, KK3, 14,  0);
-	R(e, a, b, c, d, F1, KK3,  6,  5);
-	R(d, e, a, b, c, F1, KK3,  9, 12);
-	R(c, d, e, a, b, F1, KK3, 12,  2);
-	R(b, c, d, e, a, F1, KK3,  9, 13);
-	R(a, b, c, d, e, F1, KK3, 12,  9);
-	R(e, a, b, c, d, F1, KK3,  5,  7);
-	R(d, e, a, b, c, F1, KK3, 15, 10);
-	R(c, d, e, a, b, F1, KK3,  8, 14); /* #63 */
-	/* Parallel round 5 */
-	R(b, c, d, e, a, F0, KK4,  8, 12);
-	R(a, b, c, d, e, F0, KK4,  5, 15);
-	R(e, a, b, c, d, F0, KK4, 12, 10);
-	R(d, e, a, b, c, F0, KK4,  9,  4);
-	R(c, d, e, a, b, F0, KK4, 12,  1);
-	R(b, c, d, e, a, F0, KK4,  5,  5);
-	R(a, b, c, d, e, F0, KK4, 14,  8);
-	R(e, a, b, c, d, F0, KK4,  6,  7);
-	R(d, e, a, b, c, F0, KK4,  8,  6);
-	R(c, d, e, a, b, F0, KK4, 13,  2);
-	R(b, c, d, e, a, F0, KK4,  6, 13);
-	R(a, b, c, d, e, F0, KK4,  5, 14);
-	R(e, a, b, c, d, F0, KK4, 15,  0);
-	R(d, e, a, b, c, F0, KK4, 13,  3);
-	R(c, d, e, a, b, F0, KK4, 11,  9);
-	R(b, c, d, e, a, F0, KK4, 11, 11); /* #79 */
+	R(cc, dd, ee, aa, bb, F0, KK4, 11,  9);
+	R(b, c, d, e, a, F4, K4,  6, 13);
+	R(bb, cc, dd, ee, aa, F0, KK4, 11, 11); /* #79 */
 
-	t =        state[1] + cc + d;
-	state[1] = state[2] + dd + e;
-	state[2] = state[3] + ee + a;
-	state[3] = state[4] + aa + b;
-	state[4] = state[0] + bb + c;
+	t =        state[1] + c + dd;
+	state[1] = state[2] + d + ee;
+	state[2] = state[3] + e + aa;
+	state[3] = state[4] + a + bb;
+	state[4] = state[0] + b + cc;
 	state[0] = t;
 }
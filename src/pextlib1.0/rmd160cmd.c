@@ -36,6 +36,7 @@
 
 /* required for u_char on Linux */
 #define _BSD_SOURCE
+#define _DEFAULT_SOURCE
 
 #include <string.h>
 #include <stdio.h>
@@ -48,19 +49,9 @@
 
 #include "rmd160cmd.h"
 
-#if defined(HAVE_LIBMD) && defined(HAVE_RIPEMD_H)
-#include <sys/types.h>
-#include <ripemd.h>
-#elif defined(HAVE_LIBCRYPTO) && defined(HAVE_OPENSSL_RIPEMD_H)
-#include <openssl/ripemd.h>
-
-#include "md_wrappers.h"
-CHECKSUMEnd(RIPEMD160_, RIPEMD160_CTX, RIPEMD160_DIGEST_LENGTH)
-CHECKSUMFile(RIPEMD160_, RIPEMD160_CTX)
-CHECKSUMData(RIPEMD160_, RIPEMD160_CTX)
-#else
 /*
- * let's use our own version of rmd160* libraries.
+ * Always use our own version of the rmd160* functions, whose transform is
+ * faster than the scalar ones of libmd and libcrypto.
  */
 #include <sys/types.h>
 #include "rmd160.h"
@@ -68,12 +59,40 @@ CHECKSUMData(RIPEMD160_, RIPEMD160_CTX)
 #define RIPEMD160_DIGEST_LENGTH 20
 #define RIPEMD160_File(x,y) RMD160File(x,y)
 #define RIPEMD160_Data(x,y,z) RMD160Data(x,y,z)
+#define RIPEMD160_CTX RMD160_CTX
+#define RIPEMD160_Init(c) RMD160Init(c)
+#define RIPEMD160_Update(c,d,l) RMD160Update(c,d,l)
+#define RIPEMD160_End(c,b) RMD160End(c,b)
 
 #include "md_wrappers.h"
 CHECKSUMEnd(RMD160, RMD160_CTX, RIPEMD160_DIGEST_LENGTH)
 CHECKSUMFile(RMD160, RMD160_CTX)
 CHECKSUMData(RMD160, RMD160_CTX)
-#endif
+
+struct rmd160_stream {
+	RIPEMD160_CTX ctx;
+};
+
+rmd160_stream_t *RMD160StreamNew(void)
+{
+	rmd160_stream_t *stream = malloc(sizeof(*stream));
+
+	if (stream != NULL) {
+		RIPEMD160_Init(&stream->ctx);
+	}
+	return stream;
+}
+
+void RMD160StreamUpdate(rmd160_stream_t *stream, const unsigned char *data, size_t len)
+{
+	RIPEMD160_Update(&stream->ctx, data, (u_int32_t)len);
+}
+
+void RMD160StreamEnd(rmd160_stream_t *stream, char *buf)
+{
+	RIPEMD160_End(&stream->ctx, buf);
+	free(stream);
+}
 
 int RMD160Cmd(ClientData clientData UNUSED, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
 {
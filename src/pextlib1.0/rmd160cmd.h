@@ -32,6 +32,8 @@
 #ifndef _RMD160CMD_H
 #define _RMD160CMD_H
 
+#include <stddef.h>
+
 #include <tcl.h>
 
 /**
@@ -39,5 +41,17 @@
  */
 int RMD160Cmd(ClientData, Tcl_Interp *, int, Tcl_Obj *CONST objv[]);
 
+/**
+ * Incremental rmd160 of data given in pieces, e.g. while it is downloaded.
+ * RMD160StreamNew returns NULL if it runs out of memory. RMD160StreamEnd
+ * writes the hex digest to buf, which holds 41 characters, and frees the
+ * stream.
+ */
+typedef struct rmd160_stream rmd160_stream_t;
+
+rmd160_stream_t *RMD160StreamNew(void);
+void RMD160StreamUpdate(rmd160_stream_t *stream, const unsigned char *data, size_t len);
+void RMD160StreamEnd(rmd160_stream_t *stream, char *buf);
+
 #endif
 	/* _RMD160CMD_H */
@@ -53,6 +53,7 @@
 #include "md_wrappers.h"
 CHECKSUMEnd(SHA1_, SHA_CTX, SHA_DIGEST_LENGTH)
 CHECKSUMFile(SHA1_, SHA_CTX)
+CHECKSUMStream(SHA1, sha1_stream, SHA_CTX, SHA1_Init, SHA1_Update, SHA1_End)
 
 #elif defined(HAVE_LIBMD) && defined(HAVE_SHA_H)
 #include <sys/types.h>
@@ -63,12 +64,17 @@ CHECKSUMFile(SHA1_, SHA_CTX)
 #ifndef HAVE_SHA1_FILE
 #define SHA1_File(x,y) SHAFile(x,y)
 #endif
+
+#include "md_wrappers.h"
+CHECKSUMStream(SHA1, sha1_stream, SHA_CTX, SHA1_Init, SHA1_Update, SHA1_End)
 #elif defined(HAVE_LIBCRYPTO) && defined(HAVE_OPENSSL_SHA_H)
+#include <openssl/evp.h>
 #include <openssl/sha.h>
 
 #include "md_wrappers.h"
 CHECKSUMEnd(SHA1_, SHA_CTX, SHA_DIGEST_LENGTH)
 CHECKSUMFile(SHA1_, SHA_CTX)
+CHECKSUMStreamEVP(SHA1, sha1_stream, EVP_sha1)
 #else
 #error CommonCrypto, libmd or libcrypto required
 #endif
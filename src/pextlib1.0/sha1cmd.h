@@ -30,4 +30,17 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stddef.h>
+
 int SHA1Cmd(ClientData, Tcl_Interp *, int, Tcl_Obj *CONST objv[]);
+
+/**
+ * Incremental sha1 of data given in pieces. SHA1StreamNew returns NULL if it
+ * runs out of memory. SHA1StreamEnd writes the hex digest to buf, which holds
+ * 41 characters, and frees the stream.
+ */
+typedef struct sha1_stream sha1_stream_t;
+
+sha1_stream_t *SHA1StreamNew(void);
+void SHA1StreamUpdate(sha1_stream_t *stream, const unsigned char *data, size_t len);
+void SHA1StreamEnd(sha1_stream_t *stream, char *buf);
@@ -37,6 +37,29 @@
 #include <sys/param.h>
 #include <sys/time.h>
 
+/*
+ * SHA-NI NOTE:
+ * On x86 processors with the SHA extensions, the hash transform uses
+ * the sha256rnds2 and sha256msg instructions. They are used only if
+ * CPUID reports them at run time, otherwise the portable transform
+ * below is used.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__)
+#if __has_builtin(__builtin_ia32_sha256rnds2)
+#define SHA2_SHANI_TRANSFORM
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 5
+#define SHA2_SHANI_TRANSFORM
+#endif
+#endif
+
+#ifdef SHA2_SHANI_TRANSFORM
+#include <cpuid.h>
+#include <immintrin.h>
+#include <pthread.h>
+#endif
+
 /*
  * UNROLLED TRANSFORM LOOP NOTE:
  * You can define SHA2_UNROLL_TRANSFORM to use the unrolled transform
@@ -150,7 +173,9 @@
  * library -- they are intended for private internal visibility/use
  * only.
  */
-void SHA256_Transform(SHA256_CTX *, const u_int8_t *);
+typedef void (*SHA256_Transform_func)(u_int32_t *, const u_int8_t *, size_t);
+static void SHA256_Transform_generic(u_int32_t *, const u_int8_t *, size_t);
+static SHA256_Transform_func SHA256_Transform = SHA256_Transform_generic;
 
 
 /*** SHA-XYZ INITIAL HASH VALUES AND CONSTANTS ************************/
@@ -189,9 +214,36 @@ static const u_int32_t sha256_initial_hash_value[8] = {
 
 
 /*** SHA-256: *********************************************************/
+#ifdef SHA2_SHANI_TRANSFORM
+static void SHA256_Transform_shani(u_int32_t *, const u_int8_t *, size_t);
+
+static void
+SHA256_Select_Transform(void)
+{
+	unsigned int	eax, ebx, ecx, edx;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return;
+	/* SSSE3 and SSE4.1 */
+	__cpuid(1, eax, ebx, ecx, edx);
+	if ((ecx & (1 << 9)) == 0 || (ecx & (1 << 19)) == 0)
+		return;
+	/* SHA */
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	if ((ebx & (1 << 29)) == 0)
+		return;
+	SHA256_Transform = SHA256_Transform_shani;
+}
+#endif /* SHA2_SHANI_TRANSFORM */
+
 void
 SHA256_Init(SHA256_CTX *context)
 {
+#ifdef SHA2_SHANI_TRANSFORM
+	static pthread_once_t	once = PTHREAD_ONCE_INIT;
+
+	pthread_once(&once, SHA256_Select_Transform);
+#endif
 	if (context == NULL)
 		return;
 	bcopy(sha256_initial_hash_value, context->state, SHA256_DIGEST_LENGTH);
@@ -225,59 +277,59 @@ SHA256_Init(SHA256_CTX *context)
 	j++;								    \
 } while(0)
 
-void
-SHA256_Transform(SHA256_CTX *context, const u_int8_t *data)
+static void
+SHA256_Transform_generic(u_int32_t *state, const u_int8_t *data, size_t blocks)
 {
 	u_int32_t	a, b, c, d, e, f, g, h, s0, s1;
-	u_int32_t	T1, *W256;
+	u_int32_t	T1, W256[16];
 	int		j;
 
-	W256 = (u_int32_t *)context->buffer;
-
-	/* Initialize registers with the prev. intermediate value */
-	a = context->state[0];
-	b = context->state[1];
-	c = context->state[2];
-	d = context->state[3];
-	e = context->state[4];
-	f = context->state[5];
-	g = context->state[6];
-	h = context->state[7];
-
-	j = 0;
-	do {
-		/* Rounds 0 to 15 (unrolled): */
-		ROUND256_0_TO_15(a,b,c,d,e,f,g,h);
-		ROUND256_0_TO_15(h,a,b,c,d,e,f,g);
-		ROUND256_0_TO_15(g,h,a,b,c,d,e,f);
-		ROUND256_0_TO_15(f,g,h,a,b,c,d,e);
-		ROUND256_0_TO_15(e,f,g,h,a,b,c,d);
-		ROUND256_0_TO_15(d,e,f,g,h,a,b,c);
-		ROUND256_0_TO_15(c,d,e,f,g,h,a,b);
-		ROUND256_0_TO_15(b,c,d,e,f,g,h,a);
-	} while (j < 16);
-
-	/* Now for the remaining rounds to 64: */
-	do {
-		ROUND256(a,b,c,d,e,f,g,h);
-		ROUND256(h,a,b,c,d,e,f,g);
-		ROUND256(g,h,a,b,c,d,e,f);
-		ROUND256(f,g,h,a,b,c,d,e);
-		ROUND256(e,f,g,h,a,b,c,d);
-		ROUND256(d,e,f,g,h,a,b,c);
-		ROUND256(c,d,e,f,g,h,a,b);
-		ROUND256(b,c,d,e,f,g,h,a);
-	} while (j < 64);
-
-	/* Compute the current intermediate hash value */
-	context->state[0] += a;
-	context->state[1] += b;
-	context->state[2] += c;
-	context->state[3] += d;
-	context->state[4] += e;
-	context->state[5] += f;
-	context->state[6] += g;
-	context->state[7] += h;
+	for (; blocks > 0; blocks--) {
+		/* Initialize registers with the prev. intermediate value */
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+
+		j = 0;
+		do {
+			/* Rounds 0 to 15 (unrolled): */
+			ROUND256_0_TO_15(a,b,c,d,e,f,g,h);
+			ROUND256_0_TO_15(h,a,b,c,d,e,f,g);
+			ROUND256_0_TO_15(g,h,a,b,c,d,e,f);
+			ROUND256_0_TO_15(f,g,h,a,b,c,d,e);
+			ROUND256_0_TO_15(e,f,g,h,a,b,c,d);
+			ROUND256_0_TO_15(d,e,f,g,h,a,b,c);
+			ROUND256_0_TO_15(c,d,e,f,g,h,a,b);
+			ROUND256_0_TO_15(b,c,d,e,f,g,h,a);
+		} while (j < 16);
+
+		/* Now for the remaining rounds to 64: */
+		do {
+			ROUND256(a,b,c,d,e,f,g,h);
+			ROUND256(h,a,b,c,d,e,f,g);
+			ROUND256(g,h,a,b,c,d,e,f);
+			ROUND256(f,g,h,a,b,c,d,e);
+			ROUND256(e,f,g,h,a,b,c,d);
+			ROUND256(d,e,f,g,h,a,b,c);
+			ROUND256(c,d,e,f,g,h,a,b);
+			ROUND256(b,c,d,e,f,g,h,a);
+		} while (j < 64);
+
+		/* Compute the current intermediate hash value */
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
 
 	/* Clean up */
 	a = b = c = d = e = f = g = h = T1 = 0;
@@ -285,77 +337,77 @@ SHA256_Transform(SHA256_CTX *context, const u_int8_t *data)
 
 #else /* SHA2_UNROLL_TRANSFORM */
 
-void
-SHA256_Transform(SHA256_CTX *context, const u_int8_t *data)
+static void
+SHA256_Transform_generic(u_int32_t *state, const u_int8_t *data, size_t blocks)
 {
 	u_int32_t	a, b, c, d, e, f, g, h, s0, s1;
-	u_int32_t	T1, T2, *W256;
+	u_int32_t	T1, T2, W256[16];
 	int		j;
 
-	W256 = (u_int32_t *)context->buffer;
-
-	/* Initialize registers with the prev. intermediate value */
-	a = context->state[0];
-	b = context->state[1];
-	c = context->state[2];
-	d = context->state[3];
-	e = context->state[4];
-	f = context->state[5];
-	g = context->state[6];
-	h = context->state[7];
-
-	j = 0;
-	do {
-		W256[j] = (u_int32_t)data[3] | ((u_int32_t)data[2] << 8) |
-		    ((u_int32_t)data[1] << 16) | ((u_int32_t)data[0] << 24);
-		data += 4;
-		/* Apply the SHA-256 compression function to update a..h */
-		T1 = h + Sigma1_256(e) + Ch(e, f, g) + K256[j] + W256[j];
-		T2 = Sigma0_256(a) + Maj(a, b, c);
-		h = g;
-		g = f;
-		f = e;
-		e = d + T1;
-		d = c;
-		c = b;
-		b = a;
-		a = T1 + T2;
-
-		j++;
-	} while (j < 16);
-
-	do {
-		/* Part of the message block expansion: */
-		s0 = W256[(j+1)&0x0f];
-		s0 = sigma0_256(s0);
-		s1 = W256[(j+14)&0x0f];	
-		s1 = sigma1_256(s1);
-
-		/* Apply the SHA-256 compression function to update a..h */
-		T1 = h + Sigma1_256(e) + Ch(e, f, g) + K256[j] + 
-		     (W256[j&0x0f] += s1 + W256[(j+9)&0x0f] + s0);
-		T2 = Sigma0_256(a) + Maj(a, b, c);
-		h = g;
-		g = f;
-		f = e;
-		e = d + T1;
-		d = c;
-		c = b;
-		b = a;
-		a = T1 + T2;
-
-		j++;
-	} while (j < 64);
-
-	/* Compute the current intermediate hash value */
-	context->state[0] += a;
-	context->state[1] += b;
-	context->state[2] += c;
-	context->state[3] += d;
-	context->state[4] += e;
-	context->state[5] += f;
-	context->state[6] += g;
-	context->state[7] += h;
+	for (; blocks > 0; blocks--) {
+		/* Initialize registers with the prev. intermediate value */
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+
+		j = 0;
+		do {
+			W256[j] = (u_int32_t)data[3] | ((u_int32_t)data[2] << 8) |
+			    ((u_int32_t)data[1] << 16) | ((u_int32_t)data[0] << 24);
+			data += 4;
+			/* Apply the SHA-256 compression function to update a..h */
+			T1 = h + Sigma1_256(e) + Ch(e, f, g) + K256[j] + W256[j];
+			T2 = Sigma0_256(a) + Maj(a, b, c);
+			h = g;
+			g = f;
+			f = e;
+			e = d + T1;
+			d = c;
+			c = b;
+			b = a;
+			a = T1 + T2;
+
+			j++;
+		} while (j < 16);
+
+		do {
+			/* Part of the message block expansion: */
+			s0 = W256[(j+1)&0x0f];
+			s0 = sigma0_256(s0);
+			s1 = W256[(j+14)&0x0f];	
+			s1 = sigma1_256(s1);
+
+			/* Apply the SHA-256 compression function to update a..h */
+			T1 = h + Sigma1_256(e) + Ch(e, f, g) + K256[j] + 
+			     (W256[j&0x0f] += s1 + W256[(j+9)&0x0f] + s0);
+			T2 = Sigma0_256(a) + Maj(a, b, c);
+			h = g;
+			g = f;
+			f = e;
+			e = d + T1;
+			d = c;
+			c = b;
+			b = a;
+			a = T1 + T2;
+
+			j++;
+		} while (j < 64);
+
+		/* Compute the current intermediate hash value */
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
 
 	/* Clean up */
 	a = b = c = d = e = f = g = h = T1 = T2 = 0;
@@ -363,10 +415,66 @@ SHA256_Transform(SHA256_CTX *context, const u_int8_t *data)
 
 #endif /* SHA2_UNROLL_TRANSFORM */
 
+#ifdef SHA2_SHANI_TRANSFORM
+
+/*
+ * The state is kept as ABEF and CDGH vectors as expected by sha256rnds2.
+ * Each iteration does 4 rounds, computing the next 4 words of the message
+ * schedule with sha256msg1 and sha256msg2 from the last 16.
+ */
+__attribute__((target("sha,sse4.1")))
+static void
+SHA256_Transform_shani(u_int32_t *state, const u_int8_t *data, size_t blocks)
+{
+	const __m128i	MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i		STATE0, STATE1, ABEF_SAVE, CDGH_SAVE, MSG, TMP, W[4];
+	int		j;
+
+	TMP = _mm_loadu_si128((const __m128i *)&state[0]);
+	STATE1 = _mm_loadu_si128((const __m128i *)&state[4]);
+	TMP = _mm_shuffle_epi32(TMP, 0xb1);		/* CDAB */
+	STATE1 = _mm_shuffle_epi32(STATE1, 0x1b);	/* EFGH */
+	STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);	/* ABEF */
+	STATE1 = _mm_blend_epi16(STATE1, TMP, 0xf0);	/* CDGH */
+
+	for (; blocks > 0; blocks--) {
+		ABEF_SAVE = STATE0;
+		CDGH_SAVE = STATE1;
+
+		for (j = 0; j < 16; j++) {
+			if (j < 4) {
+				MSG = _mm_loadu_si128((const __m128i *)(data + 16 * j));
+				W[j] = _mm_shuffle_epi8(MSG, MASK);
+			} else {
+				TMP = _mm_sha256msg1_epu32(W[j & 3], W[(j + 1) & 3]);
+				TMP = _mm_add_epi32(TMP, _mm_alignr_epi8(W[(j + 3) & 3], W[(j + 2) & 3], 4));
+				W[j & 3] = _mm_sha256msg2_epu32(TMP, W[(j + 3) & 3]);
+			}
+			MSG = _mm_add_epi32(W[j & 3], _mm_loadu_si128((const __m128i *)&K256[4 * j]));
+			STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+			MSG = _mm_shuffle_epi32(MSG, 0x0e);
+			STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+		}
+
+		STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+		STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+		data += SHA256_BLOCK_LENGTH;
+	}
+
+	TMP = _mm_shuffle_epi32(STATE0, 0x1b);		/* FEBA */
+	STATE1 = _mm_shuffle_epi32(STATE1, 0xb1);	/* DCHG */
+	STATE0 = _mm_blend_epi16(TMP, STATE1, 0xf0);	/* DCBA */
+	STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);	/* ABEF */
+	_mm_storeu_si128((__m128i *)&state[0], STATE0);
+	_mm_storeu_si128((__m128i *)&state[4], STATE1);
+}
+
+#endif /* SHA2_SHANI_TRANSFORM */
+
 void
 SHA256_Update(SHA256_CTX *context, const u_int8_t *data, size_t len)
 {
-	size_t	freespace, usedspace;
+	size_t	freespace, usedspace, blocks;
 
 	/* Calling with no data is valid (we do nothing) */
 	if (len == 0)
@@ -383,7 +491,7 @@ SHA256_Update(SHA256_CTX *context, const u_int8_t *data, size_t len)
 			context->bitcount += freespace << 3;
 			len -= freespace;
 			data += freespace;
-			SHA256_Transform(context, context->buffer);
+			SHA256_Transform(context->state, context->buffer, 1);
 		} else {
 			/* The buffer is not yet full */
 			bcopy(data, &context->buffer[usedspace], len);
@@ -393,12 +501,13 @@ SHA256_Update(SHA256_CTX *context, const u_int8_t *data, size_t len)
 			return;
 		}
 	}
-	while (len >= SHA256_BLOCK_LENGTH) {
+	if (len >= SHA256_BLOCK_LENGTH) {
 		/* Process as many complete blocks as we can */
-		SHA256_Transform(context, data);
-		context->bitcount += SHA256_BLOCK_LENGTH << 3;
-		len -= SHA256_BLOCK_LENGTH;
-		data += SHA256_BLOCK_LENGTH;
+		blocks = len / SHA256_BLOCK_LENGTH;
+		SHA256_Transform(context->state, data, blocks);
+		context->bitcount += (u_int64_t)blocks * SHA256_BLOCK_LENGTH << 3;
+		len -= blocks * SHA256_BLOCK_LENGTH;
+		data += blocks * SHA256_BLOCK_LENGTH;
 	}
 	if (len > 0) {
 		/* There's left-overs, so save 'em */
@@ -434,7 +543,7 @@ SHA256_Final(u_int8_t digest[], SHA256_CTX *context)
 					bzero(&context->buffer[usedspace], SHA256_BLOCK_LENGTH - usedspace);
 				}
 				/* Do second-to-last transform: */
-				SHA256_Transform(context, context->buffer);
+				SHA256_Transform(context->state, context->buffer, 1);
 
 				/* And set-up for the last transform: */
 				bzero(context->buffer, SHA256_SHORT_BLOCK_LENGTH);
@@ -450,7 +559,7 @@ SHA256_Final(u_int8_t digest[], SHA256_CTX *context)
 		*(u_int64_t *)&context->buffer[SHA256_SHORT_BLOCK_LENGTH] = context->bitcount;
 
 		/* Final transform: */
-		SHA256_Transform(context, context->buffer);
+		SHA256_Transform(context->state, context->buffer, 1);
 
 #if BYTE_ORDER == LITTLE_ENDIAN
 		{
@@ -33,6 +33,10 @@
 #include <config.h>
 #endif
 
+/* required for u_int32_t, bcopy and BYTE_ORDER on Linux */
+#define _BSD_SOURCE
+#define _DEFAULT_SOURCE
+
 #include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
@@ -60,6 +64,7 @@
 #include "md_wrappers.h"
 CHECKSUMEnd(SHA256_, SHA256_CTX, SHA256_DIGEST_LENGTH)
 CHECKSUMFile(SHA256_, SHA256_CTX)
+CHECKSUMStream(SHA256, sha256_stream, SHA256_CTX, SHA256_Init, SHA256_Update, SHA256_End)
 
 #elif defined(HAVE_LIBMD) && defined(HAVE_SHA256_H) && !defined(__FreeBSD__) /*dumps core*/
 #include <sys/types.h>
@@ -67,12 +72,17 @@ CHECKSUMFile(SHA256_, SHA256_CTX)
 #ifndef SHA256_DIGEST_LENGTH
 #define SHA256_DIGEST_LENGTH 32
 #endif
+
+#include "md_wrappers.h"
+CHECKSUMStream(SHA256, sha256_stream, SHA256_CTX, SHA256_Init, SHA256_Update, SHA256_End)
 #elif defined(HAVE_LIBCRYPTO) && defined(HAVE_OPENSSL_SHA_H) && defined(HAVE_SHA256_UPDATE)
+#include <openssl/evp.h>
 #include <openssl/sha.h>
 
 #include "md_wrappers.h"
 CHECKSUMEnd(SHA256_, SHA256_CTX, SHA256_DIGEST_LENGTH)
 CHECKSUMFile(SHA256_, SHA256_CTX)
+CHECKSUMStreamEVP(SHA256, sha256_stream, EVP_sha256)
 #else
 /*
  * let's use our own version of sha256* libraries.
@@ -84,6 +94,7 @@ CHECKSUMFile(SHA256_, SHA256_CTX)
 #include "md_wrappers.h"
 CHECKSUMEnd(SHA256_, SHA256_CTX, SHA256_DIGEST_LENGTH)
 CHECKSUMFile(SHA256_, SHA256_CTX)
+CHECKSUMStream(SHA256, sha256_stream, SHA256_CTX, SHA256_Init, SHA256_Update, SHA256_End)
 #endif
 
 int SHA256Cmd(ClientData clientData UNUSED, Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[])
@@ -32,6 +32,8 @@
 #ifndef _SHA256CMD_H
 #define _SHA256CMD_H
 
+#include <stddef.h>
+
 #include <tcl.h>
 
 /**
@@ -39,5 +41,17 @@
  */
 int SHA256Cmd(ClientData, Tcl_Interp *, int, Tcl_Obj *CONST objv[]);
 
+/**
+ * Incremental sha256 of data given in pieces, e.g. while it is downloaded.
+ * SHA256StreamNew returns NULL if it runs out of memory. SHA256StreamEnd
+ * writes the hex digest to buf, which holds 65 characters, and frees the
+ * stream.
+ */
+typedef struct sha256_stream sha256_stream_t;
+
+sha256_stream_t *SHA256StreamNew(void);
+void SHA256StreamUpdate(sha256_stream_t *stream, const unsigned char *data, size_t len);
+void SHA256StreamEnd(sha256_stream_t *stream, char *buf);
+
 #endif
 	/* _SHA256CMD_H */
@@ -310,7 +310,8 @@ int SystemCmd(ClientData clientData UNUSED, Tcl_Interp *interp, int objc, Tcl_Ob
 
     status = TCL_ERROR;
 
-    if (wait(&ret) == pid && (WIFEXITED(ret) || WIFSIGNALED(ret)) && !read_failed) {
+    /* only wait for our child, there may be others, e.g. from open "|..." */
+    if (waitpid(pid, &ret, 0) == pid && (WIFEXITED(ret) || WIFSIGNALED(ret)) && !read_failed) {
         /* Normal exit, and reading from the pipe didn't fail. */
         if (WIFEXITED(ret) && WEXITSTATUS(ret) == 0) {
             status = TCL_OK;
@@ -0,0 +1,81 @@
+# Benchmark of activating an image the way it was done before the archive
+# command, tar extracting to a temporary directory and the files being
+# renamed into place, against archive extract writing them in place.
+# Not run as part of the test suite.
+# Syntax:
+# tclsh archive-bench.tcl <Pextlib name> ?files? ?kilobytes per file?
+
+proc usec {script} {
+    set start [clock microseconds]
+    uplevel 1 $script
+    return [expr {[clock microseconds] - $start}]
+}
+
+proc report {what usec} {
+    puts [format "%-40s %10.1f ms" $what [expr {$usec / 1000.0}]]
+}
+
+proc main {pextlibname {files 2000} {kilobytes 16}} {
+    load $pextlibname
+
+    set dir [file join [pwd] archive-bench]
+    file delete -force $dir
+    set src [file join $dir src]
+    set block {}
+    for {set i 0} {$i < 1024} {incr i} {
+        append block [format %c [expr {($i * 7919 + ($i >> 8)) & 0xff}]]
+    }
+    set contents [string repeat $block $kilobytes]
+    set imagefiles {}
+    for {set i 0} {$i < $files} {incr i} {
+        set path /opt/local/share/bench/d[expr {$i / 100}]/f$i
+        file mkdir [file dirname $src$path]
+        set fd [open $src$path w]
+        fconfigure $fd -translation binary
+        puts -nonewline $fd $contents
+        close $fd
+        lappend imagefiles $path
+    }
+    puts "$files files of $kilobytes KiB"
+
+    foreach {compressor extension} {{} tar gzip tgz bzip2 tbz2 xz txz} {
+        if {$compressor ne {} && [auto_execok $compressor] eq ""} {
+            continue
+        }
+        set archive [file join $dir image.$extension]
+        if {$compressor eq {}} {
+            exec tar -C $src -cf $archive .
+        } else {
+            exec tar -C $src -cf - . | $compressor -c > $archive
+        }
+
+        set dest [file join $dir dest]
+        file delete -force $dest
+        report "$extension, tar to temporary directory" [usec {
+            set tmp [file join $dir tmp]
+            file mkdir $tmp
+            if {$compressor eq {}} {
+                exec tar -C $tmp -xpf $archive
+            } else {
+                exec $compressor -d -c $archive | tar -C $tmp -xpf -
+            }
+            foreach path $imagefiles {
+                set directory [file dirname $dest$path]
+                if {![file isdirectory $directory]} {
+                    file mkdir $directory
+                }
+                file rename $tmp$path $dest$path
+            }
+            file delete -force $tmp
+        }]
+
+        file delete -force $dest
+        report "$extension, archive extract" [usec {
+            archive extract -files $imagefiles $archive $dest
+        }]
+    }
+
+    file delete -force $dir
+}
+
+main {*}$argv
@@ -0,0 +1,71 @@
+# Benchmark of creating an image archive the way portarchive does for the
+# tbz2 and txz types, tar piped to an external compressor, against archive
+# create writing a tzst archive with one or more compression threads.
+# Not run as part of the test suite.
+# Syntax:
+# tclsh archive-create-bench.tcl <Pextlib name> ?files? ?kilobytes per file? ?threads?
+
+proc usec {script} {
+    set start [clock microseconds]
+    uplevel 1 $script
+    return [expr {[clock microseconds] - $start}]
+}
+
+proc report {what usec archive} {
+    puts [format "%-40s %10.1f ms %12d bytes" $what [expr {$usec / 1000.0}] \
+        [file size $archive]]
+}
+
+proc main {pextlibname {files 200} {kilobytes 32} {threads 4}} {
+    load $pextlibname
+
+    set dir [file join [pwd] archive-create-bench]
+    file delete -force $dir
+    set src [file join $dir src]
+    # somewhat compressible contents, different in every file
+    for {set i 0} {$i < $files} {incr i} {
+        set path $src/opt/local/share/bench/d[expr {$i / 100}]/f$i
+        file mkdir [file dirname $path]
+        set fd [open $path w]
+        fconfigure $fd -translation binary
+        set seed $i
+        for {set k 0} {$k < $kilobytes * 64} {incr k} {
+            set seed [expr {($seed * 1103515245 + 12345) & 0x7fffffff}]
+            puts -nonewline $fd [format "%08x%08x" [expr {$seed >> 20}] $k]
+        }
+        close $fd
+    }
+    puts "$files files of $kilobytes KiB"
+
+    foreach {compressor extension} {{bzip2 -9} tbz2 {xz -6} txz} {
+        if {[auto_execok [lindex $compressor 0]] eq ""} {
+            continue
+        }
+        set archive [file join $dir image.$extension]
+        report "$extension, tar | $compressor" [usec {
+            exec tar -C $src -cf - . | {*}$compressor -c > $archive
+        }] $archive
+    }
+
+    if {![archive supported image.tzst]} {
+        puts "tzst not supported by $pextlibname"
+    } else {
+        set archive [file join $dir image.tzst]
+        foreach n [lsort -unique -integer [list 1 $threads]] {
+            file delete $archive
+            report "tzst, archive create -threads $n" [usec {
+                archive create -threads $n $archive $src
+            }] $archive
+        }
+        if {[auto_execok zstd] ne ""} {
+            set archive [file join $dir tar.tzst]
+            report "tzst, tar | zstd -9 -T$threads" [usec {
+                exec tar -C $src -cf - . | zstd -q -9 -T$threads -c > $archive
+            }] $archive
+        }
+    }
+
+    file delete -force $dir
+}
+
+main {*}$argv
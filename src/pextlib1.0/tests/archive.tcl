@@ -0,0 +1,306 @@
+# Test file for Pextlib's archive command.
+# Requires r/w access to /tmp/ and tar
+# Syntax:
+# tclsh archive.tcl <Pextlib name>
+
+proc check {cond} {
+    if {![uplevel 1 [list expr $cond]]} {
+        puts "FAILED: $cond"
+        exit 1
+    }
+}
+
+proc write_file {path contents} {
+    set chan [open $path w]
+    fconfigure $chan -translation binary
+    puts -nonewline $chan $contents
+    close $chan
+}
+
+proc read_file {path} {
+    set chan [open $path r]
+    fconfigure $chan -translation binary
+    set contents [read $chan]
+    close $chan
+    return $contents
+}
+
+proc main {pextlibname} {
+    load $pextlibname
+
+    set dir [file join /tmp macports-pextlib-testarchive-[pid]]
+    file delete -force $dir
+    set src [file join $dir src]
+    set long [string repeat abcdefghij 12]/[string repeat klmnopqrst 15]
+
+    # an image like the ones built by portarchive
+    file mkdir $src/opt/local/bin $src/opt/local/share/doc $src/opt/local/$long
+    write_file $src/+CONTENTS "@name test-1.0_0\n"
+    write_file $src/opt/local/bin/tool "#!/bin/sh\necho tool\n"
+    file attributes $src/opt/local/bin/tool -permissions 0755
+    write_file $src/opt/local/share/doc/empty ""
+    set big [string repeat "0123456789abcdef" 40000]
+    write_file $src/opt/local/share/doc/big $big
+    file attributes $src/opt/local/share/doc/big -permissions 0640
+    write_file $src/opt/local/$long/file "long"
+    file link -symbolic $src/opt/local/bin/link tool
+    file link -hard $src/opt/local/bin/hardlink $src/opt/local/bin/tool
+    file attributes $src/opt/local/share/doc -permissions 0700
+    file mtime $src/opt/local/share/doc/big 1000000000
+    file mtime $src/opt/local/share/doc 1000000000
+
+    set archives [list $dir/test.tar]
+    exec tar -C $src -cf $dir/test.tar --format=pax .
+    exec tar -C $src -cf $dir/gnu.tar --format=gnu +CONTENTS opt
+    lappend archives $dir/gnu.tar
+    foreach {compressor extension} {gzip tgz bzip2 tbz2 xz txz lzma tlz} {
+        if {[auto_execok $compressor] ne ""} {
+            exec $compressor -c $dir/test.tar > $dir/test.$extension
+            lappend archives $dir/test.$extension
+            check {[archive supported $dir/test.$extension]}
+        }
+    }
+    check {[archive supported $dir/test.tar]}
+    check {![archive supported $dir/test.xar]}
+    check {![archive supported $dir/test.cpio]}
+    check {![archive supported $dir/test]}
+
+    # complete extraction, the same whatever the compression
+    foreach archive $archives {
+        set dest [file join $dir dest]
+        file delete -force $dest
+        file mkdir $dest
+        check {[archive extract -created created $archive $dest] eq ""}
+        check {[read_file $dest/+CONTENTS] eq "@name test-1.0_0\n"}
+        check {[read_file $dest/opt/local/bin/tool] eq "#!/bin/sh\necho tool\n"}
+        check {[file attributes $dest/opt/local/bin/tool -permissions] eq "00755"}
+        check {[file size $dest/opt/local/share/doc/empty] == 0}
+        check {[read_file $dest/opt/local/share/doc/big] eq $big}
+        check {[file attributes $dest/opt/local/share/doc/big -permissions] eq "00640"}
+        check {[file mtime $dest/opt/local/share/doc/big] == 1000000000}
+        check {[file attributes $dest/opt/local/share/doc -permissions] eq "040700"}
+        check {[file mtime $dest/opt/local/share/doc] == 1000000000}
+        check {[read_file $dest/opt/local/$long/file] eq "long"}
+        check {[file readlink $dest/opt/local/bin/link] eq "tool"}
+        file stat $dest/opt/local/bin/tool tool
+        file stat $dest/opt/local/bin/hardlink hardlink
+        check {$tool(ino) == $hardlink(ino)}
+        check {[lsort $created] eq [lsort [list $dest/+CONTENTS \
+            $dest/opt/local/bin/tool $dest/opt/local/bin/link \
+            $dest/opt/local/bin/hardlink $dest/opt/local/share/doc/empty \
+            $dest/opt/local/share/doc/big $dest/opt/local/$long/file]]}
+    }
+
+    # selected members only, renamed, into existing directories
+    set archive [lindex $archives end]
+    set dest [file join $dir selected]
+    file mkdir $dest/opt/local/bin
+    file attributes $dest/opt/local/bin -permissions 0711
+    set missing [archive extract \
+        -files {/opt/local/bin/tool /opt/local/bin/hardlink /opt/local/share/doc/big /opt/local/missing} \
+        -rename {/opt/local/share/doc/big /opt/local/share/doc/big.new /opt/local/missing /x} \
+        $archive $dest]
+    check {$missing eq "/opt/local/missing"}
+    check {[read_file $dest/opt/local/bin/tool] eq "#!/bin/sh\necho tool\n"}
+    check {[read_file $dest/opt/local/share/doc/big.new] eq $big}
+    file stat $dest/opt/local/bin/tool tool
+    file stat $dest/opt/local/bin/hardlink hardlink
+    check {$tool(ino) == $hardlink(ino)}
+    check {![file exists $dest/opt/local/share/doc/big]}
+    check {![file exists $dest/opt/local/share/doc/empty]}
+    check {![file exists $dest/opt/local/bin/link]}
+    check {![file exists $dest/+CONTENTS]}
+    check {![file exists $dest/x]}
+    check {[file attributes $dest/opt/local/bin -permissions] eq "040711"}
+    check {[file attributes $dest/opt/local/share/doc -permissions] eq "040700"}
+
+    # hard links need the member they link to
+    set dest [file join $dir hardlink]
+    check {[catch {archive extract -files {/opt/local/bin/tool} -created created $dir/test.tar $dest} result]}
+    check {[string match "*was not extracted" $result]}
+
+    # members beneath a symbolic link of the archive would be written where
+    # it points to
+    set hostile [file join $dir hostile]
+    file mkdir $hostile/link $hostile/dir/a/d $dir/outside
+    file link -symbolic $hostile/link/a $dir/outside
+    write_file $hostile/dir/a/x "hostile"
+    exec tar -C $hostile/link -cf $dir/hostile.tar a
+    exec tar -C $hostile/dir -rf $dir/hostile.tar a/x
+    exec tar -C $hostile/link -cf $dir/hostiledir.tar a
+    exec tar -C $hostile/dir -rf $dir/hostiledir.tar a/d
+    foreach archive [list $dir/hostile.tar $dir/hostiledir.tar] {
+        foreach files {{} {/a /a/x /a/d}} {
+            set dest [file join $dir symlink]
+            file delete -force $dest
+            file mkdir $dest
+            if {$files eq ""} {
+                check {[catch {archive extract $archive $dest} result]}
+            } else {
+                check {[catch {archive extract -files $files $archive $dest} result]}
+            }
+            check {[string match "*: $dest/a is a symbolic link" $result]}
+            check {[glob -nocomplain -directory $dir/outside *] eq ""}
+        }
+    }
+    # or beneath another name of one, as links are recognized by inode
+    file mkdir $hostile/hard $hostile/dir/b
+    file link -symbolic $hostile/hard/a $dir/outside
+    exec ln -P $hostile/hard/a $hostile/hard/b
+    write_file $hostile/dir/b/x "hostile"
+    exec tar -C $hostile/hard -cf $dir/hostilehard.tar a b
+    exec tar -C $hostile/dir -rf $dir/hostilehard.tar b/x
+    set dest [file join $dir symlinkhard]
+    file mkdir $dest
+    check {[catch {archive extract $dir/hostilehard.tar $dest} result]}
+    check {[string match "*: $dest/b is a symbolic link" $result]}
+    check {[glob -nocomplain -directory $dir/outside *] eq ""}
+    # and on case-insensitive file systems, beneath one whose name differs
+    # only in case
+    file mkdir $hostile/case
+    file link -symbolic $hostile/case/A $dir/outside
+    exec tar -C $hostile/case -cf $dir/hostilecase.tar A
+    exec tar -C $hostile/dir -rf $dir/hostilecase.tar a/x
+    set dest [file join $dir symlinkcase]
+    file mkdir $dest
+    if {[fs_case_sensitive $dest]} {
+        archive extract $dir/hostilecase.tar $dest
+        check {[file isfile $dest/a/x]}
+    } else {
+        check {[catch {archive extract $dir/hostilecase.tar $dest} result]}
+        check {[string match "*: $dest/a is a symbolic link" $result]}
+    }
+    check {[glob -nocomplain -directory $dir/outside *] eq ""}
+
+    # existing files are not overwritten, and what was created is reported
+    set dest [file join $dir conflict]
+    file mkdir $dest/opt/local/share/doc
+    write_file $dest/opt/local/share/doc/empty "mine"
+    check {[catch {archive extract -created created $dir/test.tar $dest} result]}
+    check {[string match "*/opt/local/share/doc/empty: file already exists" $result]}
+    check {[read_file $dest/opt/local/share/doc/empty] eq "mine"}
+    check {[llength $created] > 0}
+    foreach path $created {
+        check {[file exists $path] || [file type $path] eq "link"}
+    }
+    check {[lsearch -exact $created $dest/opt/local/share/doc/empty] == -1}
+
+    # broken archives
+    set chan [open $dir/test.tar r]
+    fconfigure $chan -translation binary
+    set data [read $chan]
+    close $chan
+    foreach length [list [expr {512 * 3 + 100}] [expr {[string length $data] / 2}]] {
+        write_file $dir/truncated.tar [string range $data 0 $length-1]
+        check {[catch {archive extract $dir/truncated.tar [file join $dir truncated$length]} result]}
+        check {[string match "Could not read archive: *truncated*" $result]}
+    }
+    write_file $dir/garbage.tar [string repeat "garbage " 200]
+    check {[catch {archive extract $dir/garbage.tar [file join $dir garbage]} result]}
+    check {[string match "Could not read archive: *" $result]}
+    if {[lsearch -glob $archives *.tgz] != -1} {
+        write_file $dir/truncated.tgz [string range [read_file $dir/test.tgz] 0 1000]
+        check {[catch {archive extract $dir/truncated.tgz [file join $dir truncatedgz]} result]}
+        check {[string match "Could not read archive: *" $result]}
+    }
+    check {[catch {archive extract $dir/missing.tar $dir}]}
+    check {[catch {archive extract -rename {a} $dir/test.tar $dir}]}
+    check {[catch {archive extract -bogus x $dir/test.tar $dir}]}
+    check {[catch {archive extract}]}
+
+    # reading single members
+    foreach archive $archives {
+        check {[archive read $archive ./+CONTENTS] eq "@name test-1.0_0\n"}
+    }
+    check {[catch {archive read $dir/test.tar ./missing} result]}
+    check {$result eq "./missing not found in $dir/test.tar"}
+
+    # creating archives, read back by the command itself and by tar
+    set created_archives [list $dir/created.tar]
+    if {[archive supported $dir/created.tzst]} {
+        lappend created_archives $dir/created.tzst $dir/threaded.tzst
+    }
+    foreach archive $created_archives {
+        if {[string match *threaded* $archive]} {
+            archive create -threads 4 -level 3 -blocksize 65536 $archive $src
+        } else {
+            archive create $archive $src
+        }
+        check {[archive read $archive ./+CONTENTS] eq "@name test-1.0_0\n"}
+        check {[archive read $archive ./opt/local/$long/file] eq "long"}
+        set dest [file join $dir recreated]
+        file delete -force $dest
+        file mkdir $dest
+        archive extract $archive $dest
+        check {[read_file $dest/opt/local/bin/tool] eq "#!/bin/sh\necho tool\n"}
+        check {[file attributes $dest/opt/local/bin/tool -permissions] eq "00755"}
+        check {[read_file $dest/opt/local/share/doc/big] eq $big}
+        check {[file mtime $dest/opt/local/share/doc/big] == 1000000000}
+        check {[file attributes $dest/opt/local/share/doc -permissions] eq "040700"}
+        check {[file mtime $dest/opt/local/share/doc] == 1000000000}
+        check {[file readlink $dest/opt/local/bin/link] eq "tool"}
+        file stat $dest/opt/local/bin/tool tool
+        file stat $dest/opt/local/bin/hardlink hardlink
+        check {$tool(ino) == $hardlink(ino)}
+        if {[string match *.tar $archive]} {
+            set members [split [exec tar -tf $archive] \n]
+            check {[lsearch -exact $members ./opt/local/$long/file] != -1}
+            check {[lsearch -exact $members ./+CONTENTS] < [lsearch -exact $members ./opt/]}
+        } elseif {[auto_execok zstd] ne ""} {
+            check {[exec zstd -dc $archive] eq [exec cat $dir/created.tar]}
+        }
+    }
+    if {[llength $created_archives] > 1} {
+        # the seek table lists every frame of the threaded archive
+        set data [read_file $dir/threaded.tzst]
+        binary scan [string range $data end-8 end] iucu frames descriptor
+        check {$frames > 1 && $descriptor == 0}
+        binary scan [string range $data end-3 end] iu magic
+        check {$magic == 0x8F92EAB1}
+    }
+
+    # the members describing the port come first, in compressed archives in
+    # frames of their own that can be read without the rest
+    set meta [file join $dir meta]
+    file mkdir $meta/opt/local
+    write_file $meta/+CONTENTS "@name meta-1.0_0\n"
+    write_file $meta/+DESC "description\n"
+    write_file $meta/%early "early"
+    write_file $meta/opt/local/big $big
+    archive create $dir/meta.tar $meta
+    check {[lrange [split [exec tar -tf $dir/meta.tar] \n] 0 3] eq {./ ./+CONTENTS ./+DESC ./%early}}
+    if {[archive supported $dir/meta.tzst]} {
+        archive create -blocksize 65536 $dir/meta.tzst $meta
+        set data [read_file $dir/meta.tzst]
+        binary scan [string range $data end-8 end] iu frames
+        set table [string range $data end-[expr {8 * $frames + 8}] end-9]
+        binary scan $table iuiu metadata_length metadata_size
+        check {$metadata_size < 65536}
+        binary scan [string range $table end-7 end] iuiu index_length index_size
+        check {$index_length == 16 && $index_size == 0}
+        # damage the frames after the metadata
+        set damaged [string range $data 0 [expr {$metadata_length + 99}]]
+        append damaged [string repeat x 200]
+        append damaged [string range $data [expr {$metadata_length + 300}] end]
+        write_file $dir/damaged.tzst $damaged
+        check {[archive read $dir/damaged.tzst ./+CONTENTS] eq "@name meta-1.0_0\n"}
+        check {[archive read $dir/damaged.tzst ./+DESC] eq "description\n"}
+        check {[catch {archive read $dir/damaged.tzst ./+MISSING} result]}
+        check {[string match "*not found in*" $result]}
+        check {[catch {archive read $dir/damaged.tzst ./%early} result]}
+        check {[string match "Could not read archive: *" $result]}
+        check {[catch {archive read $dir/damaged.tzst ./opt/local/big}]}
+        check {[archive read $dir/meta.tzst ./opt/local/big] eq $big}
+    }
+
+    check {[catch {archive create $dir/created.xar $src} result]}
+    check {[string match "*unsupported archive type" $result]}
+    check {![file exists $dir/created.xar]}
+    check {[catch {archive create $dir/missing.tar $dir/missing}]}
+    check {![file exists $dir/missing.tar]}
+    check {[catch {archive create -threads 0 $dir/created.tar $src}]}
+
+    file delete -force $dir
+}
+
+main $argv
@@ -0,0 +1,148 @@
+# Benchmark comparing the binary PortIndex against the text PortIndex and
+# its quick index, the way mportlookup and mportlistall use them.
+# Not run as part of the test suite.
+# Syntax:
+# tclsh binindex-bench.tcl <Pextlib name> ?ports? ?lookups?
+
+proc write_index {path count} {
+    set fd [open $path w]
+    set quick {}
+    for {set i 0} {$i < $count} {incr i} {
+        set name port-$i
+        set info [list name $name version 1.$i.0 revision 0 epoch 0 \
+            portdir category/$name categories {category devel} \
+            maintainers {{example.org:someone @someone} openmaintainer} \
+            platforms darwin license {BSD MIT} homepage https://example.org/$name \
+            description "The $name package $i" \
+            long_description "$name is a package that does [string repeat {many things } 10]" \
+            variants {debug universal} depends_build {port:pkgconfig port:cmake} \
+            depends_lib [list port:port-[expr {$i / 2}] port:zlib path:lib/libssl.dylib:openssl]]
+        append quick "$name [tell $fd]\n"
+        puts $fd [list $name [expr {[string length $info] + 1}]]
+        puts $fd $info
+    }
+    close $fd
+    set fd [open ${path}.quick w]
+    puts -nonewline $fd $quick
+    close $fd
+}
+
+proc usec {script} {
+    set start [clock microseconds]
+    uplevel 1 $script
+    return [expr {[clock microseconds] - $start}]
+}
+
+proc report {what text binary} {
+    puts [format "%-32s %10.1f ms %10.1f ms %8.1fx" $what \
+        [expr {$text / 1000.0}] [expr {$binary / 1000.0}] \
+        [expr {$binary > 0 ? double($text) / $binary : 0}]]
+}
+
+proc main {pextlibname {ports 25000} {lookups 500}} {
+    load $pextlibname
+
+    set dir [file join [pwd] binindex-bench]
+    file delete -force $dir
+    file mkdir $dir
+    set index [file join $dir PortIndex]
+    write_index $index $ports
+    set names {}
+    for {set i 0} {$i < $lookups} {incr i} {
+        lappend names port-[expr {($i * 7919) % $ports}]
+    }
+
+    set create [usec {binindex create $index ${index}.bin}]
+    puts "$ports ports, [file size $index] bytes of PortIndex,\
+        [file size ${index}.bin] bytes of binary index"
+    puts [format "binary index created in %.1f ms\n" [expr {$create / 1000.0}]]
+    puts [format "%-32s %13s %13s %9s" "" text binary speedup]
+
+    # startup: load the quick index into an array vs. map the binary index
+    set text_load [usec {
+        set fd [open ${index}.quick r]
+        foreach entry [split [read $fd] \n] {
+            set quick_index(0,[lindex $entry 0]) [lindex $entry 1]
+        }
+        close $fd
+    }]
+    set bin_load [usec {
+        set idx [binindex open ${index}.bin $index]
+    }]
+    report "startup" $text_load $bin_load
+
+    # a port outdated sized batch of lookups
+    set text_lookup [usec {
+        foreach name $names {
+            set fd [open $index r]
+            seek $fd $quick_index(0,[string tolower $name])
+            gets $fd line
+            set line [read $fd [lindex $line 1]]
+            array set portinfo $line
+            close $fd
+        }
+    }]
+    set bin_lookup [usec {
+        foreach name $names {
+            lassign [$idx lookup $name] name line
+            array set portinfo $line
+        }
+    }]
+    report "$lookups lookups" $text_lookup $bin_lookup
+    report "startup + $lookups lookups" [expr {$text_load + $text_lookup}] \
+        [expr {$bin_load + $bin_lookup}]
+
+    # listing everything
+    set text_list [usec {
+        set fd [open $index r]
+        set matches {}
+        while {[gets $fd line] >= 0} {
+            set name [lindex $line 0]
+            set line [read $fd [lindex $line 1]]
+            array unset portinfo
+            array set portinfo $line
+            lappend matches $name $line
+        }
+        close $fd
+    }]
+    set bin_list [usec {
+        set matches {}
+        foreach {name line} [$idx list] {
+            lappend matches $name $line
+        }
+    }]
+    report "list all" $text_list $bin_list
+
+    # searching a description, like port search --description
+    set text_search [usec {
+        set fd [open $index r]
+        set matches {}
+        while {[gets $fd line] >= 0} {
+            set name [lindex $line 0]
+            set line [read $fd [lindex $line 1]]
+            array unset portinfo
+            array set portinfo $line
+            if {[info exists portinfo(description)]
+                    && [string match -nocase "*package 1234*" $portinfo(description)]} {
+                lappend matches $name $line
+            }
+        }
+        close $fd
+    }]
+    set bin_search [usec {
+        set matches {}
+        lassign [$idx candidates description glob "*package 1234*"] filtered candidates
+        foreach entryno $candidates {
+            lassign [$idx entry $entryno] name line
+            if {[string match -nocase "*package 1234*" [dict get $line description]]} {
+                lappend matches $name $line
+            }
+        }
+    }]
+    report "description search" $text_search $bin_search
+
+    $idx close
+    file delete -force $dir
+}
+
+main {*}$argv
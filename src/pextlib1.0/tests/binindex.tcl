@@ -0,0 +1,242 @@
+# Test file for Pextlib's binindex command.
+# Syntax:
+# tclsh binindex.tcl <Pextlib name>
+
+proc check {cond} {
+    if {![uplevel 1 [list expr $cond]]} {
+        puts "FAILED: $cond"
+        exit 1
+    }
+}
+
+# write a PortIndex the way portindex does
+proc write_index {path ports} {
+    set fd [open $path w]
+    foreach {name info} $ports {
+        puts $fd [list $name [expr {[string length $info] + 1}]]
+        puts $fd $info
+    }
+    close $fd
+}
+
+# the matching done by mportsearch
+proc matches {pattern target nocase matchstyle} {
+    switch -- $matchstyle {
+        exact {
+            if {$nocase} {
+                return [string equal -nocase $pattern $target]
+            }
+            return [string equal $pattern $target]
+        }
+        glob {
+            if {$nocase} {
+                return [string match -nocase $pattern $target]
+            }
+            return [string match $pattern $target]
+        }
+        regexp {
+            if {$nocase} {
+                return [regexp -nocase -- $pattern $target]
+            }
+            return [regexp -- $pattern $target]
+        }
+    }
+}
+
+# search by checking every entry
+proc linear_search {idx field matchstyle pattern nocase} {
+    set result {}
+    set entryno 0
+    foreach {name info} [$idx list] {
+        if {$field eq "name"} {
+            set target $name
+        } elseif {[dict exists $info $field]} {
+            set target [dict get $info $field]
+        } else {
+            incr entryno
+            continue
+        }
+        if {[matches $pattern $target $nocase $matchstyle]} {
+            lappend result $entryno
+        }
+        incr entryno
+    }
+    return $result
+}
+
+# search by checking only the candidates from the search index
+proc indexed_search {idx field matchstyle pattern nocase} {
+    lassign [$idx candidates $field $matchstyle $pattern] filtered candidates
+    if {!$filtered} {
+        return [linear_search $idx $field $matchstyle $pattern $nocase]
+    }
+    set result {}
+    foreach entryno $candidates {
+        lassign [$idx entry $entryno] name info
+        if {$field eq "name"} {
+            set target $name
+        } elseif {[dict exists $info $field]} {
+            set target [dict get $info $field]
+        } else {
+            continue
+        }
+        if {[matches $pattern $target $nocase $matchstyle]} {
+            lappend result $entryno
+        }
+    }
+    return $result
+}
+
+# a corpus of ports with descriptions made up of random words
+proc write_corpus {path count} {
+    set words {lib LIB libfoo zlib compress compression Compressed data \
+        database data*base python py3 py27 c++ C++ gnu GNU x11 X11 tool \
+        toolkit a ab abc aab aaab abab foo bar foobar fooobar xyz x.z xz \
+        "\u212a" kelvin K\u00e9 caf\u00e9 CAF\u00c9 [regexp] {[brackets]} \
+        "a|b" dylib .dylib perl5 p5-dbi rust go-lang}
+    expr {srand(42)}
+    set ports {}
+    for {set i 0} {$i < $count} {incr i} {
+        set desc {}
+        for {set j 0} {$j < 1 + int(rand() * 8)} {incr j} {
+            lappend desc [lindex $words [expr {int(rand() * [llength $words])}]]
+        }
+        set info [list name port$i description [join $desc] \
+            long_description "[join $desc] and more [lindex $words [expr {$i % [llength $words]}]]" \
+            categories [lrange $words [expr {$i % 7}] [expr {$i % 7 + 1}]]]
+        if {$i % 3 == 0} {
+            lappend info maintainers [list [lindex $words [expr {$i % 11}]]@example.org openmaintainer]
+        }
+        if {$i % 5 == 0} {
+            lappend info variants {universal debug python27}
+        }
+        lappend ports [lindex $words [expr {$i % [llength $words]}]]-$i $info
+    }
+    write_index $path $ports
+}
+
+proc main {pextlibname} {
+    load $pextlibname
+
+    set dir [file join [pwd] binindex-test]
+    file delete -force $dir
+    file mkdir $dir
+    set text [file join $dir PortIndex]
+    set bin ${text}.bin
+
+    set ports [list \
+        zlib [list name zlib version 1.2.11 portdir archivers/zlib description {General purpose data compression library}] \
+        Foo-Bar [list name Foo-Bar version 1.0 portdir devel/Foo-Bar long_description "braces {and} \"quotes\" \\\\ and ünïcödé" depends_lib {port:zlib path:lib/libfoo.dylib:foo}] \
+        empty {} \
+        zlib [list name zlib version 1.3 portdir archivers/zlib]]
+    write_index $text $ports
+
+    binindex create $text $bin
+    set idx [binindex open $bin $text]
+    check {[$idx count] == 4}
+    check {[$idx names] eq {zlib Foo-Bar empty zlib}}
+
+    # lookups are case-insensitive, and the last of several entries with the
+    # same name wins as with the quick index
+    check {[$idx lookup foo-bar] eq [list Foo-Bar [lindex $ports 3]]}
+    check {[$idx lookup FOO-BAR] eq [list Foo-Bar [lindex $ports 3]]}
+    check {[dict get [lindex [$idx lookup zlib] 1] version] eq "1.3"}
+    check {[$idx lookup empty] eq {empty {}}}
+    check {[$idx lookup nonexistent] eq {}}
+    check {[$idx entry 0] eq [list zlib [lindex $ports 1]]}
+    check {[catch {$idx entry 4}] == 1}
+
+    # list returns the same as reading the text index
+    set expected {}
+    set fd [open $text r]
+    while {[gets $fd line] >= 0} {
+        lappend expected [lindex $line 0] [read $fd [lindex $line 1]]
+    }
+    close $fd
+    set got [$idx list]
+    check {[llength $got] == [llength $expected]}
+    foreach {name info} $got {ename einfo} $expected {
+        check {$name eq $ename}
+        array unset a
+        array unset b
+        array set a $info
+        array set b $einfo
+        check {[lsort [array get a]] eq [lsort [array get b]]}
+    }
+
+    $idx close
+    check {[info commands $idx] eq {}}
+
+    # a changed text index makes the binary one stale
+    write_index $text [lrange $ports 0 5]
+    check {[catch {binindex open $bin $text}] == 1}
+    check {$::errorCode eq {BININDEX STALE}}
+    set idx [binindex open $bin]
+    check {[$idx count] == 4}
+    $idx close
+    binindex create $text $bin
+    set idx [binindex open $bin $text]
+    check {[$idx count] == 3}
+    check {[$idx lookup zlib] eq [list zlib [lindex $ports 1]]}
+    $idx close
+
+    # searches using the search index find the same ports as checking
+    # every entry
+    write_corpus $text 500
+    binindex create $text $bin
+    set idx [binindex open $bin $text]
+    set patterns {
+        exact {compress zlib foobar python {abc xyz} X11 caf\u00e9 toolkit}
+        glob {*lib* *LIB* *compress* lib* *x?z* {*[abc]de*} {*data\*base*}
+              *py3* *c++* {*[brackets]*} *caf\u00e9* *k* *kelvin* *a|b* ""}
+        regexp {lib ^lib compress(ion)? (foo)+bar fo+bar fooo?bar ab*c a{2}b
+                {\.dylib} {[[:alpha:]]+lib} x|y (?i)lib {\mlib} c\+\+ {x.z}
+                {(data)*base} {a(b(c))} {[\]x]yz} {***=c++} perl5 kelvin
+                caf\u00e9 {ba(r} {}}
+    }
+    set filtered_searches 0
+    foreach field {name description long_description maintainers categories variants portdir} {
+        foreach {matchstyle list} $patterns {
+            foreach pattern $list {
+                foreach nocase {0 1} {
+                    if {[catch {linear_search $idx $field $matchstyle $pattern $nocase} expected]} {
+                        # invalid regular expressions fail either way
+                        check {[catch {indexed_search $idx $field $matchstyle $pattern $nocase}] == 1}
+                        continue
+                    }
+                    set got [indexed_search $idx $field $matchstyle $pattern $nocase]
+                    if {$got ne $expected} {
+                        puts "FAILED: $field $matchstyle $pattern $nocase: $got != $expected"
+                        exit 1
+                    }
+                    if {[lindex [$idx candidates $field $matchstyle $pattern] 0]} {
+                        incr filtered_searches
+                    }
+                }
+            }
+        }
+    }
+    # most of these can use the index
+    check {$filtered_searches > 200}
+    lassign [$idx candidates description glob *compress*] filtered candidates
+    check {$filtered && [llength $candidates] < 250}
+    check {[$idx candidates portdir glob *lib*] eq {0 {}}}
+    check {[$idx candidates description regexp a|b] eq {0 {}}}
+    $idx close
+
+    # garbage is rejected
+    set fd [open $bin w]
+    puts $fd "not a binary index, but long enough to hold a header..."
+    close $fd
+    check {[catch {binindex open $bin $text}] == 1}
+    check {$::errorCode eq {BININDEX CORRUPT}}
+    set fd [open $text w]
+    puts $fd "zlib 1000"
+    puts $fd "name zlib"
+    close $fd
+    check {[catch {binindex create $text $bin}] == 1}
+
+    file delete -force $dir
+}
+
+main $argv
@@ -0,0 +1,72 @@
+# Test file for Pextlib's checksum command.
+# Requires r/w access to /tmp/
+# Syntax:
+# tclsh checksum.tcl <Pextlib name>
+
+proc check {cond} {
+    if {![uplevel 1 [list expr $cond]]} {
+        puts "FAILED: $cond"
+        exit 1
+    }
+}
+
+proc main {pextlibname} {
+    load $pextlibname
+
+    set dir [file join /tmp macports-pextlib-testchecksum-[pid]]
+    file mkdir $dir
+
+    # files of different sizes, one larger than the read buffer
+    set paths {}
+    foreach size {0 1 100000 3000000} {
+        set path [file join $dir file$size]
+        set chan [open $path w]
+        fconfigure $chan -translation binary
+        for {set i 0} {$i < $size} {incr i 1000} {
+            puts -nonewline $chan [string range [string repeat "$i " 1000] 0 [expr {min(1000, $size - $i) - 1}]]
+        }
+        close $chan
+        lappend paths $path
+    }
+
+    foreach path $paths {
+        set expected [list sha256 [sha256 file $path] rmd160 [rmd160 file $path] size [file size $path]]
+        check {[checksum file $path] eq $expected}
+        check {[checksum file -types {size md5 sha1} $path] eq
+            [list size [file size $path] md5 [md5 file $path] sha1 [sha1 file $path]]}
+        lappend all $expected
+    }
+
+    # the same results with any number of threads
+    foreach threads {1 2 8} {
+        check {[checksum files -threads $threads $paths] eq $all}
+    }
+    check {[checksum files {}] eq ""}
+
+    check {[catch {checksum file [file join $dir missing]} result]}
+    check {[string match "Could not read file: *" $result]}
+    check {[catch {checksum files -threads 2 [list [lindex $paths 0] $dir]}]}
+    check {[catch {checksum file -types {sha512} [lindex $paths 0]}]}
+    check {[catch {checksum file -types {} [lindex $paths 0]}]}
+    check {[catch {checksum file -threads 2 [lindex $paths 0]}]}
+    check {[catch {checksum files -threads 0 $paths}]}
+    check {[catch {checksum file}]}
+
+    # the fingerprint changes with the file's times, to the nanosecond
+    # where the file system records them
+    set path [lindex $paths 1]
+    file stat $path stat
+    set fingerprint [checksum fingerprint $path]
+    check {[lrange $fingerprint 0 2] eq [list $stat(dev) $stat(ino) $stat(size)]}
+    check {[lindex $fingerprint 3] / 1000000000 == $stat(mtime)}
+    check {[lindex $fingerprint 4] / 1000000000 == $stat(ctime)}
+    check {[checksum fingerprint $path] eq $fingerprint}
+    file attributes $path -permissions 0600
+    check {[lindex [checksum fingerprint $path] 4] != [lindex $fingerprint 4]
+        || [lindex $fingerprint 4] % 1000000000 == 0}
+    check {[catch {checksum fingerprint [file join $dir missing]}]}
+
+    file delete -force $dir
+}
+
+main $argv
@@ -0,0 +1,169 @@
+# Test file for Pextlib's curl fetchmany, against a local HTTP server.
+# Syntax:
+# tclsh curl-fetchmany.tcl <Pextlib name>
+
+# HTTP/1.1 server run in a separate process, since curl fetchmany doesn't
+# return to the event loop. It serves /file<n> with n lines, /slow<n> the
+# same after a delay without blocking other connections, 404 for anything
+# else, and /stats with the number of connections it accepted. It prints its
+# port on startup.
+set server {
+    set connections 0
+    proc accept {chan addr port} {
+        global connections
+        incr connections
+        fconfigure $chan -translation {auto crlf} -buffering full
+        fileevent $chan readable [list request $chan]
+    }
+    proc request {chan} {
+        global connections
+        if {[gets $chan line] < 0} {
+            if {[eof $chan]} {
+                close $chan
+            }
+            return
+        }
+        set path [lindex $line 1]
+        # skip the headers
+        while {[gets $chan header] > 0} {}
+        if {[regexp {^/(file|slow)(\d+)$} $path -> type lines]} {
+            set body [string repeat "line\n" $lines]
+            if {$type eq "slow"} {
+                fileevent $chan readable {}
+                after 200 [list respond $chan "200 OK" $body]
+                return
+            }
+            set status "200 OK"
+        } elseif {$path eq "/stats"} {
+            set body $connections
+            set status "200 OK"
+        } else {
+            set body "not found"
+            set status "404 Not Found"
+        }
+        respond $chan $status $body
+    }
+    proc respond {chan status body} {
+        if {[catch {
+            puts $chan "HTTP/1.1 $status"
+            puts $chan "Content-Length: [string length $body]"
+            puts $chan ""
+            fconfigure $chan -translation {auto binary}
+            puts -nonewline $chan $body
+            flush $chan
+            fconfigure $chan -translation {auto crlf}
+            fileevent $chan readable [list request $chan]
+        }]} {
+            close $chan
+        }
+    }
+    set sock [socket -server accept -myaddr 127.0.0.1 0]
+    puts [lindex [fconfigure $sock -sockname] 2]
+    flush stdout
+    vwait forever
+}
+
+proc main {pextlibname} {
+    global server
+    load $pextlibname
+
+    set serverchan [open "|[list [info nameofexecutable] << $server]" r]
+    gets $serverchan port
+    set root http://127.0.0.1:$port
+    set dir [file join /tmp macports-pextlib-testcurl-[pid]]
+    file mkdir $dir
+
+    # all transfers succeed, each file gets the right contents
+    set transfers [list]
+    for {set i 1} {$i <= 6} {incr i} {
+        lappend transfers [list $root/slow$i $dir/file$i]
+    }
+    set results [curl fetchmany --max-host-connections 2 $transfers]
+    test "results" {$results eq [lrepeat 6 ""]}
+    for {set i 1} {$i <= 6} {incr i} {
+        test "size$i" {[file size $dir/file$i] == 5 * $i}
+    }
+
+    # connections were limited to 2 and are kept between calls
+    test "connections" {[connections $root $dir] == 2}
+    curl fetchmany [list [list $root/file1 $dir/file1] [list $root/file2 $dir/file2]]
+    test "reuse" {[connections $root $dir] == 2}
+
+    # a failed transfer doesn't affect the others
+    set results [curl fetchmany [list \
+        [list $root/file1 $dir/file1] \
+        [list $root/missing $dir/missing] \
+        [list $root/file2 $dir/nodir/file2] \
+        [list $root/file3 $dir/file3]]]
+    test "success" {[lindex $results 0] eq "" && [lindex $results 3] eq ""}
+    test "404" {[string match "*404*" [lindex $results 1]]}
+    test "nodir" {[lindex $results 2] ne ""}
+
+    # the progress callback is called for each transfer
+    set ::progress [list]
+    curl fetchmany --progress progress [list \
+        [list $root/file1000 $dir/file1] \
+        [list $root/file2000 $dir/file2]]
+    test "progress" {[lsort [lsearch -all -inline $::progress "* finish"]] eq {{0 finish} {1 finish}}}
+
+    # the urls of a transfer are tried in turn
+    set ::report [list]
+    set results [curl fetchmany --report report [list \
+        [list [list $root/missing $root/file4] $dir/file4]]]
+    test "fallback" {$results eq {{}} && [file size $dir/file4] == 20}
+    test "fallbackreport" {[lindex $::report 0 1] eq "error" && [lindex $::report 1 1] eq "ok"}
+
+    # the first url to deliver data wins the race, the others are cancelled
+    set ::report [list]
+    set results [curl fetchmany --candidates 2 --stagger 50 --report report [list \
+        [list [list $root/slow7 $root/file8] $dir/race]]]
+    test "race" {$results eq {{}} && [file size $dir/race] == 40}
+    test "racereport" {[lsort -index 1 $::report] eq [list \
+        [list $root/slow7 cancelled] [list $root/file8 ok]]}
+
+    # the digests are computed while writing
+    set results [curl fetchmany --candidates 2 --stagger 50 --digests digests [list \
+        [list [list $root/slow9 $root/file9] $dir/file9] \
+        [list $root/missing $dir/missing]]]
+    test "digests" {[lindex $digests 0] eq [list rmd160 [rmd160 file $dir/file9] \
+        sha256 [sha256 file $dir/file9] size 45] && [lindex $digests 1] eq ""}
+
+    # no url responds
+    set results [curl fetchmany --candidates 3 [list \
+        [list [list $root/missing $root/missing2] $dir/none] \
+        [list {} $dir/nourl]]]
+    test "nourl" {[string match "*404*" [lindex $results 0]] && [lindex $results 1] ne ""}
+
+    test "args" {[catch {curl fetchmany --max-host-connections}]}
+    test "pairs" {[catch {curl fetchmany [list [list $root/file1]]}]}
+    test "empty" {[curl fetchmany {}] eq ""}
+
+    exec kill [pid $serverchan]
+    catch {close $serverchan}
+    file delete -force $dir
+}
+
+proc connections {root dir} {
+    curl fetchmany [list [list $root/stats $dir/stats]]
+    set fd [open $dir/stats]
+    set connections [read $fd]
+    close $fd
+    return $connections
+}
+
+proc progress {index action args} {
+    lappend ::progress [list $index $action]
+}
+
+proc report {url status bytes seconds} {
+    lappend ::report [list $url $status]
+}
+
+proc test {test_name args} {
+    if {[catch {uplevel 1 expr $args} result] || !$result} {
+        puts "test $test_name failed: [uplevel 1 subst -nocommands $args] == $result"
+        exit 1
+    }
+}
+
+main $argv
@@ -0,0 +1,65 @@
+# Test file for Pextlib's dgraph command.
+# Syntax:
+# tclsh dgraph.tcl <Pextlib name>
+
+proc check {cond} {
+    if {![uplevel 1 [list expr $cond]]} {
+        puts "FAILED: $cond"
+        exit 1
+    }
+}
+
+proc main {pextlibname} {
+    load $pextlibname
+
+    # 0 uses 2, 1 requires 0, 2 has no dependencies, 3 requires a token
+    # nobody provides and 4 uses one.
+    set graph [dgraph create {
+        {A {} B}
+        {C A {}}
+        {B {} {}}
+        {D X {}}
+        {E {} {Y A}}
+    }]
+    check {[$graph next] == 2}
+    # next doesn't change anything
+    check {[$graph next] == 2}
+    $graph done 2 1
+    check {[$graph next] == 0}
+    $graph done 0 1
+    # 1 and 4 are eligible, 1 has fewer unmet uses tokens
+    check {[$graph next] == 1}
+    $graph done 1 0
+    check {[$graph next] == 4}
+    $graph done 4 1
+    check {[$graph next] == -1}
+    check {[$graph pending] eq {3}}
+    $graph close
+    check {[info commands $graph] eq ""}
+
+    # a failure makes dependents ineligible
+    set graph [dgraph create {{A {} {}} {B A {}}}]
+    $graph done 0 0
+    check {[$graph next] == -1}
+    check {[$graph pending] eq {1}}
+    $graph close
+
+    # started nodes stay pending but aren't returned by next
+    set graph [dgraph create {{A {} {}} {B {} {}} {C A {}}}]
+    $graph start 0
+    check {[$graph next] == 1}
+    $graph start 1
+    check {[$graph next] == -1}
+    check {[$graph pending] eq {0 1 2}}
+    $graph done 0 1
+    check {[$graph next] == 2}
+    $graph close
+
+    check {[catch {dgraph create {{A {}}}}]}
+    set graph [dgraph create {}]
+    check {[$graph next] == -1}
+    check {[catch {$graph done 0 1}]}
+    $graph close
+}
+
+main $argv
@@ -0,0 +1,63 @@
+# Benchmark of the digest commands over a file, reporting their throughput,
+# and of checksum against computing the same digests one at a time.
+# Not run as part of the test suite.
+# Syntax:
+# tclsh digests-bench.tcl <Pextlib name> ?megabytes? ?files?
+
+proc usec {script} {
+    set start [clock microseconds]
+    uplevel 1 $script
+    return [expr {[clock microseconds] - $start}]
+}
+
+proc report {what bytes usec} {
+    puts [format "%-40s %10.1f ms %10.1f MB/s" $what [expr {$usec / 1000.0}] \
+        [expr {$usec > 0 ? $bytes / double($usec) : 0}]]
+}
+
+proc main {pextlibname {megabytes 32} {files 8}} {
+    load $pextlibname
+
+    set dir [file join [pwd] digests-bench]
+    file delete -force $dir
+    file mkdir $dir
+    # pseudo random contents, written once and read from the page cache
+    set block {}
+    for {set i 0} {$i < 65536} {incr i} {
+        append block [format %c [expr {($i * 7919 + ($i >> 8)) & 0xff}]]
+    }
+    set paths {}
+    for {set f 0} {$f < $files} {incr f} {
+        set path [file join $dir file$f]
+        set fd [open $path w]
+        fconfigure $fd -translation binary
+        for {set i 0} {$i < $megabytes * 16 / $files} {incr i} {
+            puts -nonewline $fd $block
+        }
+        close $fd
+        lappend paths $path
+    }
+    set path [lindex $paths 0]
+    set size [file size $path]
+    set total [expr {$size * $files}]
+    puts "$files files of $size bytes"
+    foreach path $paths {
+        sha256 file $path
+    }
+
+    foreach type {md5 sha1 rmd160 sha256} {
+        report "$type file" $size [usec {$type file $path}]
+    }
+    report "sha256 file + rmd160 file" $size [usec {
+        sha256 file $path
+        rmd160 file $path
+    }]
+    report "checksum file" $size [usec {checksum file $path}]
+    report "checksum files, $files files" $total [usec {checksum files $paths}]
+    report "checksum files, $files files, $files threads" $total \
+        [usec {checksum files -threads $files $paths}]
+
+    file delete -force $dir
+}
+
+main {*}$argv
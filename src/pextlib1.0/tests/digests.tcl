@@ -0,0 +1,80 @@
+# Known answer tests for Pextlib's sha256 and rmd160 commands and the
+# checksum command using them, including messages around block boundaries.
+# Requires r/w access to /tmp/
+# Syntax:
+# tclsh digests.tcl <Pextlib name>
+
+proc check {cond} {
+    if {![uplevel 1 [list expr $cond]]} {
+        puts "FAILED: [uplevel 1 [list subst -nocommands $cond]]"
+        exit 1
+    }
+}
+
+proc main {pextlibname} {
+    load $pextlibname
+
+    # message, sha256, rmd160
+    set vectors [list \
+        "" \
+        e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855 \
+        9c1185a5c5e9fc54612808977ee8f548b2258d31 \
+        abc \
+        ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad \
+        8eb208f7e05d987a9b044a8e98c6b087f15a0bfc \
+        abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq \
+        248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1 \
+        12a053384a9c0c88e405a06c27dcf49ada62eb2b \
+        abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu \
+        cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1 \
+        6f3fa39b6b503c384f919a49a7aa5c2c08bdfb45 \
+        [string repeat a 55] \
+        9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318 \
+        0d8a8c9063a48576a7c97e9f95253a6e53ff6765 \
+        [string repeat a 56] \
+        b35439a4ac6f0948b6d6f9e3c6af0f5f590ce20f1bde7090ef7970686ec6738a \
+        e72334b46c83cc70bef979e15453706c95b888be \
+        [string repeat a 63] \
+        7d3e74a05d7db15bce4ad9ec0658ea98e3f06eeecf16b4c6fff2da457ddc2f34 \
+        e640041293fe663b9bf3f8c21ffecac03819e6b2 \
+        [string repeat a 64] \
+        ffe054fe7ae0cb6dc65c3af9b61d5209f439851db43d0ba5997337df154668eb \
+        9dfb7d374ad924f3f88de96291c33e9abed53e32 \
+        [string repeat a 65] \
+        635361c48bb9eab14198e76ea8ab7f1a41685d6ad62aa9146d301d4f17eb0ae0 \
+        99724bb11811e7166af38f671b6a082d8ab4960b \
+        [string repeat a 119] \
+        31eba51c313a5c08226adf18d4a359cfdfd8d2e816b13f4af952f7ea6584dcfb \
+        23e398ff2bac815aa1bbb57ca2a669c841872919 \
+        [string repeat a 120] \
+        2f3d335432c70b580af0e8e1b3674a7c020d683aa5f73aaaedfdc55af904c21c \
+        c476770a6dae31fcee8d25efe6559a05c8024595 \
+        [string repeat a 1000000] \
+        cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0 \
+        52783243c1697bdbe16d37f97f68f08325dc1528]
+
+    set dir [file join /tmp macports-pextlib-testdigests-[pid]]
+    file mkdir $dir
+    set paths {}
+    set expected {}
+    set i 0
+    foreach {message sha256 rmd160} $vectors {
+        set path [file join $dir message[incr i]]
+        set chan [open $path w]
+        fconfigure $chan -translation binary
+        puts -nonewline $chan $message
+        close $chan
+
+        check {[sha256 file $path] eq $sha256}
+        check {[rmd160 file $path] eq $rmd160}
+        check {[rmd160 string $message] eq $rmd160}
+        check {[checksum file -types {sha256 rmd160} $path] eq [list sha256 $sha256 rmd160 $rmd160]}
+        lappend paths $path
+        lappend expected [list sha256 $sha256 rmd160 $rmd160]
+    }
+    check {[checksum files -types {sha256 rmd160} -threads 4 $paths] eq $expected}
+
+    file delete -force $dir
+}
+
+main $argv
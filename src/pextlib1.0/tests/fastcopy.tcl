@@ -0,0 +1,136 @@
+# Test file for Pextlib's fastcopy command.
+# Requires r/w access to /tmp/. Also copies to and from /dev/shm if it is a
+# writable directory, and, when run as root with mkfs.ext4 and loop devices
+# available, to and from an ext4 image mounted for the test.
+# Syntax:
+# tclsh fastcopy.tcl <Pextlib name>
+
+# fails with an error rather than exiting, so that the image is unmounted
+proc check {cond} {
+    if {![uplevel 1 [list expr $cond]]} {
+        error "FAILED: $cond"
+    }
+}
+
+proc write_file {path contents} {
+    set chan [open $path w]
+    fconfigure $chan -translation binary
+    puts -nonewline $chan $contents
+    close $chan
+}
+
+proc read_file {path} {
+    set chan [open $path r]
+    fconfigure $chan -translation binary
+    set contents [read $chan]
+    close $chan
+    return $contents
+}
+
+# Mounts an ext4 file system image on mountpoint, returning 0 if that isn't
+# possible here.
+proc mount_image {image mountpoint} {
+    if {$::tcl_platform(os) ne "Linux" || [exec id -u] != 0
+            || [auto_execok mkfs.ext4] eq "" || [auto_execok mount] eq ""} {
+        return 0
+    }
+    set chan [open $image w]
+    seek $chan [expr {64 * 1024 * 1024 - 1}]
+    puts -nonewline $chan x
+    close $chan
+    file mkdir $mountpoint
+    if {[catch {exec mkfs.ext4 -q -F $image}]
+            || [catch {exec mount -o loop $image $mountpoint}]} {
+        return 0
+    }
+    return 1
+}
+
+# Copies files of various sizes from directory from to directory to with
+# every method, checking that the copies are the same as the originals.
+proc check_copies {from to} {
+    global methods
+    set block {}
+    for {set i 0} {$i < 997} {incr i} {
+        append block [format %c [expr {($i * 131 + ($i >> 3)) & 0xff}]]
+    }
+    foreach size {0 1 4095 4096 65537 300000 3145733} {
+        set contents [string range [string repeat $block [expr {$size / 997 + 1}]] 0 $size-1]
+        set source [file join $from source-$size]
+        write_file $source $contents
+        file attributes $source -permissions 0754
+        file mtime $source 1000000000
+        foreach method $methods {
+            set target [file join $to target-$size-$method]
+            file delete $target
+            set used [fastcopy -method $method $source $target]
+            check {[lsearch -exact $methods $used] >= [lsearch -exact $methods $method]}
+            check {[file size $target] == $size}
+            check {[read_file $target] eq $contents}
+            check {[file attributes $target -permissions] eq "00754"}
+            check {[file mtime $target] == 1000000000}
+            # cloned blocks are not shared any more once written to
+            set chan [open $target r+]
+            fconfigure $chan -translation binary
+            puts -nonewline $chan changed
+            close $chan
+            check {[read_file $source] eq $contents}
+            file delete $target
+        }
+        file delete $source
+    }
+}
+
+proc main {pextlibname} {
+    global methods
+    load $pextlibname
+
+    set methods {clone copy_file_range sendfile buffered}
+    set dir [file join /tmp macports-pextlib-testfastcopy-[pid]]
+    file delete -force $dir
+    file mkdir $dir/tmp
+    set dirs [list $dir/tmp]
+
+    set shm [file join /dev/shm macports-pextlib-testfastcopy-[pid]]
+    if {[file isdirectory /dev/shm] && ![catch {file mkdir $shm}]} {
+        lappend dirs $shm
+    }
+    set mountpoint [file join $dir mnt]
+    set mounted [mount_image [file join $dir ext4.img] $mountpoint]
+    if {$mounted} {
+        lappend dirs $mountpoint
+    }
+
+    set failed [catch {
+        # within and across file systems
+        foreach from $dirs {
+            foreach to $dirs {
+                check_copies $from $to
+            }
+        }
+
+        write_file $dir/tmp/source "source"
+        write_file $dir/tmp/existing "existing"
+        check {[catch {fastcopy $dir/tmp/source $dir/tmp/existing} result]}
+        check {[string match "error copying *: file already exists" $result]}
+        check {[read_file $dir/tmp/existing] eq "existing"}
+        check {[catch {fastcopy $dir/tmp/missing $dir/tmp/target} result]}
+        check {[string match "error copying *: no such file or directory" $result]}
+        check {[catch {fastcopy $dir/tmp $dir/tmp/target}]}
+        check {![file exists $dir/tmp/target]}
+        check {[catch {fastcopy $dir/tmp/source $dir/missing/target}]}
+        check {[catch {fastcopy -method bogus $dir/tmp/source $dir/tmp/target}]}
+        check {[catch {fastcopy $dir/tmp/source}]}
+        check {![file exists $dir/tmp/target]}
+    } result]
+
+    if {$mounted} {
+        exec umount $mountpoint
+    }
+    file delete -force $shm $dir
+    if {$failed} {
+        error $result $::errorInfo
+    }
+}
+
+main $argv
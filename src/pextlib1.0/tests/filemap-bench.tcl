@@ -0,0 +1,111 @@
+# Benchmark of Pextlib's filemap with a synthetic registry: memory used by
+# the map, setting, looking up and listing paths, saving and opening it,
+# and updating a saved map.
+# Run it with Pextlibs built from different versions of filemap.c to
+# compare them.
+# Not run as part of the test suite.
+# Syntax:
+# tclsh filemap-bench.tcl <Pextlib name> ?files? ?lookups?
+
+proc rss {} {
+    return [string trim [exec ps -o rss= -p [pid]]]
+}
+
+proc usec {script} {
+    set start [clock microseconds]
+    uplevel 1 $script
+    return [expr {[clock microseconds] - $start}]
+}
+
+proc report {what usec {count 0}} {
+    if {$count > 0} {
+        puts [format "%-24s %10.1f ms %10.3f us each" $what \
+            [expr {$usec / 1000.0}] [expr {double($usec) / $count}]]
+    } else {
+        puts [format "%-24s %10.1f ms" $what [expr {$usec / 1000.0}]]
+    }
+}
+
+# Paths of the files installed by a port, spread over a prefix the way
+# they usually are.
+proc port_files {port count} {
+    set files [list]
+    for {set i 0} {$i < $count} {incr i} {
+        switch [expr {$i % 4}] {
+            0 {lappend files /opt/local/include/$port/sub[expr {$i % 7}]/header-$i.h}
+            1 {lappend files /opt/local/lib/lib$port.$i.dylib}
+            2 {lappend files /opt/local/share/$port/data/[expr {$i % 13}]/file-$i.dat}
+            3 {lappend files /opt/local/share/man/man3/$port-$i.3.gz}
+        }
+    }
+    return $files
+}
+
+proc main {pextlibname {files 200000} {lookups 100000}} {
+    load $pextlibname
+
+    set db [file join [pwd] filemap-bench.db]
+    file delete -force $db ${db}.lock
+
+    set perport 200
+    set ports [expr {($files + $perport - 1) / $perport}]
+    set paths [list]
+    for {set p 0} {$p < $ports} {incr p} {
+        lappend paths port-$p [port_files port-$p $perport]
+    }
+    set lookup [list]
+    for {set i 0} {$i < $lookups} {incr i} {
+        set p [expr {($i * 7919) % $ports}]
+        lappend lookup [lindex [lindex $paths [expr {$p * 2 + 1}]] [expr {$i % $perport}]]
+    }
+
+    puts "$ports ports, [expr {$ports * $perport}] files, $lookups lookups"
+    set before [rss]
+    filemap open fm $db
+    set set_time [usec {
+        foreach {port portfiles} $paths {
+            foreach file $portfiles {
+                filemap set fm $file $port
+            }
+        }
+    }]
+    set after [rss]
+    puts [format "%-24s %10.1f MB" "memory" [expr {($after - $before) / 1024.0}]]
+    report "set" $set_time [expr {$ports * $perport}]
+    report "get" [usec {
+        foreach file $lookup {
+            filemap get fm $file
+        }
+    }] $lookups
+    report "exists (missing)" [usec {
+        foreach file $lookup {
+            filemap exists fm ${file}.missing
+        }
+    }] $lookups
+    report "list one port" [usec {
+        filemap list fm port-[expr {$ports / 2}]
+    }]
+    report "save" [usec {
+        filemap save fm
+    }]
+    filemap close fm
+    report "open" [usec {
+        filemap open fm $db readonly
+    }]
+    report "get after open" [usec {
+        filemap get fm [lindex $lookup 0]
+    }]
+    filemap close fm
+    filemap open fm $db
+    report "set one port and save" [usec {
+        foreach file [port_files port-new $perport] {
+            filemap set fm $file port-new
+        }
+        filemap save fm
+    }]
+    filemap close fm
+
+    file delete -force $db ${db}.lock
+}
+
+main {*}$argv
@@ -217,7 +217,43 @@ proc main {pextlibname} {
 
 	# delete the lock file as well.
 	file delete -force "/tmp/macports-pextlib-testmap.lock"
-	
+
+	# open a map saved in the format of version 1 (/bin and /opt/foo.h).
+	set theFile [open "/tmp/macports-pextlib-testmap" w]
+	fconfigure $theFile -translation binary
+	puts -nonewline $theFile [binary format a24a4 \
+		"org.darwinports.filemap" [binary format c4 {0 1 0 0}]]
+	puts -nonewline $theFile [binary format ca*xI 0 "" 2]
+	puts -nonewline $theFile [binary format ca*xa*x 1 "bin" "bar"]
+	puts -nonewline $theFile [binary format ca*xI 0 "opt" 1]
+	puts -nonewline $theFile [binary format ca*xa*x 1 "foo.h" "foo"]
+	close $theFile
+
+	filemap open testmap10 "/tmp/macports-pextlib-testmap"
+	if {[filemap get testmap10 "/opt/foo.h"] ne "foo"} {
+		puts {[filemap get testmap10 "/opt/foo.h"] ne "foo"}
+		exit 1
+	}
+	filemap set testmap10 "/opt/bar.h" "bar"
+	filemap close testmap10
+
+	# it's saved in the current format.
+	filemap open testmap11 "/tmp/macports-pextlib-testmap" readonly
+	set theList [filemap list testmap11 "bar"]
+	if {$theList ne {/bin /opt/bar.h}} {
+		puts {$theList ne {/bin /opt/bar.h}}
+		puts $theList
+		exit 1
+	}
+	if {[filemap get testmap11 "/opt/foo.h"] ne "foo"} {
+		puts {[filemap get testmap11 "/opt/foo.h"] ne "foo"}
+		exit 1
+	}
+	filemap close testmap11
+
+	file delete -force "/tmp/macports-pextlib-testmap"
+	file delete -force "/tmp/macports-pextlib-testmap.lock"
+
 	# create a RAM-based map.
 	filemap create testmap5
 	
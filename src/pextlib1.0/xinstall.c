@@ -73,6 +73,7 @@
 #include <tcl.h>
 
 #include "Pextlib.h"
+#include "fastcopy.h"
 
 #if HAVE_PATHS_H
 #include <paths.h>
@@ -920,16 +921,15 @@ create_newfile(Tcl_Interp *interp, const char *path, int target, struct stat *sb
 
 /*
  * copy --
- *	copy from one file to another
+ *	copy from one file to another, cloning it or having the kernel copy
+ *	it where possible (see fastcopy_fd)
  */
 static int
 copy(Tcl_Interp *interp, int from_fd, const char *from_name, int to_fd, const char *to_name,
      off_t size)
 {
-	int nr, nw;
 	int serrno;
-	char *p, buf[MAXBSIZE];
-	int done_copy;
+	fastcopy_method method = FASTCOPY_CLONE;
 
 	/* Rewind file descriptors. */
 	if (lseek(from_fd, (off_t)0, SEEK_SET) == (off_t)-1) {
@@ -946,52 +946,16 @@ copy(Tcl_Interp *interp, int from_fd, const char *from_name, int to_fd, const ch
 		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
 		return TCL_ERROR;
 	}
-	/*
-	 * Mmap and write if less than 8M (the limit is so we don't totally
-	 * trash memory on big files.  This is really a minor hack, but it
-	 * wins some CPU back.
-	 */
-	done_copy = 0;
-	if (size <= 8 * 1048576 && trymmap(from_fd) &&
-	    (p = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED,
-		    from_fd, (off_t)0)) != (char *)MAP_FAILED) {
-		if ((nw = write(to_fd, p, size)) != size) {
-			char errmsg[255];
-
-			serrno = errno;
-			(void)unlink(to_name);
-			errno = nw > 0 ? EIO : serrno;
-			snprintf(errmsg, sizeof errmsg, "%s: Write error on %s, %s",
-				 funcname, to_name, strerror(errno));
-			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
-			return TCL_ERROR;
-		}
-		done_copy = 1;
-	}
-	if (!done_copy) {
-		while ((nr = read(from_fd, buf, sizeof(buf))) > 0)
-			if ((nw = write(to_fd, buf, nr)) != nr) {
-				char errmsg[255];
-
-				serrno = errno;
-				(void)unlink(to_name);
-				errno = nw > 0 ? EIO : serrno;
-				snprintf(errmsg, sizeof errmsg, "%s: Write error on %s, %s",
-					 funcname, to_name, strerror(errno));
-				Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
-				return TCL_ERROR;
-			}
-		if (nr != 0) {
-			char errmsg[255];
+	if (fastcopy_fd(from_fd, to_fd, size, &method) != 0) {
+		char errmsg[255];
 
-			serrno = errno;
-			(void)unlink(to_name);
-			errno = serrno;
-			snprintf(errmsg, sizeof errmsg, "%s: Error on %s, %s",
-				 funcname, from_name, strerror(errno));
-			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
-			return TCL_ERROR;
-		}
+		serrno = errno;
+		(void)unlink(to_name);
+		errno = serrno;
+		snprintf(errmsg, sizeof errmsg, "%s: Error copying %s to %s, %s",
+			 funcname, from_name, to_name, strerror(errno));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
 	}
 	return TCL_OK;
 }
@@ -1005,8 +969,9 @@ strip(const char *to_name)
 {
 	const char *stripbin;
 	int serrno, status;
+	pid_t pid;
 
-	switch (fork()) {
+	switch (pid = fork()) {
 	case -1:
 		serrno = errno;
 		(void)unlink(to_name);
@@ -1021,7 +986,7 @@ strip(const char *to_name)
 		return;
 
 	default:
-		if (wait(&status) == -1 || status) {
+		if (waitpid(pid, &status, 0) == -1 || status) {
 			serrno = errno;
 			(void)unlink(to_name);
 			errno = serrno;
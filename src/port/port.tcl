@@ -50,7 +50,7 @@ package require Pextlib 1.0
 proc print_usage {{verbose 1}} {
     global cmdname
     set syntax {
-        [-bcdfknNopqRstuvy] [-D portdir|portname] [-F cmdfile] action [actionflags]
+        [-bcdfknNopqRstuvy] [-D portdir|portname] [-F cmdfile] [-J jobs] action [actionflags]
         [[portname|pseudo-portname|port-url] [@version] [+-variant]... [option=value]...]...
     }
 
@@ -772,10 +772,8 @@ proc get_outdated_ports {} {
             }
             if {$comp_result == 0} {
                 set regref [registry::open_entry $portname $installed_version $installed_revision $installed_variants $installed_epoch]
-                set os_platform_installed [registry::property_retrieve $regref os_platform]
-                set os_major_installed [registry::property_retrieve $regref os_major]
-                set cxx_stdlib_installed [registry::property_retrieve $regref cxx_stdlib]
-                set cxx_stdlib_overridden [registry::property_retrieve $regref cxx_stdlib_overridden]
+                lassign [registry::property_retrieve_many $regref {os_platform os_major cxx_stdlib cxx_stdlib_overridden}] \
+                    os_platform_installed os_major_installed cxx_stdlib_installed cxx_stdlib_overridden
                 if {${macports::cxx_stdlib} eq "libc++"} {
                     set wrong_stdlib libstdc++
                 } else {
@@ -3291,20 +3289,17 @@ proc action_installed { action portlist opts } {
             set nvariants ""
             if {[macports::ui_isset ports_verbose]} {
                 set regref [registry::open_entry $iname $iversion $irevision $ivariants [lindex $i 5]]
-                set nvariants [registry::property_retrieve $regref negated_variants]
+                lassign [registry::property_retrieve_many $regref {negated_variants os_platform os_major archs date}] \
+                    nvariants os_platform os_major archs date
                 if {$nvariants == 0} {
                     set nvariants ""
                 }
-                set os_platform [registry::property_retrieve $regref os_platform]
-                set os_major [registry::property_retrieve $regref os_major]
-                set archs [registry::property_retrieve $regref archs]
                 if {$os_platform != 0 && $os_platform ne "" && $os_major != 0 && $os_major ne ""} {
                     append extra " platform='$os_platform $os_major'"
                 }
                 if {$archs != 0 && $archs ne ""} {
                     append extra " archs='$archs'"
                 }
-                set date [registry::property_retrieve $regref date]
                 if {$date ne ""} {
                     append extra " date='[clock format $date -format "%Y-%m-%dT%H:%M:%S%z"]'"
                 }
@@ -4624,6 +4619,14 @@ proc parse_options { action ui_options_name global_options_name } {
                         }
                         break
                     }
+                    J {
+                        # Number of ports to build at once
+                        advance
+                        if {[moreargs]} {
+                            set global_options(ports_parallel_jobs) [lookahead]
+                        }
+                        break
+                    }
                     default {
                         print_usage; exit 1
                     }
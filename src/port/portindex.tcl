@@ -16,17 +16,24 @@ array set ui_options        [list ports_no_old_index_warning 1]
 array set global_options    [list]
 array set global_variations [list]
 set port_options            [list]
+set jobs 1
+set worker 0
+set script [file normalize [info script]]
 
 # Pass global options into mportinit
 mportinit ui_options global_options global_variations
+# Portfiles are evaluated for the index, which keeps track of what changed
+# itself
+set macports::portinfo_cache no
 
 # Standard procedures
 proc print_usage args {
     global argv0
-    puts "Usage: $argv0 \[-dfe\] \[-o output directory\] \[-p plat_ver_\[cxxlib_\]arch\] \[directory\]"
+    puts "Usage: $argv0 \[-dfe\] \[-j jobs\] \[-o output directory\] \[-p plat_ver_\[cxxlib_\]arch\] \[directory\]"
     puts "-d:\tOutput debugging information"
     puts "-f:\tDo a full re-index instead of updating"
     puts "-e:\tExit code indicates if ports failed to parse"
+    puts "-j:\tParse Portfiles in the given number of parallel processes"
     puts "-o:\tOutput all files to specified directory"
     puts "-p:\tPretend to be on another platform"
 }
@@ -45,11 +52,52 @@ proc _read_index {idx} {
     return [list $name $len $line]
 }
 
-proc _write_index {name len line} {
-    global fd
+# Records one step of indexing a port. With -j the steps are collected so
+# that they can be replayed in traversal order; otherwise they take effect
+# right away.
+proc _record {args} {
+    global collect
+
+    if {[info exists collect]} {
+        lappend collect $args
+    } else {
+        _replay $args
+    }
+}
+
+proc _replay {step} {
+    global fd inputsfd stats newest
 
-    puts $fd [list $name $len]
-    puts $fd $line
+    set args [lassign $step action]
+    switch -- $action {
+        index {
+            lassign $args name len line
+            puts $fd [list $name $len]
+            puts $fd $line
+        }
+        stdout {
+            puts [lindex $args 0]
+        }
+        stderr {
+            puts stderr [lindex $args 0]
+        }
+        stat {
+            incr stats([lindex $args 0])
+        }
+        inputs {
+            lassign $args portdir hashes
+            puts $inputsfd [list $portdir $hashes]
+        }
+        mtime {
+            if {[lindex $args 0] > $newest} {
+                set newest [lindex $args 0]
+            }
+        }
+    }
+}
+
+proc _write_index {name len line} {
+    _record index $name $len $line
 }
 
 proc _write_index_from_portinfo {portinfoname {is_subport no}} {
@@ -107,84 +155,287 @@ proc _open_port {portinfo_name portdir absportdir port_options_name {subport {}}
     set portinfo(portdir) $portdir
 }
 
-proc pindex {portdir} {
-    global oldmtime newest qindex directory stats full_reindex \
-           ui_options port_options
+# Returns a list of the given files and the SHA-256 hashes of their contents,
+# which is empty for files that can't be read. Hashes are remembered for the
+# rest of the run, since many ports share the same PortGroups.
+proc _input_hashes {files} {
+    global file_hashes
+
+    set hashes [list]
+    foreach file $files {
+        if {![info exists file_hashes($file)]} {
+            if {[catch {sha256 file $file} file_hashes($file)]} {
+                set file_hashes($file) {}
+            }
+        }
+        lappend hashes $file $file_hashes($file)
+    }
+    return $hashes
+}
 
-    set qname [string tolower [file tail $portdir]]
-    set absportdir [file join $directory $portdir]
-    set portfile [file join $absportdir Portfile]
-    # try to reuse the existing entry if it's still valid
-    if {$full_reindex != 1 && [info exists qindex($qname)]} {
-        try -pass_signal {
-            set mtime [file mtime $portfile]
-            if {$oldmtime >= $mtime} {
-                lassign [_read_index $qname] name len line
-                array set portinfo $line
-
-                # reuse entry if it was made from the same portdir
-                if {[info exists portinfo(portdir)] && $portinfo(portdir) eq $portdir} {
-                    _write_index $name $len $line
-                    incr stats(skipped)
-
-                    if {[info exists ui_options(ports_debug)]} {
-                        puts "Reusing existing entry for $portdir"
-                    }
+# Writes the entries of portdir (and its subports) from the old index if they
+# are still up to date. Returns 1 if they were reused.
+proc _reuse_port {portdir} {
+    global oldmtime qindex oldinputs directory full_reindex ui_options
 
-                    # also reuse the entries for its subports
-                    if {![info exists portinfo(subports)]} {
-                        return
-                    }
+    set qname [string tolower [file tail $portdir]]
+    set portfile [file join $directory $portdir Portfile]
+    if {$full_reindex == 1 || ![info exists qindex($qname)]} {
+        return 0
+    }
+    try -pass_signal {
+        # the entries are up to date if the Portfile and the PortGroups it
+        # used are unchanged; ports indexed before the hashes were kept
+        # fall back to comparing mtimes
+        if {[info exists oldinputs($portdir)]} {
+            set uptodate [expr {[_input_hashes [dict keys $oldinputs($portdir)]] eq $oldinputs($portdir)}]
+        } else {
+            set uptodate [expr {$oldmtime >= [file mtime $portfile]}]
+        }
+        if {$uptodate} {
+            lassign [_read_index $qname] name len line
+            array set portinfo $line
+
+            # reuse entry if it was made from the same portdir
+            if {[info exists portinfo(portdir)] && $portinfo(portdir) eq $portdir} {
+                set entries [list [list $name $len $line]]
+                # also reuse the entries for its subports
+                if {[info exists portinfo(subports)]} {
                     foreach sub $portinfo(subports) {
-                        _write_index {*}[_read_index [string tolower $sub]]
-                        incr stats(skipped)
+                        lappend entries [_read_index [string tolower $sub]]
                     }
+                }
 
-                    return
+                if {[info exists ui_options(ports_debug)]} {
+                    _record stdout "Reusing existing entry for $portdir"
                 }
+                foreach entry $entries {
+                    _write_index {*}$entry
+                    _record stat skipped
+                }
+                if {[info exists oldinputs($portdir)]} {
+                    _record inputs $portdir $oldinputs($portdir)
+                }
+                return 1
             }
-        } catch {{*} eCode eMessage} {
-            ui_warn "Failed to open old entry for ${portdir}, making a new one"
-            if {[info exists ui_options(ports_debug)]} {
-                puts "$::errorInfo"
-            }
+        }
+    } catch {{*} eCode eMessage} {
+        ui_warn "Failed to open old entry for ${portdir}, making a new one"
+        if {[info exists ui_options(ports_debug)]} {
+            puts "$::errorInfo"
+        }
+    }
+    return 0
+}
+
+# Adds the PortGroup files used by a port to the list in inputsname. Returns 0
+# if one of them couldn't be found, in which case the port can't be reused.
+proc _add_portgroups {inputsname portinfoname} {
+    upvar $inputsname inputs
+    upvar $portinfoname portinfo
+
+    if {![info exists portinfo(portgroups)]} {
+        return 1
+    }
+    foreach pg $portinfo(portgroups) {
+        set groupfile [lindex $pg 2]
+        if {$groupfile eq {}} {
+            return 0
+        }
+        if {$groupfile ni $inputs} {
+            lappend inputs $groupfile
         }
     }
+    return 1
+}
+
+# Evaluates the Portfile in portdir and writes the entries for the port and
+# its subports, along with the hashes of the files they were made from.
+proc _index_port {portdir} {
+    global directory port_options
+
+    set absportdir [file join $directory $portdir]
+    set portfile [file join $absportdir Portfile]
+    set inputs [list $portfile]
+    set complete 0
 
-    incr stats(total)
+    _record stat total
     try -pass_signal {
         _open_port portinfo $portdir $absportdir port_options
-        puts "Adding port $portdir"
+        _record stdout "Adding port $portdir"
 
         _write_index_from_portinfo portinfo
-        set mtime [file mtime $portfile]
-        if {$mtime > $newest} {
-            set newest $mtime
-        }
+        _record mtime [file mtime $portfile]
+        set complete [_add_portgroups inputs portinfo]
 
         # now index this portfile's subports (if any)
-        if {![info exists portinfo(subports)]} {
-            return
+        set subports [list]
+        if {[info exists portinfo(subports)]} {
+            set subports $portinfo(subports)
         }
-        foreach sub $portinfo(subports) {
-            incr stats(total)
+        foreach sub $subports {
+            _record stat total
             try -pass_signal {
                 _open_port portinfo $portdir $absportdir port_options $sub
-                puts "Adding subport $sub"
+                _record stdout "Adding subport $sub"
 
                 _write_index_from_portinfo portinfo yes
+                if {![_add_portgroups inputs portinfo]} {
+                    set complete 0
+                }
             } catch {{*} eCode eMessage} {
-                puts stderr "Failed to parse file $portdir/Portfile with subport '${sub}': $eMessage"
-                incr stats(failed)
+                _record stderr "Failed to parse file $portdir/Portfile with subport '${sub}': $eMessage"
+                _record stat failed
+                set complete 0
             }
         }
     } catch {{*} eCode eMessage} {
-        puts stderr "Failed to parse file $portdir/Portfile: $eMessage"
-        incr stats(failed)
+        _record stderr "Failed to parse file $portdir/Portfile: $eMessage"
+        _record stat failed
+    }
+
+    if {$complete} {
+        _record inputs $portdir [_input_hashes $inputs]
+    }
+}
+
+proc pindex {portdir} {
+    if {![_reuse_port $portdir]} {
+        _index_port $portdir
+    }
+}
+
+# Parallel indexing (-j): the parent traverses the tree, reuses old entries
+# itself and hands the remaining port directories to worker processes, one
+# at a time. Workers send back the recorded steps, which are replayed in
+# traversal order so that the result is the same as when indexing serially.
+# Processes are used rather than threads because mportopen changes the
+# working directory, which is shared by all threads.
+
+proc _add_portdir {portdir} {
+    global portdirs
+    lappend portdirs $portdir
+}
+
+# Replays the results that are complete, up to the first one still pending.
+proc _replay_results {} {
+    global results next_result
+
+    while {[info exists results($next_result)]} {
+        foreach step $results($next_result) {
+            _replay $step
+        }
+        unset results($next_result)
+        incr next_result
+    }
+}
+
+# Gives the next port that can't be reused to the worker on chan, or tells
+# it to exit if there are none left.
+proc _dispatch {chan} {
+    global portdirs next_job results collect worker_job
+
+    while {$next_job < [llength $portdirs]} {
+        set job $next_job
+        incr next_job
+        set portdir [lindex $portdirs $job]
+
+        set collect {}
+        set reused [_reuse_port $portdir]
+        set steps $collect
+        unset collect
+        if {$reused} {
+            set results($job) $steps
+            _replay_results
+            continue
+        }
+
+        set worker_job($chan) $job
+        puts $chan $portdir
+        flush $chan
+        return
+    }
+
+    unset -nocomplain worker_job($chan)
+    puts $chan ""
+    flush $chan
+}
+
+proc _worker_readable {chan} {
+    global portdirs results worker_job active_workers
+
+    if {[gets $chan line] < 0} {
+        if {![eof $chan]} {
+            return
+        }
+        catch {close $chan}
+        if {[info exists worker_job($chan)]} {
+            set job $worker_job($chan)
+            set results($job) [list \
+                [list stat total] \
+                [list stderr "Failed to parse file [lindex $portdirs $job]/Portfile: worker process exited"] \
+                [list stat failed]]
+            unset worker_job($chan)
+            _replay_results
+        }
+        incr active_workers -1
+        return
+    }
+
+    # anything else written to stdout (e.g. by a Portfile) is passed through
+    set marker [string first "\x01result " $line]
+    if {$marker < 0} {
+        puts $line
+        return
+    }
+    if {$marker > 0} {
+        puts -nonewline [string range $line 0 [expr {$marker - 1}]]
+    }
+    scan [string range $line $marker end] "\x01result %d" size
+    set results($worker_job($chan)) [read $chan $size]
+    _replay_results
+    _dispatch $chan
+}
+
+proc pindex_parallel {directory jobs} {
+    global portdirs next_job next_result active_workers worker_args
+
+    set portdirs [list]
+    mporttraverse _add_portdir $directory
+    set next_job 0
+    set next_result 0
+
+    set active_workers 0
+    for {set i 0} {$i < $jobs && $next_job < [llength $portdirs]} {incr i} {
+        set chan [open "|[list [info nameofexecutable] {*}$worker_args]" r+]
+        fconfigure $chan -encoding utf-8 -translation lf
+        incr active_workers
+        fileevent $chan readable [list _worker_readable $chan]
+        _dispatch $chan
+    }
+    while {$active_workers > 0} {
+        vwait active_workers
+    }
+    _replay_results
+}
+
+# Runs in a worker process: indexes the port directories read from stdin
+# until an empty line, writing the recorded steps of each to stdout.
+proc pindex_worker {} {
+    global collect
+
+    fconfigure stdin -encoding utf-8 -translation lf
+    fconfigure stdout -encoding utf-8 -translation lf
+    while {[gets stdin portdir] > 0} {
+        set collect {}
+        _index_port $portdir
+        puts -nonewline "\x01result [string length $collect]\n$collect"
+        flush stdout
     }
+    unset collect
 }
 
-if {$argc > 8} {
+if {$argc > 10} {
     print_usage
     exit 1
 }
@@ -198,8 +449,17 @@ for {set i 0} {$i < $argc} {incr i} {
             } elseif {$arg eq "-o"} { # Set output directory
                 incr i
                 set outdir [file join [pwd] [lindex $argv $i]]
+            } elseif {$arg eq "-j"} { # Parallel jobs
+                incr i
+                set jobs [lindex $argv $i]
+                if {![string is integer -strict $jobs] || $jobs < 1} {
+                    puts stderr "Invalid number of jobs: $jobs"
+                    print_usage
+                    exit 1
+                }
             } elseif {$arg eq "-p"} { # Set platform
                 incr i
+                set platform [lindex $argv $i]
                 set platlist [split [lindex $argv $i] _]
                 set os_platform [lindex $platlist 0]
                 set os_major [lindex $platlist 1]
@@ -238,6 +498,8 @@ for {set i 0} {$i < $argc} {incr i} {
                 set full_reindex 1
             } elseif {$arg eq "-e"} { # Non-zero exit code on errors
                 set permit_error 1
+            } elseif {$arg eq "-worker"} { # Internal: run as a -j worker
+                set worker 1
             } else {
                 puts stderr "Unknown option: $arg"
                 print_usage
@@ -262,6 +524,20 @@ if {[catch {cd $directory} result]} {
     set directory [pwd]
 }
 
+set save_prefix ${macports::prefix}
+foreach key {categories depends_fetch depends_extract depends_patch \
+             depends_build depends_lib depends_run depends_test \
+             description epoch homepage long_description maintainers \
+             name platforms revision variants version portdir \
+             replaced_by license installs_libs conflicts known_fail} {
+    set keepkeys($key) 1
+}
+
+if {$worker} {
+    pindex_worker
+    exit 0
+}
+
 # Set output directory to full path
 if {[info exists outdir]} {
     if {[catch {file mkdir $outdir} result]} {
@@ -296,20 +572,43 @@ if {[file isfile $outpath] && [file isfile ${outpath}.quick]} {
     set newest 0
 }
 
+# PortIndex.hashes records the files each port's entries were made from, so
+# that they can be reused for as long as none of those files change. Entries
+# made by a different MacPorts version or for different options can't be.
+set inputsheader [list version 1 macports $macports::autoconf::macports_version options $port_options]
+if {[info exists oldfd] && ![catch {open ${outpath}.hashes r} inputsfd]} {
+    if {[gets $inputsfd line] >= 0 && $line eq $inputsheader} {
+        while {[gets $inputsfd line] >= 0} {
+            set oldinputs([lindex $line 0]) [lindex $line 1]
+        }
+    } elseif {$full_reindex != 1} {
+        puts "Index was made with different options, doing a full re-index"
+        set full_reindex 1
+    }
+    close $inputsfd
+}
+
 set tempportindex [mktemp "/tmp/mports.portindex.XXXXXXXX"]
 set fd [open $tempportindex w]
-set save_prefix ${macports::prefix}
-foreach key {categories depends_fetch depends_extract depends_patch \
-             depends_build depends_lib depends_run depends_test \
-             description epoch homepage long_description maintainers \
-             name platforms revision variants version portdir \
-             replaced_by license installs_libs conflicts known_fail} {
-    set keepkeys($key) 1
-}
+set tempinputs [mktemp "/tmp/mports.portindex.XXXXXXXX"]
+set inputsfd [open $tempinputs w]
+puts $inputsfd $inputsheader
 
 set exit_fail 0
 try {
-    mporttraverse pindex $directory
+    if {$jobs > 1} {
+        set worker_args [list $script -worker]
+        if {[info exists ui_options(ports_debug)]} {
+            lappend worker_args -d
+        }
+        if {[info exists platform]} {
+            lappend worker_args -p $platform
+        }
+        lappend worker_args $directory
+        pindex_parallel $directory $jobs
+    } else {
+        mporttraverse pindex $directory
+    }
 } catch {{POSIX SIG SIGINT} eCode eMessage} {
     puts stderr "SIGINT received, terminating."
     set exit_fail 1
@@ -321,6 +620,7 @@ try {
         close $oldfd
     }
     close $fd
+    close $inputsfd
 }
 if {$exit_fail} {
     exit 1
@@ -328,7 +628,11 @@ if {$exit_fail} {
 
 file rename -force $tempportindex $outpath
 file mtime $outpath $newest
+file rename -force $tempinputs ${outpath}.hashes
 mports_generate_quickindex $outpath
+if {[catch {binindex create $outpath ${outpath}.bin} result]} {
+    puts stderr "Failed to generate binary index: $result"
+}
 puts "\nTotal number of ports parsed:\t$stats(total)\
       \nPorts successfully parsed:\t[expr {$stats(total) - $stats(failed)}]\
       \nPorts failed:\t\t\t$stats(failed)\
@@ -217,12 +217,12 @@ proc portfetch::checksites {sitelists mirrorfile} {
     }
 }
 
-# sorts fetch_urls in order of ping time
+# sorts fetch_urls in order of expected download time, from the throughput
+# and failures of earlier fetches from each host
 proc portfetch::sortsites {urls default_listvar} {
     global $default_listvar
     upvar $urls fetch_urls
     variable urlmap
-    set hostregex {[a-zA-Z]+://([a-zA-Z0-9\.\-_]+)}
 
     foreach {url_var distfile} $fetch_urls {
         if {![info exists urlmap($url_var)]} {
@@ -234,82 +234,137 @@ proc portfetch::sortsites {urls default_listvar} {
             }
         }
         set urllist $urlmap($url_var)
-        set hosts {}
 
         if {[llength $urllist] <= 1} {
-            # there is only one mirror, no need to ping or sort
+            # there is only one mirror, no need to sort
             continue
         }
 
-        # can't do the ping with dropped privileges (though it works fine if we didn't start as root)
-        if {[getuid] == 0 && [geteuid] != 0} {
-            set oldeuid [geteuid]
-            set oldegid [getegid]
-            seteuid 0; setegid 0
-        }
-
+        set scorelist {}
         foreach site $urllist {
             if {[string range $site 0 6] eq "file://"} {
-                set pingtimes(localhost) 0
-                continue
+                set score 0
+            } else {
+                set score [get_host_score [site_host $site]]
             }
-            
-            regexp $hostregex $site -> host
-            
-            if { [info exists seen($host)] } {
-                continue
+            if {$score eq {}} {
+                # hosts without statistics come after those known to be
+                # faster than 1 MiB/s, in their original order
+                set score 1000
             }
-            if { ![info exists seen($host)] } {
-                # first check the persistent cache
-                set pingtimes($host) [get_pingtime $host]
-                if {$pingtimes($host) eq {}} {
-                    if {[catch {set fds($host) [open "|ping -noq -c3 -t3 $host | grep round-trip | cut -d / -f 5"]}]} {
-                        ui_debug "Spawning ping for $host failed"
-                        # will end up after all hosts that were pinged OK but before those that didn't respond
-                        set pingtimes($host) 5000
-                    } else {
-                        set seen($host) yes
-                        lappend hosts $host
-                    }
-                }
+            # -1 means blacklisted
+            if {$score != -1} {
+                lappend scorelist [list $site $score]
             }
         }
 
-        foreach host $hosts {
-            gets $fds($host) pingtimes($host)
-            if { [catch { close $fds($host) }] || ![string is double -strict $pingtimes($host)] } {
-                # ping failed, so put it last in the list
-                set pingtimes($host) 10000
-            }
-            # cache it
-            set_pingtime $host $pingtimes($host)
+        set urlmap($url_var) {}
+        foreach pair [lsort -real -index 1 $scorelist] {
+            lappend urlmap($url_var) [lindex $pair 0]
         }
+    }
+}
 
-        if {[info exists oldeuid]} {
-            setegid $oldegid
-            seteuid $oldeuid
-        }
+# returns the host of a site, localhost for file:// urls
+proc portfetch::site_host {site} {
+    if {[string range $site 0 6] eq "file://"} {
+        return localhost
+    }
+    set host ""
+    regexp {[a-zA-Z]+://([a-zA-Z0-9\.\-_]+)} $site -> host
+    return $host
+}
 
-        set pinglist {}
-        foreach site $urllist {
-            if {[string range $site 0 6] eq "file://"} {
-                set host localhost
-            } else {
-                regexp $hostregex $site -> host
-            }
-            # -1 means blacklisted
-            if {$pingtimes($host) != "-1"} {
-                lappend pinglist [ list $site $pingtimes($host) ]
-            }
+# records the outcome of fetching url in the statistics of its host and in
+# fetch_attempts, as a --report callback of curl fetchmany
+proc portfetch::record_fetch {url status bytes seconds} {
+    variable fetch_attempts
+    ui_debug "Fetching $url: $status, $bytes bytes in $seconds s"
+    lappend fetch_attempts $url $status
+    record_host_fetch [site_host $url] $status $bytes $seconds
+}
+
+# returns the path of the file caching the digests of the file at path,
+# computed while fetching it or by the checksum phase
+proc portfetch::digests_path {path} {
+    return [file join [file dirname $path] .[file tail $path].digests]
+}
+
+# returns the device, inode, size, modification and status change times of
+# the file at path, which cached digests are valid for
+proc portfetch::digests_fingerprint {path} {
+    return [checksum fingerprint $path]
+}
+
+# caches digests, a list of checksum types and values of the file at path,
+# together with the ones already cached for it. fingerprint is the result of
+# digests_fingerprint from before the digests were computed, by default the
+# current one.
+proc portfetch::store_digests {path digests {fingerprint {}}} {
+    if {[catch {
+        if {$fingerprint eq ""} {
+            set fingerprint [digests_fingerprint $path]
         }
+        set digests [dict merge [stored_digests $path $fingerprint] $digests]
+    } result]} {
+        ui_debug "Could not store digests of $path: $result"
+        return
+    }
+    set digestsfile [digests_path $path]
+    if {[catch {
+        # not group or world writable, so that stored_digests trusts it
+        file delete -force ${digestsfile}.TMP
+        set fd [open ${digestsfile}.TMP {WRONLY CREAT EXCL} 0644]
+        puts $fd [list $fingerprint $digests]
+        close $fd
+        file rename -force ${digestsfile}.TMP $digestsfile
+    } result]} {
+        ui_debug "Could not store digests of $path: $result"
+        catch {close $fd}
+        file delete -force ${digestsfile}.TMP
+    }
+}
 
-        set pinglist [ lsort -real -index 1 $pinglist ]
+# returns whether the digests file at digestsfile can be trusted, since one
+# that others can write could claim any digests: it must be a regular file
+# owned by root or by the current user, and not writable by group or others
+proc portfetch::digests_trusted {digestsfile} {
+    if {[catch {file lstat $digestsfile stat}] || $stat(type) ne "file"} {
+        return no
+    }
+    if {$stat(uid) != 0 && $stat(uid) != [geteuid]} {
+        ui_debug "Ignoring $digestsfile, owned by uid $stat(uid)"
+        return no
+    }
+    if {$stat(mode) & 0022} {
+        ui_debug "Ignoring $digestsfile, writable by group or others"
+        return no
+    }
+    return yes
+}
 
-        set urlmap($url_var) {}
-        foreach pair $pinglist {
-            lappend urlmap($url_var) [lindex $pair 0]
+# returns the checksum types and values cached for the file at path, or an
+# empty list if there are none, if the file changed since or if the digests
+# file can't be trusted. fingerprint is the result of digests_fingerprint, by
+# default the current one.
+proc portfetch::stored_digests {path {fingerprint {}}} {
+    set digestsfile [digests_path $path]
+    if {![digests_trusted $digestsfile] || [catch {
+        if {$fingerprint eq ""} {
+            set fingerprint [digests_fingerprint $path]
         }
+        set fd [open $digestsfile r]
+        lassign [gets $fd] stored_fingerprint digests
+        close $fd
+        dict size $digests
+    }]} {
+        catch {close $fd}
+        return {}
+    }
+    if {$stored_fingerprint ne $fingerprint} {
+        return {}
     }
+    return $digests
 }
 
 proc portfetch::get_urls {} {
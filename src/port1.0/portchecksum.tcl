@@ -33,6 +33,7 @@
 
 package provide portchecksum 1.0
 package require portutil 1.0
+package require fetch_common 1.0
 
 set org.macports.checksum [target_new org.macports.checksum portchecksum::checksum_main]
 target_provides ${org.macports.checksum} checksum
@@ -182,40 +183,73 @@ proc portchecksum::parse_checksums {checksums_str} {
     return $result
 }
 
+# calc_checksums
+#
+# Calculate the checksums of the given types for the given file in one
+# pass, except for those cached for it since it last changed. If cache is
+# set, cache the calculated checksums for the next time.
+# Return a list of types and checksums, which may include other types.
+#
+proc portchecksum::calc_checksums {file types {cache no}} {
+    set fingerprint [portfetch::digests_fingerprint $file]
+    set checksums [portfetch::stored_digests $file $fingerprint]
+    # the size doesn't need reading the file
+    dict set checksums size [lindex $fingerprint 2]
+    set missing_types {}
+    foreach type $types {
+        if {![dict exists $checksums $type] && $type ni $missing_types} {
+            lappend missing_types $type
+        }
+    }
+    if {[llength $missing_types] == 0} {
+        return $checksums
+    }
+    ui_debug "Reading $file for its $missing_types checksums"
+    set checksums [dict merge $checksums [checksum file -types $missing_types $file]]
+    if {$cache} {
+        portfetch::store_digests $file $checksums $fingerprint
+    }
+    return $checksums
+}
+
 # calc_md5
 #
-# Calculate the md5 checksum for the given file.
+# Calculate the md5 checksum for the given file, or get it from the
+# digests cached for it.
 # Return the checksum.
 #
 proc portchecksum::calc_md5 {file} {
-    return [md5 file $file]
+    return [dict get [calc_checksums $file md5] md5]
 }
 
 # calc_sha1
 #
-# Calculate the sha1 checksum for the given file.
+# Calculate the sha1 checksum for the given file, or get it from the
+# digests cached for it.
 # Return the checksum.
 #
 proc portchecksum::calc_sha1 {file} {
-    return [sha1 file $file]
+    return [dict get [calc_checksums $file sha1] sha1]
 }
 
 # calc_rmd160
 #
-# Calculate the rmd160 checksum for the given file.
+# Calculate the rmd160 checksum for the given file, or get it from the
+# digests cached for it.
 # Return the checksum.
 #
 proc portchecksum::calc_rmd160 {file} {
-    return [rmd160 file $file]
+    return [dict get [calc_checksums $file rmd160] rmd160]
 }
 
 # calc_sha256
 #
-# Calculate the sha256 checksum for the given file.
+# Calculate the sha256 checksum for the given file, or get it from the
+# digests cached for it.
 # Return the checksum.
 #
 proc portchecksum::calc_sha256 {file} {
-    return [sha256 file $file]
+    return [dict get [calc_checksums $file sha256] sha256]
 }
 
 # calc_size
@@ -288,9 +322,14 @@ proc portchecksum::checksum_main {args} {
                 set portfile_checksums $checksums_array($distfile)
                 set calculated_checksums {}
 
+                # the checksums computed while fetching the distfile or
+                # checksumming it before, if it didn't change since, and the
+                # others computed in one pass
+                set distfile_checksums [calc_checksums $fullpath [dict keys $portfile_checksums] yes]
+
                 # iterate on this list to check the actual values.
                 foreach {type sum} $portfile_checksums {
-                    set calculated_sum [calc_$type $fullpath]
+                    set calculated_sum [dict get $distfile_checksums $type]
                     lappend calculated_checksums $type
                     lappend calculated_checksums $calculated_sum
 
@@ -376,8 +415,9 @@ proc portchecksum::checksum_main {args} {
                         return -code error "$distfile does not exist in $distpath"
                     }
 
+                    set distfile_checksums [calc_checksums $fullpath $missing_types]
                     foreach type $missing_types {
-                        lappend sums [format "%-8s%s" $type [calc_$type $fullpath]]
+                        lappend sums [format "%-8s%s" $type [dict get $distfile_checksums $type]]
                     }
                 }
             }
@@ -35,6 +35,7 @@
 package provide portclean 1.0
 package require portutil 1.0
 package require Pextlib 1.0
+package require fetch_common 1.0
 
 set org.macports.clean [target_new org.macports.clean portclean::clean_main]
 target_runtype ${org.macports.clean} always
@@ -108,6 +109,7 @@ proc portclean::clean_dist {args} {
             }
             incr count
         }
+        file delete -force [portfetch::digests_path $distfile]
     }
     if {$count > 0} {
         ui_debug "$count distfile(s) removed."
@@ -43,6 +43,11 @@ target_prerun ${org.macports.fetch} portfetch::fetch_start
 namespace eval portfetch {
     namespace export suffix
     variable fetch_urls {}
+
+    # number of sites raced for each distfile, and delay in ms before the
+    # next one is started while none delivered data
+    variable race_candidates 2
+    variable race_stagger 250
 }
 
 # define options: distname master_sites
@@ -507,13 +512,95 @@ proc portfetch::hgfetch {args} {
 }
 
 # Perform a standard fetch, assembling fetch urls from
-# the listed url variable and associated distfile
+# the listed url variable and associated distfile. All missing distfiles
+# are fetched at once, each racing its best sites.
 proc portfetch::fetchfiles {args} {
-    global distpath all_dist_files UI_PREFIX \
-           fetch.user fetch.password fetch.use_epsv fetch.ignore_sslcert fetch.remote_time \
-           fetch.user_agent portverbose
+    global distpath all_dist_files UI_PREFIX
     variable fetch_urls
     variable urlmap
+    variable race_candidates
+    variable race_stagger
+
+    set fetch_options [fetch_options]
+    lappend fetch_options --candidates $race_candidates --stagger $race_stagger
+    set sorted no
+
+    set distfiles [list]
+    set transfers [list]
+    foreach {url_var distfile} $fetch_urls {
+        if {![file isfile "${distpath}/${distfile}"]} {
+            ui_info "$UI_PREFIX [format [msgcat::mc "%s does not exist in %s"] $distfile $distpath]"
+            if {![file writable $distpath]} {
+                return -code error [format [msgcat::mc "%s must be writable"] $distpath]
+            }
+            if {!$sorted} {
+                sortsites fetch_urls master_sites
+                set sorted yes
+            }
+            if {![info exists urlmap($url_var)]} {
+                ui_error [format [msgcat::mc "No defined site for tag: %s, using master_sites"] $url_var]
+                set urlmap($url_var) $urlmap(master_sites)
+            }
+            if {[llength $urlmap($url_var)] == 0} {
+                error [msgcat::mc "fetch failed"]
+            }
+            ui_notice "$UI_PREFIX [format [msgcat::mc "Attempting to fetch %s from %s"] $distfile [lindex $urlmap($url_var) 0]]"
+            set urls [list]
+            foreach site $urlmap($url_var) {
+                set url [portfetch::assemble_url $site $distfile]
+                lappend urls $url
+                set url_distfile($url) $distfile
+            }
+            lappend distfiles $distfile
+            lappend transfers [list $urls "${distpath}/${distfile}.TMP"]
+        }
+    }
+    if {[llength $transfers] == 0} {
+        return 0
+    }
+
+    try -pass_signal {
+        set results [fetchmany $fetch_options $transfers digests]
+        variable fetch_attempts
+        foreach {url status} $fetch_attempts {
+            if {![info exists url_distfile($url)]} {
+                continue
+            }
+            if {$status eq "ok"} {
+                ui_notice "$UI_PREFIX [format [msgcat::mc "Fetched %s from %s"] $url_distfile($url) $url]"
+            } else {
+                ui_info "$UI_PREFIX [format [msgcat::mc "Attempted to fetch %s from %s: %s"] $url_distfile($url) $url $status]"
+            }
+        }
+        set lastError ""
+        foreach distfile $distfiles result $results distdigests $digests {
+            if {$result eq ""} {
+                file rename -force "${distpath}/${distfile}.TMP" "${distpath}/${distfile}"
+                # so that the checksum phase doesn't read it again
+                store_digests "${distpath}/${distfile}" $distdigests
+            } else {
+                ui_debug [msgcat::mc "Fetching distfile failed: %s" $result]
+                if {$lastError eq ""} {
+                    set lastError $result
+                }
+            }
+        }
+        if {$lastError ne ""} {
+            error $lastError
+        }
+    } finally {
+        foreach distfile $distfiles {
+            file delete -force "${distpath}/${distfile}.TMP"
+        }
+    }
+    return 0
+}
+
+# Returns the options for curl fetch and curl fetchmany from the fetch.*
+# options, without the progress option.
+proc portfetch::fetch_options {} {
+    global fetch.user fetch.password fetch.use_epsv fetch.ignore_sslcert \
+           fetch.remote_time fetch.user_agent
 
     set fetch_options {}
     if {[string length ${fetch.user}] || [string length ${fetch.password}]} {
@@ -533,56 +620,103 @@ proc portfetch::fetchfiles {args} {
         lappend fetch_options "--user-agent"
         lappend fetch_options "${fetch.user_agent}"
     }
+    return $fetch_options
+}
+
+# Fetches each {urls path} pair of transfers concurrently with curl
+# fetchmany, reporting their combined progress to ui_progress_download, or
+# the progress of each in verbose mode, and the outcome of each url to the
+# statistics of its host. The urls that were tried are left in
+# fetch_attempts, with their outcome. If digestsvar is given, it is set to
+# the digests of each transfer.
+# Returns the list of the transfers' errors, empty for those that succeeded.
+proc portfetch::fetchmany {fetch_options transfers {digestsvar {}}} {
+    global portverbose
+    variable progress
+    variable fetch_attempts [list]
+    array unset progress
+    lappend fetch_options --report portfetch::record_fetch
+    if {$digestsvar ne ""} {
+        upvar $digestsvar digests
+        lappend fetch_options --digests digests
+    }
     if {$portverbose eq "yes"} {
-        lappend fetch_options "--progress"
-        lappend fetch_options "builtin"
+        # curl's builtin meter would mix up the lines of the transfers
+        set index 0
+        foreach transfer $transfers {
+            set progress(name,$index) [file rootname [file tail [lindex $transfer 1]]]
+            incr index
+        }
+        lappend fetch_options --progress portfetch::progress_verbose
     } elseif {[llength [info commands ui_progress_download]] > 0} {
-        lappend fetch_options "--progress"
-        lappend fetch_options "ui_progress_download"
+        lappend fetch_options --progress portfetch::progress_many
     }
-    set sorted no
+    try -pass_signal {
+        set results [curl fetchmany {*}$fetch_options $transfers]
+    } finally {
+        if {[info exists progress(started)]} {
+            ui_progress_download finish
+        }
+        array unset progress
+    }
+    return $results
+}
 
-    foreach {url_var distfile} $fetch_urls {
-        if {![file isfile "${distpath}/${distfile}"]} {
-            ui_info "$UI_PREFIX [format [msgcat::mc "%s does not exist in %s"] $distfile $distpath]"
-            if {![file writable $distpath]} {
-                return -code error [format [msgcat::mc "%s must be writable"] $distpath]
-            }
-            if {!$sorted} {
-                sortsites fetch_urls master_sites
-                set sorted yes
-            }
-            if {![info exists urlmap($url_var)]} {
-                ui_error [format [msgcat::mc "No defined site for tag: %s, using master_sites"] $url_var]
-                set urlmap($url_var) $urlmap(master_sites)
+# Progress callback of curl fetchmany that reports the sum of the
+# transfers to ui_progress_download as a single download. The total is
+# unknown until it is known for all the transfers that started.
+proc portfetch::progress_many {index action args} {
+    variable progress
+    switch -- $action {
+        start {
+            set progress($index) {0 0 0}
+            if {![info exists progress(started)]} {
+                set progress(started) 1
+                ui_progress_download start dl
             }
-            unset -nocomplain fetched
-            set lastError ""
-            foreach site $urlmap($url_var) {
-                ui_notice "$UI_PREFIX [format [msgcat::mc "Attempting to fetch %s from %s"] $distfile $site]"
-                set file_url [portfetch::assemble_url $site $distfile]
-                try -pass_signal {
-                    curl fetch {*}$fetch_options $file_url "${distpath}/${distfile}.TMP"
-                    file rename -force "${distpath}/${distfile}.TMP" "${distpath}/${distfile}"
-                    set fetched 1
-                    break
-                } catch {{*} eCode eMessage} {
-                    ui_debug [msgcat::mc "Fetching distfile failed: %s" $eMessage]
-                    set lastError $eMessage
-                } finally {
-                    file delete -force "${distpath}/${distfile}.TMP"
+        }
+        update {
+            set progress($index) [lrange $args 1 3]
+            set total 0
+            set now 0
+            set speed 0
+            set known 1
+            foreach key [array names progress -regexp {^[0-9]+$}] {
+                lassign $progress($key) t n s
+                if {$t <= 0} {
+                    set known 0
                 }
+                set total [expr {$total + $t}]
+                set now [expr {$now + $n}]
+                set speed [expr {$speed + $s}]
             }
-            if {![info exists fetched]} {
-                if {$lastError ne ""} {
-                    error $lastError
-                } else {
-                    error [msgcat::mc "fetch failed"]
-                }
+            if {!$known} {
+                set total 0
             }
+            ui_progress_download update dl $total $now $speed
         }
     }
-    return 0
+}
+
+# Progress callback of curl fetchmany in verbose mode, which logs the
+# progress of each transfer at most once a second.
+proc portfetch::progress_verbose {index action args} {
+    variable progress
+    if {$action ne "update"} {
+        return
+    }
+    lassign $args type total now speed
+    set time [clock seconds]
+    if {[info exists progress(time,$index)] && $progress(time,$index) == $time} {
+        return
+    }
+    set progress(time,$index) $time
+    if {$total > 0} {
+        ui_info [format "%s: %.0f of %.0f bytes (%d%%), %.0f bytes/s" \
+            $progress(name,$index) $now $total [expr {int(100 * $now / $total)}] $speed]
+    } else {
+        ui_info [format "%s: %.0f bytes, %.0f bytes/s" $progress(name,$index) $now $speed]
+    }
 }
 
 # Utility function to delete fetched files.
@@ -593,6 +727,7 @@ proc portfetch::fetch_deletefiles {args} {
         if {[file isfile $distpath/$distfile]} {
             file delete -force "${distpath}/${distfile}"
         }
+        file delete -force [digests_path "${distpath}/${distfile}"]
     }
 }
 
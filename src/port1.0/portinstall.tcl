@@ -115,6 +115,31 @@ proc portinstall::create_archive {location archive.type} {
                 return -code error "No '$pax' was found on this system!"
             }
         }
+        tzst {
+            if {[archive supported ${location}]} {
+                # written by Pextlib, see below
+                ui_debug "Using Pextlib's archive command"
+            } else {
+                set tar "tar"
+                if {[catch {set tar [findBinary $tar ${portutil::autoconf::tar_path}]} errmsg] == 0} {
+                    ui_debug "Using $tar"
+                    set archive.cmd "$tar"
+                    set archive.pre_args {-cvf}
+                    set zstd "zstd"
+                    if {[catch {set zstd [findBinary $zstd ""]} errmsg] == 0} {
+                        ui_debug "Using $zstd"
+                        set archive.args {- .}
+                        set archive.post_args "| $zstd -c9 -T0 > ${location}"
+                    } else {
+                        ui_debug $errmsg
+                        return -code error "No '$zstd' was found on this system!"
+                    }
+                } else {
+                    ui_debug $errmsg
+                    return -code error "No '$tar' was found on this system!"
+                }
+            }
+        }
         t(ar|bz|lz|xz|gz) {
             set tar "tar"
             if {[catch {set tar [findBinary $tar ${portutil::autoconf::tar_path}]} errmsg] == 0} {
@@ -272,20 +297,34 @@ proc portinstall::create_archive {location archive.type} {
     # also save the contents for our own use later
     set installPlist {}
     set destpathLen [string length $destpath]
+    set entries {}
+    set regular_files {}
     fs-traverse -depth fullpath $destpath {
         if {[file type $fullpath] eq "directory"} {
             continue
         }
-
+        lappend entries $fullpath
+        if {[string index $fullpath $destpathLen+1] ne "+" && [file isfile $fullpath]} {
+            lappend regular_files $fullpath
+        }
+    }
+    # checksum all files at once, reading as many as the build runs jobs
+    set jobs 1
+    if {[exists build.jobs] && [string is integer -strict [option build.jobs]]} {
+        set jobs [expr {max(1, [option build.jobs])}]
+    }
+    ui_debug "checksumming [llength $regular_files] files with $jobs threads"
+    foreach fullpath $regular_files sums [checksum files -types md5 -threads $jobs $regular_files] {
+        set checksums($fullpath) [lindex $sums 1]
+    }
+    foreach fullpath $entries {
         set relpath [string range $fullpath $destpathLen+1 end]
         if {[string index $relpath 0] ne "+"} {
             puts $fd "$relpath"
             set abspath [file join [file separator] $relpath]
             lappend installPlist $abspath
-            if {[file isfile $fullpath]} {
-                ui_debug "checksum file: $fullpath"
-                set checksum [md5 file $fullpath]
-                puts $fd "@comment MD5:$checksum"
+            if {[info exists checksums($fullpath)]} {
+                puts $fd "@comment MD5:$checksums($fullpath)"
                 if {$have_fileIsBinary} {
                     # test if (mach-o) binary
                     set is_binary [fileIsBinary $fullpath]
@@ -316,7 +355,13 @@ proc portinstall::create_archive {location archive.type} {
 
     # Now create the archive
     ui_debug "Creating [file tail $location]"
-    command_exec archive
+    if {${archive.cmd} eq ""} {
+        # compress with as many threads as the build used
+        ui_debug "compressing with $jobs threads"
+        archive create -threads $jobs $location ${archive.dir}
+    } else {
+        command_exec archive
+    }
     ui_debug "Archive [file tail $location] packaged"
 
     # Cleanup all control files when finished
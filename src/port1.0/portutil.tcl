@@ -1164,9 +1164,41 @@ proc touch {args} {
 }
 
 # copy
-# Wrapper for file copy
+# Wrapper for file copy that copies regular files with fastcopy, which clones
+# them or has the kernel copy them where the file system allows it
 proc copy {args} {
-    file copy {*}$args
+    set options {}
+    while {[string match "-*" [lindex $args 0]]} {
+        set arg [string range [lindex $args 0] 1 end]
+        set args [lreplace $args 0 0]
+        switch -- $arg {
+            force {lappend options -$arg}
+            - break
+            default {return -code error "copy: illegal option -- $arg"}
+        }
+    }
+    lappend options --
+    set target [lindex $args end]
+    set sources [lrange $args 0 end-1]
+    if {[llength $sources] == 0 || ([llength $sources] > 1 && ![file isdirectory $target])} {
+        # let file copy complain
+        file copy {*}$options {*}$args
+        return
+    }
+    foreach source $sources {
+        if {[file isdirectory $target]} {
+            set dest [file join $target [file tail $source]]
+        } else {
+            set dest $target
+        }
+        # anything else, including overwriting, is left to file copy
+        if {![catch {file type $source} type] && $type eq "file"
+                && [catch {file lstat $dest dest_stat}]} {
+            fastcopy $source $dest
+        } else {
+            file copy {*}$options $source $target
+        }
+    }
 }
 
 # move
@@ -2589,7 +2621,7 @@ proc supportedArchiveTypes {} {
     global supported_archive_types
     if {![info exists supported_archive_types]} {
         set supported_archive_types {}
-        foreach type {tbz2 tbz tgz tar txz tlz xar zip cpgz cpio} {
+        foreach type {tbz2 tbz tgz tar txz tlz tzst xar zip cpgz cpio} {
             if {[catch {archiveTypeIsSupported $type}] == 0} {
                 lappend supported_archive_types $type
             }
@@ -2664,6 +2696,20 @@ proc archiveTypeIsSupported {type} {
                 }
             }
         }
+        tzst {
+            # read and written by Pextlib if it was built with zstd,
+            # otherwise by tar and zstd
+            if {[archive supported archive.tzst]} {
+                return 0
+            }
+            set tar "tar"
+            if {[catch {set tar [findBinary $tar ${portutil::autoconf::tar_path}]} errmsg] == 0} {
+                set zstd "zstd"
+                if {[catch {set zstd [findBinary $zstd ""]} errmsg] == 0} {
+                    return 0
+                }
+            }
+        }
         xar {
             set xar "xar"
             if {[catch {set xar [findBinary $xar ${portutil::autoconf::xar_path}]} errmsg] == 0} {
@@ -2722,6 +2768,16 @@ proc extract_archive_metadata {archive_location archive_type metadata_type} {
         tlz {
             set raw_contents [exec -ignorestderr [findBinary tar ${portutil::autoconf::tar_path}] -xO${qflag}f $archive_location --use-compress-program [findBinary lzma ""] ./+CONTENTS]
         }
+        tzst {
+            if {[archive supported $archive_location]} {
+                # only decompresses the frames holding the metadata if the
+                # archive has an index of them; without the final newline,
+                # like exec
+                regsub {\n$} [archive read $archive_location ./+CONTENTS] {} raw_contents
+            } else {
+                set raw_contents [exec -ignorestderr [findBinary tar ${portutil::autoconf::tar_path}] -xO${qflag}f $archive_location --use-compress-program [findBinary zstd ""] ./+CONTENTS]
+            }
+        }
         xar {
             system -W ${tempdir} "[findBinary xar ${portutil::autoconf::xar_path}] -xf $archive_location +CONTENTS"
         }
@@ -3055,117 +3111,37 @@ proc exec_as_uid {uid code} {
     return -code $retcode $result
 }
 
-# dependency analysis helpers
+# dependency analysis helpers; the tests themselves are done by
+# _mportdeptest and _mportdepport in macports1.0, so that they can be done
+# for ports opened from the cache without evaluating them
+
+# returns what the dependency tests need to know about this port
+proc _depspec_context {} {
+    global prefix frameworks_dir os.platform
+    return [list $prefix $frameworks_dir ${os.platform}]
+}
 
 ### _libtest is private; subject to change without notice
-# XXX - Architecture specific
-# XXX - Rely on information from internal defines in cctools/dyld:
-# define DEFAULT_FALLBACK_FRAMEWORK_PATH
-# /Library/Frameworks:/Library/Frameworks:/Network/Library/Frameworks:/System/Library/Frameworks
-# define DEFAULT_FALLBACK_LIBRARY_PATH /lib:/usr/local/lib:/lib:/usr/lib
-#   -- Since /usr/local is bad, using /lib:/usr/lib only.
-# Environment variables DYLD_FRAMEWORK_PATH, DYLD_LIBRARY_PATH,
-# DYLD_FALLBACK_FRAMEWORK_PATH, and DYLD_FALLBACK_LIBRARY_PATH take precedence
 
 proc _libtest {depspec {return_match 0}} {
-    global env prefix frameworks_dir os.platform
-    set depline [lindex [split $depspec :] 1]
-
-    if {[info exists env(DYLD_FRAMEWORK_PATH)]} {
-        lappend search_path $env(DYLD_FRAMEWORK_PATH)
-    } else {
-        lappend search_path ${frameworks_dir} /Library/Frameworks /Network/Library/Frameworks /System/Library/Frameworks
-    }
-    if {[info exists env(DYLD_FALLBACK_FRAMEWORK_PATH)]} {
-        lappend search_path $env(DYLD_FALLBACK_FRAMEWORK_PATH)
-    }
-    if {[info exists env(DYLD_LIBRARY_PATH)]} {
-        lappend search_path $env(DYLD_LIBRARY_PATH)
-    }
-    lappend search_path /lib /usr/lib ${prefix}/lib
-    if {[info exists env(DYLD_FALLBACK_LIBRARY_PATH)]} {
-        lappend search_path $env(DYLD_FALLBACK_LIBRARY_PATH)
-    }
-
-    set i [string first . $depline]
-    if {$i < 0} {set i [string length $depline]}
-    set depname [string range $depline 0 [expr {$i - 1}]]
-    set depversion [string range $depline $i end]
-    regsub {\.} $depversion {\.} depversion
-    if {${os.platform} eq "darwin"} {
-        set depregex \^${depname}${depversion}\\.dylib\$
-    } else {
-        set depregex \^${depname}\\.so${depversion}\$
-    }
-
-    return [_mportsearchpath $depregex $search_path 0 $return_match]
+    return [_mportdeptest $depspec [_depspec_context] $return_match]
 }
 
 ### _bintest is private; subject to change without notice
 
 proc _bintest {depspec {return_match 0}} {
-    global env
-    set depregex [lindex [split $depspec :] 1]
-
-    set search_path [split $env(PATH) :]
-
-    set depregex \^$depregex\$
-
-    return [_mportsearchpath $depregex $search_path 1 $return_match]
+    return [_mportdeptest $depspec [_depspec_context] $return_match]
 }
 
 ### _pathtest is private; subject to change without notice
 
 proc _pathtest {depspec {return_match 0}} {
-    global prefix
-    set depregex [lindex [split $depspec :] 1]
-
-    # separate directory from regex
-    set fullname $depregex
-
-    regexp {^(.*)/(.*?)$} "$fullname" match search_path depregex
-
-    if {[string index $search_path 0] ne "/"} {
-        # Prepend prefix if not an absolute path
-        set search_path "${prefix}/${search_path}"
-    }
-
-    set depregex \^$depregex\$
-
-    return [_mportsearchpath $depregex $search_path 0 $return_match]
+    return [_mportdeptest $depspec [_depspec_context] $return_match]
 }
 
 # returns the name of the port that will actually be satisfying $depspec
 proc _get_dep_port {depspec} {
-    set speclist [split $depspec :]
-    set portname [lindex $speclist end]
-    set res [_portnameactive $portname]
-    if {$res != 0} {
-        return $portname
-    }
-    
-    set depfile ""
-    switch [lindex $speclist 0] {
-        bin {
-            set depfile [_bintest $depspec 1]
-        }
-        lib {
-            set depfile [_libtest $depspec 1]
-        }
-        path {
-            set depfile [_pathtest $depspec 1]
-        }
-    }
-    if {$depfile eq ""} {
-        return $portname
-    } else {
-        set theport [registry_file_registered $depfile]
-        if {$theport != 0} {
-            return $theport
-        } else {
-            return ""
-        }
-    }
+    return [_mportdepport $depspec [_depspec_context]]
 }
 
 # returns the list of archs that the port is targeting
@@ -3371,27 +3347,36 @@ proc _check_xcode_version {} {
 
 # check if we can unarchive this port
 proc _archive_available {} {
-    global ports_source_only porturl portutil::archive_available_result
+    global portutil::archive_available_result
 
-    if {[info exists archive_available_result]} {
-        return $archive_available_result
+    if {![info exists archive_available_result]} {
+        set archive_available_result [archive_available [_archive_lookup]]
     }
+    return $archive_available_result
+}
 
-    if {[tbool ports_source_only]} {
-        set archive_available_result 0
-        return 0
-    }
+# returns where archive_available looks for an archive of this port: whether
+# only building from source is allowed, the registry entry and local paths
+# of the archive, whether porturl is the archive and its URL on the server
+proc _archive_lookup {} {
+    global ports_source_only porturl portdbpath subport version revision \
+           portvariants force_archive_refresh
 
-    if {[find_portarchive_path] ne ""} {
-        set archive_available_result 1
-        return 1
+    if {[tbool ports_source_only]} {
+        return [dict create source_only 1]
     }
-
     set archiverootname [file rootname [get_portimage_name]]
-    if {[file rootname [file tail $porturl]] eq $archiverootname && [file extension $porturl] ne ""} {
-        set archive_available_result 1
-        return 1
+    set paths [list]
+    foreach unarchive.type [supportedArchiveTypes] {
+        set fullarchivename "${archiverootname}.${unarchive.type}"
+        lappend paths [file join $portdbpath software $subport $fullarchivename] \
+                      [file join $portdbpath incoming/verified $fullarchivename]
     }
+    set lookup [dict create source_only 0 \
+        entry [list $subport $version $revision $portvariants] \
+        refresh [tbool force_archive_refresh] paths $paths url {}]
+    dict set lookup porturl [expr {[file rootname [file tail $porturl]] eq $archiverootname
+                                   && [file extension $porturl] ne ""}]
 
     # check if there's an archive available on the server
     global archive_sites
@@ -3400,8 +3385,7 @@ proc _archive_available {} {
         set mirrors [lindex [split [lindex $archive_sites 0] :] 0]
     }
     if {$mirrors eq {}} {
-        set archive_available_result 0
-        return 0
+        return $lookup
     }
     set archivetype $portfetch::mirror_sites::archive_type($mirrors)
     set archivename "${archiverootname}.${archivetype}"
@@ -3423,14 +3407,6 @@ proc _archive_available {} {
     } else {
         append site [option archive.subdir]
     }
-    set url [portfetch::assemble_url $site $archivename]
-    # curl getsize can return -1 instead of throwing an error for
-    # nonexistent files on FTP sites.
-    if {![catch {curl getsize $url} size] && $size > 0} {
-        set archive_available_result 1
-        return 1
-    }
-
-    set archive_available_result 0
-    return 0
+    dict set lookup url [portfetch::assemble_url $site $archivename]
+    return $lookup
 }
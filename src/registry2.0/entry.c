@@ -240,13 +240,131 @@ static strategy_type strategies[] = {
     { NULL, 0 }
 };
 
+/**
+ * Parses search criteria of the form `?key ?options? value ...?` as accepted
+ * by `registry::entry search`. `keys`, `vals` and `strats` need to have room
+ * for `objc` elements; the strings stored in them belong to the given objects.
+ *
+ * @param [in] interp     Tcl interpreter to report errors in
+ * @param [in] objc       number of words of criteria
+ * @param [in] objv       words of criteria
+ * @param [out] keys      keys to search by
+ * @param [out] vals      values to search by, matching keys
+ * @param [out] strats    strategies to use, matching keys
+ * @param [out] key_count number of keys
+ * @return                TCL_OK if success; TCL_ERROR if failure
+ */
+static int entry_search_criteria(Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST *objv, const char** keys, const char** vals,
+        int* strats, int* key_count) {
+    *key_count = 0;
+    for (int i = 0; i < objc; ++*key_count /* i in incremented in the loop */) {
+        int key_index, strategy_index;
+
+        /* Grab the key */
+        if (Tcl_GetIndexFromObj(interp, objv[i], entry_props, "search key",
+            0, &key_index) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        keys[*key_count] = entry_props[key_index];
+        if (objc <= ++i) {
+            goto missing_value; /* We're missing a strategy or value */
+        }
+
+        /* Set the default strategy, in case we don't find one */
+        strats[*key_count] = reg_strategy_exact;
+        /* Try to grab the strategy */
+        if (Tcl_GetIndexFromObjStruct(interp, objv[i], strategies,
+                sizeof(strategy_type), "option", 0, &strategy_index) !=
+                TCL_ERROR) {
+            strats[*key_count] = strategies[strategy_index].strategy;
+            if (objc <= ++i && strats[*key_count] != reg_strategy_null) {
+                goto missing_value;
+            } else if (strats[*key_count] == reg_strategy_null) {
+                /* This doesn't take a value, so start from the top */
+                continue;
+            }
+        }
+
+        /* Grab the value */
+        vals[*key_count] = Tcl_GetString(objv[i++]);
+    }
+    Tcl_ResetResult(interp);
+    return TCL_OK;
+
+missing_value:
+    Tcl_ResetResult(interp);
+    Tcl_AppendResult(interp, "missing value for search key \"",
+            keys[*key_count], "\"", NULL);
+    return TCL_ERROR;
+}
+
+/**
+ * Runs `reg_entry_search_props` and sets the interpreter result to a list with
+ * a dict of the requested properties for each matching port. Properties which
+ * are NULL in the registry are left out of the dicts.
+ */
+static int entry_search_props(Tcl_Interp* interp, reg_registry* reg,
+        Tcl_Obj* props, const char** keys, const char** vals, int key_count,
+        int* strats) {
+    Tcl_Obj** listv;
+    const char** columns;
+    char** rows;
+    reg_error error;
+    int listc;
+    int row_count;
+    int index;
+    int i, j;
+    if (Tcl_ListObjGetElements(interp, props, &listc, &listv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    columns = malloc((listc + 1) * sizeof(char*));
+    if (!columns) {
+        return TCL_ERROR;
+    }
+    for (i = 0; i < listc; i++) {
+        if (Tcl_GetIndexFromObj(interp, listv[i], entry_props, "prop", 0,
+                    &index) != TCL_OK) {
+            free(columns);
+            return TCL_ERROR;
+        }
+        columns[i] = entry_props[index];
+    }
+    row_count = reg_entry_search_props(reg, columns, listc, keys, vals,
+            key_count, strats, &rows, &error);
+    if (row_count < 0) {
+        free(columns);
+        return registry_failed(interp, &error);
+    }
+    Tcl_Obj* resultObj = Tcl_NewListObj(0, NULL);
+    for (i = 0; i < row_count; i++) {
+        Tcl_Obj* row = Tcl_NewDictObj();
+        for (j = 0; j < listc; j++) {
+            char* value = rows[i * listc + j];
+            if (value != NULL) {
+                Tcl_DictObjPut(interp, row, Tcl_NewStringObj(columns[j], -1),
+                        Tcl_NewStringObj(value, -1));
+                free(value);
+            }
+        }
+        Tcl_ListObjAppendElement(interp, resultObj, row);
+    }
+    free(rows);
+    free(columns);
+    Tcl_SetObjResult(interp, resultObj);
+    return TCL_OK;
+}
+
 /*
- * registry::entry search ?key value ...?
+ * registry::entry search ?-props prop-list? ?key value ...?
  *
  * Searches the registry for ports for which each key's value is equal to the
  * given value. To find all ports, call `entry search` with no key-value pairs.
  * Can be given an option of -exact, -glob, -regexp or -null to specify the
  * matching strategy; defaults to exact.
+ *
+ * If -props is given, no entries are opened; instead, a list containing a
+ * dict of the listed properties for each matching port is returned.
  */
 static int entry_search(Tcl_Interp* interp, int objc, Tcl_Obj* CONST *objv) {
     reg_registry *reg = registry_for(interp, reg_attached);
@@ -256,6 +374,7 @@ static int entry_search(Tcl_Interp* interp, int objc, Tcl_Obj* CONST *objv) {
     const char **keys = malloc(objc * sizeof(char *));
     const char **vals = malloc(objc * sizeof(char *));
     int *strats = malloc(objc * sizeof(int));
+    Tcl_Obj* props = NULL;
     if (!keys || !vals || !strats) {
         goto cleanup_error;
     }
@@ -265,38 +384,27 @@ static int entry_search(Tcl_Interp* interp, int objc, Tcl_Obj* CONST *objv) {
     objv += 2;
     objc -= 2;
 
-    for (int i = 0; i < objc; ++key_count /* i in incremented in the loop */) {
-        int key_index, strategy_index;
-
-        /* Grab the key */
-        if (Tcl_GetIndexFromObj(interp, objv[i], entry_props, "search key",
-            0, &key_index) != TCL_OK) {
-            goto cleanup_error;
-        }
-        keys[key_count] = entry_props[key_index];
-        if (objc <= ++i) {
-            goto wrong_num_args; /* We're missing a strategy or value */
+    if (objc >= 1 && strcmp(Tcl_GetString(objv[0]), "-props") == 0) {
+        if (objc < 2) {
+            goto wrong_num_args;
         }
+        props = objv[1];
+        objv += 2;
+        objc -= 2;
+    }
 
-        /* Set the default strategy, in case we don't find one */
-        strats[key_count] = reg_strategy_exact;
-        /* Try to grab the strategy */
-        if (Tcl_GetIndexFromObjStruct(interp, objv[i], strategies,
-                sizeof(strategy_type), "option", 0, &strategy_index) !=
-                TCL_ERROR) {
-            strats[key_count] = strategies[strategy_index].strategy;
-            if (objc <= ++i && strats[key_count] != reg_strategy_null) {
-                goto wrong_num_args;
-            } else if (strats[key_count] == reg_strategy_null) {
-                /* This doesn't take a value, so start from the top */
-                continue;
-            }
-        }
+    if (entry_search_criteria(interp, objc, objv, keys, vals, strats,
+                &key_count) != TCL_OK) {
+        goto cleanup_error;
+    }
 
-        /* Grab the value */
-        if (!(vals[key_count] = Tcl_GetString(objv[i++]))) {
-            goto wrong_num_args; /* We're missing a value */
-        }
+    if (props != NULL) {
+        int retval = entry_search_props(interp, reg, props, keys, vals,
+                key_count, strats);
+        free(keys);
+        free(vals);
+        free(strats);
+        return retval;
     }
 
     reg_entry **entries;
@@ -328,7 +436,7 @@ static int entry_search(Tcl_Interp* interp, int objc, Tcl_Obj* CONST *objv) {
 
 wrong_num_args:
     Tcl_WrongNumArgs(interp, 2, objv,
-            "search ?key ?options? value ...?");
+            "search ?-props prop-list? ?key ?options? value ...?");
 cleanup_error:
     free(keys);
     free(vals);
@@ -336,6 +444,63 @@ cleanup_error:
     return TCL_ERROR;
 }
 
+/*
+ * registry::entry foreach varList criteria body
+ *
+ * Evaluates body once for each port matching the search criteria, which take
+ * the same form as the arguments of `entry search`. Each variable in varList
+ * must be named after a port property and is set to that property's value for
+ * the current port. Rows are read from the registry in small chunks, and no
+ * entry objects are created. The registry isn't locked while the body runs.
+ * The body may use break and continue.
+ */
+static int entry_foreach(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]) {
+    reg_registry* reg = registry_for(interp, reg_attached);
+    if (objc != 5) {
+        Tcl_WrongNumArgs(interp, 2, objv, "varList criteria body");
+        return TCL_ERROR;
+    } else if (reg == NULL) {
+        return TCL_ERROR;
+    } else {
+        Tcl_Obj** crit_objv;
+        int crit_objc;
+        const char** keys;
+        const char** vals;
+        int* strats;
+        int key_count;
+        foreach_data data;
+        reg_error error;
+        int result;
+        if (Tcl_ListObjGetElements(interp, objv[3], &crit_objc, &crit_objv)
+                != TCL_OK) {
+            return TCL_ERROR;
+        }
+        keys = malloc((crit_objc + 1) * sizeof(char*));
+        vals = malloc((crit_objc + 1) * sizeof(char*));
+        strats = malloc((crit_objc + 1) * sizeof(int));
+        if (!keys || !vals || !strats
+                || entry_search_criteria(interp, crit_objc, crit_objv, keys,
+                    vals, strats, &key_count) != TCL_OK
+                || foreach_init(interp, &data, objv[2], objv[4], entry_props)
+                    != TCL_OK) {
+            free(keys);
+            free(vals);
+            free(strats);
+            return TCL_ERROR;
+        }
+        result = reg_entry_foreach(reg, data.columns, data.var_count, keys,
+                vals, key_count, strats, foreach_row, &data, &error);
+        foreach_free(&data);
+        free(keys);
+        free(vals);
+        free(strats);
+        if (!result) {
+            return registry_failed(interp, &error);
+        }
+        return foreach_result(&data);
+    }
+}
+
 /*
  * registry::entry exists name
  *
@@ -494,6 +659,79 @@ static int entry_owner(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]) {
     }
 }
 
+/*
+ * registry::entry owners path-list [cs = true]
+ *
+ * Looks up the owners of all the given paths in a single query. Returns a
+ * list of path/port pairs, suitable for `array set`, containing only the paths
+ * that belong to an active port.
+ */
+static int entry_owners(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]) {
+    reg_registry* reg = registry_for(interp, reg_attached);
+    int cs = 1;
+    Tcl_Obj** listv;
+    int listc;
+
+    if ((objc < 3) || (objc > 4)) {
+        Tcl_WrongNumArgs(interp, 2, objv, "path-list ?cs?");
+        return TCL_ERROR;
+    }
+
+    if (objc == 4) {
+        if (Tcl_GetBooleanFromObj(interp, objv[3], &cs) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+
+    if (Tcl_ListObjGetElements(interp, objv[2], &listc, &listv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    if (reg == NULL) {
+        return TCL_ERROR;
+    } else {
+        char** paths;
+        char** owned;
+        reg_entry** owners;
+        reg_error error;
+        int owned_count;
+        if (!list_obj_to_string(&paths, listv, listc, &error)) {
+            return registry_failed(interp, &error);
+        }
+        owned_count = reg_entry_owners(reg, paths, listc, cs, &owned, &owners,
+                &error);
+        free(paths);
+        if (owned_count >= 0) {
+            Tcl_Obj* resultObj = Tcl_NewListObj(0, NULL);
+            int result = TCL_OK;
+            int lower_bound = 0;
+            int i;
+            for (i=0; i<owned_count; i++) {
+                Tcl_Obj* owner;
+                if (result == TCL_OK) {
+                    if (entry_to_obj(interp, &owner, owners[i], &lower_bound,
+                                &error)) {
+                        Tcl_ListObjAppendElement(interp, resultObj,
+                                Tcl_NewStringObj(owned[i], -1));
+                        Tcl_ListObjAppendElement(interp, resultObj, owner);
+                    } else {
+                        result = TCL_ERROR;
+                    }
+                }
+                free(owned[i]);
+            }
+            free(owned);
+            free(owners);
+            if (result == TCL_OK) {
+                Tcl_SetObjResult(interp, resultObj);
+                return TCL_OK;
+            }
+            Tcl_DecrRefCount(resultObj);
+        }
+        return registry_failed(interp, &error);
+    }
+}
+
 typedef struct {
     char* name;
     int (*function)(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
@@ -506,10 +744,12 @@ static entry_cmd_type entry_cmds[] = {
     { "open", entry_open },
     { "close", entry_close },
     { "search", entry_search },
+    { "foreach", entry_foreach },
     { "exists", entry_exists },
     { "imaged", entry_imaged },
     { "installed", entry_installed },
     { "owner", entry_owner },
+    { "owners", entry_owners },
     { NULL, NULL }
 };
 
@@ -108,6 +108,66 @@ static int entry_obj_prop(Tcl_Interp* interp, reg_entry* entry, int objc,
     }
 }
 
+/* ${entry} props prop-list */
+static int entry_obj_props(Tcl_Interp* interp, reg_entry* entry, int objc,
+        Tcl_Obj* CONST objv[]) {
+    reg_registry* reg = registry_for(interp, reg_attached);
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "prop-list");
+        return TCL_ERROR;
+    } else if (reg == NULL) {
+        return TCL_ERROR;
+    } else {
+        const char** keys;
+        char** values;
+        reg_error error;
+        Tcl_Obj** listv;
+        Tcl_Obj* result;
+        int listc;
+        int index;
+        int i;
+        if (Tcl_ListObjGetElements(interp, objv[2], &listc, &listv) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        result = Tcl_NewDictObj();
+        if (listc == 0) {
+            Tcl_SetObjResult(interp, result);
+            return TCL_OK;
+        }
+        keys = malloc(listc * sizeof(char*));
+        if (!keys) {
+            Tcl_DecrRefCount(result);
+            return TCL_ERROR;
+        }
+        for (i=0; i<listc; i++) {
+            if (Tcl_GetIndexFromObj(interp, listv[i], entry_props, "prop", 0,
+                        &index) != TCL_OK) {
+                Tcl_DecrRefCount(result);
+                free(keys);
+                return TCL_ERROR;
+            }
+            keys[i] = entry_props[index];
+        }
+        if (!reg_entry_propget_many(entry, keys, listc, &values, &error)) {
+            Tcl_DecrRefCount(result);
+            free(keys);
+            return registry_failed(interp, &error);
+        }
+        for (i=0; i<listc; i++) {
+            /* properties that are NULL in the registry are left out */
+            if (values[i] != NULL) {
+                Tcl_DictObjPut(interp, result, Tcl_NewStringObj(keys[i], -1),
+                        Tcl_NewStringObj(values[i], -1));
+                free(values[i]);
+            }
+        }
+        free(values);
+        free(keys);
+        Tcl_SetObjResult(interp, result);
+        return TCL_OK;
+    }
+}
+
 typedef struct {
     char* name;
     int (*function)(reg_entry* entry, char** files, int file_count,
@@ -436,6 +496,7 @@ static entry_obj_cmd_type entry_cmds[] = {
     { "requested", entry_obj_prop },
     { "cxx_stdlib", entry_obj_prop },
     { "cxx_stdlib_overridden", entry_obj_prop },
+    { "props", entry_obj_props },
     /* filemap */
     { "map", entry_obj_filemap },
     { "unmap", entry_obj_filemap },
@@ -135,6 +135,79 @@ static strategy_type strategies[] = {
     { NULL, 0 }
 };
 
+/**
+ * Parses search criteria of the form `?key ?options? value ...?` as accepted
+ * by `registry::file search`. The arrays returned in `keys`, `vals` and
+ * `strats` need to be freed by the caller; the strings in them belong to the
+ * given objects.
+ *
+ * @param [in] interp     Tcl interpreter to report errors in
+ * @param [in] objc       number of words of criteria
+ * @param [in] objv       words of criteria
+ * @param [out] keys      keys to search by
+ * @param [out] vals      values to search by, matching keys
+ * @param [out] strats    strategies to use, matching keys
+ * @param [out] key_count number of keys
+ * @return                TCL_OK if success; TCL_ERROR if failure
+ */
+static int file_search_criteria(Tcl_Interp* interp, int objc,
+        Tcl_Obj* CONST objv[], char*** keys, char*** vals, int** strats,
+        int* key_count) {
+    int i, j;
+    *keys = malloc(objc * sizeof(char*));
+    *vals = malloc(objc * sizeof(char*));
+    *strats = malloc(objc * sizeof(int));
+    if (!*keys || !*vals || !*strats) {
+        goto cleanup_error;
+    }
+    for (i = 0, j = 0; i < objc; j++) {
+        int index, strat_index, val_length;
+        if (Tcl_GetIndexFromObj(interp, objv[i], file_props, "search key",
+                    0, &index) != TCL_OK) {
+            goto cleanup_error;
+        }
+        (*keys)[j] = (char*)file_props[index];
+
+        /* we ate the key value */
+        i++;
+
+        /* check whether there's a strategy */
+        (*strats)[j] = reg_strategy_exact;
+        if (i < objc && Tcl_GetString(objv[i])[0] == '-'
+                && Tcl_GetIndexFromObjStruct(interp, objv[i], strategies,
+                    sizeof(strategy_type), "option", 0, &strat_index)
+                != TCL_ERROR) {
+            /* this key has a strategy specified, eat the strategy parameter */
+            i++;
+            (*strats)[j] = strategies[strat_index].strategy;
+        }
+
+        if ((*strats)[j] == reg_strategy_null) {
+            (*vals)[j] = NULL;
+            continue;
+        }
+
+        /* this key must also have a value */
+        if (i >= objc || Tcl_GetStringFromObj(objv[i], &val_length) == NULL
+                || val_length == 0) {
+            Tcl_ResetResult(interp);
+            Tcl_AppendResult(interp, "missing value for search key \"",
+                    (*keys)[j], "\"", NULL);
+            goto cleanup_error;
+        }
+        (*vals)[j] = Tcl_GetString(objv[i++]);
+    }
+    Tcl_ResetResult(interp);
+    *key_count = j;
+    return TCL_OK;
+
+cleanup_error:
+    free(*keys);
+    free(*vals);
+    free(*strats);
+    return TCL_ERROR;
+}
+
 /*
  * registry::file search ?key value ...?
  *
@@ -144,7 +217,6 @@ static strategy_type strategies[] = {
  * specify the matching strategy; defaults to exact.
  */
 static int file_search(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]) {
-    int i, j;
     reg_registry* reg = registry_for(interp, reg_attached);
     if (reg == NULL) {
         return TCL_ERROR;
@@ -152,87 +224,14 @@ static int file_search(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]) {
         char** keys;
         char** vals;
         int* strats;
-        int key_count = 0;
+        int key_count;
         reg_file** files;
         reg_error error;
         int file_count;
-        for (i = 2; i < objc;) {
-            int index, strat_index, val_length;
-            if (Tcl_GetIndexFromObj(interp, objv[i], file_props, "search key",
-                        0, &index) != TCL_OK) {
-                return TCL_ERROR;
-            }
-
-            /* we ate the key value */
-            i++;
-
-            /* check whether there's a strategy */
-            if (Tcl_GetString(objv[i])[0] == '-'
-                    && Tcl_GetIndexFromObjStruct(interp, objv[i], strategies,
-                        sizeof(strategy_type), "option", 0, &strat_index)
-                    != TCL_ERROR) {
-                /* this key has a strategy specified, eat the strategy parameter */
-                i++;
-
-                if (strategies[strat_index].strategy != reg_strategy_null) {
-                    /* this key must also have a value */
-
-                    if (Tcl_GetStringFromObj(objv[i], &val_length) == NULL
-                            || val_length == 0) {
-                        Tcl_WrongNumArgs(interp, 2, objv,
-                                "search ?key ?options? value ...?");
-                        return TCL_ERROR;
-                    }
-
-                    i++;
-                }
-            } else {
-                /* this key must also have a value */
-
-                if (Tcl_GetStringFromObj(objv[i], &val_length) == NULL
-                        || val_length == 0) {
-                    Tcl_WrongNumArgs(interp, 2, objv,
-                            "search ?key ?options? value ...?");
-                    return TCL_ERROR;
-                }
-
-                i++;
-            }
-
-            key_count++;
-        }
-
-        keys = malloc(key_count * sizeof(char*));
-        vals = malloc(key_count * sizeof(char*));
-        strats = malloc(key_count * sizeof(int));
-        if (!keys || !vals || !strats) {
+        if (file_search_criteria(interp, objc - 2, objv + 2, &keys, &vals,
+                    &strats, &key_count) != TCL_OK) {
             return TCL_ERROR;
         }
-        for (i = 2, j = 0; i < objc && j < key_count; j++) {
-            int strat_index;
-
-            keys[j] = Tcl_GetString(objv[i++]);
-
-            /* try to get the strategy */
-            if (Tcl_GetString(objv[i])[0] == '-'
-                    && Tcl_GetIndexFromObjStruct(interp, objv[i], strategies,
-                        sizeof(strategy_type), "option", 0, &strat_index)
-                    != TCL_ERROR) {
-                /* this key has a strategy specified */
-                i++;
-
-                strats[j] = strategies[strat_index].strategy;
-            } else {
-                /* use default strategy */
-                strats[j] = reg_strategy_exact;
-            }
-
-            if (strats[j] != reg_strategy_null) {
-                vals[j] = Tcl_GetString(objv[i++]);
-            } else {
-                vals[j] = NULL;
-            }
-        }
         file_count = reg_file_search(reg, keys, vals, strats, key_count,
                 &files, &error);
         free(keys);
@@ -257,6 +256,94 @@ static int file_search(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]) {
     }
 }
 
+/*
+ * registry::file foreach varList criteria body
+ *
+ * Evaluates body once for each file matching the search criteria, which take
+ * the same form as the arguments of `file search`. Each variable in varList
+ * must be named after a file property and is set to that property's value for
+ * the current file. Rows are read from the registry in small chunks, and no
+ * file objects are created, so this is suitable for iterating over a large
+ * number of files. The registry isn't locked while the body runs, so it may
+ * take long and other processes can write meanwhile. The body may use break
+ * and continue.
+ */
+static int file_foreach(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]) {
+    reg_registry* reg = registry_for(interp, reg_attached);
+    if (objc != 5) {
+        Tcl_WrongNumArgs(interp, 2, objv, "varList criteria body");
+        return TCL_ERROR;
+    } else if (reg == NULL) {
+        return TCL_ERROR;
+    } else {
+        Tcl_Obj** crit_objv;
+        int crit_objc;
+        char** keys;
+        char** vals;
+        int* strats;
+        int key_count;
+        foreach_data data;
+        reg_error error;
+        int result;
+        if (Tcl_ListObjGetElements(interp, objv[3], &crit_objc, &crit_objv)
+                != TCL_OK
+                || file_search_criteria(interp, crit_objc, crit_objv, &keys,
+                    &vals, &strats, &key_count) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (foreach_init(interp, &data, objv[2], objv[4], file_props)
+                != TCL_OK) {
+            free(keys);
+            free(vals);
+            free(strats);
+            return TCL_ERROR;
+        }
+        result = reg_file_foreach(reg, data.columns, data.var_count, keys,
+                vals, strats, key_count, foreach_row, &data, &error);
+        foreach_free(&data);
+        free(keys);
+        free(vals);
+        free(strats);
+        if (!result) {
+            return registry_failed(interp, &error);
+        }
+        return foreach_result(&data);
+    }
+}
+
+/*
+ * registry::file count ?key value ...?
+ *
+ * Returns the number of files matching the search criteria, which take the
+ * same form as the arguments of `file search`.
+ */
+static int file_count(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]) {
+    reg_registry* reg = registry_for(interp, reg_attached);
+    if (reg == NULL) {
+        return TCL_ERROR;
+    } else {
+        char** keys;
+        char** vals;
+        int* strats;
+        int key_count;
+        reg_error error;
+        int count;
+        if (file_search_criteria(interp, objc - 2, objv + 2, &keys, &vals,
+                    &strats, &key_count) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        count = reg_file_count(reg, keys, vals, strats, key_count, &error);
+        free(keys);
+        free(vals);
+        free(strats);
+        if (count < 0) {
+            return registry_failed(interp, &error);
+        }
+        Tcl_SetObjResult(interp, Tcl_NewIntObj(count));
+        return TCL_OK;
+    }
+}
+
 typedef struct {
     char* name;
     int (*function)(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
@@ -267,6 +354,8 @@ static file_cmd_type file_cmds[] = {
     { "open", file_open },
     { "close", file_close },
     { "search", file_search },
+    { "foreach", file_foreach },
+    { "count", file_count },
     { NULL, NULL }
 };
 
@@ -293,6 +293,22 @@ proc _activate_file {srcfile dstfile} {
             }
             return 0
         }
+        file {
+            ui_debug "activating file: $dstfile"
+            if {[catch {::file lstat $dstfile dststat}] && [_crosses_device $srcfile $dstfile]} {
+                # file rename would copy the data through a buffer
+                fastcopy $srcfile $dstfile
+                if {[getuid] == 0} {
+                    ::file attributes $dstfile -owner [::file attributes $srcfile -owner] \
+                        -group [::file attributes $srcfile -group] \
+                        -permissions [::file attributes $srcfile -permissions]
+                }
+                ::file delete $srcfile
+            } else {
+                ::file rename $srcfile $dstfile
+            }
+            return 1
+        }
         default {
             ui_debug "activating file: $dstfile"
             ::file rename $srcfile $dstfile
@@ -301,6 +317,31 @@ proc _activate_file {srcfile dstfile} {
     }
 }
 
+# Whether srcfile and the directory dstfile is to be created in are on
+# different file systems.
+proc _crosses_device {srcfile dstfile} {
+    ::file stat $srcfile srcstat
+    ::file stat [::file dirname $dstfile] dststat
+    return [expr {$srcstat(dev) != $dststat(dev)}]
+}
+
+# Whether the image at location can be extracted by Pextlib's archive
+# command straight to where its files are activated, instead of to a
+# temporary directory they are then moved from.
+proc _can_extract_in_place {location} {
+    global macports::hfscompression
+    if {![archive supported $location]} {
+        return 0
+    }
+    # HFS+ compression is only done by bsdtar
+    if {${macports::hfscompression} &&
+            ![catch {macports::binaryInPath bsdtar}] &&
+            ![catch {exec bsdtar -x --hfsCompression < /dev/null >& /dev/null}]} {
+        return 0
+    }
+    return 1
+}
+
 # extract an archive to a temporary location
 # returns: path to the extracted directory
 proc extract_archive_to_tmpdir {location} {
@@ -349,7 +390,7 @@ proc extract_archive_to_tmpdir {location} {
                     throw MACPORTS "No '$pax' was found on this system!"
                 }
             }
-            t(ar|bz|lz|xz|gz) {
+            t(ar|bz|lz|xz|gz|zst) {
                 global macports::hfscompression
                 # Opportunistic HFS compression. bsdtar will automatically
                 # disable this if filesystem does not support compression.
@@ -370,7 +411,7 @@ proc extract_archive_to_tmpdir {location} {
                     set unarchive.pre_args {-xvpf}
                 }
 
-                if {[regexp {z2?$} ${unarchive.type}]} {
+                if {[regexp {z2?$|zst$} ${unarchive.type}]} {
                     set unarchive.args {-}
                     if {[regexp {bz2?$} ${unarchive.type}]} {
                         if {![catch {macports::binaryInPath lbzip2}]} {
@@ -384,6 +425,8 @@ proc extract_archive_to_tmpdir {location} {
                         set gzip "lzma"
                     } elseif {[regexp {xz$} ${unarchive.type}]} {
                         set gzip "xz"
+                    } elseif {[regexp {zst$} ${unarchive.type}]} {
+                        set gzip "zstd"
                     } else {
                         set gzip "gzip"
                     }
@@ -462,7 +505,12 @@ proc _activate_contents {port {rename_list {}}} {
     set baksuffix .mp_[clock seconds]
     set location [$port location]
     set imagefiles [$port imagefiles]
-    set extracted_dir [extract_archive_to_tmpdir $location]
+    set in_place [_can_extract_in_place $location]
+    if {$in_place} {
+        set extracted_dir {}
+    } else {
+        set extracted_dir [extract_archive_to_tmpdir $location]
+    }
     set replaced_by_re "(?i)^[$port name]\$"
 
     set backups [list]
@@ -476,24 +524,38 @@ proc _activate_contents {port {rename_list {}}} {
     array set todeactivate {}
     try {
         registry::write {
+            # Look up all the owners in one query; only files that already
+            # belong to an active port are returned.
+            array set owners [registry::entry owners $imagefiles]
+            array set replaced {}
+            array set seen_dirs {}
+
             foreach file $imagefiles {
                 set srcfile "${extracted_dir}${file}"
 
                 # To be able to install links, we test if we can lstat the file to
                 # figure out if the source file exists (file exists will return
-                # false for symlinks on files that do not exist)
-                if { [catch {::file lstat $srcfile dummystatvar}] } {
+                # false for symlinks on files that do not exist). Files extracted
+                # in place are checked for when extracting them.
+                if { !$in_place && [catch {::file lstat $srcfile dummystatvar}] } {
                     throw registry::image-error "Image error: Source file $srcfile does not appear to exist (cannot lstat it).  Unable to activate port [$port name]."
                 }
 
-                set owner [registry::entry owner $file]
+                if {[info exists owners($file)]} {
+                    set owner $owners($file)
+                } else {
+                    set owner {}
+                }
 
                 if {$owner ne {} && $owner ne $port} {
                     # deactivate conflicting port if it is replaced_by this one
-                    set result [mportlookup [$owner name]]
-                    array unset portinfo
-                    array set portinfo [lindex $result 1]
-                    if {[info exists portinfo(replaced_by)] && [lsearch -regexp $portinfo(replaced_by) $replaced_by_re] != -1} {
+                    if {![info exists replaced($owner)]} {
+                        set result [mportlookup [$owner name]]
+                        array unset portinfo
+                        array set portinfo [lindex $result 1]
+                        set replaced($owner) [expr {[info exists portinfo(replaced_by)] && [lsearch -regexp $portinfo(replaced_by) $replaced_by_re] != -1}]
+                    }
+                    if {$replaced($owner)} {
                         # we'll deactivate the owner later, but before activating our files
                         set todeactivate($owner) yes
                         set owner "replaced"
@@ -536,7 +598,8 @@ proc _activate_contents {port {rename_list {}}} {
                 # we'll set the directory attributes properly for all
                 # directories.
                 set directory [::file dirname $file]
-                while {$directory ni $files} {
+                while {![info exists seen_dirs($directory)]} {
+                    set seen_dirs($directory) 1
                     lappend files $directory
                     set directory [::file dirname $directory]
                 }
@@ -574,16 +637,34 @@ proc _activate_contents {port {rename_list {}}} {
             # Activate it, and catch errors so we can roll-back
             try {
                 $port activate $imagefiles
-                foreach file $files {
-                    if {[_activate_file "${extracted_dir}${file}" $file] == 1} {
-                        lappend rollback_filelist $file
+                if {$in_place} {
+                    foreach {src dest} $confirmed_rename_list {
+                        $port deactivate [list $src]
+                        $port activate [list $src] [list $dest]
                     }
-                }
-                foreach {src dest} $confirmed_rename_list {
-                    $port deactivate [list $src]
-                    $port activate [list $src] [list $dest]
-                    if {[_activate_file ${extracted_dir}${src} $dest] == 1} {
-                        lappend rollback_filelist $dest
+                    # Files are created directly in their final location and
+                    # added to the rollback list as they are, so an error or
+                    # a signal half way leaves nothing behind. Directories
+                    # are created as needed, existing ones are left alone.
+                    ui_debug "activating files of $location in place"
+                    set missing [archive extract -files $imagefiles \
+                        -rename $confirmed_rename_list \
+                        -created rollback_filelist $location]
+                    if {$missing ne {}} {
+                        throw registry::image-error "Image error: Source file [lindex $missing 0] does not appear to exist (not in $location).  Unable to activate port [$port name]."
+                    }
+                } else {
+                    foreach file $files {
+                        if {[_activate_file "${extracted_dir}${file}" $file] == 1} {
+                            lappend rollback_filelist $file
+                        }
+                    }
+                    foreach {src dest} $confirmed_rename_list {
+                        $port deactivate [list $src]
+                        $port activate [list $src] [list $dest]
+                        if {[_activate_file ${extracted_dir}${src} $dest] == 1} {
+                            lappend rollback_filelist $dest
+                        }
                     }
                 }
 
@@ -648,10 +729,14 @@ proc _activate_contents {port {rename_list {}}} {
         }
 
         # remove temp image dir
-        ::file delete -force $extracted_dir
+        if {!$in_place} {
+            ::file delete -force $extracted_dir
+        }
         throw
     }
-    ::file delete -force $extracted_dir
+    if {!$in_place} {
+        ::file delete -force $extracted_dir
+    }
 }
 
 # These directories should not be removed during deactivation even if they are empty.
@@ -688,6 +773,7 @@ proc _deactivate_file {dstfile} {
 
 proc _deactivate_contents {port imagefiles {force 0} {rollback 0}} {
     set files [list]
+    array set seen_dirs {}
 
     foreach file $imagefiles {
         if { [::file exists $file] || (![catch {::file type $file}] && [::file type $file] eq "link") } {
@@ -706,7 +792,8 @@ proc _deactivate_contents {port imagefiles {force 0} {rollback 0}} {
 
             # Split out the filename's subpaths and add them to the image list
             # as well.
-            while {$directory ni $files} {
+            while {![info exists seen_dirs($directory)]} {
+                set seen_dirs($directory) 1
                 lappend files $directory
                 set directory [::file dirname $directory]
             }
@@ -403,6 +403,21 @@ proc property_retrieve {ref property} {
 	}
 }
 
+##
+#
+# Retrieve several properties from a receipt that was loaded in memory.
+#
+# ref			reference number for the receipt.
+# properties	list of keys for the properties to retrieve.
+#
+proc property_retrieve_many {ref properties} {
+	set ret [list]
+	foreach property $properties {
+		lappend ret [property_retrieve $ref $property]
+	}
+	return $ret
+}
+
 # Delete an entry
 proc delete_entry {name version {revision 0} {variants ""}} {
 	global macports::registry.path
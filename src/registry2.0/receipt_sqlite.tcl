@@ -52,17 +52,49 @@ namespace eval receipt_sqlite {
 #         is "installed", epoch).
 proc active {name} {
     if {$name ne ""} {
-        set ports [registry::entry installed $name]
+        set rows [search_ports state installed name $name]
     } else {
-        set ports [registry::entry installed]
+        set rows [search_ports state installed]
     }
     set rlist [list]
-    foreach port $ports {
-        lappend rlist [list [$port name] [$port version] [$port revision] [$port variants] [string equal [$port state] "installed"] [$port epoch]]
+    foreach row $rows {
+        lappend rlist [port_list $row]
     }
     return $rlist
 }
 
+##
+# Search the registry for ports without opening registry entries for them.
+#
+# @param args
+#        Search criteria as accepted by registry::entry search.
+# @return A list of dicts holding name, version, revision, variants, state and
+#         epoch of each matching port.
+proc search_ports {args} {
+    return [registry::entry search -props {name version revision variants state epoch} {*}$args]
+}
+
+##
+# Convert a dict as returned by #search_ports to a list in the form given by
+# #active.
+proc port_list {row} {
+    set ret [list]
+    foreach key {name version revision variants} {
+        if {[dict exists $row $key]} {
+            lappend ret [dict get $row $key]
+        } else {
+            lappend ret {}
+        }
+    }
+    lappend ret [expr {[dict exists $row state] && [dict get $row state] eq "installed"}]
+    if {[dict exists $row epoch]} {
+        lappend ret [dict get $row epoch]
+    } else {
+        lappend ret {}
+    }
+    return $ret
+}
+
 ##
 # Open an existing entry in the registry uniquely identified by name, version,
 # revision, variants and epoch and return a reference.
@@ -183,6 +215,46 @@ proc property_retrieve {ref property} {
     return $ret
 }
 
+##
+# Retrieve several properties from a registry entry with a single query.
+#
+# @param ref
+#        Reference to the registry entry.
+# @param properties
+#        List of names of the properties to retrieve.
+# @return A list of the values of the given properties, in the same order.
+#         Values follow the same rules as for #property_retrieve.
+proc property_retrieve_many {ref properties} {
+    set columns [list]
+    foreach property $properties {
+        if {$property eq "active"} {
+            lappend columns state
+        } else {
+            lappend columns $property
+        }
+    }
+    if {[catch {set values [$ref props $columns]}]} {
+        # at least one of the properties isn't a column; take the slow path
+        set ret [list]
+        foreach property $properties {
+            lappend ret [property_retrieve $ref $property]
+        }
+        return $ret
+    }
+    set ret [list]
+    foreach property $properties column $columns {
+        if {$property eq "active"} {
+            lappend ret [expr {[dict exists $values state] && [dict get $values state] eq "installed"}]
+        } elseif {[dict exists $values $column]} {
+            lappend ret [dict get $values $column]
+        } else {
+            # match behaviour of property_retrieve
+            lappend ret 0
+        }
+    }
+    return $ret
+}
+
 ##
 # Store a property in a registry entry.
 #
@@ -226,23 +298,25 @@ proc installed {{name ""} {version ""}} {
     # The syntax for that can be ambiguous if there's an underscore and dash in
     # version for example, so we don't attempt to split up the composite
     # version into its components, we just compare the whole thing.
-    if {$name eq "" && $version eq ""} {
-        set ports [registry::entry imaged]
-    } elseif {$name ne "" && $version eq ""} {
-        set ports [registry::entry imaged $name]
+    if {$name eq ""} {
+        set rows [search_ports]
     } else {
-        set ports {}
-        set possible_ports [registry::entry imaged $name]
-        foreach p $possible_ports {
-            if {"[$p version]_[$p revision][$p variants]" eq $version || [$p version] eq $version} {
-                lappend ports $p
-            }
-        }
+        set rows [search_ports name $name]
     }
 
     set rlist [list]
-    foreach port $ports {
-        lappend rlist [list [$port name] [$port version] [$port revision] [$port variants] [string equal [$port state] "installed"] [$port epoch]]
+    foreach row $rows {
+        set port [port_list $row]
+        if {![dict exists $row state] || [dict get $row state] ni {imaged installed}} {
+            continue
+        }
+        if {$version ne ""} {
+            lassign $port pname pversion prevision pvariants
+            if {"${pversion}_${prevision}${pvariants}" ne $version && $pversion ne $version} {
+                continue
+            }
+        }
+        lappend rlist $port
     }
     return $rlist
 }
@@ -186,10 +186,29 @@ reg_registry* registry_for(Tcl_Interp* interp, int status) {
     return reg;
 }
 
+/*
+ * registry::open ?-journal mode? db-file
+ *
+ * Attaches the registry database at db-file. If -journal is given, the
+ * database is switched to the given journal mode ("wal" or "delete") if
+ * possible.
+ */
 static int registry_open(ClientData clientData UNUSED, Tcl_Interp* interp,
         int objc, Tcl_Obj* CONST objv[]) {
+    static const char* journal_modes[] = { "wal", "delete", NULL };
+    const char* journal_mode = NULL;
+    if (objc == 4 && strcmp(Tcl_GetString(objv[1]), "-journal") == 0) {
+        int index;
+        if (Tcl_GetIndexFromObj(interp, objv[2], journal_modes,
+                    "journal mode", 0, &index) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        journal_mode = journal_modes[index];
+        objc -= 2;
+        objv += 2;
+    }
     if (objc != 2) {
-        Tcl_WrongNumArgs(interp, 1, objv, "db-file");
+        Tcl_WrongNumArgs(interp, 1, objv, "?-journal mode? db-file");
         return TCL_ERROR;
     } else {
         char* path = Tcl_GetString(objv[1]);
@@ -201,7 +220,7 @@ static int registry_open(ClientData clientData UNUSED, Tcl_Interp* interp,
         }
         if (reg == NULL) {
             return TCL_ERROR;
-        } else if (reg_attach(reg, path, &error)) {
+        } else if (reg_attach(reg, path, journal_mode, &error)) {
             return TCL_OK;
         } else {
             return registry_failed(interp, &error);
@@ -370,6 +389,43 @@ int metadata_cmd(ClientData clientData UNUSED, Tcl_Interp* interp, int objc,
     return TCL_ERROR;
 }
 
+/*
+ * registry::stats
+ *
+ * Returns a dict of statistics about the registry: the number of times a lock
+ * on the database had to be waited for (lock_waits), the total time spent
+ * waiting in milliseconds (lock_wait_time) and the journal mode of the
+ * database (journal_mode).
+ */
+static int registry_stats(ClientData clientData UNUSED, Tcl_Interp* interp,
+        int objc, Tcl_Obj* CONST objv[]) {
+    if (objc != 1) {
+        Tcl_WrongNumArgs(interp, 1, objv, NULL);
+        return TCL_ERROR;
+    } else {
+        reg_registry* reg = registry_for(interp, reg_attached);
+        Tcl_Obj* result;
+        reg_error error;
+        char* mode;
+        if (reg == NULL) {
+            return TCL_ERROR;
+        }
+        if (!reg_journal_mode(reg, &mode, &error)) {
+            return registry_failed(interp, &error);
+        }
+        result = Tcl_NewDictObj();
+        Tcl_DictObjPut(interp, result, Tcl_NewStringObj("lock_waits", -1),
+                Tcl_NewIntObj(reg->lock_waits));
+        Tcl_DictObjPut(interp, result, Tcl_NewStringObj("lock_wait_time", -1),
+                Tcl_NewWideIntObj(reg->lock_wait_time));
+        Tcl_DictObjPut(interp, result, Tcl_NewStringObj("journal_mode", -1),
+                Tcl_NewStringObj(mode, -1));
+        free(mode);
+        Tcl_SetObjResult(interp, result);
+        return TCL_OK;
+    }
+}
+
 /**
  * Initializer for the registry lib.
  *
@@ -388,6 +444,7 @@ int Registry_Init(Tcl_Interp* interp) {
     Tcl_CreateObjCommand(interp, "registry::file", file_cmd, NULL, NULL);
     Tcl_CreateObjCommand(interp, "registry::portgroup", portgroup_cmd, NULL, NULL);
     Tcl_CreateObjCommand(interp, "registry::metadata", metadata_cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "registry::stats", registry_stats, NULL, NULL);
     if (Tcl_PkgProvide(interp, "registry2", "2.0") != TCL_OK) {
         return TCL_ERROR;
     }
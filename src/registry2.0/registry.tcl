@@ -132,6 +132,13 @@ proc property_retrieve {ref property} {
 	return [${macports::registry.format}::property_retrieve $ref $property]
 }
 
+# Retrieve several properties from the open registry entry at once. Returns a
+# list of the values in the same order as the given property names.
+proc property_retrieve_many {ref properties} {
+	global macports::registry.format
+	return [${macports::registry.format}::property_retrieve_many $ref $properties]
+}
+
 # If only one version of the port is installed, this process returns that
 # version's parts.  Otherwise, it lists the versions installed and exits.
 proc installed {{name ""} {version ""}} {
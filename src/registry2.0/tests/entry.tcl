@@ -77,8 +77,34 @@ proc main {pextlibname} {
 
         # test that passing in confusing arguments doesn't crash
         test {[catch {registry::entry search name vim1 --}] == 1}
+
+        # fetch several properties at once
+        test_equal {[$vim3 props {name version revision variants}]} \
+            {name vim version 7.1.002 revision 0 variants +cscope+multibyte}
+        test_equal {[dict get [$zlib props {installtype state}] state]} installed
+        test_equal {[$zlib props {}]} {}
+        test {[catch {$zlib props {name nonexistent}}] == 1}
+
+        # search without opening entries
+        test_equal {[registry::entry search -props {name version} name pcre]} \
+            {{name pcre version 7.1}}
+        test_set {[registry::entry search -props name name -glob vi*]} \
+            {{name vim} {name vim} {name vim}}
+        test_equal {[llength [registry::entry search -props {name state}]]} 5
+        test_throws {registry::entry search -props {} name pcre} \
+            registry::misuse
     }
 
+    # property values are bound to cached statements rather than quoted into
+    # the query, so they must round-trip unchanged
+    registry::write {
+        $zlib portfile {it's a "portfile"}
+        $pcre portfile {}
+    }
+    test_equal {[$zlib portfile]} {it's a "portfile"}
+    test_equal {[$pcre portfile]} {}
+    test_equal {[$zlib name]} zlib
+
     # try mapping files and checking their owners
     registry::write {
 
@@ -130,6 +156,18 @@ proc main {pextlibname} {
         test_equal {[registry::entry owner /opt/local/bin/vimdiff]} {$vim2}
         test_equal {[registry::entry owner /opt/local/bin/vimdiff.0]} {$vim3}
 
+        # look up many owners at once; only owned paths are returned, in order
+        test_equal {[registry::entry owners {}]} {}
+        test_equal {[registry::entry owners [list /opt/local/bin/emacs \
+            /opt/local/bin/vimdiff.0 /opt/local/bin/vimtutor \
+            /opt/local/bin/vimdiff]]} \
+            {/opt/local/bin/vimdiff.0 $vim3 /opt/local/bin/vimdiff $vim2}
+        test_equal {[registry::entry owners [list /OPT/local/bin/vim]]} {}
+        test_equal {[registry::entry owners [list /OPT/local/bin/vim] 0]} \
+            {/OPT/local/bin/vim $vim3}
+        test_equal {[registry::entry owners [list /opt/local/bin/vim \
+            /opt/local/bin/vim]]} {/opt/local/bin/vim $vim3 /opt/local/bin/vim $vim3}
+
         # make sure you can't unmap a file you don't own
         test_throws {$zlib unmap [list /opt/local/bin/vim]} registry::invalid
         test_throws {$zlib unmap [list /opt/local/bin/emacs]} registry::invalid
@@ -137,6 +175,35 @@ proc main {pextlibname} {
 
     test_set {[$vim3 imagefiles]} {/opt/local/bin/vim /opt/local/bin/vimdiff}
     test_set {[$vim3 files]} {/opt/local/bin/vim /opt/local/bin/vimdiff.0}
+    test_equal {[registry::entry owners [list /opt/local/bin/vim]]} \
+        {/opt/local/bin/vim $vim3}
+
+    # iterate over files and ports without opening them
+    set seen {}
+    registry::file foreach {actual_path} [list id [$vim3 id] active 1] {
+        lappend seen $actual_path
+    }
+    test_set {$seen} {/opt/local/bin/vim /opt/local/bin/vimdiff.0}
+    test_equal {[registry::file count id [$vim3 id] active 1]} 2
+    test_equal {[registry::file count path -glob /opt/local/bin/vim*]} 8
+    set seen 0
+    registry::file foreach {path binary} {} {
+        incr seen
+        break
+    }
+    test_equal {$seen} 1
+    test {[catch {registry::file foreach {path} {} {error boom}} err] == 1}
+    test_equal {$err} boom
+    test {[catch {registry::file foreach {nonexistent} {} {}}] == 1}
+    test {[catch {registry::file foreach {path} {active} {}}] == 1}
+    set seen {}
+    registry::entry foreach {name state} {name -glob vi*} {
+        if {$state ne "installed"} {
+            continue
+        }
+        lappend seen $name
+    }
+    test_equal {$seen} vim
 
     # try some deletions
     test_set {[registry::entry installed zlib]} {$zlib}
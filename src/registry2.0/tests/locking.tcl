@@ -0,0 +1,156 @@
+# Test file for concurrent access to the registry from several processes
+# Syntax:
+# tclsh locking.tcl registry.dylib
+
+# Runs in a child process: holds a write transaction open for a while,
+# creating the file `ready` once the lock has been acquired.
+set holder_script {
+    lassign $argv pextlibname db
+    load $pextlibname
+    registry::open $db
+    registry::write {
+        registry::entry create holder 1 0 {} 0
+        close [open ready w]
+        after 1500
+    }
+    registry::close
+}
+
+# Runs in a child process: creates a number of entries, each in its own
+# write transaction, to contend with other writers.
+set writer_script {
+    lassign $argv pextlibname db name count
+    load $pextlibname
+    registry::open $db
+    for {set i 0} {$i < $count} {incr i} {
+        registry::write {
+            registry::entry create $name $i 0 {} 0
+        }
+    }
+    registry::close
+}
+
+# Runs in a child process as a user who can't write to the registry: prints
+# the number of entries.
+set reader_script {
+    lassign $argv pextlibname db
+    load $pextlibname
+    registry::open -journal delete $db
+    puts [llength [registry::entry search -props name]]
+    registry::close
+}
+
+# Returns the command running a command as nobody, if we can.
+proc as_nobody {} {
+    if {[exec id -u] != 0} {
+        return {}
+    }
+    if {[auto_execok runuser] ne ""} {
+        return {runuser -u nobody --}
+    }
+    if {[auto_execok sudo] ne ""} {
+        return {sudo -u nobody}
+    }
+    return {}
+}
+
+proc spawn {name script args} {
+    if {![file exists $name.tcl]} {
+        set fd [open $name.tcl w]
+        puts $fd $script
+        close $fd
+    }
+    return [open "|[list [info nameofexecutable] $name.tcl {*}$args] r"]
+}
+
+proc main {pextlibname} {
+    global holder_script writer_script reader_script
+    set pextlibname [file normalize $pextlibname]
+    load $pextlibname
+
+    # totally lame that file delete won't do it
+    exec -ignorestderr rm -f {*}[glob -nocomplain locking.db* ready holder.tcl writer.tcl reader.tcl]
+
+    test {[catch {registry::open -journal bogus locking.db}] == 1}
+    registry::open -journal wal locking.db
+    test_equal {[dict get [registry::stats] journal_mode]} wal
+    test_equal {[dict get [registry::stats] lock_waits]} 0
+    registry::write {
+        registry::entry create reader 1 0 {} 0
+    }
+
+    # with WAL, reading isn't blocked by a writer in another process
+    set holder [spawn holder $holder_script $pextlibname locking.db]
+    while {![file exists ready]} {
+        after 10
+    }
+    set start [clock milliseconds]
+    test_equal {[llength [registry::entry search -props name name reader]]} 1
+    test {[clock milliseconds] - $start < 1000}
+    test_equal {[dict get [registry::stats] lock_waits]} 0
+
+    # but writing has to wait for the lock, which shows up in the stats
+    registry::write {
+        registry::entry create waiter 1 0 {} 0
+    }
+    test {[clock milliseconds] - $start >= 1000}
+    test_equal {[dict get [registry::stats] lock_waits]} 1
+    test {[dict get [registry::stats] lock_wait_time] > 0}
+    close $holder
+    file delete ready
+
+    # several writers contending for the lock all get to write eventually
+    set writers {}
+    foreach name {w1 w2 w3 w4} {
+        lappend writers [spawn writer $writer_script $pextlibname locking.db $name 25]
+    }
+    foreach writer $writers {
+        close $writer
+    }
+    test_equal {[llength [registry::entry search -props name name -glob w?]]} 100
+
+    # users who can't write to the directory of the registry can read it,
+    # through the -wal and -shm files that are kept for them, or without
+    # them once they are gone
+    registry::close
+    set nobody [as_nobody]
+    if {$nobody ne ""} {
+        set fd [open reader.tcl w]
+        puts $fd $reader_script
+        close $fd
+        test {[file exists locking.db-wal] && [file exists locking.db-shm]}
+        test_equal {[exec {*}$nobody [info nameofexecutable] reader.tcl $pextlibname [file normalize locking.db]]} 103
+        file delete locking.db-wal locking.db-shm
+        test_equal {[exec {*}$nobody [info nameofexecutable] reader.tcl $pextlibname [file normalize locking.db]]} 103
+    }
+
+    # the journal mode can be switched back once nobody else uses the db
+    registry::open -journal delete locking.db
+    test_equal {[dict get [registry::stats] journal_mode]} delete
+    test_equal {[llength [registry::entry search -props name]]} 103
+
+    # foreach doesn't keep the registry locked while its body runs, so
+    # that other processes can write in the meantime; what they add is
+    # seen by the chunks read after it
+    set seen 0
+    registry::entry foreach {name} {} {
+        if {[incr seen] == 1} {
+            close [spawn writer $writer_script $pextlibname locking.db w5 300]
+        }
+    }
+    test_equal {$seen} 103
+    set names {}
+    registry::entry foreach {name} {} {
+        if {[llength [lappend names $name]] == 1} {
+            close [spawn writer $writer_script $pextlibname locking.db w6 10]
+        }
+    }
+    test_equal {[llength $names]} 413
+    test_equal {[llength [lsearch -all $names w6]]} 10
+    registry::close
+
+    file delete locking.db holder.tcl writer.tcl reader.tcl
+}
+
+source tests/common.tcl
+main $argv
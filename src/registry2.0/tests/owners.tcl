@@ -0,0 +1,101 @@
+# Test file for registry::entry owners at the scale of a large port
+# Syntax:
+# tclsh owners.tcl registry.dylib ?files?
+
+proc elapsed {script} {
+    set start [clock microseconds]
+    uplevel 1 $script
+    return [expr {([clock microseconds] - $start) / 1000.0}]
+}
+
+proc main {pextlibname {count 100000}} {
+    load $pextlibname
+
+    file delete -force owners.db
+
+    registry::open owners.db
+
+    # texlive-like layout: $count files spread over directories of 100 files
+    set afiles {}
+    set bfiles {}
+    for {set i 0} {$i < $count} {incr i} {
+        set dir /opt/local/share/texmf/d[expr {$i / 100}]
+        lappend afiles $dir/a$i
+        # every other file of b collides with one of a
+        if {$i % 2 == 0} {
+            lappend bfiles $dir/a$i
+        } else {
+            lappend bfiles $dir/b$i
+        }
+    }
+
+    registry::write {
+        set a [registry::entry create texlive-a 1 0 {} 0]
+        set b [registry::entry create texlive-b 1 0 {} 0]
+        $a map $afiles
+        $a activate $afiles
+        $b map $bfiles
+    }
+
+    registry::read {
+        set bulk_ms [elapsed {
+            array set owners [registry::entry owners $bfiles]
+        }]
+        set single_ms [elapsed {
+            set single {}
+            foreach file $bfiles {
+                set owner [registry::entry owner $file]
+                if {$owner ne {}} {
+                    lappend single $file $owner
+                }
+            }
+        }]
+    }
+    puts [format "%-40s %10.1f ms" "owner, $count files" $single_ms]
+    puts [format "%-40s %10.1f ms" "owners, $count files" $bulk_ms]
+
+    test_equal {[array size owners]} {[expr {$count / 2}]}
+    test_equal {[registry::entry owners $bfiles]} {$single}
+    test {$owners([lindex $bfiles 0]) eq $a}
+    test {![info exists owners([lindex $bfiles 1])]}
+
+    # the hashed directory set used by _activate_contents against the list
+    # membership test it replaced, which is quadratic so only gets a tenth
+    set hashed_ms [elapsed {
+        set files {}
+        array set seen_dirs {}
+        foreach file $bfiles {
+            set directory [file dirname $file]
+            while {![info exists seen_dirs($directory)]} {
+                set seen_dirs($directory) 1
+                lappend files $directory
+                set directory [file dirname $directory]
+            }
+            lappend files $file
+        }
+    }]
+    set hashed_files [lsort -unique $files]
+    set tenth [lrange $bfiles 0 [expr {$count / 10 - 1}]]
+    set list_ms [elapsed {
+        set files {}
+        foreach file $tenth {
+            set directory [file dirname $file]
+            while {$directory ni $files} {
+                lappend files $directory
+                set directory [file dirname $directory]
+            }
+            lappend files $file
+        }
+    }]
+    puts [format "%-40s %10.1f ms" "list directories, [llength $tenth] files" $list_ms]
+    puts [format "%-40s %10.1f ms" "hashed directories, $count files" $hashed_ms]
+
+    test_equal {[llength $hashed_files]} \
+        {[expr {$count + ($count + 99) / 100 + 5}]}
+
+    registry::close
+    file delete owners.db
+}
+
+source tests/common.tcl
+main {*}$argv
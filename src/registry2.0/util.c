@@ -236,6 +236,126 @@ int set_portgroup(Tcl_Interp* interp, char* name, reg_portgroup* portgroup,
     return 0;
 }
 
+/**
+ * Sets up a `foreach_data` for one of the `foreach` commands. Each variable
+ * in `varList` has to be named after one of `props`; the matching properties
+ * are stored in `data->columns`. Must be matched by a call to `foreach_free`
+ * if successful.
+ *
+ * @param [in] interp  Tcl interpreter the command is running in
+ * @param [out] data   the `foreach_data` to set up
+ * @param [in] varList list of variables to set for each row
+ * @param [in] body    script to evaluate for each row
+ * @param [in] props   NULL-terminated list of valid properties
+ * @return             TCL_OK if success; TCL_ERROR if failure
+ */
+int foreach_init(Tcl_Interp* interp, foreach_data* data, Tcl_Obj* varList,
+        Tcl_Obj* body, const char** props) {
+    Tcl_Obj** vars;
+    int i;
+    if (Tcl_ListObjGetElements(interp, varList, &data->var_count, &vars)
+            != TCL_OK) {
+        return TCL_ERROR;
+    }
+    data->interp = interp;
+    data->body = body;
+    data->status = TCL_OK;
+    /* copy the variables since the body might change the list */
+    data->vars = malloc((data->var_count + 1) * sizeof(Tcl_Obj*));
+    data->columns = malloc((data->var_count + 1) * sizeof(char*));
+    if (!data->vars || !data->columns) {
+        free(data->vars);
+        free(data->columns);
+        return TCL_ERROR;
+    }
+    for (i = 0; i < data->var_count; i++) {
+        int index;
+        if (Tcl_GetIndexFromObj(interp, vars[i], props, "prop", 0, &index)
+                != TCL_OK) {
+            free(data->vars);
+            free(data->columns);
+            return TCL_ERROR;
+        }
+        data->columns[i] = props[index];
+        data->vars[i] = vars[i];
+    }
+    for (i = 0; i < data->var_count; i++) {
+        Tcl_IncrRefCount(data->vars[i]);
+    }
+    Tcl_IncrRefCount(data->body);
+    return TCL_OK;
+}
+
+/**
+ * Frees the resources held by a `foreach_data` set up by `foreach_init`.
+ *
+ * @param [in] data the `foreach_data` to free
+ */
+void foreach_free(foreach_data* data) {
+    int i;
+    for (i = 0; i < data->var_count; i++) {
+        Tcl_DecrRefCount(data->vars[i]);
+    }
+    Tcl_DecrRefCount(data->body);
+    free(data->vars);
+    free(data->columns);
+}
+
+/**
+ * Row callback for the `foreach` commands, to be passed to cregistry's
+ * `reg_*_foreach` functions along with a `foreach_data`. Sets each variable to
+ * the value of the matching column of the current row (NULL values become the
+ * empty string) and evaluates the body in the caller's scope.
+ *
+ * @param [in] calldata     the `foreach_data` of the running command
+ * @param [in] values       the values of the current row
+ * @param [in] column_count the number of values
+ * @return                  true to continue with the next row; false to stop
+ */
+int foreach_row(void* calldata, char** values, int column_count UNUSED) {
+    foreach_data* data = (foreach_data*)calldata;
+    int i;
+    for (i = 0; i < data->var_count; i++) {
+        Tcl_Obj* value = values[i] == NULL ? Tcl_NewObj()
+            : Tcl_NewStringObj(values[i], -1);
+        if (Tcl_ObjSetVar2(data->interp, data->vars[i], NULL, value,
+                    TCL_LEAVE_ERR_MSG) == NULL) {
+            data->status = TCL_ERROR;
+            return 0;
+        }
+    }
+    data->status = Tcl_EvalObjEx(data->interp, data->body, 0);
+    switch (data->status) {
+        case TCL_OK:
+        case TCL_CONTINUE:
+            data->status = TCL_OK;
+            return 1;
+        case TCL_BREAK:
+            data->status = TCL_OK;
+            return 0;
+        case TCL_ERROR:
+            Tcl_AddErrorInfo(data->interp, "\n    (\"foreach\" body)");
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Finishes a `foreach` command after the search returned successfully. Leaves
+ * the result of an error or `return` in the body in place; otherwise, the
+ * result of the command is empty.
+ *
+ * @param [in] data the `foreach_data` of the command
+ * @return          the Tcl return code of the command
+ */
+int foreach_result(foreach_data* data) {
+    if (data->status == TCL_OK) {
+        Tcl_ResetResult(data->interp);
+    }
+    return data->status;
+}
+
 /**
  * Reports a sqlite3 error to Tcl.
  *
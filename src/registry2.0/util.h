@@ -47,6 +47,15 @@ typedef struct {
 
 #define END_FLAGS 0
 
+typedef struct {
+    Tcl_Interp* interp;
+    Tcl_Obj** vars; /* variables to set, one per selected column */
+    const char** columns; /* properties selected */
+    int var_count;
+    Tcl_Obj* body; /* script to evaluate for each row */
+    int status; /* Tcl return code of the last evaluation */
+} foreach_data;
+
 char* unique_name(Tcl_Interp* interp, char* prefix, int* lower_bound);
 
 int parse_flags(Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[], int* start,
@@ -63,6 +72,12 @@ int set_file(Tcl_Interp* interp, char* name, reg_file* file,
 int set_portgroup(Tcl_Interp* interp, char* name, reg_portgroup* portgroup,
         reg_error* errPtr);
 
+int foreach_init(Tcl_Interp* interp, foreach_data* data, Tcl_Obj* varList,
+        Tcl_Obj* body, const char** props);
+int foreach_row(void* calldata, char** values, int column_count);
+int foreach_result(foreach_data* data);
+void foreach_free(foreach_data* data);
+
 void set_sqlite_result(Tcl_Interp* interp, sqlite3* db, const char* query);
 
 const char* string_or_null(Tcl_Obj* obj);
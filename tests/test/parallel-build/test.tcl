@@ -0,0 +1,43 @@
+package require tcltest 2
+namespace import tcltest::*
+
+source [file dirname $argv0]/../library.tcl
+
+makeFile "" $output_file
+makeDirectory $work_dir
+set path [file dirname [file normalize $argv0]]
+
+load_variables $path
+set_dir
+port_index
+
+proc parallel_install {} {
+    global bindir portsrc output_file
+
+    if {[catch {exec -ignorestderr env PORTSRC=${portsrc} ${bindir}/port -d -N -J 2 install parallel-build >$output_file 2>@1}]} {
+        return "FAIL: install failed"
+    }
+    foreach subport {a b c} {
+        if {[get_line $output_file "*building parallel-build-$subport in a child process*"] == -1} {
+            return "FAIL: parallel-build-$subport not built in a child process"
+        }
+    }
+    set fd [open $output_file r]
+    set order [regexp -all -inline {Installing parallel-build-[a-c]} [read $fd]]
+    close $fd
+    set a [lsearch $order *-a]
+    set c [lsearch $order *-c]
+    if {$a == -1 || $c == -1 || $a > $c} {
+        return "FAIL: parallel-build-c installed before parallel-build-a"
+    }
+    return "Parallel install successful."
+}
+
+test parallel_build {
+    Regression test for building dependencies in parallel.
+} -body {
+    parallel_install
+} -result "Parallel install successful."
+
+cleanup
+cleanupTests